@@ -0,0 +1,86 @@
+#pragma once
+
+#ifndef __CAPYBARAKV_H__
+#define __CAPYBARAKV_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Keys and items are stored in fixed size slots; shorter ones are zero padded. These match
+// ycsb_ffi, so stores set up by either library can be opened by the other.
+#define CAPYBARAKV_MAX_KEY_LEN 24
+#define CAPYBARAKV_MAX_ITEM_LEN 1140
+
+enum capybarakv_status {
+    CAPYBARAKV_OK = 0,
+    CAPYBARAKV_NOT_FOUND = 1,
+    CAPYBARAKV_ALREADY_EXISTS = 2,
+    CAPYBARAKV_OUT_OF_SPACE = 3,
+    CAPYBARAKV_INVALID_ARGUMENT = 4,
+    CAPYBARAKV_ERROR = 5,
+};
+
+// A sharded store over the files <file_prefix>_0 .. <file_prefix>_<num_shards - 1>.
+struct capybarakv;
+
+// A handle to a store for one thread. Handles of one store may be used concurrently.
+struct capybarakv_handle;
+
+// One operation of a batch. status is set by the batch call.
+struct capybarakv_op {
+    const void* key;
+    size_t key_len;
+    void* item;          // input for put/update, output for get
+    size_t item_len;     // for get: capacity of item on input, bytes written on output
+    int status;
+};
+
+// Create a new store, removing any files left at file_prefix. Returns NULL on error.
+struct capybarakv* capybarakv_create(const char* file_prefix, uint64_t num_shards, uint64_t region_size,
+                                     uint64_t num_keys, uint64_t max_list_elements);
+
+// Recover a store created with the same file_prefix, num_shards and region_size.
+struct capybarakv* capybarakv_open(const char* file_prefix, uint64_t num_shards, uint64_t region_size);
+
+// Release all handles of db before closing it.
+void capybarakv_close(struct capybarakv* db);
+
+struct capybarakv_handle* capybarakv_get_handle(struct capybarakv* db);
+
+void capybarakv_release_handle(struct capybarakv_handle* handle);
+
+int capybarakv_put(struct capybarakv_handle* handle, const void* key, size_t key_len,
+                   const void* item, size_t item_len);
+
+// Copy up to *item_len bytes of the item into item and set *item_len to the bytes copied.
+int capybarakv_get(struct capybarakv_handle* handle, const void* key, size_t key_len,
+                   void* item, size_t* item_len);
+
+int capybarakv_update(struct capybarakv_handle* handle, const void* key, size_t key_len,
+                      const void* item, size_t item_len);
+
+int capybarakv_delete(struct capybarakv_handle* handle, const void* key, size_t key_len);
+
+int capybarakv_list_append(struct capybarakv_handle* handle, const void* key, size_t key_len,
+                           uint64_t element);
+
+// Copy up to *num_elements list elements into elements and set *num_elements to the list length.
+int capybarakv_list_read(struct capybarakv_handle* handle, const void* key, size_t key_len,
+                         uint64_t* elements, size_t* num_elements);
+
+// Run num_ops operations in one call and return how many of them succeeded.
+size_t capybarakv_put_batch(struct capybarakv_handle* handle, struct capybarakv_op* ops, size_t num_ops);
+size_t capybarakv_get_batch(struct capybarakv_handle* handle, struct capybarakv_op* ops, size_t num_ops);
+size_t capybarakv_update_batch(struct capybarakv_handle* handle, struct capybarakv_op* ops, size_t num_ops);
+size_t capybarakv_delete_batch(struct capybarakv_handle* handle, struct capybarakv_op* ops, size_t num_ops);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
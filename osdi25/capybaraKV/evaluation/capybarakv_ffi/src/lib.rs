@@ -0,0 +1,517 @@
+// C ABI for the sharded CapybaraKV store, so C and C++ harnesses can drive it in-process.
+// The functions here are declared in include/capybarakv.h.
+
+use capybarakv::kv2::spec_t::*;
+use capybarakv::kv2::shardkv_t::*;
+use capybarakv::kv2::shardkv_v::*;
+use capybarakv::kv2::concurrentspec_t::*;
+#[cfg(target_os = "linux")]
+use capybarakv::pmem::linux_pmemfile_t::*;
+#[cfg(target_os = "windows")]
+use capybarakv::pmem::windows_pmemfile_t::*;
+use capybarakv::pmem::pmcopy_t::*;
+use capybarakv::pmem::traits_t::{ConstPmSized, PmSized, UnsafeSpecPmSized, PmSafe};
+use pmcopy::PmCopy;
+#[allow(unused_imports)]
+use builtin::*;
+#[allow(unused_imports)]
+use builtin_macros::*;
+
+use std::collections::VecDeque;
+use std::ffi::{c_char, c_int, c_void, CStr};
+use std::hash::Hash;
+
+// Keep in sync with include/capybarakv.h and ycsb_ffi.
+const MAX_KEY_LEN: usize = 24;
+const MAX_ITEM_LEN: usize = 1140;
+
+// use a constant log id so we don't run into issues trying to restore a KV
+const KVSTORE_ID: u128 = 500;
+
+const CAPYBARAKV_OK: c_int = 0;
+const CAPYBARAKV_NOT_FOUND: c_int = 1;
+const CAPYBARAKV_ALREADY_EXISTS: c_int = 2;
+const CAPYBARAKV_OUT_OF_SPACE: c_int = 3;
+const CAPYBARAKV_INVALID_ARGUMENT: c_int = 4;
+const CAPYBARAKV_ERROR: c_int = 5;
+
+struct PlaceholderCB {}
+
+verus! {
+    impl<K, I, L, Op> MutatingLinearizer<K, I, L, Op> for PlaceholderCB
+    where
+        Op: MutatingOperation<K, I, L>,
+        K: Hash + PmCopy + Sized + std::fmt::Debug,
+        I: PmCopy + Sized + std::fmt::Debug,
+        L: PmCopy + LogicalRange + std::fmt::Debug + Copy,
+{
+    type Completion = Self;
+
+    closed spec fn namespaces(self) -> Set<int>
+    {
+        Set::empty()
+    }
+
+    closed spec fn pre(self, id: int, op: Op) -> bool
+    {
+        true
+    }
+
+    closed spec fn post(
+        self,
+        complete: Self::Completion,
+        id: int,
+        op: Op,
+        exec_result: Result<Op::KvResult, KvError>,
+    ) -> bool
+    {
+        true
+    }
+
+    proof fn apply(
+        tracked self,
+        op: Op,
+        new_ckv: ConcurrentKvStoreView<K, I, L>,
+        exec_result: Result<Op::KvResult, KvError>,
+        tracked r: &mut GhostVarAuth<ConcurrentKvStoreView<K, I, L>>
+    ) -> (tracked complete: Self::Completion)
+    {
+        admit();
+        self
+    }
+}
+
+impl<K, I, L, Op> ReadLinearizer<K, I, L, Op> for PlaceholderCB
+    where
+        Op: ReadOnlyOperation<K, I, L>,
+        K: Hash + PmCopy + Sized + std::fmt::Debug,
+        I: PmCopy + Sized + std::fmt::Debug,
+        L: PmCopy + LogicalRange + std::fmt::Debug + Copy,
+{
+    type Completion = Self;
+
+    closed spec fn namespaces(self) -> Set<int>
+    {
+        Set::empty()
+    }
+
+    closed spec fn pre(self, id: int, op: Op) -> bool
+    {
+        true
+    }
+
+    closed spec fn post(
+        self,
+        completion: Self,
+        id: int,
+        op: Op,
+        result: Result<Op::KvResult, KvError>,
+    ) -> bool
+    {
+        true
+    }
+
+    proof fn apply(
+        tracked self,
+        op: Op,
+        result: Result<Op::KvResult, KvError>,
+        tracked r: &GhostVarAuth<ConcurrentKvStoreView<K, I, L>>
+    ) -> tracked Self::Completion
+    {
+        self
+    }
+}
+}
+
+type Kv = ShardedKvStore::<FileBackedPersistentMemoryRegion, FfiKey, FfiItem, FfiListElement>;
+
+pub struct CapybaraKv {
+    kv: Kv,
+}
+
+// The store is shared by all threads; its operations take &self and synchronize per shard. A
+// handle only ties a thread to its store for now, but keeps room for per-thread state.
+pub struct CapybaraKvHandle {
+    db: *const CapybaraKv,
+}
+
+#[repr(C)]
+pub struct CapybaraKvOp {
+    key: *const c_void,
+    key_len: usize,
+    item: *mut c_void,
+    item_len: usize,
+    status: c_int,
+}
+
+#[repr(C)]
+#[derive(PmCopy, Copy, Debug, Hash)]
+struct FfiKey {
+    key: [i8; MAX_KEY_LEN],
+}
+
+#[repr(C)]
+#[derive(PmCopy, Copy, Debug)]
+struct FfiItem {
+    item: [i8; MAX_ITEM_LEN],
+}
+
+#[repr(C)]
+#[derive(PmCopy, Copy, Debug)]
+struct FfiListElement {
+    val: u64,
+}
+
+impl LogicalRange for FfiListElement {
+    fn start(&self) -> usize {
+        self.val as usize
+    }
+
+    fn end(&self) -> usize {
+        self.val as usize
+    }
+}
+
+fn status_of(e: &KvError) -> c_int {
+    match e {
+        KvError::KeyNotFound => CAPYBARAKV_NOT_FOUND,
+        KvError::KeyAlreadyExists => CAPYBARAKV_ALREADY_EXISTS,
+        KvError::OutOfSpace | KvError::TooManyKeys | KvError::TooManyListNodes => CAPYBARAKV_OUT_OF_SPACE,
+        KvError::InvalidParameter | KvError::InvalidKey | KvError::KeySizeTooBig
+            | KvError::ItemSizeTooBig => CAPYBARAKV_INVALID_ARGUMENT,
+        _ => CAPYBARAKV_ERROR,
+    }
+}
+
+fn status_of_result<T>(result: &Result<T, KvError>) -> c_int {
+    match result {
+        Ok(_) => CAPYBARAKV_OK,
+        Err(e) => status_of(e),
+    }
+}
+
+unsafe fn key_from_raw(key: *const c_void, key_len: usize) -> Option<FfiKey> {
+    if key.is_null() || key_len > MAX_KEY_LEN {
+        return None;
+    }
+    let mut k = FfiKey { key: [0i8; MAX_KEY_LEN] };
+    std::ptr::copy_nonoverlapping(key as *const i8, k.key.as_mut_ptr(), key_len);
+    Some(k)
+}
+
+unsafe fn item_from_raw(item: *const c_void, item_len: usize) -> Option<FfiItem> {
+    if item.is_null() || item_len > MAX_ITEM_LEN {
+        return None;
+    }
+    let mut i = FfiItem { item: [0i8; MAX_ITEM_LEN] };
+    std::ptr::copy_nonoverlapping(item as *const i8, i.item.as_mut_ptr(), item_len);
+    Some(i)
+}
+
+unsafe fn kv_of<'a>(handle: *mut CapybaraKvHandle) -> &'a Kv {
+    &(*(*handle).db).kv
+}
+
+fn get_kv_file_name(file_prefix: &str, id: u64) -> String {
+    format!("{}_{}", file_prefix, id)
+}
+
+unsafe fn file_prefix_from_raw(file_prefix: *const c_char) -> Option<String> {
+    if file_prefix.is_null() {
+        return None;
+    }
+    CStr::from_ptr(file_prefix).to_str().ok().map(|s| s.to_string())
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_create(
+    file_prefix: *const c_char,
+    num_shards: u64,
+    region_size: u64,
+    num_keys: u64,
+    max_list_elements: u64,
+) -> *mut CapybaraKv {
+    let file_prefix = match file_prefix_from_raw(file_prefix) {
+        Some(f) if num_shards > 0 => f,
+        _ => return std::ptr::null_mut(),
+    };
+
+    // add one to account for cases where the number of keys is not divisible
+    // by the number of shards
+    let setup_parameters = SetupParameters {
+        kvstore_id: KVSTORE_ID,
+        logical_range_gaps_policy: LogicalRangeGapsPolicy::LogicalRangeGapsPermitted,
+        max_keys: (num_keys / num_shards) + 1,
+        max_list_elements,
+        max_operations_per_transaction: 5,
+    };
+
+    let mut pms = VecDeque::new();
+    for i in 0..num_shards {
+        let file_name = get_kv_file_name(&file_prefix, i);
+        // Ignore the result, it's ok if the file doesn't exist.
+        let _ = std::fs::remove_file(&file_name);
+        match create_pm_region(&file_name, region_size) {
+            Some(pm) => pms.push_back(pm),
+            None => return std::ptr::null_mut(),
+        }
+    }
+
+    match setup::<FileBackedPersistentMemoryRegion, FfiKey, FfiItem, FfiListElement>(
+        pms, &setup_parameters, Ghost::assume_new(), Ghost::assume_new(), Ghost::assume_new()) {
+        Ok((kv, _)) => Box::into_raw(Box::new(CapybaraKv { kv })),
+        Err(e) => {
+            eprintln!("Error setting up CapybaraKV: {:?}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_open(
+    file_prefix: *const c_char,
+    num_shards: u64,
+    region_size: u64,
+) -> *mut CapybaraKv {
+    let file_prefix = match file_prefix_from_raw(file_prefix) {
+        Some(f) if num_shards > 0 => f,
+        _ => return std::ptr::null_mut(),
+    };
+
+    let mut pms = VecDeque::new();
+    for i in 0..num_shards {
+        match open_pm_region(&get_kv_file_name(&file_prefix, i), region_size) {
+            Some(pm) => pms.push_back(pm),
+            None => return std::ptr::null_mut(),
+        }
+    }
+
+    match recover(pms, KVSTORE_ID, Ghost::assume_new(), Ghost::assume_new(), Ghost::assume_new(),
+                  Ghost::assume_new()) {
+        Ok(kv) => Box::into_raw(Box::new(CapybaraKv { kv })),
+        Err(e) => {
+            eprintln!("Error recovering CapybaraKV: {:?}", e);
+            std::ptr::null_mut()
+        }
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_close(db: *mut CapybaraKv) {
+    if !db.is_null() {
+        // Drop the store so that all file descriptors, etc. are cleaned up
+        let _ = Box::from_raw(db);
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_get_handle(db: *mut CapybaraKv) -> *mut CapybaraKvHandle {
+    if db.is_null() {
+        return std::ptr::null_mut();
+    }
+    Box::into_raw(Box::new(CapybaraKvHandle { db }))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_release_handle(handle: *mut CapybaraKvHandle) {
+    if !handle.is_null() {
+        let _ = Box::from_raw(handle);
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_put(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+    item: *const c_void,
+    item_len: usize,
+) -> c_int {
+    let (k, i) = match (key_from_raw(key, key_len), item_from_raw(item, item_len)) {
+        (Some(k), Some(i)) => (k, i),
+        _ => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).create(&k, &i, Tracked::<PlaceholderCB>::assume_new());
+    status_of_result(&ret)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_get(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+    item: *mut c_void,
+    item_len: *mut usize,
+) -> c_int {
+    let k = match key_from_raw(key, key_len) {
+        Some(k) if !item.is_null() && !item_len.is_null() => k,
+        _ => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).read_item(&k, Tracked::<PlaceholderCB>::assume_new());
+    match ret {
+        Ok(i) => {
+            let len = (*item_len).min(MAX_ITEM_LEN);
+            std::ptr::copy_nonoverlapping(i.item.as_ptr(), item as *mut i8, len);
+            *item_len = len;
+            CAPYBARAKV_OK
+        }
+        Err(e) => status_of(&e),
+    }
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_update(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+    item: *const c_void,
+    item_len: usize,
+) -> c_int {
+    let (k, i) = match (key_from_raw(key, key_len), item_from_raw(item, item_len)) {
+        (Some(k), Some(i)) => (k, i),
+        _ => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).update_item(&k, &i, Tracked::<PlaceholderCB>::assume_new());
+    status_of_result(&ret)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_delete(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+) -> c_int {
+    let k = match key_from_raw(key, key_len) {
+        Some(k) => k,
+        None => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).delete(&k, Tracked::<PlaceholderCB>::assume_new());
+    status_of_result(&ret)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_list_append(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+    element: u64,
+) -> c_int {
+    let k = match key_from_raw(key, key_len) {
+        Some(k) => k,
+        None => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).append_to_list(&k, FfiListElement { val: element },
+                                                Tracked::<PlaceholderCB>::assume_new());
+    status_of_result(&ret)
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_list_read(
+    handle: *mut CapybaraKvHandle,
+    key: *const c_void,
+    key_len: usize,
+    elements: *mut u64,
+    num_elements: *mut usize,
+) -> c_int {
+    let k = match key_from_raw(key, key_len) {
+        Some(k) if !num_elements.is_null() && (elements.is_null() == (*num_elements == 0)) => k,
+        _ => return CAPYBARAKV_INVALID_ARGUMENT,
+    };
+    let (ret, _) = kv_of(handle).read_list(&k, Tracked::<PlaceholderCB>::assume_new());
+    match ret {
+        Ok(list) => {
+            for (idx, element) in list.iter().take(*num_elements).enumerate() {
+                *elements.add(idx) = element.val;
+            }
+            *num_elements = list.len();
+            CAPYBARAKV_OK
+        }
+        Err(e) => status_of(&e),
+    }
+}
+
+unsafe fn run_batch<F>(ops: *mut CapybaraKvOp, num_ops: usize, mut op_fn: F) -> usize
+    where F: FnMut(&mut CapybaraKvOp) -> c_int
+{
+    if ops.is_null() {
+        return 0;
+    }
+    let mut num_ok = 0;
+    for op in std::slice::from_raw_parts_mut(ops, num_ops) {
+        op.status = op_fn(op);
+        num_ok += (op.status == CAPYBARAKV_OK) as usize;
+    }
+    num_ok
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_put_batch(
+    handle: *mut CapybaraKvHandle,
+    ops: *mut CapybaraKvOp,
+    num_ops: usize,
+) -> usize {
+    run_batch(ops, num_ops, |op| capybarakv_put(handle, op.key, op.key_len, op.item, op.item_len))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_get_batch(
+    handle: *mut CapybaraKvHandle,
+    ops: *mut CapybaraKvOp,
+    num_ops: usize,
+) -> usize {
+    run_batch(ops, num_ops, |op| capybarakv_get(handle, op.key, op.key_len, op.item, &mut op.item_len))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_update_batch(
+    handle: *mut CapybaraKvHandle,
+    ops: *mut CapybaraKvOp,
+    num_ops: usize,
+) -> usize {
+    run_batch(ops, num_ops, |op| capybarakv_update(handle, op.key, op.key_len, op.item, op.item_len))
+}
+
+#[no_mangle]
+pub unsafe extern "C" fn capybarakv_delete_batch(
+    handle: *mut CapybaraKvHandle,
+    ops: *mut CapybaraKvOp,
+    num_ops: usize,
+) -> usize {
+    run_batch(ops, num_ops, |op| capybarakv_delete(handle, op.key, op.key_len))
+}
+
+fn create_pm_region(file_name: &str, region_size: u64) -> Option<FileBackedPersistentMemoryRegion>
+{
+    #[cfg(target_os = "windows")]
+    let pm_region = FileBackedPersistentMemoryRegion::new(
+        &file_name,
+        MemoryMappedFileMediaType::BatteryBackedDRAM,
+        region_size,
+        FileCloseBehavior::Persistent
+    );
+    #[cfg(target_os = "linux")]
+    let pm_region = FileBackedPersistentMemoryRegion::new(
+        &file_name,
+        region_size,
+        PersistentMemoryCheck::DontCheckForPersistentMemory,
+    );
+
+    pm_region.ok()
+}
+
+fn open_pm_region(file_name: &str, region_size: u64) -> Option<FileBackedPersistentMemoryRegion>
+{
+    #[cfg(target_os = "windows")]
+    let pm_region = FileBackedPersistentMemoryRegion::restore(
+        &file_name,
+        MemoryMappedFileMediaType::BatteryBackedDRAM,
+        region_size,
+    );
+    #[cfg(target_os = "linux")]
+    let pm_region = FileBackedPersistentMemoryRegion::restore(
+        &file_name,
+        region_size
+    );
+
+    pm_region.ok()
+}
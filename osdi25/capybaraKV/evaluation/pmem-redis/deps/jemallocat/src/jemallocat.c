@@ -192,6 +192,65 @@ static int get_page_bitmap(struct page* page, size_t item_count, size_t item_ind
     }
 }
 
+/*
+从page_id开始，计算连续的、可分配的、未被任何单元占用的页的个数（不超过highest_used_page）
+*/
+static size_t get_free_run_length(struct jemallocat* jemallocat, size_t page_id)
+{
+    size_t length = 0;
+    while(page_id + length <= jemallocat->highest_used_page)
+    {
+        struct page* page = jemallocat->pages + page_id + length;
+        if(page->std_size || page->bias)
+            break;
+        if(!jemallocat->is_page_allocatable(jemallocat->udata, page_id + length))
+            break;
+        length++;
+    }
+    return length;
+}
+
+/*
+用一个大对象一次性占据从page_id开始的若干个空闲页，代替逐页分配、逐页释放
+只有超过max_small_size、且标准化后大小不变的尺寸，分配器才会恰好为其切出这么多个连续的页
+大对象不超过8倍的max_small_size，以免超出一个chunk
+返回占据的页数，0表示未能占据（此时分配器的状态不变，调用者退回逐页分配）
+*/
+static size_t malloc_free_run(struct jemallocat* jemallocat, void* base_addr,
+    size_t page_id, size_t run_length)
+{
+    size_t page_size = jemallocat->page_size;
+    size_t min_pages = jemallocat->max_small_size / page_size + 1;
+    size_t max_pages = jemallocat->max_small_size * 8 / page_size;
+    size_t pages = run_length < max_pages ? run_length : max_pages;
+    /* 找到不超过该段长度的最大的标准尺寸 */
+    for(; pages >= min_pages; pages--)
+        if(jemallocat->standardize_size(jemallocat->udata, pages * page_size) == pages * page_size)
+            break;
+    if(pages < min_pages)
+        return 0;
+    void* ptr = jemallocat->malloc(jemallocat->udata, pages * page_size);
+    if(!ptr)
+        return 0;
+    if((size_t)((char*)ptr - (char*)base_addr) != page_id * page_size)
+    {
+        /* 不在预期的位置，归还之 */
+        jemallocat->free(jemallocat->udata, ptr);
+        return 0;
+    }
+    /* 首页记录该对象，之后的页视为被其覆盖（bias不小于页大小），两轮遍历都会跳过 */
+    struct page* page = jemallocat->pages + page_id;
+    page->std_size = pages * page_size;
+    page->bias = 0;
+    page->bitmap64 = 0;
+    for(size_t i = 1; i < pages; i++)
+    {
+        page[i].std_size = pages * page_size;
+        page[i].bias = page_size;
+    }
+    return pages;
+}
+
 int jemallocat_finish(struct jemallocat* jemallocat)
 {
     assert(jemallocat);
@@ -216,7 +275,19 @@ int jemallocat_finish(struct jemallocat* jemallocat)
         /* 这里被过滤掉的，有：1、整页都被某个大对象占用；2、上面的不可分配页 */
         if(page->bias >= jemallocat->page_size)
             continue;
-        /* 如果是空闲页，那么则用于分配一个大小刚好为一页的对象 */
+        /* 如果是空闲页，先尝试与之后的空闲页一起分配为一个大对象，
+           这样恢复时分配的次数取决于存活单元的个数，而不是空间的大小 */
+        if(!page->std_size)
+        {
+            size_t run_length = get_free_run_length(jemallocat, page_id);
+            size_t pages = malloc_free_run(jemallocat, base_addr, page_id, run_length);
+            if(pages)
+            {
+                page_id += pages - 1;
+                continue;
+            }
+        }
+        /* 否则用于分配一个大小刚好为一页的对象 */
         if(!page->std_size)
         {
             page->std_size = jemallocat->page_size;
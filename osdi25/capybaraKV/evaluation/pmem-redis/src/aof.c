@@ -213,6 +213,11 @@ void aof_background_fsync(int fd) {
 void stopAppendOnly(void) {
     serverAssert(server.aof_state != AOF_OFF);
     flushAppendOnlyFile(1);
+#ifdef USE_NVM
+    if (aofRingRelease() == C_ERR)
+        serverLog(LL_WARNING,"Error draining the AOF PMem ring, it will be "
+            "replayed on restart.");
+#endif
     aof_fsync(server.aof_fd);
     close(server.aof_fd);
 
@@ -293,10 +298,22 @@ int startAppendOnly(void) {
 void flushAppendOnlyFile(int force) {
     ssize_t nwritten;
     int sync_in_progress = 0;
+    int use_ring = 0;
     mstime_t latency;
 
     if (sdslen(server.aof_buf) == 0) return;
 
+#ifdef USE_NVM
+    /* With appendfsync always the write is durable once on the PMem ring,
+     * which is synced to the AOF in the background. Otherwise what it still
+     * holds must reach the AOF before this write. */
+    use_ring = server.aof_ring_enabled && server.aof_fsync == AOF_FSYNC_ALWAYS;
+    if (!use_ring && aofRingDetach() == C_ERR) {
+        server.aof_last_write_status = C_ERR;
+        return;
+    }
+#endif
+
     if (server.aof_fsync == AOF_FSYNC_EVERYSEC)
         sync_in_progress = bioPendingJobsOfType(BIO_AOF_FSYNC) != 0;
 
@@ -328,6 +345,12 @@ void flushAppendOnlyFile(int force) {
      * or alike */
 
     latencyStartMonitor(latency);
+#ifdef USE_NVM
+    if (use_ring) {
+        nwritten = aofRingAppend(server.aof_buf,sdslen(server.aof_buf)) == C_OK ?
+                   (ssize_t)sdslen(server.aof_buf) : -1;
+    } else
+#endif
 #ifdef USE_AOFGUARD
     if(server.aofguard.enable)
     {
@@ -452,7 +475,10 @@ void flushAppendOnlyFile(int force) {
             return;
 
     /* Perform the fsync if needed. */
-    if (server.aof_fsync == AOF_FSYNC_ALWAYS) {
+    if (use_ring) {
+        /* Persisted on the ring already. */
+        server.aof_last_fsync = server.unixtime;
+    } else if (server.aof_fsync == AOF_FSYNC_ALWAYS) {
         /* aof_fsync is defined as fdatasync() for Linux in order to avoid
          * flushing metadata. */
         latencyStartMonitor(latency);
@@ -2024,6 +2050,16 @@ void backgroundRewriteDoneHandler(int exitcode, int bysignal) {
             oldfd = -1; /* We'll set this to the current AOF filedes later. */
         }
 
+#ifdef USE_NVM
+        /* Once renamed the new AOF must not be written by a replay of the
+         * ring, whose records are for the old one: drain them first. */
+        if (aofRingDetach() == C_ERR) {
+            close(newfd);
+            if (oldfd != -1) close(oldfd);
+            goto cleanup;
+        }
+#endif
+
         /* Rename the temporary file. This will not unlink the target file if
          * it exists, because we reference it with "oldfd". */
         latencyStartMonitor(latency);
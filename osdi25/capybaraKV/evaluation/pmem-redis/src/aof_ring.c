@@ -0,0 +1,479 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "server.h"
+#include "bio.h"
+
+#ifdef USE_NVM
+#include <libpmem.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define AOF_RING_MAGIC 0x474e4952464f4152ULL    /* "RAOFRING" */
+#define AOF_RING_RECORD_MAGIC 0x52464f41U       /* "AOFR" */
+#define AOF_RING_HEADER_SIZE 4096
+#define AOF_RING_DRAIN_BYTES (1<<20)            /* pending bytes to drain */
+
+/* Offsets in the ring only grow, a record at offset 'off' is stored at
+ * off % capacity, possibly wrapping around the end of the data area.
+ * A record is valid if it carries its own offset and its checksum matches,
+ * so a record torn by a crash before its fence, or one left by a previous
+ * lap, ends the replay. */
+typedef struct aofRingHeader {
+    uint64_t magic;
+    uint64_t capacity;
+    uint64_t drained;       /* records before are in the AOF and synced */
+} aofRingHeader;
+
+typedef struct aofRingRecord {
+    uint32_t magic;
+    uint32_t len;           /* payload bytes, following the record */
+    uint64_t ring_off;      /* offset of this record in the ring */
+    uint64_t aof_off;       /* offset of the payload in the AOF */
+    uint64_t crc;           /* crc64 of the fields above and the payload */
+} aofRingRecord;
+
+#define AOF_RING_RECORD_SIZE(len) \
+    (sizeof(aofRingRecord) + (((size_t)(len) + 7) & ~(size_t)7))
+
+static struct {
+    char *path;
+    aofRingHeader *hdr;
+    char *data;
+    size_t capacity;
+    size_t mapped_len;
+    int is_pmem;
+    size_t head;            /* main thread: offset of the next record */
+    size_t durable;         /* end of the persisted records */
+    size_t drained;         /* end of the records drained to the AOF */
+    off_t aof_off;          /* main thread: AOF offset of the next payload */
+    int fd;                 /* AOF drained to, -1 when detached */
+    struct iovec iov[IOV_MAX];
+} ring = { .fd = -1 };
+
+/* Serializes the drains of the bio thread and of the main thread. */
+static pthread_mutex_t ring_drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* ----------------------------- ring access ------------------------------ */
+
+static void ringCopy(char *dst, const void *src, size_t len) {
+    if (ring.is_pmem) {
+        pmem_memcpy(dst,src,len,PMEM_F_MEM_NONTEMPORAL|PMEM_F_MEM_NODRAIN);
+    } else {
+        memcpy(dst,src,len);
+        pmem_msync(dst,len);
+    }
+}
+
+/* Store 'len' bytes at ring offset 'off', without waiting for them to be
+ * persistent. */
+static void ringWrite(size_t off, const void *src, size_t len) {
+    size_t pos = off % ring.capacity, first = ring.capacity - pos;
+
+    if (first > len) first = len;
+    ringCopy(ring.data+pos,src,first);
+    if (len > first) ringCopy(ring.data,(const char*)src+first,len-first);
+}
+
+static void ringRead(size_t off, void *dst, size_t len) {
+    size_t pos = off % ring.capacity, first = ring.capacity - pos;
+
+    if (first > len) first = len;
+    memcpy(dst,ring.data+pos,first);
+    if (len > first) memcpy((char*)dst+first,ring.data,len-first);
+}
+
+/* Fill 'iov' with the one or two pieces of the ring range, returns their
+ * number. */
+static int ringPieces(size_t off, size_t len, struct iovec *iov) {
+    size_t pos = off % ring.capacity, first = ring.capacity - pos;
+
+    if (first >= len) {
+        iov[0].iov_base = ring.data+pos;
+        iov[0].iov_len = len;
+        return 1;
+    }
+    iov[0].iov_base = ring.data+pos;
+    iov[0].iov_len = first;
+    iov[1].iov_base = ring.data;
+    iov[1].iov_len = len-first;
+    return 2;
+}
+
+static void ringPersist(const void *addr, size_t len) {
+    if (ring.is_pmem)
+        pmem_persist(addr,len);
+    else
+        pmem_msync(addr,len);
+}
+
+static void ringSetDrained(size_t off) {
+    ring.hdr->drained = off;
+    ringPersist(&ring.hdr->drained,sizeof(ring.hdr->drained));
+    __atomic_store_n(&ring.drained,off,__ATOMIC_RELEASE);
+}
+
+/* Return 1 if the record at 'off' was completely persisted. */
+static int ringRecordValid(size_t off, aofRingRecord *rec) {
+    struct iovec iov[2];
+    uint64_t crc;
+    int j, n;
+
+    ringRead(off,rec,sizeof(*rec));
+    if (rec->magic != AOF_RING_RECORD_MAGIC || rec->ring_off != off ||
+        AOF_RING_RECORD_SIZE(rec->len) > ring.capacity) return 0;
+    crc = crc64(0,(unsigned char*)rec,offsetof(aofRingRecord,crc));
+    n = ringPieces(off+sizeof(*rec),rec->len,iov);
+    for (j = 0; j < n; j++)
+        crc = crc64(crc,iov[j].iov_base,iov[j].iov_len);
+    return crc == rec->crc;
+}
+
+/* Write all the buffers of 'iov', which is modified. */
+static int ringWritev(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt) {
+        ssize_t nwritten = writev(fd,iov,iovcnt);
+
+        if (nwritten == -1) {
+            if (errno == EINTR) continue;
+            return C_ERR;
+        }
+        while (iovcnt && (size_t)nwritten >= iov->iov_len) {
+            nwritten -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt) {
+            iov->iov_base = (char*)iov->iov_base + nwritten;
+            iov->iov_len -= nwritten;
+        }
+    }
+    return C_OK;
+}
+
+/* ------------------------------- draining ------------------------------- */
+
+/* Write the persisted records not drained yet to the AOF and sync it. Must
+ * be called with ring_drain_mutex held. On error the AOF is truncated back
+ * to where the drain started, so that the next attempt doesn't duplicate
+ * what was written. */
+static int ringDrainLocked(void) {
+    size_t end = __atomic_load_n(&ring.durable,__ATOMIC_ACQUIRE);
+    size_t off = ring.drained;
+    off_t start = -1;
+    int iovcnt = 0;
+
+    if (off == end || ring.fd == -1) return C_OK;
+    while (off < end) {
+        aofRingRecord rec;
+
+        ringRead(off,&rec,sizeof(rec));
+        if (start == -1) start = rec.aof_off;
+        iovcnt += ringPieces(off+sizeof(rec),rec.len,ring.iov+iovcnt);
+        off += AOF_RING_RECORD_SIZE(rec.len);
+        if (off == end || iovcnt >= IOV_MAX-1) {
+            if (ringWritev(ring.fd,ring.iov,iovcnt) == C_ERR) goto werr;
+            iovcnt = 0;
+        }
+    }
+    if (aof_fsync(ring.fd) == -1) goto werr;
+    ringSetDrained(end);
+    return C_OK;
+
+werr:
+    serverLog(LL_WARNING,"Error draining the AOF PMem ring: %s",
+        strerror(errno));
+    if (ftruncate(ring.fd,start) == -1) {
+        serverLog(LL_WARNING,"Could not remove a partial drain from the "
+            "append-only file: %s",strerror(errno));
+    }
+    return C_ERR;
+}
+
+/* Called by the bio thread. */
+void aofRingDrain(void) {
+    pthread_mutex_lock(&ring_drain_mutex);
+    ringDrainLocked();
+    pthread_mutex_unlock(&ring_drain_mutex);
+}
+
+/* Drain the whole ring, and stop draining to the current AOF. The next
+ * append attaches it to server.aof_fd again.
+ *
+ * Records left by aofRingRelease() are for an AOF closed since. The AOF is
+ * only opened again by a rewrite, which includes them, so they are dropped
+ * here instead of being drained or replayed to the new file. */
+int aofRingDetach(void) {
+    int retval = C_OK;
+
+    if (!ring.hdr) return C_OK;
+    pthread_mutex_lock(&ring_drain_mutex);
+    if (ring.fd == -1) {
+        if (ring.drained != ring.durable) {
+            serverLog(LL_NOTICE,"Dropping %zu bytes of the AOF PMem ring "
+                "left from the previous append-only file.",
+                ring.durable - ring.drained);
+            ringSetDrained(ring.durable);
+        }
+    } else {
+        retval = ringDrainLocked();
+        if (retval == C_OK) ring.fd = -1;
+    }
+    pthread_mutex_unlock(&ring_drain_mutex);
+    return retval;
+}
+
+/* Like aofRingDetach(), for an AOF file descriptor about to be closed: the
+ * ring is detached even if the drain fails, so that neither the bio thread
+ * nor the cron writes to the closed descriptor. The records not drained are
+ * replayed on restart. */
+int aofRingRelease(void) {
+    int retval;
+
+    if (!ring.hdr) return C_OK;
+    pthread_mutex_lock(&ring_drain_mutex);
+    retval = ringDrainLocked();
+    ring.fd = -1;
+    pthread_mutex_unlock(&ring_drain_mutex);
+    return retval;
+}
+
+static int ringAttach(int fd) {
+    off_t size = lseek(fd,0,SEEK_END);
+
+    if (size == -1) return C_ERR;
+    pthread_mutex_lock(&ring_drain_mutex);
+    ring.fd = fd;
+    ring.aof_off = size;
+    pthread_mutex_unlock(&ring_drain_mutex);
+    return C_OK;
+}
+
+/* Drain once per second what didn't reach AOF_RING_DRAIN_BYTES. */
+void aofRingCron(void) {
+    if (!ring.hdr || ring.fd == -1) return;
+    if (__atomic_load_n(&ring.drained,__ATOMIC_ACQUIRE) != ring.durable &&
+        bioPendingJobsOfType(BIO_AOF_RING) == 0)
+    {
+        bioCreateBackgroundJob(BIO_AOF_RING,NULL,NULL,NULL);
+    }
+}
+
+/* ------------------------------- appending ------------------------------ */
+
+/* Append 'buf' to the AOF. On success it is persistent on return: one
+ * fence covers the record and its payload, the order in which they reach
+ * PMem doesn't matter as both are checked on replay. */
+int aofRingAppend(const char *buf, size_t len) {
+    aofRingRecord rec;
+    size_t need = AOF_RING_RECORD_SIZE(len);
+
+    if (!ring.hdr &&
+        aofRingOpen(server.aof_ring_file,server.aof_ring_size,NULL) == C_ERR)
+        return C_ERR;
+    if (ring.fd == -1 && ringAttach(server.aof_fd) == C_ERR) return C_ERR;
+
+    if (need > ring.capacity || len > UINT32_MAX) {
+        /* Larger than the whole ring, write it through. */
+        struct iovec iov = { (void*)buf, len };
+
+        if (aofRingDetach() == C_ERR) return C_ERR;
+        if (ringWritev(server.aof_fd,&iov,1) == C_ERR ||
+            aof_fsync(server.aof_fd) == -1) return C_ERR;
+        return C_OK;
+    }
+    if (ring.head + need - __atomic_load_n(&ring.drained,__ATOMIC_ACQUIRE) >
+        ring.capacity)
+    {
+        /* Full, drain it from the main thread. */
+        pthread_mutex_lock(&ring_drain_mutex);
+        int retval = ringDrainLocked();
+        pthread_mutex_unlock(&ring_drain_mutex);
+        if (retval == C_ERR) return C_ERR;
+    }
+
+    rec.magic = AOF_RING_RECORD_MAGIC;
+    rec.len = len;
+    rec.ring_off = ring.head;
+    rec.aof_off = ring.aof_off;
+    rec.crc = crc64(0,(unsigned char*)&rec,offsetof(aofRingRecord,crc));
+    rec.crc = crc64(rec.crc,(const unsigned char*)buf,len);
+    ringWrite(ring.head,&rec,sizeof(rec));
+    ringWrite(ring.head+sizeof(rec),buf,len);
+    if (ring.is_pmem) pmem_drain();
+
+    ring.head += need;
+    ring.aof_off += len;
+    __atomic_store_n(&ring.durable,ring.head,__ATOMIC_RELEASE);
+    if (ring.head - __atomic_load_n(&ring.drained,__ATOMIC_ACQUIRE) >=
+        AOF_RING_DRAIN_BYTES && bioPendingJobsOfType(BIO_AOF_RING) == 0)
+    {
+        bioCreateBackgroundJob(BIO_AOF_RING,NULL,NULL,NULL);
+    }
+    return C_OK;
+}
+
+/* ------------------------------- recovery ------------------------------- */
+
+/* Write the records persisted but not drained to 'aof_filename', then
+ * truncate it after the last one. */
+static int ringReplay(const char *aof_filename) {
+    size_t off = ring.drained, records = 0, bytes = 0;
+    off_t aof_end = -1;
+    int fd = -1;
+    aofRingRecord rec;
+    struct stat sb;
+
+    while (off - ring.drained < ring.capacity && ringRecordValid(off,&rec)) {
+        struct iovec iov[2];
+        off_t aof_off = rec.aof_off;
+        int j, n;
+
+        if (fd == -1) {
+            fd = open(aof_filename,O_WRONLY|O_CREAT,0644);
+            if (fd == -1 || fstat(fd,&sb) == -1) goto werr;
+            aof_end = sb.st_size;
+        }
+        /* Records written before the last drain was recorded are written
+         * again, at the same place, a gap means the AOF is not the one the
+         * ring drained to. */
+        if (aof_off > aof_end) {
+            serverLog(LL_WARNING,"The AOF PMem ring doesn't match the "
+                "append-only file, not replaying it from offset %lld.",
+                (long long)aof_off);
+            break;
+        }
+        n = ringPieces(off+sizeof(rec),rec.len,iov);
+        for (j = 0; j < n; j++) {
+            char *p = iov[j].iov_base;
+            size_t left = iov[j].iov_len;
+
+            while (left) {
+                ssize_t nwritten = pwrite(fd,p,left,aof_off);
+
+                if (nwritten == -1) {
+                    if (errno == EINTR) continue;
+                    goto werr;
+                }
+                p += nwritten;
+                left -= nwritten;
+                aof_off += nwritten;
+            }
+        }
+        aof_end = aof_off;
+        off += AOF_RING_RECORD_SIZE(rec.len);
+        records++;
+        bytes += rec.len;
+    }
+    if (fd != -1) {
+        if (ftruncate(fd,aof_end) == -1 || aof_fsync(fd) == -1) goto werr;
+        close(fd);
+        serverLog(LL_NOTICE,"Replayed %zu records (%zu bytes) of the AOF "
+            "PMem ring", records, bytes);
+    }
+    ringSetDrained(off);
+    return C_OK;
+
+werr:
+    serverLog(LL_WARNING,"Error replaying the AOF PMem ring to %s: %s",
+        aof_filename, strerror(errno));
+    if (fd != -1) close(fd);
+    return C_ERR;
+}
+
+static int ringMap(const char *path, size_t len, int flags) {
+    void *addr = pmem_map_file(path,len,flags,0644,&ring.mapped_len,
+                               &ring.is_pmem);
+
+    if (addr == NULL) {
+        serverLog(LL_WARNING,"Can't map the AOF PMem ring %s: %s",
+            path, strerror(errno));
+        return C_ERR;
+    }
+    ring.hdr = addr;
+    ring.data = (char*)addr + AOF_RING_HEADER_SIZE;
+    ring.capacity = ring.mapped_len - AOF_RING_HEADER_SIZE;
+    return C_OK;
+}
+
+/* Map the ring at 'path', of 'size' bytes. The records of an existing ring
+ * are replayed to 'aof_filename', or discarded if it is NULL. */
+int aofRingOpen(const char *path, size_t size, const char *aof_filename) {
+    size = (size + 4095) & ~(size_t)4095;
+    zfree(ring.path);
+    ring.path = zstrdup(path);
+
+    if (access(path,F_OK) == 0) {
+        if (ringMap(path,0,0) == C_ERR) return C_ERR;
+        if (ring.mapped_len > AOF_RING_HEADER_SIZE &&
+            ring.hdr->magic == AOF_RING_MAGIC &&
+            ring.hdr->capacity == ring.capacity)
+        {
+            ring.drained = ring.hdr->drained;
+            if (aof_filename) {
+                if (ringReplay(aof_filename) == C_ERR) return C_ERR;
+            } else {
+                /* Skip a whole lap, no record is valid past it. */
+                ringSetDrained(ring.drained + ring.capacity);
+            }
+            if (ring.capacity == size) {
+                ring.head = ring.durable = ring.drained;
+                return C_OK;
+            }
+        } else {
+            serverLog(LL_WARNING,"Ignoring the invalid AOF PMem ring %s",
+                path);
+        }
+        aofRingClose(1);
+    }
+
+    /* A new file reads as zeros, it holds no valid record. */
+    if (ringMap(path,AOF_RING_HEADER_SIZE+size,PMEM_FILE_CREATE) == C_ERR)
+        return C_ERR;
+    ring.hdr->capacity = ring.capacity;
+    ring.hdr->drained = 0;
+    ringPersist(ring.hdr,sizeof(*ring.hdr));
+    ring.hdr->magic = AOF_RING_MAGIC;
+    ringPersist(&ring.hdr->magic,sizeof(ring.hdr->magic));
+    ring.head = ring.durable = ring.drained = 0;
+    return C_OK;
+}
+
+/* Unmap the ring, which must be detached, and optionally remove it. */
+void aofRingClose(int remove) {
+    if (!ring.hdr) return;
+    pmem_unmap(ring.hdr,ring.mapped_len);
+    ring.hdr = NULL;
+    if (remove) unlink(ring.path);
+}
+
+#endif /* USE_NVM */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (c) 2018, Intel Corporation
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *   * Redistributions of source code must retain the above copyright notice,
+ *     this list of conditions and the following disclaimer.
+ *   * Redistributions in binary form must reproduce the above copyright
+ *     notice, this list of conditions and the following disclaimer in the
+ *     documentation and/or other materials provided with the distribution.
+ *   * Neither the name of Redis nor the names of its contributors may be used
+ *     to endorse or promote products derived from this software without
+ *     specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __AOF_RING_H
+#define __AOF_RING_H
+#include <stddef.h>
+
+/* With appendfsync always, the AOF buffer is appended to a ring on PMem and
+ * is durable once that single write is persisted. A bio thread drains the
+ * ring to the AOF file in large writes followed by one fdatasync. On restart
+ * the records not drained yet are written to the AOF before it is loaded.
+ *
+ * The ring is "attached" to the AOF file descriptor it drains to. Writing
+ * to that file by other means requires to detach the ring first, which
+ * drains it, so that the AOF keeps the order of the writes. Closing that
+ * file requires to release the ring, which detaches it even if it can't be
+ * drained. */
+int aofRingOpen(const char *path, size_t size, const char *aof_filename);
+void aofRingClose(int remove);
+int aofRingAppend(const char *buf, size_t len);
+int aofRingDetach(void);
+int aofRingRelease(void);
+void aofRingDrain(void);
+void aofRingCron(void);
+
+#endif
@@ -192,13 +192,18 @@ void *bioProcessBackgroundJobs(void *arg) {
             /* What we free changes depending on what arguments are set:
              * arg1 -> free the object at pointer.
              * arg2 & arg3 -> free two dictionaries (a Redis DB).
-             * only arg3 -> free the skiplist. */
+             * only arg3 -> free the skiplist.
+             * only arg2 -> release the NVM copy-on-write state of a BGSAVE. */
             if (job->arg1)
                 lazyfreeFreeObjectFromBioThread(job->arg1);
             else if (job->arg2 && job->arg3)
                 lazyfreeFreeDatabaseFromBioThread(job->arg2,job->arg3);
             else if (job->arg3)
                 lazyfreeFreeSlotsMapFromBioThread(job->arg3);
+#ifdef AEP_COW
+            else if (job->arg2)
+                cow_release(job->arg2);
+#endif
         }
 #ifdef USE_AOFGUARD
         else if(type == BIO_DEINIT_AOFGUARD)
@@ -211,6 +216,11 @@ void *bioProcessBackgroundJobs(void *arg) {
             }
             zfree(aofguard);
         }
+#endif
+#ifdef USE_NVM
+        else if (type == BIO_AOF_RING) {
+            aofRingDrain();
+        }
 #endif
         else {
             serverPanic("Wrong job type in bioProcessBackgroundJobs().");
@@ -42,7 +42,13 @@ void bioKillThreads(void);
 
 #ifdef USE_AOFGUARD
 #define BIO_DEINIT_AOFGUARD 3
-#define BIO_NUM_OPS         4
+#endif
+
+#ifdef USE_NVM
+#define BIO_AOF_RING      4 /* Drain the AOF PMem ring. */
+#define BIO_NUM_OPS       5
+#elif defined(USE_AOFGUARD)
+#define BIO_NUM_OPS       4
 #else
 #define BIO_NUM_OPS       3
 #endif
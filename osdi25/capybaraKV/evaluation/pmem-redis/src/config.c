@@ -436,6 +436,17 @@ void loadServerConfigFromString(char *config) {
             server.hz = atoi(argv[1]);
             if (server.hz < CONFIG_MIN_HZ) server.hz = CONFIG_MIN_HZ;
             if (server.hz > CONFIG_MAX_HZ) server.hz = CONFIG_MAX_HZ;
+        } else if (!strcasecmp(argv[0],"io-threads") && argc == 2) {
+            server.io_threads_num = atoi(argv[1]);
+            if (server.io_threads_num < 1 ||
+                server.io_threads_num > IO_THREADS_MAX_NUM)
+            {
+                err = "Invalid number of I/O threads"; goto loaderr;
+            }
+        } else if (!strcasecmp(argv[0],"io-threads-do-reads") && argc == 2) {
+            if ((server.io_threads_do_reads = yesnotoi(argv[1])) == -1) {
+                err = "argument must be 'yes' or 'no'"; goto loaderr;
+            }
         } else if (!strcasecmp(argv[0],"appendonly") && argc == 2) {
             int yes;
 
@@ -766,6 +777,45 @@ void loadServerConfigFromString(char *config) {
                 goto loaderr;
             }
         }
+        else if(!strcasecmp(argv[0], "nvm-dram-budget")) {
+            if(argc != 2) {
+                err = "--nvm-dram-budget <bytes>";
+                goto loaderr;
+            }
+            server.nvm_dram_budget = memtoll(argv[1],NULL);
+        }
+        else if(!strcasecmp(argv[0], "nvm-tiering-rate")) {
+            if(argc != 2) {
+                err = "--nvm-tiering-rate <bytes per second>";
+                goto loaderr;
+            }
+            server.nvm_tiering_rate = memtoll(argv[1],NULL);
+            if(server.nvm_tiering_rate == 0) {
+                err = "nvm-tiering-rate must be greater than 0";
+                goto loaderr;
+            }
+        }
+        else if(!strcasecmp(argv[0], "aof-pmem-ring")) {
+            if(argc != 2) {
+                err = "--aof-pmem-ring <yes or no>";
+                goto loaderr;
+            }
+            if((server.aof_ring_enabled = yesnotoi(argv[1])) == -1) {
+                err = "argument must be 'yes' or 'no'";
+                goto loaderr;
+            }
+        }
+        else if(!strcasecmp(argv[0], "aof-pmem-ring-size")) {
+            if(argc != 2) {
+                err = "--aof-pmem-ring-size <bytes>";
+                goto loaderr;
+            }
+            server.aof_ring_size = memtoll(argv[1],NULL);
+            if(server.aof_ring_size < (1<<20)) {
+                err = "aof-pmem-ring-size must be at least 1mb";
+                goto loaderr;
+            }
+        }
 #endif
 
 #ifdef SUPPORT_PBA
@@ -812,6 +862,27 @@ void loadServerConfigFromString(char *config) {
         server.aofguard.enable = 1;
 #endif
 
+#ifdef USE_NVM
+    if(server.nvm_dir)
+    {
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s/redis-%d.aofring", server.nvm_dir, server.port);
+        server.aof_ring_file = zstrdup(filename);
+    }
+    if(server.aof_ring_enabled)
+    {
+        if(!server.nvm_dir)
+        {
+            serverLog(LL_WARNING, "aof-pmem-ring need param <nvm-dir>!");
+            exit(1);
+        }
+#ifdef USE_AOFGUARD
+        /* The ring replaces the aofguard one. */
+        server.aofguard.enable = 0;
+#endif
+    }
+#endif
+
 #ifdef USE_AOFGUARD
     if(server.aofguard.enable)
     {
@@ -1367,6 +1438,7 @@ void configGetCommand(client *c) {
     config_get_numerical_field("min-slaves-to-write",server.repl_min_slaves_to_write);
     config_get_numerical_field("min-slaves-max-lag",server.repl_min_slaves_max_lag);
     config_get_numerical_field("hz",server.hz);
+    config_get_numerical_field("io-threads",server.io_threads_num);
     config_get_numerical_field("cluster-node-timeout",server.cluster_node_timeout);
     config_get_numerical_field("cluster-migration-barrier",server.cluster_migration_barrier);
     config_get_numerical_field("cluster-slave-validity-factor",server.cluster_slave_validity_factor);
@@ -1385,6 +1457,7 @@ void configGetCommand(client *c) {
     config_get_bool_field("stop-writes-on-bgsave-error",
             server.stop_writes_on_bgsave_err);
     config_get_bool_field("daemonize", server.daemonize);
+    config_get_bool_field("io-threads-do-reads", server.io_threads_do_reads);
     config_get_bool_field("rdbcompression", server.rdb_compression);
     config_get_bool_field("rdbchecksum", server.rdb_checksum);
     config_get_bool_field("activerehashing", server.activerehashing);
@@ -2136,6 +2209,8 @@ int rewriteConfig(char *path) {
     rewriteConfigYesNoOption(state,"protected-mode",server.protected_mode,CONFIG_DEFAULT_PROTECTED_MODE);
     rewriteConfigClientoutputbufferlimitOption(state);
     rewriteConfigNumericalOption(state,"hz",server.hz,CONFIG_DEFAULT_HZ);
+    rewriteConfigNumericalOption(state,"io-threads",server.io_threads_num,CONFIG_DEFAULT_IO_THREADS_NUM);
+    rewriteConfigYesNoOption(state,"io-threads-do-reads",server.io_threads_do_reads,CONFIG_DEFAULT_IO_THREADS_DO_READS);
     rewriteConfigYesNoOption(state,"aof-rewrite-incremental-fsync",server.aof_rewrite_incremental_fsync,CONFIG_DEFAULT_AOF_REWRITE_INCREMENTAL_FSYNC);
     rewriteConfigYesNoOption(state,"aof-load-truncated",server.aof_load_truncated,CONFIG_DEFAULT_AOF_LOAD_TRUNCATED);
     rewriteConfigYesNoOption(state,"aof-use-rdb-preamble",server.aof_use_rdb_preamble,CONFIG_DEFAULT_AOF_USE_RDB_PREAMBLE);
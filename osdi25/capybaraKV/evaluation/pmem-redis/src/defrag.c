@@ -106,6 +106,7 @@ defrag_debug:
         if(newptr) {
             pmem_memcpy_persist(newptr, ptr, size);
             zfree_nvm_no_tcache(ptr);
+            server.stat_active_defrag_nvm_moved += size;
         }else {
             newptr=ptr;
         }
@@ -924,6 +925,9 @@ float getNvmAllocatorFragmentation(size_t *out_frag_bytes) {
 
 #define INTERPOLATE(x, x1, x2, y1, y2) ( (y1) + ((x)-(x1)) * ((y2)-(y1)) / ((x2)-(x1)) )
 #define LIMIT(y, min, max) ((y)<(min)? min: ((y)>(max)? max: (y)))
+#ifdef USE_NVM
+#define ACTIVE_DEFRAG_NVM_CHECK_BYTES (1024*1024)
+#endif
 
 /* Perform incremental defragmentation work from the serverCron.
  * This works in a similar way to activeExpireCycle, in the sense that
@@ -936,9 +940,18 @@ void activeDefragCycle(void) {
     unsigned int iterations = 0;
     unsigned long long defragged = server.stat_active_defrag_hits;
     long long start, timelimit;
+#ifdef USE_NVM
+    static size_t start_nvm_frag_bytes;
+    long long nvm_moved = server.stat_active_defrag_nvm_moved;
+#endif
 
     if (server.aof_child_pid!=-1 || server.rdb_child_pid!=-1)
         return; /* Defragging memory while there's a fork will just do damage. */
+#ifdef SUPPORT_PBA
+    /* The PBA move list still points into values loaded from the AOF. */
+    if (server.pba.loading || server.pba.move_list)
+        return;
+#endif
 
     /* Once a second, check if we the fragmentation justfies starting a scan
      * or making it more aggressive. */
@@ -956,8 +969,8 @@ void activeDefragCycle(void) {
 #endif
         /* If we're not already running, and below the threshold, exit. */
         if (!server.active_defrag_running) {
-#ifdef USE_NVM          
-            if(server.nvm_base &&(nvm_frag_pct < server.active_defrag_threshold_lower || nvm_frag_bytes < server.active_defrag_ignore_bytes)) {
+#ifdef USE_NVM
+            if(!server.nvm_base || nvm_frag_pct < server.active_defrag_threshold_lower || nvm_frag_bytes < server.active_defrag_ignore_bytes) {
 #endif
                 if(frag_pct < server.active_defrag_threshold_lower || frag_bytes < server.active_defrag_ignore_bytes)
                     return;
@@ -975,6 +988,21 @@ void activeDefragCycle(void) {
         cpu_pct = LIMIT(cpu_pct,
                 server.active_defrag_cycle_min,
                 server.active_defrag_cycle_max);
+#ifdef USE_NVM
+        /* Both heaps are scanned together, so go as fast as the more
+         * fragmented one asks for. */
+        if (nvm_frag_bytes >= server.active_defrag_ignore_bytes) {
+            int nvm_cpu_pct = INTERPOLATE(nvm_frag_pct,
+                    server.active_defrag_threshold_lower,
+                    server.active_defrag_threshold_upper,
+                    server.active_defrag_cycle_min,
+                    server.active_defrag_cycle_max);
+            nvm_cpu_pct = LIMIT(nvm_cpu_pct,
+                    server.active_defrag_cycle_min,
+                    server.active_defrag_cycle_max);
+            if (nvm_cpu_pct > cpu_pct) cpu_pct = nvm_cpu_pct;
+        }
+#endif
          /* We allow increasing the aggressiveness during a scan, but don't
           * reduce it. */
         if (!server.active_defrag_running ||
@@ -1015,7 +1043,12 @@ void activeDefragCycle(void) {
                     "Active defrag done in %dms, reallocated=%d, frag=%.0f%%, frag_bytes=%zu",
                     (int)((now - start_scan)/1000), (int)(server.stat_active_defrag_hits - start_stat), frag_pct, frag_bytes);
 #ifdef USE_NVM
-                serverLog(LL_VERBOSE,"nvm_frag=%.0f%%, nvm_frag_bytes=%zu",nvm_frag_pct,nvm_frag_bytes);
+                if (start_nvm_frag_bytes > nvm_frag_bytes)
+                    server.stat_active_defrag_nvm_reclaimed +=
+                        start_nvm_frag_bytes - nvm_frag_bytes;
+                serverLog(LL_VERBOSE,"nvm_frag=%.0f%%, nvm_frag_bytes=%zu, nvm_reclaimed=%zu",
+                    nvm_frag_pct,nvm_frag_bytes,
+                    start_nvm_frag_bytes > nvm_frag_bytes ? start_nvm_frag_bytes - nvm_frag_bytes : 0);
 #endif
 
                 start_scan = now;
@@ -1029,6 +1062,11 @@ void activeDefragCycle(void) {
                 /* Start a scan from the first database. */
                 start_scan = ustime();
                 start_stat = server.stat_active_defrag_hits;
+#ifdef USE_NVM
+                start_nvm_frag_bytes = 0;
+                if (server.nvm_base)
+                    getNvmAllocatorFragmentation(&start_nvm_frag_bytes);
+#endif
             }
 
             db = &server.db[current_db];
@@ -1039,13 +1077,22 @@ void activeDefragCycle(void) {
             cursor = dictScan(db->dict, cursor, defragScanCallback, defragDictBucketCallback, db);
             /* Once in 16 scan iterations, or 1000 pointer reallocations
              * (if we have a lot of pointers in one hash bucket), check if we
-             * reached the tiem limit. */
-            if (cursor && (++iterations > 16 || server.stat_active_defrag_hits - defragged > 1000)) {
+             * reached the tiem limit. NVM copies are much slower than DRAM
+             * ones, so also check after every ACTIVE_DEFRAG_NVM_CHECK_BYTES
+             * moved to NVM. */
+            if (cursor && (++iterations > 16 || server.stat_active_defrag_hits - defragged > 1000
+#ifdef USE_NVM
+                || server.stat_active_defrag_nvm_moved - nvm_moved > ACTIVE_DEFRAG_NVM_CHECK_BYTES
+#endif
+                )) {
                 if ((ustime() - start) > timelimit) {
                     return;
                 }
                 iterations = 0;
                 defragged = server.stat_active_defrag_hits;
+#ifdef USE_NVM
+                nvm_moved = server.stat_active_defrag_nvm_moved;
+#endif
             }
         } while(cursor);
     } while(1);
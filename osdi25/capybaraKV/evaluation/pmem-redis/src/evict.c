@@ -587,3 +587,171 @@ cant_free:
     return C_ERR;
 }
 
+
+#ifdef USE_NVM
+/* ----------------------------------------------------------------------------
+ * DRAM/NVM tiering
+ *
+ * Large string values are put on NVM when they are stored (see sdsmvtonvm())
+ * and, without tiering, stay there whatever their access pattern is. When
+ * nvm-dram-budget is set, nvmTieringCycle() is called by databasesCron() and
+ * moves values between the two tiers using the same access information the
+ * eviction uses: the LFU counter with an LFU maxmemory-policy, the LRU idle
+ * time otherwise.
+ *
+ * Every step samples a few keys of a DB. While the DRAM used is above budget
+ * the coldest sampled value on DRAM is demoted to NVM. Otherwise the hottest
+ * sampled value on NVM is promoted to DRAM, if it is hot at all and either
+ * fits in the budget or is hotter than the coldest sampled value on DRAM,
+ * which is demoted to make room for it. The number of bytes moved is limited
+ * to nvm-tiering-rate per second.
+ * --------------------------------------------------------------------------*/
+
+#define NVM_TIERING_SAMPLES 16      /* Keys sampled per step. */
+#define NVM_TIERING_MAX_STEPS 64    /* Steps per call, moved bytes or not. */
+#define NVM_TIERING_HOT_IDLE 1000   /* LRU: accessed in the last second. */
+
+/* Return the "idle" score evictionPoolPopulate() would give the object:
+ * the higher, the colder. */
+static unsigned long long nvmTieringIdle(robj *o) {
+    if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU)
+        return 255-LFUDecrAndReturn(o);
+    return estimateObjectIdleTime(o);
+}
+
+static int nvmTieringIsHot(unsigned long long idle) {
+    if (server.maxmemory_policy & MAXMEMORY_FLAG_LFU)
+        return idle < 255-LFU_INIT_VAL;
+    return idle < NVM_TIERING_HOT_IDLE;
+}
+
+static size_t nvmTieringSize(robj *o) {
+    return sdsheadersize(o->ptr)+sdsalloc(o->ptr)+1;
+}
+
+/* Only plain string values are moved: other types keep their own layout on
+ * NVM, and arguments a pointer based AOF command still refers to can't be
+ * freed. */
+static int nvmTieringCandidate(robj *o) {
+    if (o->type != OBJ_STRING || o->encoding != OBJ_ENCODING_RAW ||
+        o->refcount == OBJ_SHARED_REFCOUNT) return 0;
+#ifdef SUPPORT_PBA
+    if (o->no_free_val) return 0;
+#endif
+    return nvmTieringSize(o) >= server.sdsmv_threshold;
+}
+
+/* Return the number of bytes moved, 0 if NVM is full. */
+static size_t nvmTieringDemote(robj *o) {
+    size_t size = nvmTieringSize(o);
+
+    o->ptr = sdsmvtonvm(o->ptr);
+    if (!is_nvm_addr(o->ptr)) return 0;
+    o->need_mv_to_nvm = 0;
+    server.stat_nvm_demoted++;
+    return size;
+}
+
+static size_t nvmTieringPromote(int dbid, sds key, robj *o) {
+    size_t size = nvmTieringSize(o);
+
+#ifdef SUPPORT_PBA
+    if (IS_PBA()) {
+        /* The AOF refers to the value by its NVM offset. Log the DRAM copy
+         * before the NVM one goes away, and free the latter with sdsfree(),
+         * which defers NVM frees while PBA is on. SET clears the expire on
+         * replay, so it is logged again as the absolute PEXPIREAT that the
+         * AOF uses for every expire. */
+        sds old = o->ptr;
+        robj *keyobj = createStringObject(key,sdslen(key));
+        long long when = getExpire(server.db+dbid,keyobj);
+        robj *argv[3];
+
+        o->ptr = sdsnewlen(old,sdslen(old));
+        argv[0] = createStringObject("SET",3);
+        argv[1] = keyobj;
+        argv[2] = o;
+        feedAppendOnlyFile(server.pba.setCommand,dbid,argv,3);
+        decrRefCount(argv[0]);
+        if (when != -1) {
+            argv[0] = createStringObject("PEXPIREAT",9);
+            argv[2] = createStringObjectFromLongLong(when);
+            feedAppendOnlyFile(server.pexpireatCommand,dbid,argv,3);
+            decrRefCount(argv[0]);
+            decrRefCount(argv[2]);
+        }
+        decrRefCount(keyobj);
+        sdsfree(old);
+    } else
+#endif
+    o->ptr = sdsmvtodram(o->ptr);
+    o->need_mv_to_nvm = 0;
+    server.stat_nvm_promoted++;
+    return size;
+}
+
+void nvmTieringCycle(void) {
+    static unsigned int current_db = 0;
+    long long budget;
+    int steps;
+
+    if (!server.nvm_base) return;
+    /* Like rehashing, moving values while a child is saving the dataset
+     * only causes copy-on-write of DRAM and NVM. */
+    if (server.rdb_child_pid != -1 || server.aof_child_pid != -1) return;
+
+    budget = server.nvm_tiering_rate/server.hz;
+    if (budget <= 0) budget = 1;
+
+    for (steps = 0; steps < NVM_TIERING_MAX_STEPS && budget > 0; steps++) {
+        redisDb *db = server.db+(current_db++ % server.dbnum);
+        dictEntry *samples[NVM_TIERING_SAMPLES];
+        robj *cold = NULL, *hot = NULL;
+        sds hot_key = NULL;
+        unsigned long long cold_idle = 0, hot_idle = ULLONG_MAX;
+        size_t used, overhead, moved;
+        int j, count;
+
+        if (dictSize(db->dict) == 0) continue;
+        count = dictGetSomeKeys(db->dict,samples,NVM_TIERING_SAMPLES);
+        for (j = 0; j < count; j++) {
+            robj *o = dictGetVal(samples[j]);
+            unsigned long long idle;
+
+            if (!nvmTieringCandidate(o)) continue;
+            idle = nvmTieringIdle(o);
+            if (is_nvm_addr(o->ptr)) {
+                if (idle < hot_idle) {
+                    hot = o;
+                    hot_key = dictGetKey(samples[j]);
+                    hot_idle = idle;
+                }
+            } else {
+                if (cold == NULL || idle > cold_idle) {
+                    cold = o;
+                    cold_idle = idle;
+                }
+            }
+        }
+
+        used = zmalloc_used_memory();
+        overhead = freeMemoryGetNotCountedMemory();
+        used = (used > overhead) ? used-overhead : 0;
+
+        if (used > server.nvm_dram_budget) {
+            if (cold == NULL) continue;
+            moved = nvmTieringDemote(cold);
+            if (moved == 0) break; /* NVM is full. */
+            budget -= moved;
+        } else if (hot && nvmTieringIsHot(hot_idle)) {
+            if (used+nvmTieringSize(hot) > server.nvm_dram_budget) {
+                if (cold == NULL || cold_idle <= hot_idle) continue;
+                moved = nvmTieringDemote(cold);
+                if (moved == 0) break;
+                budget -= moved;
+            }
+            budget -= nvmTieringPromote(db->id,hot_key,hot);
+        }
+    }
+}
+#endif
@@ -30,6 +30,9 @@
 
 #include "server.h"
 #include "atomicvar.h"
+#ifdef USE_NVM
+#include "nvm.h"
+#endif
 #include <sys/uio.h>
 #include <math.h>
 #include <ctype.h>
@@ -163,6 +166,7 @@ client *createClient(int fd) {
  * Typically gets called every time a reply is built, before adding more
  * data to the clients output buffers. If the function returns C_ERR no
  * data should be appended to the output buffers. */
+static void clientInstallWriteHandler(client *c);
 int prepareClientToWrite(client *c) {
     /* If it's the Lua client we always return ok without installing any
      * handler since there is no socket at all. */
@@ -179,11 +183,20 @@ int prepareClientToWrite(client *c) {
     if (c->fd <= 0) return C_ERR; /* Fake client for AOF loading. */
 
     /* Schedule the client to write the output buffers to the socket only
-     * if not already done (there were no pending writes already and the client
-     * was yet not flagged), and, for slaves, if the slave can actually
-     * receive writes at this stage. */
-    if (!clientHasPendingReplies(c) &&
-        !(c->flags & CLIENT_PENDING_WRITE) &&
+     * if there were no pending writes already. A client being read by an
+     * I/O thread is scheduled by the main thread once the read is done. */
+    if (!clientHasPendingReplies(c) && !(c->flags & CLIENT_PENDING_READ))
+        clientInstallWriteHandler(c);
+
+    /* Authorize the caller to queue in the output buffer of this client. */
+    return C_OK;
+}
+
+/* Schedule the client to write the output buffers to the socket if not
+ * already done (the client was yet not flagged), and, for slaves, if the
+ * slave can actually receive writes at this stage. */
+static void clientInstallWriteHandler(client *c) {
+    if (!(c->flags & CLIENT_PENDING_WRITE) &&
         (c->replstate == REPL_STATE_NONE ||
          (c->replstate == SLAVE_STATE_ONLINE && !c->repl_put_online_on_ack)))
     {
@@ -196,9 +209,6 @@ int prepareClientToWrite(client *c) {
         c->flags |= CLIENT_PENDING_WRITE;
         listAddNodeHead(server.clients_pending_write,c);
     }
-
-    /* Authorize the caller to queue in the output buffer of this client. */
-    return C_OK;
 }
 
 /* -----------------------------------------------------------------------------
@@ -763,6 +773,14 @@ void unlinkClient(client *c) {
         c->flags &= ~CLIENT_PENDING_WRITE;
     }
 
+    /* Remove from the list of clients to read in the I/O threads. */
+    if (c->flags & CLIENT_PENDING_READ) {
+        ln = listSearchKey(server.clients_pending_read,c);
+        serverAssert(ln != NULL);
+        listDelNode(server.clients_pending_read,ln);
+        c->flags &= ~(CLIENT_PENDING_READ|CLIENT_PENDING_COMMAND);
+    }
+
     /* When client was just unblocked because of a blocking operation,
      * remove it from the list of unblocked clients. */
     if (c->flags & CLIENT_UNBLOCKED) {
@@ -870,11 +888,36 @@ void freeClient(client *c) {
 /* Schedule a client to free it at a safe time in the serverCron() function.
  * This function is useful when we need to terminate a client but we are in
  * a context where calling freeClient() is not possible, because the client
- * should be valid for the continuation of the flow of the program. */
+ * should be valid for the continuation of the flow of the program.
+ *
+ * It is also how the I/O threads free clients, so the queue is locked while
+ * they run. */
+#define IO_THREADS_OP_IDLE 0
+#define IO_THREADS_OP_READ 1
+#define IO_THREADS_OP_WRITE 2
+
+static pthread_mutex_t async_free_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int io_threads_op = IO_THREADS_OP_IDLE; /* What the I/O threads do */
+
 void freeClientAsync(client *c) {
     if (c->flags & CLIENT_CLOSE_ASAP || c->flags & CLIENT_LUA) return;
     c->flags |= CLIENT_CLOSE_ASAP;
+    if (io_threads_op == IO_THREADS_OP_IDLE) {
+        listAddNodeTail(server.clients_to_close,c);
+        return;
+    }
+    pthread_mutex_lock(&async_free_queue_mutex);
     listAddNodeTail(server.clients_to_close,c);
+    pthread_mutex_unlock(&async_free_queue_mutex);
+}
+
+/* Free a client on an I/O error. While the I/O threads run only the
+ * client itself may be changed, it is freed later by the main thread. */
+static void freeClientOnIOError(client *c) {
+    if (io_threads_op == IO_THREADS_OP_IDLE)
+        freeClient(c);
+    else
+        freeClientAsync(c);
 }
 
 void freeClientsInAsyncFreeQueue(void) {
@@ -889,7 +932,8 @@ void freeClientsInAsyncFreeQueue(void) {
 }
 
 /* Write data in output buffers to client. Return C_OK if the client
- * is still valid after the call, C_ERR if it was freed. */
+ * is still valid after the call, C_ERR if it was freed, or scheduled to be
+ * freed when the I/O threads run. */
 int writeToClient(int fd, client *c, int handler_installed) {
     ssize_t nwritten = 0, totwritten = 0;
     size_t objlen;
@@ -945,14 +989,14 @@ int writeToClient(int fd, client *c, int handler_installed) {
             (server.maxmemory == 0 ||
              zmalloc_used_memory() < server.maxmemory)) break;
     }
-    server.stat_net_output_bytes += totwritten;
+    atomicIncr(server.stat_net_output_bytes,totwritten);
     if (nwritten == -1) {
         if (errno == EAGAIN) {
             nwritten = 0;
         } else {
             serverLog(LL_VERBOSE,
                 "Error writing to client: %s", strerror(errno));
-            freeClient(c);
+            freeClientOnIOError(c);
             return C_ERR;
         }
     }
@@ -969,7 +1013,7 @@ int writeToClient(int fd, client *c, int handler_installed) {
 
         /* Close connection after entire reply has been sent. */
         if (c->flags & CLIENT_CLOSE_AFTER_REPLY) {
-            freeClient(c);
+            freeClientOnIOError(c);
             return C_ERR;
         }
     }
@@ -1240,6 +1284,14 @@ int processMultibulkBuffer(client *c) {
                 qblen = sdslen(c->querybuf);
                 /* Hint the sds library about the amount of bytes this string is
                  * going to contain. */
+#ifdef USE_NVM
+                /* The value would be moved to NVM once stored: read it
+                 * there in the first place. */
+                if (qblen < (size_t)ll+2 && server.nvm_base &&
+                    (size_t)ll+2 >= server.sdsmv_threshold)
+                    c->querybuf = sdsMakeRoomForNvm(c->querybuf,ll+2-qblen);
+                else
+#endif
                 if (qblen < (size_t)ll+2)
                     c->querybuf = sdsMakeRoomFor(c->querybuf,ll+2-qblen);
             }
@@ -1260,12 +1312,36 @@ int processMultibulkBuffer(client *c) {
             {
                 c->argv[c->argc++] = createObject(OBJ_STRING,c->querybuf);
                 sdsIncrLen(c->querybuf,-2); /* remove CRLF */
-                /* Assume that if we saw a fat argument we'll see another one
-                 * likely... */
-                c->querybuf = sdsnewlen(NULL,c->bulklen+2);
-                sdsclear(c->querybuf);
+#ifdef USE_NVM
+                if (is_nvm_addr(c->querybuf)) {
+                    /* The argument was read in place on NVM. Go back to a
+                     * DRAM query buffer, the next fat argument is moved to
+                     * NVM again as soon as its length is known. */
+                    sdsflushnvm(c->querybuf);
+                    c->querybuf = sdsempty();
+                } else
+#endif
+                {
+                    /* Assume that if we saw a fat argument we'll see another
+                     * one likely... */
+                    c->querybuf = sdsnewlen(NULL,c->bulklen+2);
+                    sdsclear(c->querybuf);
+                }
                 pos = 0;
-            } else {
+            }
+#ifdef USE_NVM
+            else if (server.nvm_base &&
+                     c->bulklen > OBJ_ENCODING_EMBSTR_SIZE_LIMIT &&
+                     (size_t)c->bulklen >= server.sdsmv_threshold)
+            {
+                /* Copy a large argument straight to NVM rather than to DRAM
+                 * first and to NVM again when it is stored. */
+                c->argv[c->argc++] = createObject(OBJ_STRING,
+                    sdsnewlennvm(c->querybuf+pos,c->bulklen));
+                pos += c->bulklen+2;
+            }
+#endif
+            else {
                 c->argv[c->argc++] =
                     createStringObject(c->querybuf+pos,c->bulklen);
                 pos += c->bulklen+2;
@@ -1285,16 +1361,46 @@ int processMultibulkBuffer(client *c) {
     return C_ERR;
 }
 
+/* Execute the command parsed in the client structure and prepare the
+ * client for the next one. Returns C_ERR if the client was freed meanwhile:
+ * freeMemoryIfNeeded may flush slave output buffers. This may result into
+ * a slave, that may be the active client, to be freed. */
+static int processCommandAndResetClient(client *c) {
+    int retval = C_OK;
+
+    server.current_client = c;
+    if (processCommand(c) == C_OK) {
+        if (c->flags & CLIENT_MASTER && !(c->flags & CLIENT_MULTI)) {
+            /* Update the applied replication offset of our master. */
+            c->reploff = c->read_reploff - sdslen(c->querybuf);
+        }
+
+        /* Don't reset the client structure for clients blocked in a
+         * module blocking command, so that the reply callback will
+         * still be able to access the client argv and argc field.
+         * The client will be reset in unblockClientFromModule(). */
+        if (!(c->flags & CLIENT_BLOCKED) || c->btype != BLOCKED_MODULE)
+            resetClient(c);
+    }
+    if (server.current_client == NULL) retval = C_ERR;
+    server.current_client = NULL;
+    return retval;
+}
+
 /* This function is called every time, in the client structure 'c', there is
  * more query buffer to process, because we read more data from the socket
  * or because a client was blocked and later reactivated, so there could be
- * pending query buffer, already representing a full command, to process. */
+ * pending query buffer, already representing a full command, to process.
+ *
+ * Called by an I/O thread, it only parses the next command, which is left
+ * to the main thread to execute. */
 void processInputBuffer(client *c) {
-    server.current_client = c;
-    /* Keep processing while there is something in the input buffer */
-    while(sdslen(c->querybuf)) {
+    /* Keep processing while there is something in the input buffer, or a
+     * command an I/O thread parsed. */
+    while(sdslen(c->querybuf) || c->flags & CLIENT_PENDING_COMMAND) {
         /* Return if clients are paused. */
-        if (!(c->flags & CLIENT_SLAVE) && clientsArePaused()) break;
+        if (!(c->flags & (CLIENT_SLAVE|CLIENT_PENDING_READ)) &&
+            clientsArePaused()) break;
 
         /* Immediately abort if the client is in the middle of something. */
         if (c->flags & CLIENT_BLOCKED) break;
@@ -1306,6 +1412,12 @@ void processInputBuffer(client *c) {
          * The same applies for clients we want to terminate ASAP. */
         if (c->flags & (CLIENT_CLOSE_AFTER_REPLY|CLIENT_CLOSE_ASAP)) break;
 
+        if (c->flags & CLIENT_PENDING_COMMAND) {
+            c->flags &= ~CLIENT_PENDING_COMMAND;
+            if (processCommandAndResetClient(c) == C_ERR) break;
+            continue;
+        }
+
         /* Determine request type when unknown. */
         if (!c->reqtype) {
             if (c->querybuf[0] == '*') {
@@ -1326,28 +1438,33 @@ void processInputBuffer(client *c) {
         /* Multibulk processing could see a <= 0 length. */
         if (c->argc == 0) {
             resetClient(c);
+        } else if (c->flags & CLIENT_PENDING_READ) {
+            c->flags |= CLIENT_PENDING_COMMAND;
+            break;
         } else {
             /* Only reset the client when the command was executed. */
-            if (processCommand(c) == C_OK) {
-                if (c->flags & CLIENT_MASTER && !(c->flags & CLIENT_MULTI)) {
-                    /* Update the applied replication offset of our master. */
-                    c->reploff = c->read_reploff - sdslen(c->querybuf);
-                }
-
-                /* Don't reset the client structure for clients blocked in a
-                 * module blocking command, so that the reply callback will
-                 * still be able to access the client argv and argc field.
-                 * The client will be reset in unblockClientFromModule(). */
-                if (!(c->flags & CLIENT_BLOCKED) || c->btype != BLOCKED_MODULE)
-                    resetClient(c);
-            }
-            /* freeMemoryIfNeeded may flush slave output buffers. This may
-             * result into a slave, that may be the active client, to be
-             * freed. */
-            if (server.current_client == NULL) break;
+            if (processCommandAndResetClient(c) == C_ERR) break;
         }
     }
-    server.current_client = NULL;
+}
+
+/* When the I/O threads are active, queue the client to be read and parsed
+ * by them rather than reading it now. Masters, slaves, blocked clients and
+ * clients with a parsed command still to execute are always served by the
+ * main thread. Returns 1 if the read is postponed. */
+static int ProcessingEventsWhileBlocked = 0;
+static int postponeClientRead(client *c) {
+    if (server.io_threads_active &&
+        server.io_threads_do_reads &&
+        !ProcessingEventsWhileBlocked &&
+        !(c->flags & (CLIENT_MASTER|CLIENT_SLAVE|CLIENT_PENDING_READ|
+                      CLIENT_PENDING_COMMAND|CLIENT_BLOCKED)))
+    {
+        c->flags |= CLIENT_PENDING_READ;
+        listAddNodeHead(server.clients_pending_read,c);
+        return 1;
+    }
+    return 0;
 }
 
 void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
@@ -1357,6 +1474,8 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
     UNUSED(el);
     UNUSED(mask);
 
+    if (postponeClientRead(c)) return;
+
     readlen = PROTO_IOBUF_LEN;
     /* If this is a multi bulk request, and we are processing a bulk reply
      * that is large enough, try to maximize the probability that the query
@@ -1381,12 +1500,12 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
             return;
         } else {
             serverLog(LL_VERBOSE, "Reading from client: %s",strerror(errno));
-            freeClient(c);
+            freeClientOnIOError(c);
             return;
         }
     } else if (nread == 0) {
         serverLog(LL_VERBOSE, "Client closed connection");
-        freeClient(c);
+        freeClientOnIOError(c);
         return;
     } else if (c->flags & CLIENT_MASTER) {
         /* Append the query buffer to the pending (not applied) buffer
@@ -1399,7 +1518,7 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
     sdsIncrLen(c->querybuf,nread);
     c->lastinteraction = server.unixtime;
     if (c->flags & CLIENT_MASTER) c->read_reploff += nread;
-    server.stat_net_input_bytes += nread;
+    atomicIncr(server.stat_net_input_bytes,nread);
     if (sdslen(c->querybuf) > server.client_max_querybuf_len) {
         sds ci = catClientInfoString(sdsempty(),c), bytes = sdsempty();
 
@@ -1407,7 +1526,7 @@ void readQueryFromClient(aeEventLoop *el, int fd, void *privdata, int mask) {
         serverLog(LL_WARNING,"Closing client that reached max query buffer length: %s (qbuf initial bytes: %s)", ci, bytes);
         sdsfree(ci);
         sdsfree(bytes);
-        freeClient(c);
+        freeClientOnIOError(c);
         return;
     }
 
@@ -2022,6 +2141,9 @@ int clientsArePaused(void) {
 int processEventsWhileBlocked(void) {
     int iterations = 4; /* See the function top-comment. */
     int count = 0;
+
+    /* Commands are executed right away, not after the I/O threads read. */
+    ProcessingEventsWhileBlocked = 1;
     while (iterations--) {
         int events = 0;
         events += aeProcessEvents(server.el, AE_FILE_EVENTS|AE_DONT_WAIT);
@@ -2029,5 +2151,257 @@ int processEventsWhileBlocked(void) {
         if (!events) break;
         count += events;
     }
+    ProcessingEventsWhileBlocked = 0;
     return count;
 }
+
+/* ==========================================================================
+ * Threaded I/O
+ * ========================================================================== */
+
+/* With io-threads > 1, the clients with replies to write, and with
+ * io-threads-do-reads the clients with queries to read, are split between
+ * the main thread and the I/O threads before re-entering the event loop.
+ * The threads write the replies, or read and parse the next command, which
+ * the main thread then executes: commands never run concurrently. While
+ * the threads run the main thread only serves its own share of clients,
+ * and waits for the others to be done.
+ *
+ * The threads spin waiting for work, and are parked on a mutex held by the
+ * main thread when there are too few clients to write to. */
+static pthread_t io_threads[IO_THREADS_MAX_NUM];
+static pthread_mutex_t io_threads_mutex[IO_THREADS_MAX_NUM];
+static unsigned long io_threads_pending[IO_THREADS_MAX_NUM];
+static list *io_threads_list[IO_THREADS_MAX_NUM];
+
+static unsigned long getIOPendingCount(int i) {
+    return __atomic_load_n(&io_threads_pending[i],__ATOMIC_ACQUIRE);
+}
+
+static void setIOPendingCount(int i, unsigned long count) {
+    __atomic_store_n(&io_threads_pending[i],count,__ATOMIC_RELEASE);
+}
+
+static void *IOThreadMain(void *myid) {
+    long id = (long)myid;
+    listIter li;
+    listNode *ln;
+
+    while(1) {
+        int j;
+
+        /* Wait for start */
+        for (j = 0; j < 1000000; j++) {
+            if (getIOPendingCount(id) != 0) break;
+        }
+
+        /* Give the main thread a chance to stop this thread. */
+        if (getIOPendingCount(id) == 0) {
+            pthread_mutex_lock(&io_threads_mutex[id]);
+            pthread_mutex_unlock(&io_threads_mutex[id]);
+            continue;
+        }
+
+        /* Process: note that the main thread will never touch our list
+         * before we drop the pending count to 0. */
+        listRewind(io_threads_list[id],&li);
+        while((ln = listNext(&li))) {
+            client *c = listNodeValue(ln);
+            if (io_threads_op == IO_THREADS_OP_WRITE) {
+                writeToClient(c->fd,c,0);
+            } else if (io_threads_op == IO_THREADS_OP_READ) {
+                readQueryFromClient(server.el,c->fd,c,AE_READABLE);
+            } else {
+                serverPanic("io_threads_op value is unknown");
+            }
+        }
+        listEmpty(io_threads_list[id]);
+        setIOPendingCount(id,0);
+    }
+    return NULL;
+}
+
+/* Initialize the data structures needed for threaded I/O. */
+void initThreadedIO(void) {
+    int i;
+
+    server.io_threads_active = 0; /* We start with threads not active. */
+    if (server.io_threads_num == 1) return;
+
+    /* Spawn and initialize the I/O threads. The main thread is thread 0. */
+    for (i = 0; i < server.io_threads_num; i++) {
+        io_threads_list[i] = listCreate();
+        if (i == 0) continue;
+
+        pthread_t tid;
+        pthread_mutex_init(&io_threads_mutex[i],NULL);
+        setIOPendingCount(i,0);
+        pthread_mutex_lock(&io_threads_mutex[i]); /* Thread will be stopped. */
+        if (pthread_create(&tid,NULL,IOThreadMain,(void*)(long)i) != 0) {
+            serverLog(LL_WARNING,"Fatal: Can't initialize IO thread.");
+            exit(1);
+        }
+        io_threads[i] = tid;
+    }
+}
+
+static void startThreadedIO(void) {
+    int j;
+
+    serverAssert(server.io_threads_active == 0);
+    for (j = 1; j < server.io_threads_num; j++)
+        pthread_mutex_unlock(&io_threads_mutex[j]);
+    server.io_threads_active = 1;
+}
+
+static void stopThreadedIO(void) {
+    int j;
+
+    /* We may have still clients with pending reads when this function
+     * is called: handle them before stopping the threads. */
+    handleClientsWithPendingReadsUsingThreads();
+    serverAssert(server.io_threads_active == 1);
+    for (j = 1; j < server.io_threads_num; j++)
+        pthread_mutex_lock(&io_threads_mutex[j]);
+    server.io_threads_active = 0;
+}
+
+/* Park the threads when there are too few clients to write to for them to
+ * pay off, start them again otherwise. Returns 1 if the I/O should be done
+ * by the main thread alone. */
+static int stopThreadedIOIfNeeded(void) {
+    int pending = listLength(server.clients_pending_write);
+
+    /* Return ASAP if I/O threads are disabled (single threaded mode). */
+    if (server.io_threads_num == 1) return 1;
+
+    if (pending < (server.io_threads_num*2)) {
+        if (server.io_threads_active) stopThreadedIO();
+        return 1;
+    }
+    return 0;
+}
+
+/* Hand the clients of 'clients' out to the threads, serve the share of
+ * the main thread, and wait for the others. */
+static void runIOThreads(list *clients, int op) {
+    listIter li;
+    listNode *ln;
+    int item_id = 0, j;
+
+    listRewind(clients,&li);
+    while((ln = listNext(&li))) {
+        client *c = listNodeValue(ln);
+        int target_id = item_id % server.io_threads_num;
+        listAddNodeTail(io_threads_list[target_id],c);
+        item_id++;
+    }
+
+    /* Give the start condition to the waiting threads, by setting the
+     * start condition atomic var. */
+    io_threads_op = op;
+    for (j = 1; j < server.io_threads_num; j++) {
+        int count = listLength(io_threads_list[j]);
+        setIOPendingCount(j,count);
+    }
+
+    /* Also use the main thread to process a slice of clients. */
+    listRewind(io_threads_list[0],&li);
+    while((ln = listNext(&li))) {
+        client *c = listNodeValue(ln);
+        if (op == IO_THREADS_OP_WRITE)
+            writeToClient(c->fd,c,0);
+        else
+            readQueryFromClient(server.el,c->fd,c,AE_READABLE);
+    }
+    listEmpty(io_threads_list[0]);
+
+    /* Wait for all the other threads to end their work. */
+    while(1) {
+        unsigned long pending = 0;
+        for (j = 1; j < server.io_threads_num; j++)
+            pending += getIOPendingCount(j);
+        if (pending == 0) break;
+    }
+    io_threads_op = IO_THREADS_OP_IDLE;
+}
+
+/* Like handleClientsWithPendingWrites(), but with the I/O threads when
+ * they are enabled and there are enough clients to write to. */
+int handleClientsWithPendingWritesUsingThreads(void) {
+    listIter li;
+    listNode *ln;
+    int processed = listLength(server.clients_pending_write);
+
+    if (processed == 0) return 0; /* Return ASAP if there are no clients. */
+
+    /* If I/O threads are disabled or we have few clients to serve, don't
+     * use I/O threads, but the boring synchronous code. */
+    if (stopThreadedIOIfNeeded()) return handleClientsWithPendingWrites();
+
+    /* Start threads if needed. */
+    if (!server.io_threads_active) startThreadedIO();
+
+    /* The clients stay in the list until the write handlers are installed,
+     * but are no longer flagged: replies written meanwhile queue them again
+     * at the head of the list. */
+    listRewind(server.clients_pending_write,&li);
+    while((ln = listNext(&li))) {
+        client *c = listNodeValue(ln);
+        c->flags &= ~CLIENT_PENDING_WRITE;
+    }
+    runIOThreads(server.clients_pending_write,IO_THREADS_OP_WRITE);
+
+    /* Run the list of clients again to install the write handler where
+     * needed. */
+    listRewind(server.clients_pending_write,&li);
+    while((ln = listNext(&li))) {
+        client *c = listNodeValue(ln);
+
+        /* Install the write handler if there are pending writes in some
+         * of the clients. */
+        if (!(c->flags & CLIENT_CLOSE_ASAP) && clientHasPendingReplies(c) &&
+            aeCreateFileEvent(server.el, c->fd, AE_WRITABLE,
+                sendReplyToClient, c) == AE_ERR)
+        {
+            freeClientAsync(c);
+        }
+    }
+    listEmpty(server.clients_pending_write);
+    server.stat_io_writes_processed += processed;
+    return processed;
+}
+
+/* Read and parse the clients postponed by readQueryFromClient() with the
+ * I/O threads, then execute the parsed commands in the main thread. */
+int handleClientsWithPendingReadsUsingThreads(void) {
+    listNode *ln;
+    int processed = listLength(server.clients_pending_read);
+
+    if (!server.io_threads_active || !server.io_threads_do_reads) return 0;
+    if (processed == 0) return 0;
+
+    runIOThreads(server.clients_pending_read,IO_THREADS_OP_READ);
+
+    /* Run the list of clients again to process the new buffers. */
+    while(listLength(server.clients_pending_read)) {
+        ln = listFirst(server.clients_pending_read);
+        client *c = listNodeValue(ln);
+        c->flags &= ~CLIENT_PENDING_READ;
+        listDelNode(server.clients_pending_read,ln);
+
+        /* Clients the threads failed to read are freed asynchronously. */
+        if (c->flags & CLIENT_CLOSE_ASAP) continue;
+
+        /* Execute the command parsed by the thread, if any, and the ones
+         * left in the query buffer. */
+        processInputBuffer(c);
+
+        /* We may have pending replies if a thread readQueryFromClient()
+         * produced replies and did not install a write handler (it can't). */
+        if (!(c->flags & CLIENT_PENDING_WRITE) && clientHasPendingReplies(c))
+            clientInstallWriteHandler(c);
+    }
+    server.stat_io_reads_processed += processed;
+    return processed;
+}
@@ -35,25 +35,109 @@
 #ifdef _DEFAULT_SOURCE
 #undef _DEFAULT_SOURCE
 #endif
-#include "atomicvar.h"
 #include "nvm.h"
 
-#define update_nvm_stat_alloc(__n) do { \
-    size_t _n = (__n); \
-    if (_n&(sizeof(long)-1)) _n += sizeof(long)-(_n&(sizeof(long)-1)); \
-    atomicIncr(used_nvm,__n); \
-    atomicIncr(alloc_count, 1); \
-} while(0)
+/* NVM usage accounted by a single thread. Only the owning thread writes to
+ * it, with relaxed stores so that nvm_stats_fold() can read it from the main
+ * thread: allocating and freeing never touches a cache line shared with other
+ * threads. Frees may run in another thread than the allocation (lazyfree,
+ * bio), so a thread's counters can go negative, only their sum is
+ * meaningful. */
+typedef struct nvmThreadStats {
+    long long used;
+    long long count;
+    long long class_count[NVM_SIZE_CLASSES];
+    long long class_bytes[NVM_SIZE_CLASSES];
+    struct nvmThreadStats *next;
+} nvmThreadStats;
 
-#define update_nvm_stat_free(__n) do { \
-    size_t _n = (__n); \
-    if (_n&(sizeof(long)-1)) _n += sizeof(long)-(_n&(sizeof(long)-1)); \
-    atomicDecr(used_nvm,__n); \
-    atomicDecr(alloc_count, 1); \
-} while(0)
+static __thread nvmThreadStats *thread_stats = NULL;
+/* Every thread that ever used NVM. Blocks are never freed, so what a thread
+ * accounted still counts after it exits. */
+static nvmThreadStats *all_thread_stats = NULL;
+static pthread_mutex_t thread_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
 
+/* Totals of all the threads, as of the last nvm_stats_fold(). */
 static size_t used_nvm = 0;
 static size_t alloc_count = 0;
+static long long class_count[NVM_SIZE_CLASSES];
+static long long class_bytes[NVM_SIZE_CLASSES];
+
+static nvmThreadStats *nvm_thread_stats(void) {
+    nvmThreadStats *ts = thread_stats;
+
+    if (ts) return ts;
+    ts = zcalloc(sizeof(*ts));
+    pthread_mutex_lock(&thread_stats_mutex);
+    ts->next = all_thread_stats;
+    all_thread_stats = ts;
+    pthread_mutex_unlock(&thread_stats_mutex);
+    thread_stats = ts;
+    return ts;
+}
+
+/* Class 'c' holds the allocations of (2^(c-1), 2^c] bytes. */
+static int nvm_size_class(size_t size) {
+    int c = size <= 1 ? 0 : 64-__builtin_clzll(size-1);
+    return c < NVM_SIZE_CLASSES ? c : NVM_SIZE_CLASSES-1;
+}
+
+#define nvm_stat_add(field, n) \
+    __atomic_store_n(&(field), (field)+(n), __ATOMIC_RELAXED)
+
+static inline void update_nvm_stat_alloc(size_t n) {
+    nvmThreadStats *ts = nvm_thread_stats();
+    int c = nvm_size_class(n);
+
+    nvm_stat_add(ts->used, (long long)n);
+    nvm_stat_add(ts->count, 1);
+    nvm_stat_add(ts->class_count[c], 1);
+    nvm_stat_add(ts->class_bytes[c], (long long)n);
+}
+
+static inline void update_nvm_stat_free(size_t n) {
+    nvmThreadStats *ts = nvm_thread_stats();
+    int c = nvm_size_class(n);
+
+    nvm_stat_add(ts->used, -(long long)n);
+    nvm_stat_add(ts->count, -1);
+    nvm_stat_add(ts->class_count[c], -1);
+    nvm_stat_add(ts->class_bytes[c], -(long long)n);
+}
+
+/* Sum up what every thread accounted into the totals nvm_get_used() and
+ * friends return. Called by serverCron() and INFO. */
+void nvm_stats_fold(void) {
+    nvmThreadStats *ts;
+    long long used = 0, count = 0;
+    int j;
+
+    for (j = 0; j < NVM_SIZE_CLASSES; j++)
+        class_count[j] = class_bytes[j] = 0;
+    /* Threads are only ever prepended, the rest of the list is stable. */
+    pthread_mutex_lock(&thread_stats_mutex);
+    ts = all_thread_stats;
+    pthread_mutex_unlock(&thread_stats_mutex);
+    for (; ts; ts = ts->next) {
+        used += __atomic_load_n(&ts->used, __ATOMIC_RELAXED);
+        count += __atomic_load_n(&ts->count, __ATOMIC_RELAXED);
+        for (j = 0; j < NVM_SIZE_CLASSES; j++) {
+            class_count[j] += __atomic_load_n(&ts->class_count[j], __ATOMIC_RELAXED);
+            class_bytes[j] += __atomic_load_n(&ts->class_bytes[j], __ATOMIC_RELAXED);
+        }
+    }
+    /* A free can be seen before the allocation it undoes. */
+    used_nvm = used > 0 ? used : 0;
+    alloc_count = count > 0 ? count : 0;
+}
+
+/* Live allocations and bytes in size class 'c', as of the last
+ * nvm_stats_fold(). Returns 0 if the class is empty. */
+int nvm_get_size_class(int c, long long *count, long long *bytes) {
+    *count = class_count[c];
+    *bytes = class_bytes[c];
+    return *count > 0;
+}
 
 int is_nvm_addr(const void* ptr) {
     if(!server.nvm_base)
@@ -77,8 +161,8 @@ void* nvm_malloc(size_t size) {
         if (ptr)
             update_nvm_stat_alloc(jemk_malloc_usable_size(ptr));
 #ifdef AEP_COW
-        if(server.rdb_child_pid != -1) {
-            cow_addaddressindict(server.forked_dict, ptr);
+        if(ptr && server.rdb_child_pid != -1) {
+            cow_markforked(ptr);
         }
 #endif
     }
@@ -86,39 +170,46 @@ void* nvm_malloc(size_t size) {
 }
 
 int nvm_free(void* ptr) {
-    /*update_nvm_stat_free(memkind_usable_size(server.pmem_kind, ptr));*/
-    size_t size = jemk_malloc_usable_size(ptr);
 #ifdef AEP_COW
-    if(!cow_isnvmaddrindict(server.forked_dict,ptr) && server.rdb_child_pid !=-1) {
-        cow_addaddressindict(server.cow_dict, ptr);
-        server.cow_nvm_size += size;
+    /* The child may still read what was allocated before the fork. */
+    if(server.rdb_child_pid != -1 && !cow_unmarkforked(ptr)) {
+        cow_deferfree(ptr);
+        server.cow_nvm_size += jemk_malloc_usable_size(ptr);
         return 1;
-    }else if(server.rdb_child_pid != -1) {
-        cow_remaddressindict(server.forked_dict, ptr);
     }
 #endif
-    
-    update_nvm_stat_free(size);
-    memkind_free(server.pmem_kind, ptr);
+    nvm_free_untracked(ptr);
     return 1;
 }
 
+/* Free ptr now, whether a BGSAVE child runs or not. */
+void nvm_free_untracked(void* ptr) {
+    /*update_nvm_stat_free(memkind_usable_size(server.pmem_kind, ptr));*/
+    update_nvm_stat_free(jemk_malloc_usable_size(ptr));
+    memkind_free(server.pmem_kind, ptr);
+}
+
 size_t nvm_usable_size(void* ptr) {
     /*return memkind_usable_size(server.pmem_kind, ptr);*/
     return jemk_malloc_usable_size(ptr);
 }
 
+/* Bytes a string of 'len' bytes takes in a ziplist encoded object: strings
+ * that go to NVM are stored out of line, and only their pointer is kept in
+ * the ziplist. */
+size_t nvm_ziplist_entry_len(size_t len) {
+    if (server.nvm_base && len >= server.sdsmv_threshold)
+        return sizeof(void*);
+    return len;
+}
+
 size_t nvm_get_used(void) {
-    size_t um;
-    atomicGet(used_nvm,um);
-    return um;
+    return used_nvm;
 }
 
 size_t nvm_get_alloc_count(void)
 {
-    size_t ret;
-    atomicGet(alloc_count, ret);
-    return ret;
+    return alloc_count;
 }
 
 size_t nvm_get_rss(void) {
@@ -133,17 +224,15 @@ size_t nvm_get_rss(void) {
 
 
 #ifdef HAVE_DEFRAG
+/* The pmem kind never goes through a thread cache (memkind allocates with
+ * MALLOCX_TCACHE_NONE), and nvm_malloc()/nvm_free() already keep used_nvm
+ * up to date, so these must not count the allocation a second time. */
 void * zmalloc_nvm_no_tcache(size_t size) {
-    void *ptr = nvm_malloc(size);
-    if(ptr)
-        update_nvm_stat_alloc(jemk_malloc_usable_size(ptr));
-    return ptr;
+    return nvm_malloc(size);
 }
 
 void zfree_nvm_no_tcache(void *ptr) {
     if (ptr == NULL) return;
-    size_t size=jemk_malloc_usable_size(ptr);
-    update_nvm_stat_free(size);
     nvm_free(ptr);
 }
 #endif
@@ -42,10 +42,18 @@ extern "C" {
 int is_nvm_addr(const void* ptr);
 void* nvm_malloc(size_t size);
 int nvm_free(void* ptr);
+void nvm_free_untracked(void* ptr);
 size_t nvm_usable_size(void* ptr);
 size_t nvm_get_used(void);
 size_t nvm_get_alloc_count(void);
 size_t nvm_get_rss(void);
+size_t nvm_ziplist_entry_len(size_t len);
+
+/* Allocations are accounted per thread, in NVM_SIZE_CLASSES power of two
+ * size classes, and summed up by nvm_stats_fold(). */
+#define NVM_SIZE_CLASSES 40
+void nvm_stats_fold(void);
+int nvm_get_size_class(int c, long long *count, long long *bytes);
 
 #ifdef HAVE_DEFRAG
 void *zmalloc_nvm_no_tcache(size_t size);
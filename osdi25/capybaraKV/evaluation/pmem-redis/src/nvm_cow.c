@@ -30,71 +30,162 @@
  */
 /***************************************************************************/
 #include "nvm_cow.h"
+#include <stdint.h>
+#include "zmalloc.h"
+#include "nvm.h"
 
-/*compare the two address*/
-static int dictAddrCompare(void *privdata, const void *addr1, const void * addr2) {
-    DICT_NOTUSED(privdata);
-    return addr1==addr2;
-}
+/* The NVM space is split in regions of 2MB, each tracked by a bitmap with one
+ * bit per 8 bytes, the smallest allocation alignment. Bitmaps are created the
+ * first time an allocation of their region is marked, so only the regions
+ * allocated from during a snapshot cost memory (32KB each).
+ *
+ * Both the main thread and the lazy free thread allocate and free NVM, bits
+ * are set and cleared with atomic operations, and deferred frees are pushed on
+ * a lock-free stack of chunks. */
+#define COW_REGION_SHIFT 21
+#define COW_GRAIN_SHIFT 3
+#define COW_REGION_WORDS ((1UL<<(COW_REGION_SHIFT-COW_GRAIN_SHIFT))/64)
+#define COW_FREE_CHUNK_SLOTS 510
+
+typedef struct cowFreeChunk {
+    struct cowFreeChunk *next;
+    size_t used;                    /* slots taken, may overshoot when full */
+    void *addr[COW_FREE_CHUNK_SLOTS];
+} cowFreeChunk;
 
-static void dictAddrDestructor (void *privdata, void *addr) {
-    DICT_NOTUSED(privdata);
-    zfree(addr);
+typedef struct cowState {
+    uint64_t **regions;             /* bitmap of each region, or NULL */
+    size_t nregions;
+    cowFreeChunk *frees;            /* deferred frees, newest chunk first */
+} cowState;
+
+static char *cow_base = NULL;
+static size_t cow_size = 0;
+static cowState *cow_state = NULL;
+
+static cowState *cowCreateState(void) {
+    cowState *st = zmalloc(sizeof(*st));
+    st->nregions = (cow_size+(1UL<<COW_REGION_SHIFT)-1) >> COW_REGION_SHIFT;
+    st->regions = zcalloc(sizeof(uint64_t*)*st->nregions);
+    st->frees = NULL;
+    return st;
 }
 
-static uint64_t dictaddrHash(const void *addr) {
-    return dictGenHashFunction((unsigned char*)&addr, sizeof(void *));
+static cowState *cowCurrentState(void) {
+    return __atomic_load_n(&cow_state, __ATOMIC_ACQUIRE);
 }
 
+/* Return the bitmap word of addr and set *mask to its bit. The bitmap of the
+ * region is created if 'create' is true, otherwise NULL is returned when the
+ * region has none. */
+static uint64_t *cowBitmapWord(void *addr, uint64_t *mask, int create) {
+    cowState *st = cowCurrentState();
+    size_t off = (char*)addr - cow_base;
+    size_t region = off >> COW_REGION_SHIFT;
+    size_t bit = (off & ((1UL<<COW_REGION_SHIFT)-1)) >> COW_GRAIN_SHIFT;
+    uint64_t *bitmap = __atomic_load_n(&st->regions[region], __ATOMIC_ACQUIRE);
 
-static dictType dbforkType = {
-    dictaddrHash,                /* hash function */
-    NULL,                       /* key dup */
-    NULL,                       /* val dup */
-    dictAddrCompare,            /* key compare */
-    NULL,                       /* key destructor */
-    NULL                        /* val destructor */
-};
-
-/*DB->dict, COW dict in which the NVM adress are freeed or duplicated then 
-after BGSAVE, the object must be freeded.*/
-static dictType dbcowType = {
-    dictaddrHash,                /* hash function */
-    NULL,                       /* key dup */
-    NULL,                       /* val dup */
-    dictAddrCompare,            /* key compare */
-    dictAddrDestructor,         /* key destructor */
-    NULL                        /* val destructor */
-};
+    if (bitmap == NULL) {
+        uint64_t *expected = NULL;
+
+        if (!create) return NULL;
+        bitmap = zcalloc(sizeof(uint64_t)*COW_REGION_WORDS);
+        if (!__atomic_compare_exchange_n(&st->regions[region], &expected,
+                bitmap, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        {
+            zfree(bitmap);
+            bitmap = expected;
+        }
+    }
+    *mask = 1ULL << (bit & 63);
+    return bitmap + (bit >> 6);
+}
 
 /***************************************************************************/
 /*NVM COW APIs*/
 /***************************************************************************/
-int cow_isnvmaddrindict(dict *dict, void * addr) {
-    dictEntry *de;
-    de = dictFind(dict,addr);
-    if (de) {
-        return 1;
-    }
-    return 0;
+void cow_init(char *base, size_t size) {
+    cow_base = base;
+    cow_size = size;
+    cow_state = cowCreateState();
+}
+
+/* Return 1 if addr was allocated after the fork, the child doesn't see it. */
+int cow_isforked(void *addr) {
+    uint64_t mask;
+    uint64_t *word = cowBitmapWord(addr, &mask, 0);
+
+    return word && (__atomic_load_n(word, __ATOMIC_RELAXED) & mask) != 0;
 }
 
-void * cow_createforknvmdict() {
-    return dictCreate(&dbforkType, NULL);
+void cow_markforked(void *addr) {
+    uint64_t mask;
+    uint64_t *word = cowBitmapWord(addr, &mask, 1);
+
+    __atomic_fetch_or(word, mask, __ATOMIC_RELAXED);
 }
 
-void * cow_createcownvmdict() {
-    return dictCreate(&dbcowType,NULL);
+/* Unmark addr before it is freed. Return 1 if it was marked. */
+int cow_unmarkforked(void *addr) {
+    uint64_t mask;
+    uint64_t *word = cowBitmapWord(addr, &mask, 0);
+
+    if (word == NULL) return 0;
+    return (__atomic_fetch_and(word, ~mask, __ATOMIC_RELAXED) & mask) != 0;
 }
 
-/* Low level key lookup API, not actually called directly from commands
- * implementations that should instead rely on lookupKeyRead(),
- * lookupKeyWrite() and lookupKeyReadWithFlags(). */
-void cow_addaddressindict(dict * dict, void *addr) {   
-    dictAddRaw(dict, addr, NULL);
+/* Keep addr, still visible to the child, until cow_release(). */
+void cow_deferfree(void *addr) {
+    cowState *st = cowCurrentState();
+
+    while (1) {
+        cowFreeChunk *chunk = __atomic_load_n(&st->frees, __ATOMIC_ACQUIRE);
+        cowFreeChunk *fresh;
+
+        if (chunk) {
+            size_t slot = __atomic_fetch_add(&chunk->used, 1, __ATOMIC_RELAXED);
+            if (slot < COW_FREE_CHUNK_SLOTS) {
+                chunk->addr[slot] = addr;
+                return;
+            }
+        }
+        fresh = zmalloc(sizeof(*fresh));
+        fresh->next = chunk;
+        fresh->used = 1;
+        fresh->addr[0] = addr;
+        if (__atomic_compare_exchange_n(&st->frees, &chunk, fresh, 0,
+                __ATOMIC_RELEASE, __ATOMIC_RELAXED)) return;
+        zfree(fresh);
+    }
 }
 
-void cow_remaddressindict(dict *dict, void *addr) {
-    dictDelete(dict,addr);
+/* Start over with no marked allocation and no deferred free, once the child
+ * exited. Return the previous state, to be passed to cow_release() by the
+ * lazy free thread: pushes in flight from that thread are complete by the
+ * time it gets there. */
+void *cow_reset(void) {
+    cowState *old = cow_state;
+
+    __atomic_store_n(&cow_state, cowCreateState(), __ATOMIC_RELEASE);
+    return old;
 }
 
+/* Free the deferred addresses and the bitmaps of a state. */
+void cow_release(void *state) {
+    cowState *st = state;
+    cowFreeChunk *chunk = st->frees;
+    size_t j;
+
+    while (chunk) {
+        cowFreeChunk *next = chunk->next;
+        size_t used = chunk->used < COW_FREE_CHUNK_SLOTS ?
+                      chunk->used : COW_FREE_CHUNK_SLOTS;
+
+        for (j = 0; j < used; j++) nvm_free_untracked(chunk->addr[j]);
+        zfree(chunk);
+        chunk = next;
+    }
+    for (j = 0; j < st->nregions; j++) zfree(st->regions[j]);
+    zfree(st->regions);
+    zfree(st);
+}
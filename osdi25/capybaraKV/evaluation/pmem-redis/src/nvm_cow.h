@@ -30,18 +30,22 @@
 #ifndef __NVM_COW_H
 #define __NVM_COW_H
 #include "stddef.h"
-#include "dict.h"
-#include "zmalloc.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
-int cow_isnvmaddrindict(dict *dict, void * addr);
-void * cow_createforknvmdict();
-void * cow_createcownvmdict();
-void cow_addaddressindict(dict *dict, void *addr);
-void cow_remaddressindict(dict *dict, void *addr);
+/* While a BGSAVE child runs, NVM allocated before the fork may still be read
+ * by the child, through the shared mapping, and can neither be freed nor
+ * written in place by the parent. Allocations made after the fork are marked
+ * in a bitmap indexed by their offset from the NVM base, frees of the others
+ * are deferred until the child is done. */
+void cow_init(char *base, size_t size);
+int cow_isforked(void *addr);
+void cow_markforked(void *addr);
+int cow_unmarkforked(void *addr);
+void cow_deferfree(void *addr);
+void *cow_reset(void);
+void cow_release(void *state);
 #ifdef __cplusplus
 }
 #endif
 #endif
-
@@ -299,8 +299,12 @@ REDIS_STATIC void __quicklistCompress(const quicklist *quicklist,
      * we can't compress anything. */
     if (!quicklistAllowsCompression(quicklist)) {
 #ifdef USE_NVM
-        /* if list-compress-depth is 0, move raw ziplist node from DDR to NVM. */
-        if (node && node->sz >= server.sdsmv_threshold && getpid() == server.pid) {
+        /* if list-compress-depth is 0, move raw ziplist node from DDR to NVM.
+         * The head and tail nodes take the pushes and pops, so they stay in
+         * DRAM until a new node takes their place, otherwise every push would
+         * reallocate the whole ziplist on NVM. */
+        if (node && node != quicklist->head && node != quicklist->tail &&
+            node->sz >= server.sdsmv_threshold && getpid() == server.pid) {
             unsigned char *zl_nvm = nvm_malloc(node->sz);
             if(zl_nvm) {
                 pmem_memcpy_persist(zl_nvm, node->zl, node->sz);
@@ -462,6 +466,14 @@ _quicklistNodeSizeMeetsOptimizationRequirement(const size_t sz,
 
 #define sizeMeetsSafetyLimit(sz) ((sz) <= SIZE_SAFETY_LIMIT)
 
+/* Bytes 'value' takes in a ziplist: strings on NVM are stored out of line,
+ * the ziplist only holds a pointer to them. */
+#ifdef USE_NVM
+#define ziplistInlineSz(value, sz) (is_nvm_addr(value) ? sizeof(void*) : (sz))
+#else
+#define ziplistInlineSz(value, sz) (sz)
+#endif
+
 REDIS_STATIC int _quicklistNodeAllowInsert(const quicklistNode *node,
                                            const int fill, const size_t sz) {
     if (unlikely(!node))
@@ -524,7 +536,8 @@ REDIS_STATIC int _quicklistNodeAllowMerge(const quicklistNode *a,
  * Returns 1 if new head created. */
 int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
     quicklistNode *orig_head = quicklist->head;
-    if (likely(_quicklistNodeAllowInsert(quicklist->head, quicklist->fill, sz))) {
+    if (likely(_quicklistNodeAllowInsert(quicklist->head, quicklist->fill,
+                                         ziplistInlineSz(value, sz)))) {
 #ifdef AEP_COW
         quicklist->head->zl=redisduplicatenvmaddr(quicklist->head->zl);
 #endif
@@ -550,7 +563,8 @@ int quicklistPushHead(quicklist *quicklist, void *value, size_t sz) {
 int quicklistPushTail(quicklist *quicklist, void *value, size_t sz) {
     quicklistNode *orig_tail = quicklist->tail;
     if (likely(
-            _quicklistNodeAllowInsert(quicklist->tail, quicklist->fill, sz))) {
+            _quicklistNodeAllowInsert(quicklist->tail, quicklist->fill,
+                                      ziplistInlineSz(value, sz)))) {
 #ifdef AEP_COW
         quicklist->tail->zl=redisduplicatenvmaddr(quicklist->tail->zl);
 #endif
@@ -917,7 +931,7 @@ REDIS_STATIC void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
     }
 
     /* Populate accounting flags for easier boolean checks later */
-    if (!_quicklistNodeAllowInsert(node, fill, sz)) {
+    if (!_quicklistNodeAllowInsert(node, fill, ziplistInlineSz(value, sz))) {
         D("Current node is full with count %d with requested fill %lu",
           node->count, fill);
         full = 1;
@@ -926,7 +940,8 @@ REDIS_STATIC void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
     if (after && (entry->offset == node->count)) {
         D("At Tail of current ziplist");
         at_tail = 1;
-        if (!_quicklistNodeAllowInsert(node->next, fill, sz)) {
+        if (!_quicklistNodeAllowInsert(node->next, fill,
+                                       ziplistInlineSz(value, sz))) {
             D("Next node is full too.");
             full_next = 1;
         }
@@ -935,7 +950,8 @@ REDIS_STATIC void _quicklistInsert(quicklist *quicklist, quicklistEntry *entry,
     if (!after && (entry->offset == 0)) {
         D("At Head");
         at_head = 1;
-        if (!_quicklistNodeAllowInsert(node->prev, fill, sz)) {
+        if (!_quicklistNodeAllowInsert(node->prev, fill,
+                                       ziplistInlineSz(value, sz))) {
             D("Prev node is full too.");
             full_prev = 1;
         }
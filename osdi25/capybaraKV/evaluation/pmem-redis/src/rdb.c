@@ -1773,10 +1773,10 @@ void backgroundSaveDoneHandlerDisk(int exitcode, int bysignal) {
     updateSlavesWaitingBgsave((!bysignal && exitcode == 0) ? C_OK : C_ERR, RDB_CHILD_TYPE_DISK);
 #ifdef AEP_COW
     serverLog(LL_NOTICE, "RDB BGSAVE duplicate nvm_size=%ld, memorysize=%ld",server.cow_nvm_size,server.cow_mem_size);
+    nvm_stats_fold();
     serverLog(LL_NOTICE, "RDB BGSAVE before lazy release, memory_used=%ld, nvm_used=%ld",zmalloc_used_memory(),nvm_get_used());
-    bioCreateBackgroundJob(BIO_LAZY_FREE,NULL,server.forked_dict,server.cow_dict); 
-    server.forked_dict=cow_createforknvmdict();
-    server.cow_dict = cow_createcownvmdict();
+    if (server.nvm_base)
+        bioCreateBackgroundJob(BIO_LAZY_FREE,NULL,cow_reset(),NULL);
     server.last_nvm_cow_size=server.cow_nvm_size + server.cow_mem_size;
     server.cow_nvm_size=0;
     server.cow_mem_size=0;
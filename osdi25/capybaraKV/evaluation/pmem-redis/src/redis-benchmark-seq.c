@@ -40,6 +40,7 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <assert.h>
+#include <math.h>
 
 #include <sds.h> /* Use hiredis sds. */
 #include "ae.h"
@@ -51,6 +52,10 @@
 #define RANDPTR_INITIAL_SIZE 8
 #define SEQPTR_INITIAL_SIZE 8
 
+#define DSIZE_DIST_FIXED 0
+#define DSIZE_DIST_UNIFORM 1
+#define DSIZE_DIST_ZIPF 2
+
 static struct config {
     aeEventLoop *el;
     const char *hostip;
@@ -88,6 +93,11 @@ static struct config {
     sds dbnumstr;
     char *tests;
     char *auth;
+    double rate;            /* Open-loop target requests/sec, 0 = closed loop */
+    int dsize_dist;         /* DSIZE_DIST_* of the open-loop value sizes */
+    int dsize_min;          /* Smallest value size, -d is the largest */
+    double zipf_theta;
+    int info_interval;      /* Milliseconds between open-loop INFO samples */
 } config;
 
 typedef struct _client {
@@ -570,6 +580,599 @@ static void benchmark(char *title, char *cmd, int len) {
     freeAllClients();
 }
 
+/* Open-loop mode.
+ *
+ * With --rate the benchmark no longer waits for a reply before sending the
+ * next request: request i is due at start + i/rate, and is queued on the
+ * first connection with less than -P requests in flight. Latency is taken
+ * from the time a request was due, so when the server falls behind, the
+ * requests it kept us from sending are charged too (coordinated omission
+ * correction). The latency from the time a request was actually queued is
+ * kept as well. Both go to HDR style histograms, and the results, as well
+ * as periodic INFO samples of the NVM counters, are printed as JSON lines. */
+
+/* Log-linear histogram of latencies in microseconds: values below
+ * 2*HIST_SUB_COUNT are exact, above that each power of two is split in
+ * HIST_SUB_COUNT buckets (~0.1% precision). */
+#define HIST_SUB_BITS 10
+#define HIST_SUB_COUNT (1<<HIST_SUB_BITS)
+#define HIST_MAX_SHIFT 32
+#define HIST_LEN ((HIST_MAX_SHIFT+2)*HIST_SUB_COUNT)
+#define HIST_MAX_VALUE ((1LL<<(HIST_MAX_SHIFT+HIST_SUB_BITS+1))-1)
+
+typedef struct histogram {
+    long long counts[HIST_LEN];
+    long long total;
+    long long min, max;
+    double sum;
+} histogram;
+
+typedef struct _olclient {
+    redisContext *context;
+    sds obuf;
+    size_t written;         /* Bytes of 'obuf' already written */
+    int writing;            /* Write handler installed */
+    long long *due;         /* Due time of the requests in flight (FIFO) */
+    long long *sent;        /* Time the requests in flight were queued */
+    int head;               /* Oldest request in flight in due/sent */
+    int inflight;           /* Requests in flight, at most config.pipeline */
+    int prefix_pending;     /* Replies to AUTH/SELECT still to discard */
+} *olclient;
+
+static struct openloop {
+    const char *title;
+    olclient *clients;
+    int next;               /* Round robin cursor over 'clients' */
+    long long start;
+    long long issued;
+    long long finished;
+    histogram *corrected;   /* Latency from the time a request was due */
+    histogram *uncorrected; /* Latency from the time a request was queued */
+    int argc;               /* Command template */
+    const char **templates;
+    const char **argv;
+    size_t *argvlen;
+    sds *keys;              /* Copies of the arguments with __rand_int__ */
+    char *data;             /* config.datasize bytes values are taken from */
+    double zipf_zetan, zipf_eta, zipf_alpha;
+    long long zipf_n;
+    redisContext *info;
+    int info_pending;       /* An INFO request is in flight */
+    int info_prefix;        /* AUTH reply still to discard */
+    long long last_sample;
+    long long last_finished;
+} ol;
+
+static const char *olInfoFields[] = {
+    "used_memory",
+    "used_nvm",
+    "used_nvm_rss",
+    "nvm_fragmentation_ratio",
+    "rdb_bgsave_in_progress",
+    "rdb_last_cow_size",
+    "rdb_last_nvm_cow_size",
+    "aof_rewrite_in_progress",
+    "aof_last_cow_size",
+    NULL
+};
+
+static void olWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask);
+
+static int histIndex(long long v) {
+    int shift;
+
+    if (v < 0) v = 0;
+    if (v > HIST_MAX_VALUE) v = HIST_MAX_VALUE;
+    if (v < 2*HIST_SUB_COUNT) return v;
+    shift = 63-__builtin_clzll(v)-HIST_SUB_BITS;
+    return shift*HIST_SUB_COUNT + (int)(v >> shift);
+}
+
+/* Highest latency that is recorded in bucket 'idx'. */
+static long long histValue(int idx) {
+    int shift;
+
+    if (idx < 2*HIST_SUB_COUNT) return idx;
+    shift = idx/HIST_SUB_COUNT-1;
+    return ((long long)(idx-shift*HIST_SUB_COUNT) << shift) + (1LL<<shift) - 1;
+}
+
+static void histRecord(histogram *h, long long v) {
+    h->counts[histIndex(v)]++;
+    if (h->total == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->total++;
+    h->sum += v;
+}
+
+static long long histPercentile(histogram *h, double perc) {
+    long long target = (long long)ceil(perc/100*h->total), seen = 0;
+    int j;
+
+    if (target < 1) target = 1;
+    for (j = 0; j < HIST_LEN; j++) {
+        seen += h->counts[j];
+        if (seen >= target) {
+            long long v = histValue(j);
+            return v > h->max ? h->max : v;
+        }
+    }
+    return h->max;
+}
+
+static sds histToJson(sds s, histogram *h) {
+    static double percs[] = {50, 90, 99, 99.9, 99.99};
+    static const char *names[] = {"p50", "p90", "p99", "p99.9", "p99.99"};
+    size_t j;
+
+    s = sdscatprintf(s,"{\"count\":%lld,\"mean\":%.2f,\"min\":%lld",
+        h->total, h->total ? h->sum/h->total : 0, h->min);
+    for (j = 0; j < sizeof(percs)/sizeof(percs[0]); j++)
+        s = sdscatprintf(s,",\"%s\":%lld",names[j],histPercentile(h,percs[j]));
+    return sdscatprintf(s,",\"max\":%lld}",h->max);
+}
+
+static sds sdscatjson(sds s, const char *str) {
+    s = sdscatlen(s,"\"",1);
+    for (; *str; str++) {
+        if (*str == '"' || *str == '\\')
+            s = sdscatprintf(s,"\\%c",*str);
+        else if ((unsigned char)*str < 0x20)
+            s = sdscatprintf(s,"\\u%04x",(unsigned char)*str);
+        else
+            s = sdscatlen(s,str,1);
+    }
+    return sdscatlen(s,"\"",1);
+}
+
+static double randomUnit(void) {
+    return (double)random()/((double)RAND_MAX+1);
+}
+
+/* Zipfian ranks in [0, n) as in "Quickly generating billion-record synthetic
+ * databases" (Gray et al.), rank 0 being the most frequent. Setup is O(n). */
+static void zipfInit(long long n, double theta) {
+    double zeta2 = 1+pow(0.5,theta);
+    long long j;
+
+    ol.zipf_n = n;
+    ol.zipf_zetan = 0;
+    for (j = 1; j <= n; j++) ol.zipf_zetan += 1/pow((double)j,theta);
+    ol.zipf_alpha = 1/(1-theta);
+    ol.zipf_eta = (1-pow(2.0/n,1-theta))/(1-zeta2/ol.zipf_zetan);
+}
+
+static long long zipfNext(void) {
+    double u = randomUnit(), uz = u*ol.zipf_zetan;
+    long long r;
+
+    if (uz < 1) return 0;
+    if (uz < 1+pow(0.5,config.zipf_theta)) return ol.zipf_n > 1;
+    r = (long long)(ol.zipf_n*pow(ol.zipf_eta*u-ol.zipf_eta+1,ol.zipf_alpha));
+    return r >= ol.zipf_n ? ol.zipf_n-1 : r;
+}
+
+static size_t olValueSize(void) {
+    long long range = config.datasize-config.dsize_min+1;
+
+    switch(config.dsize_dist) {
+    case DSIZE_DIST_UNIFORM: return config.dsize_min+random()%range;
+    case DSIZE_DIST_ZIPF: return config.dsize_min+zipfNext();
+    default: return config.datasize;
+    }
+}
+
+/* Fill the arguments of the next request: __data__ is replaced by a value
+ * of the configured size distribution, __rand_int__ as in closed-loop
+ * mode. */
+static void olPrepareArgs(void) {
+    int j;
+
+    for (j = 0; j < ol.argc; j++) {
+        const char *p = ol.templates[j];
+
+        if (ol.argv[j] == ol.data) {
+            ol.argvlen[j] = olValueSize();
+            continue;
+        }
+        if (ol.argv[j] == p) continue; /* Nothing to expand. */
+        if (!config.sequencekeys &&
+            (!config.randomkeys || config.randomkeys_keyspacelen == 0))
+            continue;
+        /* Search the template, the copy already has digits in place. */
+        while ((p = strstr(p,"__rand_int__")) != NULL) {
+            char *d = ol.keys[j]+(p-ol.templates[j])+11;
+            size_t r, i;
+
+            if (config.sequencekeys)
+                r = config.sequencekeys_keyspacelen--;
+            else
+                r = random() % config.randomkeys_keyspacelen;
+            for (i = 0; i < 12; i++) {
+                *d-- = '0'+r%10;
+                r /= 10;
+            }
+            p += 12; /* 12 is strlen("__rand_int__). */
+        }
+    }
+}
+
+static olclient olCreateClient(void) {
+    olclient c = zmalloc(sizeof(struct _olclient));
+
+    if (config.hostsocket == NULL)
+        c->context = redisConnectNonBlock(config.hostip,config.hostport);
+    else
+        c->context = redisConnectUnixNonBlock(config.hostsocket);
+    if (c->context->err) {
+        fprintf(stderr,"Could not connect to Redis at ");
+        if (config.hostsocket == NULL)
+            fprintf(stderr,"%s:%d: %s\n",config.hostip,config.hostport,c->context->errstr);
+        else
+            fprintf(stderr,"%s: %s\n",config.hostsocket,c->context->errstr);
+        exit(1);
+    }
+    c->context->reader->maxbuf = 0;
+    c->obuf = sdsempty();
+    c->written = 0;
+    c->writing = 0;
+    c->due = zmalloc(sizeof(long long)*config.pipeline);
+    c->sent = zmalloc(sizeof(long long)*config.pipeline);
+    c->head = 0;
+    c->inflight = 0;
+    c->prefix_pending = 0;
+    if (config.auth) {
+        char *buf = NULL;
+        int len = redisFormatCommand(&buf,"AUTH %s",config.auth);
+        c->obuf = sdscatlen(c->obuf,buf,len);
+        free(buf);
+        c->prefix_pending++;
+    }
+    if (config.dbnum != 0) {
+        c->obuf = sdscatprintf(c->obuf,"*2\r\n$6\r\nSELECT\r\n$%d\r\n%s\r\n",
+            (int)sdslen(config.dbnumstr),config.dbnumstr);
+        c->prefix_pending++;
+    }
+    if (sdslen(c->obuf)) {
+        aeCreateFileEvent(config.el,c->context->fd,AE_WRITABLE,olWriteHandler,c);
+        c->writing = 1;
+    }
+    config.liveclients++;
+    return c;
+}
+
+static void olFreeClient(olclient c) {
+    aeDeleteFileEvent(config.el,c->context->fd,AE_WRITABLE);
+    aeDeleteFileEvent(config.el,c->context->fd,AE_READABLE);
+    redisFree(c->context);
+    sdsfree(c->obuf);
+    zfree(c->due);
+    zfree(c->sent);
+    zfree(c);
+    config.liveclients--;
+}
+
+/* Queue request 'due' on 'c', 'now' being the time it is actually queued. */
+static void olQueueRequest(olclient c, long long due, long long now) {
+    char *cmd;
+    int len, slot;
+
+    olPrepareArgs();
+    len = redisFormatCommandArgv(&cmd,ol.argc,ol.argv,ol.argvlen);
+    c->obuf = sdscatlen(c->obuf,cmd,len);
+    free(cmd);
+
+    slot = (c->head+c->inflight) % config.pipeline;
+    c->due[slot] = due;
+    c->sent[slot] = now;
+    c->inflight++;
+    if (!c->writing) {
+        aeCreateFileEvent(config.el,c->context->fd,AE_WRITABLE,olWriteHandler,c);
+        c->writing = 1;
+    }
+}
+
+/* Queue every request that is due by now on connections that have room for
+ * it. What does not fit stays due, and is charged the wait once sent. */
+static void olDispatch(void) {
+    long long now = ustime();
+    long long due = (long long)((now-ol.start)*config.rate/1000000)+1;
+
+    if (due > config.requests) due = config.requests;
+    while (ol.issued < due) {
+        olclient c = NULL;
+        int j;
+
+        for (j = 0; j < config.numclients; j++) {
+            olclient o = ol.clients[(ol.next+j) % config.numclients];
+            if (o->inflight < config.pipeline) {
+                c = o;
+                ol.next = (ol.next+j+1) % config.numclients;
+                break;
+            }
+        }
+        if (c == NULL) break;
+        olQueueRequest(c,ol.start+(long long)(ol.issued*1000000/config.rate),now);
+        ol.issued++;
+    }
+}
+
+static void olWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    olclient c = privdata;
+    ssize_t nwritten;
+    UNUSED(el);
+    UNUSED(mask);
+
+    nwritten = write(fd,c->obuf+c->written,sdslen(c->obuf)-c->written);
+    if (nwritten == -1) {
+        if (errno == EAGAIN) return;
+        fprintf(stderr,"Writing to socket: %s\n",strerror(errno));
+        exit(1);
+    }
+    c->written += nwritten;
+    if (c->written == sdslen(c->obuf)) {
+        sdsclear(c->obuf);
+        c->written = 0;
+        aeDeleteFileEvent(config.el,fd,AE_WRITABLE);
+        c->writing = 0;
+    }
+}
+
+static void olReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    olclient c = privdata;
+    void *reply = NULL;
+    long long now = ustime();
+    UNUSED(el);
+    UNUSED(fd);
+    UNUSED(mask);
+
+    if (redisBufferRead(c->context) != REDIS_OK) {
+        fprintf(stderr,"Error: %s\n",c->context->errstr);
+        exit(1);
+    }
+    while(1) {
+        if (redisGetReply(c->context,&reply) != REDIS_OK) {
+            fprintf(stderr,"Error: %s\n",c->context->errstr);
+            exit(1);
+        }
+        if (reply == NULL) break;
+        if (config.showerrors) {
+            static time_t lasterr_time = 0;
+            time_t t = time(NULL);
+            redisReply *r = reply;
+            if (r->type == REDIS_REPLY_ERROR && lasterr_time != t) {
+                lasterr_time = t;
+                fprintf(stderr,"Error from server: %s\n",r->str);
+            }
+        }
+        freeReplyObject(reply);
+        if (c->prefix_pending > 0) {
+            c->prefix_pending--;
+            continue;
+        }
+        histRecord(ol.corrected,now-c->due[c->head]);
+        histRecord(ol.uncorrected,now-c->sent[c->head]);
+        c->head = (c->head+1) % config.pipeline;
+        c->inflight--;
+        ol.finished++;
+    }
+    if (ol.finished == config.requests) {
+        aeStop(config.el);
+        return;
+    }
+    olDispatch();
+}
+
+static int olTick(struct aeEventLoop *eventLoop, long long id, void *clientData) {
+    long long delay;
+    UNUSED(eventLoop);
+    UNUSED(id);
+    UNUSED(clientData);
+
+    olDispatch();
+    if (ol.issued >= config.requests) return 1;
+    /* Timers have millisecond resolution, poll when the next request is due
+     * sooner than that, or else it is charged the timer slack. */
+    delay = ol.start+(long long)(ol.issued*1000000/config.rate)-ustime();
+    return delay < 1000 ? 0 : delay/1000;
+}
+
+static void olInfoReadHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    redisReply *reply = NULL;
+    long long now = ustime();
+    double dt = (double)(now-ol.last_sample)/1000000;
+    long long due = (long long)((now-ol.start)*config.rate/1000000)+1;
+    sds line;
+    int j;
+    UNUSED(el);
+    UNUSED(privdata);
+    UNUSED(mask);
+
+    if (redisBufferRead(ol.info) != REDIS_OK) goto err;
+    while(1) {
+        if (redisGetReply(ol.info,(void**)&reply) != REDIS_OK) goto err;
+        if (reply == NULL) return;
+        if (!ol.info_prefix) break;
+        freeReplyObject(reply);
+        ol.info_prefix--;
+    }
+
+    if (due > config.requests) due = config.requests;
+    line = sdscatjson(sdsnew("{\"type\":\"sample\",\"test\":"),ol.title);
+    line = sdscatprintf(line,
+        ",\"elapsed_ms\":%lld,\"completed\":%lld,\"rps\":%.2f,\"backlog\":%lld",
+        (now-ol.start)/1000, ol.finished,
+        dt > 0 ? (ol.finished-ol.last_finished)/dt : 0, due-ol.issued);
+    if (reply->type == REDIS_REPLY_STRING) {
+        for (j = 0; olInfoFields[j]; j++) {
+            const char *p = reply->str;
+            size_t flen = strlen(olInfoFields[j]);
+
+            while ((p = strstr(p,olInfoFields[j])) != NULL) {
+                if ((p == reply->str || p[-1] == '\n') && p[flen] == ':') {
+                    p += flen+1;
+                    line = sdscatprintf(line,",\"%s\":%.*s",olInfoFields[j],
+                        (int)strcspn(p,"\r\n"),p);
+                    break;
+                }
+                p += flen;
+            }
+        }
+    }
+    printf("%s}\n",line);
+    fflush(stdout);
+    sdsfree(line);
+    freeReplyObject(reply);
+    ol.last_sample = now;
+    ol.last_finished = ol.finished;
+    ol.info_pending = 0;
+    aeDeleteFileEvent(config.el,fd,AE_READABLE);
+    return;
+
+err:
+    /* Stop sampling, info_pending stays set. */
+    fprintf(stderr,"INFO sampling: %s\n",ol.info->errstr);
+    aeDeleteFileEvent(config.el,fd,AE_READABLE);
+}
+
+static void olInfoWriteHandler(aeEventLoop *el, int fd, void *privdata, int mask) {
+    int done = 0;
+    UNUSED(el);
+    UNUSED(privdata);
+    UNUSED(mask);
+
+    if (redisBufferWrite(ol.info,&done) != REDIS_OK) {
+        fprintf(stderr,"INFO sampling: %s\n",ol.info->errstr);
+        aeDeleteFileEvent(config.el,fd,AE_WRITABLE);
+        return;
+    }
+    if (done) {
+        aeDeleteFileEvent(config.el,fd,AE_WRITABLE);
+        aeCreateFileEvent(config.el,fd,AE_READABLE,olInfoReadHandler,NULL);
+    }
+}
+
+static int olSampleInfo(struct aeEventLoop *eventLoop, long long id, void *clientData) {
+    UNUSED(eventLoop);
+    UNUSED(id);
+    UNUSED(clientData);
+
+    /* Skip a sample rather than pile INFO requests up on a slow server. */
+    if (!ol.info_pending && !ol.info->err) {
+        redisAppendCommand(ol.info,"INFO");
+        aeCreateFileEvent(config.el,ol.info->fd,AE_WRITABLE,olInfoWriteHandler,NULL);
+        ol.info_pending = 1;
+    }
+    return config.info_interval;
+}
+
+/* Tests of the default suite that run in open-loop mode. */
+static struct {
+    const char *name;
+    const char *title;
+    int argc;
+    const char *argv[4];
+} olTests[] = {
+    {"set", "SET", 3, {"SET", "key:__rand_int__", "__data__"}},
+    {"get", "GET", 2, {"GET", "key:__rand_int__"}},
+    {"lpush", "LPUSH", 3, {"LPUSH", "mylist:__rand_int__", "__data__"}},
+    {"sadd", "SADD", 3, {"SADD", "myset:__rand_int__", "__data__"}},
+    {"hset", "HSET", 4, {"HSET", "myhash:__rand_int__", "field:__rand_int__", "__data__"}},
+    {NULL, NULL, 0, {NULL}}
+};
+
+/* Run the command in 'argv' in open-loop mode, see the comment on top of
+ * this section. */
+static void benchmarkOpenLoop(const char *title, int argc, const char **argv) {
+    long long tick_id, info_id = AE_ERR, end;
+    sds line;
+    int j;
+
+    if (config.requests <= 0) return;
+    memset(&ol,0,sizeof(ol));
+    ol.title = title;
+    ol.corrected = zcalloc(sizeof(histogram));
+    ol.uncorrected = zcalloc(sizeof(histogram));
+    ol.argc = argc;
+    ol.templates = argv;
+    ol.argv = zmalloc(sizeof(char*)*argc);
+    ol.argvlen = zmalloc(sizeof(size_t)*argc);
+    ol.keys = zcalloc(sizeof(sds)*argc);
+    ol.data = zmalloc(config.datasize);
+    memset(ol.data,'x',config.datasize);
+    for (j = 0; j < argc; j++) {
+        ol.argv[j] = argv[j];
+        ol.argvlen[j] = strlen(argv[j]);
+        if (!strcmp(argv[j],"__data__")) {
+            ol.argv[j] = ol.data;
+        } else if (strstr(argv[j],"__rand_int__")) {
+            ol.keys[j] = sdsnew(argv[j]);
+            ol.argv[j] = ol.keys[j];
+        }
+    }
+    if (config.dsize_dist == DSIZE_DIST_ZIPF)
+        zipfInit(config.datasize-config.dsize_min+1,config.zipf_theta);
+
+    ol.clients = zmalloc(sizeof(olclient)*config.numclients);
+    for (j = 0; j < config.numclients; j++) {
+        ol.clients[j] = olCreateClient();
+        aeCreateFileEvent(config.el,ol.clients[j]->context->fd,AE_READABLE,
+            olReadHandler,ol.clients[j]);
+    }
+    if (config.info_interval > 0) {
+        if (config.hostsocket == NULL)
+            ol.info = redisConnectNonBlock(config.hostip,config.hostport);
+        else
+            ol.info = redisConnectUnixNonBlock(config.hostsocket);
+        if (config.auth) {
+            redisAppendCommand(ol.info,"AUTH %s",config.auth);
+            ol.info_prefix = 1;
+        }
+        info_id = aeCreateTimeEvent(config.el,config.info_interval,olSampleInfo,NULL,NULL);
+    }
+
+    ol.start = ol.last_sample = ustime();
+    tick_id = aeCreateTimeEvent(config.el,1,olTick,NULL,NULL);
+    olDispatch();
+    aeMain(config.el);
+    end = ustime();
+    aeDeleteTimeEvent(config.el,tick_id);
+
+    line = sdscatjson(sdsnew("{\"type\":\"summary\",\"test\":"),title);
+    line = sdscatprintf(line,
+        ",\"rate\":%.2f,\"clients\":%d,\"pipeline\":%d,\"requests\":%lld"
+        ",\"duration_ms\":%lld,\"rps\":%.2f"
+        ",\"value_size\":{\"dist\":\"%s\",\"min\":%d,\"max\":%d}",
+        config.rate, config.numclients, config.pipeline, ol.finished,
+        (end-ol.start)/1000, ol.finished/((double)(end-ol.start)/1000000),
+        config.dsize_dist == DSIZE_DIST_ZIPF ? "zipf" :
+        config.dsize_dist == DSIZE_DIST_UNIFORM ? "uniform" : "fixed",
+        config.dsize_dist == DSIZE_DIST_FIXED ? config.datasize : config.dsize_min,
+        config.datasize);
+    line = sdscat(line,",\"latency_us\":");
+    line = histToJson(line,ol.corrected);
+    line = sdscat(line,",\"latency_uncorrected_us\":");
+    line = histToJson(line,ol.uncorrected);
+    printf("%s}\n",line);
+    fflush(stdout);
+    sdsfree(line);
+
+    if (info_id != AE_ERR) {
+        aeDeleteTimeEvent(config.el,info_id);
+        aeDeleteFileEvent(config.el,ol.info->fd,AE_READABLE|AE_WRITABLE);
+        redisFree(ol.info);
+    }
+    for (j = 0; j < config.numclients; j++) olFreeClient(ol.clients[j]);
+    for (j = 0; j < argc; j++) sdsfree(ol.keys[j]);
+    zfree(ol.clients);
+    zfree(ol.keys);
+    zfree(ol.argv);
+    zfree(ol.argvlen);
+    zfree(ol.data);
+    zfree(ol.corrected);
+    zfree(ol.uncorrected);
+}
+
 /* Returns number of consumed options. */
 int parseOptions(int argc, const char **argv) {
     int i;
@@ -654,6 +1257,33 @@ int parseOptions(int argc, const char **argv) {
             config.tests = sdscat(config.tests,(char*)argv[++i]);
             config.tests = sdscat(config.tests,",");
             sdstolower(config.tests);
+        } else if (!strcmp(argv[i],"--rate")) {
+            if (lastarg) goto invalid;
+            config.rate = atof(argv[++i]);
+            if (config.rate < 0) config.rate = 0;
+        } else if (!strcmp(argv[i],"--dsize-dist")) {
+            if (lastarg) goto invalid;
+            i++;
+            if (!strcasecmp(argv[i],"fixed"))
+                config.dsize_dist = DSIZE_DIST_FIXED;
+            else if (!strcasecmp(argv[i],"uniform"))
+                config.dsize_dist = DSIZE_DIST_UNIFORM;
+            else if (!strcasecmp(argv[i],"zipf"))
+                config.dsize_dist = DSIZE_DIST_ZIPF;
+            else
+                goto invalid;
+        } else if (!strcmp(argv[i],"--dsize-min")) {
+            if (lastarg) goto invalid;
+            config.dsize_min = atoi(argv[++i]);
+            if (config.dsize_min < 1) config.dsize_min = 1;
+        } else if (!strcmp(argv[i],"--zipf-theta")) {
+            if (lastarg) goto invalid;
+            config.zipf_theta = atof(argv[++i]);
+            if (config.zipf_theta <= 0 || config.zipf_theta >= 1) goto invalid;
+        } else if (!strcmp(argv[i],"--info-interval")) {
+            if (lastarg) goto invalid;
+            config.info_interval = atoi(argv[++i]);
+            if (config.info_interval < 0) config.info_interval = 0;
         } else if (!strcmp(argv[i],"--dbnum")) {
             if (lastarg) goto invalid;
             config.dbnum = atoi(argv[++i]);
@@ -703,7 +1333,17 @@ usage:
 " -l                 Loop. Run the tests forever\n"
 " -t <tests>         Only run the comma separated list of tests. The test\n"
 "                    names are the same as the ones produced as output.\n"
-" -I                 Idle mode. Just open N idle connections and wait.\n\n"
+" -I                 Idle mode. Just open N idle connections and wait.\n"
+" --rate <rps>       Open-loop mode: send <rps> requests per second whether\n"
+"                    or not replies came back, with at most -P requests in\n"
+"                    flight per connection. Latencies are corrected for\n"
+"                    coordinated omission, results are printed as JSON lines.\n"
+"                    In command lines __data__ is replaced by a value.\n"
+" --dsize-dist <dist> Open-loop value sizes: fixed (-d bytes, default),\n"
+"                    uniform or zipf between --dsize-min and -d bytes.\n"
+" --dsize-min <size> Smallest open-loop value size (default 1)\n"
+" --zipf-theta <t>   Skew of the zipf value sizes, 0 < t < 1 (default 0.99)\n"
+" --info-interval <ms> Open-loop INFO sampling period, 0 disables (default 1000)\n\n"
 "Examples:\n\n"
 " Run the benchmark with the default configuration against 127.0.0.1:6379:\n"
 "   $ redis-benchmark\n\n"
@@ -715,6 +1355,9 @@ usage:
 "   $ redis-benchmark -t ping,set,get -n 100000 --csv\n\n"
 " Benchmark a specific command line:\n"
 "   $ redis-benchmark -r 10000 -n 10000 eval 'return redis.call(\"ping\")' 0\n\n"
+" Offer 50k SET/sec with 1-4096 bytes zipf values, 16 requests deep:\n"
+"   $ redis-benchmark-seq -t set -n 1000000 -r 1000000 -P 16 --rate 50000 \\\n"
+"       -d 4096 --dsize-dist zipf\n\n"
 " Fill a list with 10000 random elements:\n"
 "   $ redis-benchmark -r 10000 -n 10000 lpush mylist __rand_int__\n\n"
 " On user specified command lines __rand_int__ is replaced with a random integer\n"
@@ -732,7 +1375,7 @@ int showThroughput(struct aeEventLoop *eventLoop, long long id, void *clientData
         fprintf(stderr,"All clients disconnected... aborting.\n");
         exit(1);
     }
-    if (config.csv) return 250;
+    if (config.csv || config.rate > 0) return 250;
     if (config.idlemode == 1) {
         printf("clients: %d\r", config.liveclients);
         fflush(stdout);
@@ -799,12 +1442,18 @@ int main(int argc, const char **argv) {
     config.tests = NULL;
     config.dbnum = 0;
     config.auth = NULL;
+    config.rate = 0;
+    config.dsize_dist = DSIZE_DIST_FIXED;
+    config.dsize_min = 1;
+    config.zipf_theta = 0.99;
+    config.info_interval = 1000;
 
     i = parseOptions(argc,argv);
     argc -= i;
     argv += i;
 
     config.latency = zmalloc(sizeof(long long)*config.requests);
+    if (config.dsize_min > config.datasize) config.dsize_min = config.datasize;
 
     if (config.keepalive == 0) {
         printf("WARNING: keepalive disabled, you probably need 'echo 1 > /proc/sys/net/ipv4/tcp_tw_reuse' for Linux and 'sudo sysctl -w net.inet.tcp.msl=1000' for Mac OS X in order to use a lot of clients/requests\n");
@@ -818,6 +1467,27 @@ int main(int argc, const char **argv) {
         /* and will wait for every */
     }
 
+    if (config.rate > 0) {
+        if (argc) {
+            sds title = sdsnew(argv[0]);
+            for (i = 1; i < argc; i++) {
+                title = sdscatlen(title, " ", 1);
+                title = sdscatlen(title, (char*)argv[i], strlen(argv[i]));
+            }
+            do {
+                benchmarkOpenLoop(title,argc,argv);
+            } while(config.loop);
+            return 0;
+        }
+        do {
+            for (i = 0; olTests[i].name; i++) {
+                if (test_is_selected((char*)olTests[i].name))
+                    benchmarkOpenLoop(olTests[i].title,olTests[i].argc,olTests[i].argv);
+            }
+        } while(config.loop);
+        return 0;
+    }
+
     /* Run benchmark with command in the remainder of the arguments. */
     if (argc) {
         sds title = sdsnew(argv[0]);
@@ -212,6 +212,47 @@ sds sdsdupnvm(const sds s) {
     return sdsnewlennvm(s, sdslen(s));
 }
 
+/* Like sdsMakeRoomFor(), but the string is moved to a buffer on NVM sized
+ * for exactly 'addlen' more bytes, so that a large value can be read straight
+ * into the memory it is going to be stored in. The string is returned as it is
+ * if it is already on NVM, or if NVM is not configured or full. */
+sds sdsMakeRoomForNvm(sds s, size_t addlen) {
+    void *newsh;
+    size_t len, newlen;
+    char type;
+    int hdrlen;
+    sds news;
+
+    if (!server.nvm_base || is_nvm_addr(s)) return sdsMakeRoomFor(s,addlen);
+
+    len = sdslen(s);
+    newlen = len+addlen;
+    type = sdsReqType(newlen);
+    if (type == SDS_TYPE_5) type = SDS_TYPE_8;
+    hdrlen = sdsHdrSize(type);
+
+    newsh = nvm_malloc(hdrlen+newlen+1);
+    if (newsh == NULL) return sdsMakeRoomFor(s,addlen);
+    news = (char*)newsh+hdrlen;
+    news[-1] = type;
+    /* The content is still transient, it is flushed by sdsflushnvm() once
+     * the string is complete. */
+    memcpy(news, s, len+1);
+    sdsfree(s);
+    sdssetlen(news, len);
+    sdssetalloc(news, newlen);
+    return news;
+}
+
+/* Flush the header and content of a string that was written in place on
+ * NVM, as s_memcpy() does for strings copied there. */
+void sdsflushnvm(const sds s) {
+    if (is_nvm_addr(s)) {
+        size_t hdrsize = sdsheadersize(s);
+        pmem_flush(s-hdrsize, hdrsize+sdslen(s)+1);
+    }
+}
+
 #endif
 
 /* Create a new sds string with the content specified by the 'init' pointer
@@ -228,6 +228,8 @@ sds sdsmvtodram(const sds s);
 
 sds sdsnewlennvm(const void *init, size_t initlen);
 sds sdsdupnvm(const sds s);
+sds sdsMakeRoomForNvm(sds s, size_t addlen);
+void sdsflushnvm(const sds s);
 #endif
 
 sds sdsnewlen(const void *init, size_t initlen);
@@ -892,6 +892,12 @@ void databasesCron(void) {
     if (server.active_defrag_enabled)
         activeDefragCycle();
 
+#ifdef USE_NVM
+    /* Move values between DRAM and NVM following their access pattern. */
+    if (server.nvm_dram_budget)
+        nvmTieringCycle();
+#endif
+
     /* Perform hash tables rehashing if needed, but only if there are no
      * other processes saving the DB on disk. Otherwise rehashing is bad
      * as will cause a lot of copy-on-write of memory pages. */
@@ -995,6 +1001,14 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
     /* Record the max memory used since the server was started. */
     if (zmalloc_used_memory() > server.stat_peak_memory)
         server.stat_peak_memory = zmalloc_used_memory();
+#ifdef USE_NVM
+    /* Sum up the NVM usage the threads accounted on their own. */
+    if (server.nvm_base) {
+        nvm_stats_fold();
+        if (nvm_get_used() > server.stat_peak_nvm)
+            server.stat_peak_nvm = nvm_get_used();
+    }
+#endif
 
     /* Sample the RSS here since this is a relatively slow call. */
     server.resident_set_size = zmalloc_get_rss();
@@ -1133,6 +1147,9 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
     run_with_period(1000) {
         if (server.aof_last_write_status == C_ERR)
             flushAppendOnlyFile(0);
+#ifdef USE_NVM
+        aofRingCron();
+#endif
     }
 
     /* Close clients that need to be closed asynchronous */
@@ -1205,6 +1222,10 @@ int serverCron(struct aeEventLoop *eventLoop, long long id, void *clientData) {
 void beforeSleep(struct aeEventLoop *eventLoop) {
     UNUSED(eventLoop);
 
+    /* Read, parse and execute the queries of the clients postponed by
+     * readQueryFromClient() for the I/O threads. */
+    handleClientsWithPendingReadsUsingThreads();
+
     /* Call the Redis Cluster before sleep function. Note that this function
      * may change the state of Redis Cluster (from ok to fail or vice versa),
      * so it's a good idea to call it before serving the unblocked clients
@@ -1248,7 +1269,7 @@ void beforeSleep(struct aeEventLoop *eventLoop) {
     flushAppendOnlyFile(0);
 
     /* Handle writes with pending output buffers. */
-    handleClientsWithPendingWrites();
+    handleClientsWithPendingWritesUsingThreads();
 
     /* Before we are going to sleep, let the threads access the dataset by
      * releasing the GIL. Redis main thread will not touch anything at this
@@ -1372,6 +1393,8 @@ void initServerConfig(void) {
     server.configfile = NULL;
     server.executable = NULL;
     server.hz = CONFIG_DEFAULT_HZ;
+    server.io_threads_num = CONFIG_DEFAULT_IO_THREADS_NUM;
+    server.io_threads_do_reads = CONFIG_DEFAULT_IO_THREADS_DO_READS;
     server.arch_bits = (sizeof(long) == 8) ? 64 : 32;
     server.port = CONFIG_DEFAULT_SERVER_PORT;
     server.tcp_backlog = CONFIG_DEFAULT_TCP_BACKLOG;
@@ -1531,6 +1554,7 @@ void initServerConfig(void) {
     server.execCommand = lookupCommandByCString("exec");
     server.expireCommand = lookupCommandByCString("expire");
     server.pexpireCommand = lookupCommandByCString("pexpire");
+    server.pexpireatCommand = lookupCommandByCString("pexpireat");
 
     /* Slow log */
     server.slowlog_log_slower_than = CONFIG_DEFAULT_SLOWLOG_LOG_SLOWER_THAN;
@@ -1552,6 +1576,11 @@ void initServerConfig(void) {
     server.nvm_size = 0;
     server.pmem_kind = NULL;
     server.sdsmv_threshold = 0;
+    server.nvm_dram_budget = 0;
+    server.nvm_tiering_rate = CONFIG_DEFAULT_NVM_TIERING_RATE;
+    server.aof_ring_enabled = 0;
+    server.aof_ring_size = CONFIG_DEFAULT_AOF_PMEM_RING_SIZE;
+    server.aof_ring_file = NULL;
 #endif
 
 #ifdef FAST_SDSFREE
@@ -1834,6 +1863,14 @@ void resetServerStats(void) {
     server.stat_active_defrag_misses = 0;
     server.stat_active_defrag_key_hits = 0;
     server.stat_active_defrag_key_misses = 0;
+    server.stat_io_reads_processed = 0;
+    server.stat_io_writes_processed = 0;
+#ifdef USE_NVM
+    server.stat_nvm_promoted = 0;
+    server.stat_nvm_demoted = 0;
+    server.stat_active_defrag_nvm_moved = 0;
+    server.stat_active_defrag_nvm_reclaimed = 0;
+#endif
     server.stat_fork_time = 0;
     server.stat_fork_rate = 0;
     server.stat_rejected_conn = 0;
@@ -1867,6 +1904,9 @@ void allocateNVMSpace(void) {
     }
     server.nvm_base = memkind_base_addr(server.pmem_kind);
     zmalloc_get_nvm_config(server.sdsmv_threshold,server.pmem_kind); 
+#ifdef AEP_COW
+    cow_init(server.nvm_base, server.nvm_size);
+#endif
 }
 #endif
 
@@ -1876,7 +1916,7 @@ void * redisduplicatenvmaddr(void *addr) {
     void * nvm_addr=addr;
     size_t size;
     if(server.rdb_child_pid != -1 && 
-    is_nvm_addr(addr) && !cow_isnvmaddrindict(server.forked_dict,addr)) {
+    is_nvm_addr(addr) && !cow_isforked(addr)) {
         void * dupaddr=NULL;    
         size= jemk_malloc_usable_size(addr);
         dupaddr = nvm_malloc(size);
@@ -1887,11 +1927,10 @@ void * redisduplicatenvmaddr(void *addr) {
         }else {
             //pmem_memcpy_persist(dupaddr, addr, size);
             pmem_memcpy(dupaddr, addr, size,PMEM_F_MEM_NOFLUSH);
-            cow_addaddressindict(server.forked_dict, dupaddr);
             server.cow_nvm_size +=size;
         }
         assert(dupaddr != NULL);
-        cow_addaddressindict(server.cow_dict,addr);
+        cow_deferfree(addr);
         nvm_addr=dupaddr;
     }
     return nvm_addr;
@@ -1917,6 +1956,7 @@ void initServer(void) {
     server.slaves = listCreate();
     server.monitors = listCreate();
     server.clients_pending_write = listCreate();
+    server.clients_pending_read = listCreate();
     server.slaveseldb = -1; /* Force to emit the first SELECT command. */
     server.unblocked_clients = listCreate();
     server.ready_keys = listCreate();
@@ -1970,11 +2010,6 @@ void initServer(void) {
         server.db[j].avg_ttl = 0;
     }
 
-#ifdef AEP_COW
-    server.forked_dict = cow_createforknvmdict();
-    server.cow_dict = cow_createcownvmdict();
-#endif
-
     evictionPoolAlloc(); /* Initialize the LRU keys pool. */
     server.pubsub_channels = dictCreate(&keylistDictType,NULL);
     server.pubsub_patterns = listCreate();
@@ -2048,6 +2083,22 @@ void initServer(void) {
                 strerror(errno));
             exit(1);
         }
+#ifdef USE_NVM
+        /* Write what the PMem ring still holds to the AOF before it is
+         * loaded, also when the ring was disabled since. */
+        if (server.aof_ring_file &&
+            (server.aof_ring_enabled || access(server.aof_ring_file,F_OK) == 0))
+        {
+            if (aofRingOpen(server.aof_ring_file,server.aof_ring_size,
+                            server.aof_filename) == C_ERR)
+            {
+                serverLog(LL_WARNING,"Can't open the AOF PMem ring %s",
+                    server.aof_ring_file);
+                exit(1);
+            }
+            if (!server.aof_ring_enabled) aofRingClose(1);
+        }
+#endif
 #ifdef USE_AOFGUARD
         if(server.aofguard.enable)
         {
@@ -2078,6 +2129,7 @@ void initServer(void) {
     slowlogInit();
     latencyMonitorInit();
     bioInit();
+    initThreadedIO();
     server.initial_memory_usage = zmalloc_used_memory();
 #ifdef USE_NVM
     allocateNVMSpace();
@@ -2673,6 +2725,11 @@ int prepareForShutdown(int flags) {
                 "There is a child rewriting the AOF. Killing it!");
             kill(server.aof_child_pid,SIGUSR1);
         }
+#ifdef USE_NVM
+        if (aofRingRelease() == C_ERR)
+            serverLog(LL_WARNING,"Error draining the AOF PMem ring on "
+                "shutdown, it will be replayed on restart.");
+#endif
         /* Append only file: fsync() the AOF and exit */
         serverLog(LL_NOTICE,"Calling fsync() on the AOF file.");
         aof_fsync(server.aof_fd);
@@ -3042,6 +3099,7 @@ sds genRedisInfoString(char *section) {
         char nvm_rss_hmem[64];
         char peak_nvm_hmem[64];
         char nvm_size_hmem[64];
+        nvm_stats_fold();
         size_t nvm_used = nvm_get_used();
         size_t nvm_alloc_count = nvm_get_alloc_count();
         size_t nvm_rss = nvm_get_rss();
@@ -3279,7 +3337,9 @@ sds genRedisInfoString(char *section) {
             "active_defrag_hits:%lld\r\n"
             "active_defrag_misses:%lld\r\n"
             "active_defrag_key_hits:%lld\r\n"
-            "active_defrag_key_misses:%lld\r\n",
+            "active_defrag_key_misses:%lld\r\n"
+            "io_threaded_reads_processed:%lld\r\n"
+            "io_threaded_writes_processed:%lld\r\n",
             server.stat_numconnections,
             server.stat_numcommands,
             getInstantaneousMetric(STATS_METRIC_COMMAND),
@@ -3303,7 +3363,20 @@ sds genRedisInfoString(char *section) {
             server.stat_active_defrag_hits,
             server.stat_active_defrag_misses,
             server.stat_active_defrag_key_hits,
-            server.stat_active_defrag_key_misses);
+            server.stat_active_defrag_key_misses,
+            server.stat_io_reads_processed,
+            server.stat_io_writes_processed);
+#ifdef USE_NVM
+        info = sdscatprintf(info,
+            "nvm_tiering_promoted:%lld\r\n"
+            "nvm_tiering_demoted:%lld\r\n"
+            "active_defrag_nvm_moved_bytes:%lld\r\n"
+            "active_defrag_nvm_reclaimed_bytes:%lld\r\n",
+            server.stat_nvm_promoted,
+            server.stat_nvm_demoted,
+            server.stat_active_defrag_nvm_moved,
+            server.stat_active_defrag_nvm_reclaimed);
+#endif
     }
 
     /* Replication */
@@ -3465,6 +3538,23 @@ sds genRedisInfoString(char *section) {
         }
     }
 
+#ifdef USE_NVM
+    /* NVM size classes */
+    if (allsections || !strcasecmp(section,"nvmsizes")) {
+        long long count, bytes;
+
+        if (sections++) info = sdscat(info,"\r\n");
+        info = sdscatprintf(info, "# NVMsizes\r\n");
+        nvm_stats_fold();
+        for (j = 0; j < NVM_SIZE_CLASSES; j++) {
+            if (!nvm_get_size_class(j,&count,&bytes)) continue;
+            info = sdscatprintf(info,
+                "nvm_size_le_%llu:count=%lld,bytes=%lld\r\n",
+                1ULL << j, count, bytes);
+        }
+    }
+#endif
+
     /* Cluster */
     if (allsections || defsections || !strcasecmp(section,"cluster")) {
         if (sections++) info = sdscat(info,"\r\n");
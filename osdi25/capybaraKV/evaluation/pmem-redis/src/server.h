@@ -77,6 +77,7 @@ typedef long long mstime_t; /* millisecond time type. */
 
 #ifdef USE_NVM
 #include <memkind.h>
+#include "aof_ring.h"
 
 #define IS_EMBED_IN_ZIPLIST(p, zl) ((char*)(zl) < (char*)(p) && (char*)(p) < (char*)(zl) + ziplistBlobLen(zl))
 #endif
@@ -111,6 +112,9 @@ typedef long long mstime_t; /* millisecond time type. */
 #define CONFIG_DEFAULT_HZ        10      /* Time interrupt calls/sec. */
 #define CONFIG_MIN_HZ            1
 #define CONFIG_MAX_HZ            500
+#define CONFIG_DEFAULT_IO_THREADS_NUM 1  /* Single threaded by default */
+#define CONFIG_DEFAULT_IO_THREADS_DO_READS 0 /* Read clients in the main thread */
+#define IO_THREADS_MAX_NUM       128
 #define CONFIG_DEFAULT_SERVER_PORT        6379    /* TCP port */
 #define CONFIG_DEFAULT_TCP_BACKLOG       511     /* TCP listen backlog */
 #define CONFIG_DEFAULT_CLIENT_TIMEOUT       0       /* default client timeout: infinite */
@@ -190,6 +194,8 @@ typedef long long mstime_t; /* millisecond time type. */
 #define CONFIG_DEFAULT_DEFRAG_IGNORE_BYTES (100<<20) /* don't defrag if frag overhead is below 100mb */
 #define CONFIG_DEFAULT_DEFRAG_CYCLE_MIN 25 /* 25% CPU min (at lower threshold) */
 #define CONFIG_DEFAULT_DEFRAG_CYCLE_MAX 75 /* 75% CPU max (at upper threshold) */
+#define CONFIG_DEFAULT_NVM_TIERING_RATE (64<<20) /* bytes moved between DRAM and NVM per second */
+#define CONFIG_DEFAULT_AOF_PMEM_RING_SIZE (512<<20) /* PMem staging the AOF writes */
 
 #define ACTIVE_EXPIRE_CYCLE_LOOKUPS_PER_LOOP 20 /* Loopkups per loop. */
 #define ACTIVE_EXPIRE_CYCLE_FAST_DURATION 1000 /* Microseconds */
@@ -278,6 +284,9 @@ typedef long long mstime_t; /* millisecond time type. */
 #define CLIENT_LUA_DEBUG (1<<25)  /* Run EVAL in debug mode. */
 #define CLIENT_LUA_DEBUG_SYNC (1<<26)  /* EVAL debugging without fork() */
 #define CLIENT_MODULE (1<<27) /* Non connected client used by some module. */
+#define CLIENT_PENDING_READ (1<<28) /* The client is read by an I/O thread. */
+#define CLIENT_PENDING_COMMAND (1<<29) /* An I/O thread parsed a command the
+                                          main thread did not execute yet. */
 
 /* Client block type (btype field in client structure)
  * if CLIENT_BLOCKED flag is set. */
@@ -606,6 +615,9 @@ typedef struct RedisModuleDigest {
 #define OBJ_ENCODING_EMBSTR 8  /* Embedded sds string encoding */
 #define OBJ_ENCODING_QUICKLIST 9 /* Encoded as linked list of ziplists */
 
+/* Longest string kept in the EMBSTR encoding, see createStringObject(). */
+#define OBJ_ENCODING_EMBSTR_SIZE_LIMIT 44
+
 #define LRU_BITS 24
 #define LRU_CLOCK_MAX ((1<<LRU_BITS)-1) /* Max value of obj->lru */
 #define LRU_CLOCK_RESOLUTION 1000 /* LRU clock resolution in ms */
@@ -914,6 +926,9 @@ struct redisServer {
     char *executable;           /* Absolute executable file path. */
     char **exec_argv;           /* Executable argv vector (copy). */
     int hz;                     /* serverCron() calls frequency in hertz */
+    int io_threads_num;         /* Number of I/O threads, main one included */
+    int io_threads_do_reads;    /* Read and parse in the I/O threads too */
+    int io_threads_active;      /* The I/O threads are running, not parked */
     redisDb *db;
     dict *commands;             /* Command table */
     dict *orig_commands;        /* Command table before command renaming. */
@@ -951,6 +966,7 @@ struct redisServer {
     list *clients;              /* List of active clients */
     list *clients_to_close;     /* Clients to close asynchronously */
     list *clients_pending_write; /* There is to write or install handler. */
+    list *clients_pending_read; /* Clients to read and parse in I/O threads. */
     list *slaves, *monitors;    /* List of slaves and MONITORs */
     client *current_client; /* Current client, only used on crash report */
     int clients_paused;         /* True if clients are currently paused */
@@ -968,7 +984,7 @@ struct redisServer {
     /* Fast pointers to often looked up command */
     struct redisCommand *delCommand, *multiCommand, *lpushCommand, *lpopCommand,
                         *rpopCommand, *sremCommand, *execCommand, *expireCommand,
-                        *pexpireCommand;
+                        *pexpireCommand, *pexpireatCommand;
     /* Fields used only for stats */
     time_t stat_starttime;          /* Server start time */
     long long stat_numcommands;     /* Number of processed commands */
@@ -981,9 +997,15 @@ struct redisServer {
     long long stat_active_defrag_misses;    /* number of allocations scanned but not moved */
     long long stat_active_defrag_key_hits;  /* number of keys with moved allocations */
     long long stat_active_defrag_key_misses;/* number of keys scanned and not moved */
+    long long stat_io_reads_processed; /* Clients read by the I/O threads */
+    long long stat_io_writes_processed; /* Clients written by the I/O threads */
     size_t stat_peak_memory;        /* Max used memory record */
 #ifdef USE_NVM
     size_t stat_peak_nvm;           /* Max used nvm record */
+    long long stat_nvm_promoted;    /* Values moved from NVM to DRAM */
+    long long stat_nvm_demoted;     /* Values moved from DRAM to NVM */
+    long long stat_active_defrag_nvm_moved; /* Bytes moved by active defrag within NVM */
+    long long stat_active_defrag_nvm_reclaimed; /* NVM fragmentation bytes released by active defrag */
 #endif
     long long stat_fork_time;       /* Time needed to perform latest fork() */
     double stat_fork_rate;          /* Fork rate in GB/sec. */
@@ -1246,12 +1268,14 @@ struct redisServer {
     size_t nvm_size;
     struct memkind *pmem_kind;
     size_t sdsmv_threshold;
+    size_t nvm_dram_budget;    /* DRAM kept for hot values, 0 disables tiering */
+    size_t nvm_tiering_rate;   /* Max bytes moved between tiers per second */
+    int aof_ring_enabled;      /* Stage appendfsync always writes on PMem */
+    size_t aof_ring_size;      /* Bytes of the PMem ring */
+    char *aof_ring_file;       /* PMem ring file in nvm_dir */
 #endif
 
 #ifdef AEP_COW
-    dict *forked_dict;         /*once bgsave, if new nvm address will be put into the forked dict. 
-                                if the address is not in the forked_dict, it means need to duplicate*/
-    dict *cow_dict;             /*duplicate address or the deleted address will be added into the cow_dict*/
     size_t cow_nvm_size;
     size_t cow_mem_size;
     size_t last_nvm_cow_size;   /*cow_nvm_size + cow_mem_size*/
@@ -1486,6 +1510,9 @@ void pauseClients(mstime_t duration);
 int clientsArePaused(void);
 int processEventsWhileBlocked(void);
 int handleClientsWithPendingWrites(void);
+void initThreadedIO(void);
+int handleClientsWithPendingWritesUsingThreads(void);
+int handleClientsWithPendingReadsUsingThreads(void);
 int clientHasPendingReplies(client *c);
 void unlinkClient(client *c);
 int writeToClient(int fd, client *c, int handler_installed);
@@ -1573,6 +1600,9 @@ int compareStringObjects(robj *a, robj *b);
 int collateStringObjects(robj *a, robj *b);
 int equalStringObjects(robj *a, robj *b);
 unsigned long long estimateObjectIdleTime(robj *o);
+#ifdef USE_NVM
+void nvmTieringCycle(void);
+#endif
 #define sdsEncodedObject(objptr) (objptr->encoding == OBJ_ENCODING_RAW || objptr->encoding == OBJ_ENCODING_EMBSTR)
 
 #ifdef SUPPORT_PBA
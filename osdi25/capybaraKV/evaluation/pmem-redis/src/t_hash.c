@@ -47,8 +47,14 @@ void hashTypeTryConversion(robj *o, robj **argv, int start, int end) {
     if (o->encoding != OBJ_ENCODING_ZIPLIST) return;
 
     for (i = start; i <= end; i++) {
+#ifdef USE_NVM
+        if (sdsEncodedObject(argv[i]) &&
+            nvm_ziplist_entry_len(sdslen(argv[i]->ptr)) >
+            server.hash_max_ziplist_value)
+#else
         if (sdsEncodedObject(argv[i]) &&
             sdslen(argv[i]->ptr) > server.hash_max_ziplist_value)
+#endif
         {
             hashTypeConvert(o, OBJ_ENCODING_HT);
             break;
@@ -205,6 +211,9 @@ int hashTypeExists(robj *o, sds field) {
 #define HASH_SET_COPY 0
 int hashTypeSet(robj *o, sds field, sds value, int flags) {
     int update = 0;
+#ifdef USE_NVM
+    int inline_large = 0; /* A large string did not make it to NVM */
+#endif
 
     if (o->encoding == OBJ_ENCODING_ZIPLIST) {
         unsigned char *zl, *fptr, *vptr;
@@ -235,6 +244,11 @@ int hashTypeSet(robj *o, sds field, sds value, int flags) {
 #endif
 #ifdef SUPPORT_PBA
                 setArgPBA(ele);
+#endif
+#ifdef USE_NVM
+                if (!is_nvm_addr(ele) &&
+                    sdslen(ele) > server.hash_max_ziplist_value)
+                    inline_large = 1;
 #endif
                 /* Insert new value */
                 zl = ziplistInsert(zl, vptr, (unsigned char*)ele,
@@ -267,6 +281,13 @@ int hashTypeSet(robj *o, sds field, sds value, int flags) {
 #endif
 #ifdef SUPPORT_PBA
             setArgPBA(vele);
+#endif
+#ifdef USE_NVM
+            if ((!is_nvm_addr(fele) &&
+                 sdslen(fele) > server.hash_max_ziplist_value) ||
+                (!is_nvm_addr(vele) &&
+                 sdslen(vele) > server.hash_max_ziplist_value))
+                inline_large = 1;
 #endif
             /* Push new field/value pair onto the tail of the ziplist */
             zl = ziplistPush(zl, (unsigned char*)fele, sdslen(fele),
@@ -279,6 +300,10 @@ int hashTypeSet(robj *o, sds field, sds value, int flags) {
         /* Check if the ziplist needs to be converted to a hash table */
         if (hashTypeLength(o) > server.hash_max_ziplist_entries)
             hashTypeConvert(o, OBJ_ENCODING_HT);
+#ifdef USE_NVM
+        else if (inline_large)
+            hashTypeConvert(o, OBJ_ENCODING_HT);
+#endif
     } else if (o->encoding == OBJ_ENCODING_HT) {
         dictEntry *de = dictFind(o->ptr,field);
         if (de) {
@@ -1297,6 +1297,33 @@ int zsetScore(robj *zobj, sds member, double *score) {
     return C_OK;
 }
 
+/* Insert 'ele' with 'score' into the ziplist of 'zobj'. Elements of
+ * nvm-threshold bytes or more are duplicated to NVM, and the ziplist only
+ * keeps a pointer to them. Returns 1 if the element is kept inline and is
+ * too large for the ziplist encoding, 0 otherwise. */
+static int zzlInsertMember(robj *zobj, sds ele, double score) {
+    sds zele = ele;
+#ifdef USE_NVM
+    if(sdslen(zele)>= server.sdsmv_threshold)
+    {
+        sds e = sdsdupnvm(zele);
+        if(!is_nvm_addr(e))
+            sdsfree(e);
+        else
+            zele = e;
+    }
+#endif
+#ifdef SUPPORT_PBA
+    setArgPBA(zele);
+#endif
+    zobj->ptr = zzlInsert(zobj->ptr,zele,score);
+#ifdef USE_NVM
+    /* Elements on NVM only take a pointer in the ziplist. */
+    if (is_nvm_addr(zele)) return 0;
+#endif
+    return sdslen(ele) > server.zset_max_ziplist_value;
+}
+
 /* Add a new element or update the score of an existing element in a sorted
  * set, regardless of its encoding.
  *
@@ -1382,32 +1409,20 @@ int zsetAdd(robj *zobj, double score, sds ele, int *flags, double *newscore) {
             /* Remove and re-insert when score changed. */
             if (score != curscore) {
                 zobj->ptr = zzlDelete(zobj->ptr,eptr);
-                zobj->ptr = zzlInsert(zobj->ptr,ele,score);
+                /* Deleting freed the NVM copy of the element, so it is
+                 * duplicated again like a new element. */
+                if (zzlInsertMember(zobj,ele,score))
+                    zsetConvert(zobj,OBJ_ENCODING_SKIPLIST);
                 *flags |= ZADD_UPDATED;
             }
             return 1;
         } else if (!xx) {
             /* Optimize: check if the element is too large or the list
              * becomes too long *before* executing zzlInsert. */
-            /*only update the value and only duplicate the value to NVM*/
-             sds zele = ele;
- #ifdef USE_NVM
-             if(sdslen(zele)>= server.sdsmv_threshold)
-             {
-                 sds e = sdsdupnvm(zele);
-                 if(!is_nvm_addr(e))
-                     sdsfree(e);
-                 else
-                     zele = e;
-             }
-#endif
-#ifdef SUPPORT_PBA
-            setArgPBA(zele);
-#endif
-            zobj->ptr = zzlInsert(zobj->ptr,zele,score);
+            int inline_large = zzlInsertMember(zobj,ele,score);
             if (zzlLength(zobj->ptr) > server.zset_max_ziplist_entries)
                 zsetConvert(zobj,OBJ_ENCODING_SKIPLIST);
-            if (sdslen(ele) > server.zset_max_ziplist_value)
+            else if (inline_large)
                 zsetConvert(zobj,OBJ_ENCODING_SKIPLIST);
             if (newscore) *newscore = score;
             *flags |= ZADD_ADDED;
@@ -1680,8 +1695,14 @@ void zaddGenericCommand(client *c, int flags) {
     zobj = lookupKeyWrite(c->db,key);
     if (zobj == NULL) {
         if (xx) goto reply_to_client; /* No key + XX option: nothing to do. */
+#ifdef USE_NVM
+        if (server.zset_max_ziplist_entries == 0 ||
+            server.zset_max_ziplist_value <
+            nvm_ziplist_entry_len(sdslen(c->argv[scoreidx+1]->ptr)))
+#else
         if (server.zset_max_ziplist_entries == 0 ||
             server.zset_max_ziplist_value < sdslen(c->argv[scoreidx+1]->ptr))
+#endif
         {
             zobj = createZsetObject();
         } else {
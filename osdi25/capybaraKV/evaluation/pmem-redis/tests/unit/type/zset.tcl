@@ -768,6 +768,21 @@ start_server {
     basics ziplist
     basics skiplist
 
+    test {[NVM] ZINCRBY keeps a large ziplist member on NVM} {
+        r config set zset-max-ziplist-entries 128
+        r config set zset-max-ziplist-value 64
+        set member [string repeat x 200]
+        r del ztmp
+        r zadd ztmp 1 $member
+        assert_encoding ziplist ztmp
+        set size [r memory usage ztmp]
+        r zincrby ztmp 1 $member
+        r zadd ztmp 3 $member
+        assert_encoding ziplist ztmp
+        assert_equal $size [r memory usage ztmp]
+        r zscore ztmp $member
+    } {3}
+
     test {ZINTERSTORE regression with two sets, intset+hashtable} {
         r del seta setb setc
         r sadd set1 a
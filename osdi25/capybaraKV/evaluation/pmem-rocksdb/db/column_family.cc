@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <cinttypes>
+#include <cstring>
 #include <limits>
 #include <string>
 #include <vector>
@@ -27,6 +28,7 @@
 #include "db/table_properties_collector.h"
 #include "db/version_set.h"
 #include "db/write_controller.h"
+#include "dcpmm/kvs_dcpmm.h"
 #include "file/sst_file_manager_impl.h"
 #include "memtable/hash_skiplist_rep.h"
 #include "monitoring/thread_status_util.h"
@@ -860,6 +862,15 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
         vstorage->estimated_compaction_needed_bytes(), mutable_cf_options);
     write_stall_condition = write_stall_condition_and_cause.first;
     auto write_stall_cause = write_stall_condition_and_cause.second;
+#ifdef ON_DCPMM
+    // KVS fills up faster than compactions migrate values out of it. Slow
+    // writes down rather than letting them fall back to inline values.
+    if (write_stall_condition == WriteStallCondition::kNormal &&
+        KVSEnabled() && KVSNeedsWriteDelay()) {
+      write_stall_condition = WriteStallCondition::kDelayed;
+      write_stall_cause = WriteStallCause::kDcpmmKvsUsage;
+    }
+#endif
 
     bool was_stopped = write_controller->IsStopped();
     bool needed_delay = write_controller->NeedsDelay();
@@ -960,6 +971,20 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
           "bytes %" PRIu64 " rate %" PRIu64,
           name_.c_str(), vstorage->estimated_compaction_needed_bytes(),
           write_controller->delayed_write_rate());
+#ifdef ON_DCPMM
+    } else if (write_stall_condition == WriteStallCondition::kDelayed &&
+               write_stall_cause == WriteStallCause::kDcpmmKvsUsage) {
+      auto usage = KVSGetUsage();
+      write_controller_token_ =
+          SetupDelay(write_controller, usage.used, prev_dcpmm_kvs_used_,
+                     was_stopped, mutable_cf_options.disable_auto_compactions);
+      prev_dcpmm_kvs_used_ = usage.used;
+      ROCKS_LOG_WARN(ioptions_.info_log,
+                     "[%s] Stalling writes because DCPMM KVS uses %" ROCKSDB_PRIszt
+                     " of %" ROCKSDB_PRIszt " bytes rate %" PRIu64,
+                     name_.c_str(), usage.used, usage.capacity,
+                     write_controller->delayed_write_rate());
+#endif
     } else {
       assert(write_stall_condition == WriteStallCondition::kNormal);
       if (vstorage->l0_delay_trigger_count() >=
@@ -973,6 +998,18 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
             "[%s] Increasing compaction threads because we have %d level-0 "
             "files ",
             name_.c_str(), vstorage->l0_delay_trigger_count());
+#ifdef ON_DCPMM
+      } else if (KVSEnabled() && KVSNeedsMigration()) {
+        // Compactions migrate values out of KVS while it is above the
+        // migrate ratio, run more of them.
+        write_controller_token_ =
+            write_controller->GetCompactionPressureToken();
+        ROCKS_LOG_INFO(
+            ioptions_.info_log,
+            "[%s] Increasing compaction threads to migrate values out of "
+            "DCPMM KVS",
+            name_.c_str());
+#endif
       } else if (vstorage->estimated_compaction_needed_bytes() >=
                  mutable_cf_options.soft_pending_compaction_bytes_limit / 4) {
         // Increase compaction threads if bytes needed for compaction exceeds
@@ -1034,8 +1071,32 @@ uint64_t ColumnFamilyData::GetLiveSstFilesSize() const {
 
 MemTable* ColumnFamilyData::ConstructNewMemtable(
     const MutableCFOptions& mutable_cf_options, SequenceNumber earliest_seq) {
+  DcpmmArena* dcpmm_arena = nullptr;
+#ifdef ON_DCPMM
+  // Only the skiplist rep knows how to reattach to a recovered arena.
+  const ImmutableDBOptions* db_options =
+      column_family_set_ != nullptr ? column_family_set_->db_options_ : nullptr;
+  if (db_options != nullptr && !db_options->dcpmm_memtable_dir.empty() &&
+      strcmp(ioptions_.memtable_factory->Name(), "SkipListFactory") == 0) {
+    size_t arena_size = db_options->dcpmm_memtable_arena_size;
+    if (arena_size == 0) {
+      arena_size = 2 * mutable_cf_options.write_buffer_size;
+    }
+    std::unique_ptr<DcpmmArena> arena;
+    Status s = DcpmmArena::Create(db_options->dcpmm_memtable_dir, id_,
+                                  arena_size, &arena);
+    if (s.ok()) {
+      dcpmm_arena = arena.release();
+    } else {
+      ROCKS_LOG_WARN(ioptions_.info_log,
+                     "[%s] Failed to create DCPMM memtable arena, "
+                     "using DRAM: %s",
+                     name_.c_str(), s.ToString().c_str());
+    }
+  }
+#endif
   return new MemTable(internal_comparator_, ioptions_, mutable_cf_options,
-                      write_buffer_manager_, earliest_seq, id_);
+                      write_buffer_manager_, earliest_seq, id_, dcpmm_arena);
 }
 
 void ColumnFamilyData::CreateNewMemtable(
@@ -473,6 +473,7 @@ class ColumnFamilyData {
     kMemtableLimit,
     kL0FileCountLimit,
     kPendingCompactionBytes,
+    kDcpmmKvsUsage,
   };
   static std::pair<WriteStallCondition, WriteStallCause>
   GetWriteStallConditionAndCause(int num_unflushed_memtables, int num_l0_files,
@@ -588,6 +589,11 @@ class ColumnFamilyData {
 
   uint64_t prev_compaction_needed_bytes_;
 
+#ifdef ON_DCPMM
+  // KVS usage seen at the last delay, to tell if the delay is working.
+  uint64_t prev_dcpmm_kvs_used_ = 0;
+#endif
+
   // if the database was opened with 2pc enabled
   bool allow_2pc_;
 
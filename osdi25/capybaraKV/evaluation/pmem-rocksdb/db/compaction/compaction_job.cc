@@ -910,6 +910,14 @@ void CompactionJob::ProcessKeyValueCompaction(SubcompactionState* sub_compact) {
                                   sub_compact->current_output_file_size);
   }
   const auto& c_iter_stats = c_iter->iter_stats();
+#ifdef ON_DCPMM
+  // Move values out of KVS at this level, or at any level once KVS is
+  // filling up.
+  const bool kvs_migrate =
+      KVSEnabled() &&
+      (sub_compact->compaction->output_level() > db_options_.dcpmm_kvs_level ||
+       KVSNeedsMigration());
+#endif
 
   while (status.ok() && !cfd->IsDropped() && c_iter->Valid()) {
     // Invariant: c_iter.status() is guaranteed to be OK if c_iter->Valid()
@@ -941,7 +949,7 @@ void CompactionJob::ProcessKeyValueCompaction(SubcompactionState* sub_compact) {
     assert(sub_compact->current_output() != nullptr);
 #ifdef ON_DCPMM
     if(KVSEnabled()){
-    if((sub_compact->compaction->output_level() > db_options_.dcpmm_kvs_level) &&
+    if(kvs_migrate &&
         (KVSGetEncoding(value.data()) != kEncodingRawCompressed) &&
         (KVSGetEncoding(value.data()) != kEncodingRawUncompressed)){
       auto add = std::bind(&TableBuilder::Add, sub_compact->builder.get(), key, std::placeholders::_1);
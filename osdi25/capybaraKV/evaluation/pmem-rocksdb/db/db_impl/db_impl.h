@@ -1411,6 +1411,14 @@ class DBImpl : public DB {
                          SequenceNumber* next_sequence, bool read_only,
                          bool* corrupted_log_found);
 
+#ifdef ON_DCPMM
+  // Flush the memtables a previous incarnation sealed in DCPMM arenas and
+  // advance the column families' log numbers past them, so that their WALs
+  // are not replayed. Arenas that cannot be used are deleted; their content
+  // is recovered from the WAL.
+  Status RecoverDcpmmMemtables();
+#endif
+
   // The following two methods are used to flush a memtable to
   // storage. The first one is used at database RecoveryTime (when the
   // database is opened) and is heavyweight because it holds the mutex
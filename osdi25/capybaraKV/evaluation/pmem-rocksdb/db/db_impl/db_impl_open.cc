@@ -370,6 +370,15 @@ Status DBImpl::Recover(
       return s;
     }
 
+#ifdef ON_DCPMM
+    if (!immutable_db_options_.dcpmm_memtable_dir.empty()) {
+      s = env_->CreateDirIfMissing(immutable_db_options_.dcpmm_memtable_dir);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+#endif
+
     std::string current_fname = CurrentFileName(dbname_);
     // Path to any MANIFEST file in the db dir. It does not matter which one.
     // Since best-efforts recovery ignores CURRENT file, existence of a
@@ -506,6 +515,14 @@ Status DBImpl::Recover(
   if (s.ok() && immutable_db_options_.persist_stats_to_disk) {
     s = InitPersistStatsColumnFamily();
   }
+#ifdef ON_DCPMM
+  // Prepared transactions keep older WALs alive, the arenas alone cannot
+  // tell which of their entries were committed.
+  if (s.ok() && !read_only && !immutable_db_options_.allow_2pc &&
+      !immutable_db_options_.dcpmm_memtable_dir.empty()) {
+    s = RecoverDcpmmMemtables();
+  }
+#endif
 
   if (s.ok()) {
     // Initial max_total_in_memory_state_ before recovery logs. Log recovery
@@ -1173,6 +1190,125 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
   return status;
 }
 
+#ifdef ON_DCPMM
+Status DBImpl::RecoverDcpmmMemtables() {
+  mutex_.AssertHeld();
+  const std::string& dir = immutable_db_options_.dcpmm_memtable_dir;
+  std::vector<std::string> filenames;
+  Status s = env_->GetChildren(dir, &filenames);
+  if (!s.ok()) {
+    return s;
+  }
+
+  std::map<uint32_t, std::vector<std::unique_ptr<DcpmmArena>>> sealed;
+  for (const auto& fname : filenames) {
+    if (!DcpmmArena::IsArenaFile(fname)) {
+      continue;
+    }
+    const std::string path = dir + "/" + fname;
+    std::unique_ptr<DcpmmArena> arena;
+    Status open_s = DcpmmArena::Open(path, &arena);
+    if (open_s.IsBusy()) {
+      // A memtable of this incarnation.
+      continue;
+    }
+    if (!open_s.ok()) {
+      ROCKS_LOG_WARN(immutable_db_options_.info_log,
+                     "Deleting DCPMM memtable arena %s: %s", path.c_str(),
+                     open_s.ToString().c_str());
+      env_->DeleteFile(path);
+      continue;
+    }
+    auto* cfd = versions_->GetColumnFamilySet()->GetColumnFamily(
+        arena->GetColumnFamilyID());
+    if (cfd == nullptr || !arena->IsSealed() ||
+        arena->GetNextLogNumber() <= cfd->GetLogNumber()) {
+      arena->Discard();
+      continue;
+    }
+    sealed[cfd->GetID()].push_back(std::move(arena));
+  }
+
+  int job_id = next_job_id_.fetch_add(1);
+  std::map<uint32_t, VersionEdit> version_edits;
+  std::vector<MemTable*> mems;
+  SequenceNumber max_sequence = 0;
+  for (auto& entry : sealed) {
+    if (!s.ok()) {
+      break;
+    }
+    auto* cfd = versions_->GetColumnFamilySet()->GetColumnFamily(entry.first);
+    auto& arenas = entry.second;
+    std::sort(arenas.begin(), arenas.end(),
+              [](const std::unique_ptr<DcpmmArena>& a,
+                 const std::unique_ptr<DcpmmArena>& b) {
+                return a->GetLastSequence() < b->GetLastSequence();
+              });
+    VersionEdit edit;
+    edit.SetColumnFamily(cfd->GetID());
+    uint64_t log_number = cfd->GetLogNumber();
+    for (auto& arena : arenas) {
+      if (!s.ok()) {
+        break;
+      }
+      // Each arena must start where the previous one, or the last flush,
+      // stopped. From the first gap on, the WAL has to be replayed anyway.
+      if (arena->GetLogNumber() == 0 || arena->GetLogNumber() > log_number) {
+        arena->Discard();
+        continue;
+      }
+      const uint64_t next_log_number = arena->GetNextLogNumber();
+      const SequenceNumber last_sequence = arena->GetLastSequence();
+      ROCKS_LOG_INFO(immutable_db_options_.info_log,
+                     "[%s] Recovering memtable from DCPMM arena %s",
+                     cfd->GetName().c_str(), arena->GetFileName().c_str());
+      MemTable* mem = new MemTable(
+          cfd->internal_comparator(), *cfd->ioptions(),
+          *cfd->GetLatestMutableCFOptions(), nullptr /* write_buffer_manager */,
+          kMaxSequenceNumber, cfd->GetID(), arena.release());
+      mem->Ref();
+      mems.push_back(mem);
+      s = WriteLevel0TableForRecovery(job_id, cfd, mem, &edit);
+      if (s.ok()) {
+        log_number = next_log_number;
+        max_sequence = std::max(max_sequence, last_sequence);
+      }
+    }
+    if (log_number > cfd->GetLogNumber()) {
+      edit.SetLogNumber(log_number);
+      version_edits[cfd->GetID()] = edit;
+    }
+  }
+
+  if (s.ok() && !version_edits.empty()) {
+    if (versions_->LastSequence() < max_sequence) {
+      versions_->SetLastAllocatedSequence(max_sequence);
+      versions_->SetLastPublishedSequence(max_sequence);
+      versions_->SetLastSequence(max_sequence);
+    }
+    autovector<ColumnFamilyData*> cfds;
+    autovector<const MutableCFOptions*> cf_opts;
+    autovector<autovector<VersionEdit*>> edit_lists;
+    for (auto& entry : version_edits) {
+      auto* cfd = versions_->GetColumnFamilySet()->GetColumnFamily(entry.first);
+      cfds.push_back(cfd);
+      cf_opts.push_back(cfd->GetLatestMutableCFOptions());
+      edit_lists.push_back({&entry.second});
+    }
+    s = versions_->LogAndApply(cfds, cf_opts, edit_lists, &mutex_,
+                               directories_.GetDbDir());
+  }
+  for (auto* mem : mems) {
+    // Keep the arenas for the next attempt if the flush did not commit.
+    if (s.ok()) {
+      mem->GetDcpmmArena()->Discard();
+    }
+    delete mem->Unref();
+  }
+  return s;
+}
+#endif
+
 Status DBImpl::RestoreAliveLogFiles(const std::vector<uint64_t>& log_numbers) {
   if (log_numbers.empty()) {
     return Status::OK();
@@ -1464,6 +1600,10 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
     }
     KVSSetKVSValueThres(impl->immutable_db_options_.dcpmm_kvs_value_thres);
     KVSSetCompressKnob(impl->immutable_db_options_.dcpmm_compress_value);
+    KVSSetCompressionType(impl->immutable_db_options_.dcpmm_compression_type);
+    KVSSetUsageLimits(impl->immutable_db_options_.dcpmm_kvs_migrate_ratio,
+                      impl->immutable_db_options_.dcpmm_kvs_slowdown_ratio);
+    KVSSetStatistics(impl->immutable_db_options_.statistics.get());
   }
 #endif
 
@@ -1494,6 +1634,17 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
       assert(new_log != nullptr);
       impl->logs_.emplace_back(new_log_number, new_log);
     }
+#ifdef ON_DCPMM
+    if (s.ok()) {
+      // The memtables of this incarnation hold everything since the last
+      // flush, which may include WALs replayed without flushing.
+      for (auto cfd : *impl->versions_->GetColumnFamilySet()) {
+        if (cfd->mem()->GetDcpmmArena() != nullptr) {
+          cfd->mem()->GetDcpmmArena()->SetLogNumber(cfd->GetLogNumber());
+        }
+      }
+    }
+#endif
 
     if (s.ok()) {
       // set column family handles
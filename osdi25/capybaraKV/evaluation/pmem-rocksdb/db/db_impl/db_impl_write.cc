@@ -1786,6 +1786,15 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
   }
 
   cfd->mem()->SetNextLogNumber(logfile_number_);
+#ifdef ON_DCPMM
+  if (cfd->mem()->GetDcpmmArena() != nullptr) {
+    cfd->mem()->GetDcpmmArena()->Seal(versions_->LastSequence(),
+                                      logfile_number_);
+  }
+  if (new_mem->GetDcpmmArena() != nullptr) {
+    new_mem->GetDcpmmArena()->SetLogNumber(logfile_number_);
+  }
+#endif
   cfd->imm()->Add(cfd->mem(), &context->memtables_to_free_);
   new_mem->Ref();
   cfd->SetMemtable(new_mem);
@@ -19,6 +19,7 @@
 
 #include "db/column_family.h"
 #include "db/db_impl/db_impl.h"
+#include "dcpmm/kvs_dcpmm.h"
 #include "table/block_based/block_based_table_factory.h"
 #include "util/string_util.h"
 
@@ -258,6 +259,9 @@ static const std::string block_cache_capacity = "block-cache-capacity";
 static const std::string block_cache_usage = "block-cache-usage";
 static const std::string block_cache_pinned_usage = "block-cache-pinned-usage";
 static const std::string options_statistics = "options-statistics";
+static const std::string dcpmm_kvs_capacity = "dcpmm-kvs-capacity";
+static const std::string dcpmm_kvs_usage = "dcpmm-kvs-usage";
+static const std::string dcpmm_kvs_stats = "dcpmm-kvs-stats";
 
 const std::string DB::Properties::kNumFilesAtLevelPrefix =
     rocksdb_prefix + num_files_at_level_prefix;
@@ -347,6 +351,12 @@ const std::string DB::Properties::kBlockCachePinnedUsage =
     rocksdb_prefix + block_cache_pinned_usage;
 const std::string DB::Properties::kOptionsStatistics =
     rocksdb_prefix + options_statistics;
+const std::string DB::Properties::kDcpmmKvsCapacity =
+    rocksdb_prefix + dcpmm_kvs_capacity;
+const std::string DB::Properties::kDcpmmKvsUsage =
+    rocksdb_prefix + dcpmm_kvs_usage;
+const std::string DB::Properties::kDcpmmKvsStats =
+    rocksdb_prefix + dcpmm_kvs_stats;
 
 const std::unordered_map<std::string, DBPropertyInfo>
     InternalStats::ppt_name_to_info = {
@@ -486,6 +496,15 @@ const std::unordered_map<std::string, DBPropertyInfo>
         {DB::Properties::kOptionsStatistics,
          {false, nullptr, nullptr, nullptr,
           &DBImpl::GetPropertyHandleOptionsStatistics}},
+        {DB::Properties::kDcpmmKvsCapacity,
+         {false, nullptr, &InternalStats::HandleDcpmmKvsCapacity, nullptr,
+          nullptr}},
+        {DB::Properties::kDcpmmKvsUsage,
+         {false, nullptr, &InternalStats::HandleDcpmmKvsUsage, nullptr,
+          nullptr}},
+        {DB::Properties::kDcpmmKvsStats,
+         {false, &InternalStats::HandleDcpmmKvsStats, nullptr, nullptr,
+          nullptr}},
 };
 
 const DBPropertyInfo* GetPropertyInfo(const Slice& property) {
@@ -955,6 +974,61 @@ bool InternalStats::HandleBlockCachePinnedUsage(uint64_t* value, DBImpl* /*db*/,
   return true;
 }
 
+bool InternalStats::HandleDcpmmKvsCapacity(uint64_t* value, DBImpl* /*db*/,
+                                           Version* /*version*/) {
+#ifdef ON_DCPMM
+  if (KVSEnabled()) {
+    *value = static_cast<uint64_t>(KVSGetUsage().capacity);
+    return true;
+  }
+#else
+  (void)value;
+#endif
+  return false;
+}
+
+bool InternalStats::HandleDcpmmKvsUsage(uint64_t* value, DBImpl* /*db*/,
+                                        Version* /*version*/) {
+#ifdef ON_DCPMM
+  if (KVSEnabled()) {
+    *value = static_cast<uint64_t>(KVSGetUsage().used);
+    return true;
+  }
+#else
+  (void)value;
+#endif
+  return false;
+}
+
+bool InternalStats::HandleDcpmmKvsStats(std::string* value, Slice /*suffix*/) {
+#ifdef ON_DCPMM
+  if (KVSEnabled()) {
+    char buf[200];
+    value->clear();
+    for (size_t i = 0; i < KVSGetPoolCount(); i++) {
+      auto usage = KVSGetPoolUsage(i);
+      snprintf(buf, sizeof(buf),
+               "Pool %" ROCKSDB_PRIszt ": capacity %" ROCKSDB_PRIszt
+               " used %" ROCKSDB_PRIszt " free %" ROCKSDB_PRIszt "\n",
+               i, usage.capacity, usage.used,
+               usage.capacity > usage.used ? usage.capacity - usage.used : 0);
+      value->append(buf);
+    }
+    auto usage = KVSGetUsage();
+    snprintf(buf, sizeof(buf),
+             "Total: capacity %" ROCKSDB_PRIszt " used %" ROCKSDB_PRIszt
+             " migrating %d delaying writes %d\n",
+             usage.capacity, usage.used, KVSNeedsMigration(),
+             KVSNeedsWriteDelay());
+    value->append(buf);
+    return true;
+  }
+#else
+  (void)value;
+#endif
+  return false;
+}
+
 void InternalStats::DumpDBStats(std::string* value) {
   char buf[1000];
   // DB-level stats, only available from default column family
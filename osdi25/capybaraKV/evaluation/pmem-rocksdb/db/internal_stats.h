@@ -581,6 +581,9 @@ class InternalStats {
   bool HandleBlockCacheUsage(uint64_t* value, DBImpl* db, Version* version);
   bool HandleBlockCachePinnedUsage(uint64_t* value, DBImpl* db,
                                    Version* version);
+  bool HandleDcpmmKvsCapacity(uint64_t* value, DBImpl* db, Version* version);
+  bool HandleDcpmmKvsUsage(uint64_t* value, DBImpl* db, Version* version);
+  bool HandleDcpmmKvsStats(std::string* value, Slice suffix);
   // Total number of background errors encountered. Every time a flush task
   // or compaction task fails, this counter is incremented. The failure can
   // be caused by any possible reason, including file system errors, out of
@@ -64,19 +64,21 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
                    const ImmutableCFOptions& ioptions,
                    const MutableCFOptions& mutable_cf_options,
                    WriteBufferManager* write_buffer_manager,
-                   SequenceNumber latest_seq, uint32_t column_family_id)
+                   SequenceNumber latest_seq, uint32_t column_family_id,
+                   DcpmmArena* dcpmm_arena)
     : comparator_(cmp),
       moptions_(ioptions, mutable_cf_options),
       refs_(0),
       kArenaBlockSize(OptimizeBlockSize(moptions_.arena_block_size)),
       mem_tracker_(write_buffer_manager),
+      dcpmm_arena_(dcpmm_arena),
       arena_(moptions_.arena_block_size,
              (write_buffer_manager != nullptr &&
               (write_buffer_manager->enabled() ||
                write_buffer_manager->cost_to_cache()))
                  ? &mem_tracker_
                  : nullptr,
-             mutable_cf_options.memtable_huge_page_size),
+             mutable_cf_options.memtable_huge_page_size, dcpmm_arena),
       table_(ioptions.memtable_factory->CreateMemTableRep(
           comparator_, &arena_, mutable_cf_options.prefix_extractor.get(),
           ioptions.info_log, column_family_id)),
@@ -111,6 +113,13 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
   // something went wrong if we need to flush before inserting anything
   assert(!ShouldScheduleFlush());
 
+  if (dcpmm_arena_ && dcpmm_arena_->IsRecovered()) {
+    std::unique_ptr<MemTableRep::Iterator> iter(
+        range_del_table_->GetIterator());
+    iter->SeekToFirst();
+    is_range_del_table_empty_ = !iter->Valid();
+  }
+
   // use bloom_filter_ for both whole key and prefix bloom filter
   if ((prefix_extractor_ || moptions_.memtable_whole_key_filtering) &&
       moptions_.memtable_prefix_bloom_bits > 0) {
@@ -124,6 +133,9 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
 MemTable::~MemTable() {
   mem_tracker_.FreeMem();
   assert(refs_ == 0);
+  if (dcpmm_arena_ && flush_completed_) {
+    dcpmm_arena_->Discard();
+  }
 }
 
 size_t MemTable::ApproximateMemoryUsage() {
@@ -500,8 +512,7 @@ bool MemTable::Add(SequenceNumber s, ValueType type,
   assert((unsigned)(p + val_size - buf) == (unsigned)encoded_len);
   size_t ts_sz = GetInternalKeyComparator().user_comparator()->timestamp_size();
   // TODO checksum etc
-  pmem_persist(buf, encoded_len);
-//  pmem_flush(buf, encoded_len);
+  arena_.Persist(buf, encoded_len);
   if (!allow_concurrent) {
     // Extract prefix for insert with hint.
     if (insert_with_hint_prefix_extractor_ != nullptr &&
@@ -99,11 +99,15 @@ class MemTable {
   // If the earliest sequence number is not known, kMaxSequenceNumber may be
   // used, but this may prevent some transactions from succeeding until the
   // first key is inserted into the memtable.
+  //
+  // If dcpmm_arena is given, the memtable takes ownership of it and builds
+  // its skiplists in it. A recovered arena yields the memtable it held.
   explicit MemTable(const InternalKeyComparator& comparator,
                     const ImmutableCFOptions& ioptions,
                     const MutableCFOptions& mutable_cf_options,
                     WriteBufferManager* write_buffer_manager,
-                    SequenceNumber earliest_seq, uint32_t column_family_id);
+                    SequenceNumber earliest_seq, uint32_t column_family_id,
+                    DcpmmArena* dcpmm_arena = nullptr);
   // No copying allowed
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
@@ -427,6 +431,9 @@ class MemTable {
 
   void SetFlushCompleted(bool completed) { flush_completed_ = completed; }
 
+  // The DCPMM arena the memtable is built on, or nullptr.
+  DcpmmArena* GetDcpmmArena() const { return dcpmm_arena_.get(); }
+
   uint64_t GetFileNumber() const { return file_number_; }
 
   void SetFileNumber(uint64_t file_num) { file_number_ = file_num; }
@@ -457,6 +464,7 @@ class MemTable {
   int refs_;
   const size_t kArenaBlockSize;
   AllocTracker mem_tracker_;
+  std::unique_ptr<DcpmmArena> dcpmm_arena_;
   ConcurrentArena arena_;
   std::unique_ptr<MemTableRep> table_;
   std::unique_ptr<MemTableRep> range_del_table_;
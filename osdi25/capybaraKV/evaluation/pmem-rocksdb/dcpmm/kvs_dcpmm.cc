@@ -14,13 +14,15 @@
 
 #include <libpmem.h>
 #include <libpmemobj.h>
-#include <snappy.h>
 
 #include <atomic>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "monitoring/statistics.h"
+#include "util/coding.h"
 #include "util/compression.h"
 
 namespace rocksdb {
@@ -29,8 +31,10 @@ struct Pool {
   PMEMobjpool* pool;
   uint64_t uuid_lo;
   size_t base_addr;
+  size_t capacity;
+  std::atomic<size_t> used;
 
-  Pool() : pool(nullptr) {
+  Pool() : pool(nullptr), capacity(0), used(0) {
   }
 
   ~Pool() {
@@ -50,10 +54,10 @@ static std::atomic<size_t> next_pool_index_(0);
 
 static size_t kvs_value_thres_ = 0;
 static bool compress_value_ = false;
-static size_t dcpmm_avail_size_min_ = 0;
-
-static std::atomic<size_t> dcpmm_avail_size_(0);
-static std::atomic<bool> dcpmm_is_avail_(true);
+static CompressionType compression_type_ = kSnappyCompression;
+static double migrate_ratio_ = 1.0;
+static double slowdown_ratio_ = 1.0;
+static Statistics* statistics_ = nullptr;
 
 int KVSOpen(const char* path, size_t size, size_t pool_count) {
   assert(!pools_);
@@ -92,9 +96,16 @@ int KVSOpen(const char* path, size_t size, size_t pool_count) {
     pools_[i].pool = pool;
     pools_[i].uuid_lo = root.pool_uuid_lo;
     pools_[i].base_addr = (size_t)pool;
+    pools_[i].capacity = pool_size;
+
+    // Count the values that survived the restart, the root object included.
+    size_t used = 0;
+    PMEMoid oid;
+    POBJ_FOREACH(pool, oid) {
+      used += pmemobj_alloc_usable_size(oid);
+    }
+    pools_[i].used = used;
   }
-  // hard code it as 1/10 of total dcpmm size.
-  dcpmm_avail_size_min_ = size / 10;
   return 0;
 }
 
@@ -106,7 +117,12 @@ void KVSClose() {
 enum ValueEncoding KVSGetEncoding(const void *ptr) {
   // whether it is raw or pointed, the first byte is encoding
   auto* hdr = (KVSHdr*)ptr;
-  return (enum ValueEncoding)(hdr->encoding);
+  return (enum ValueEncoding)(hdr->encoding & kEncodingTypeMask);
+}
+
+enum ValueCodec KVSGetCodec(const void *ptr) {
+  auto* hdr = (KVSHdr*)ptr;
+  return (enum ValueCodec)(hdr->encoding >> kEncodingCodecShift);
 }
 
 bool KVSEnabled() {
@@ -120,13 +136,18 @@ static bool ReservePmem(size_t size, size_t* p_pool_index, PMEMoid* p_oid,
 
   PMEMoid oid;
   for (size_t i = 0; i < retry_loop; i++) {
-    auto* pool = pools_[pool_index].pool;
-    oid = pmemobj_reserve(pool, pact, size, 0);
-    if (!OID_IS_NULL(oid)) {
-      *p_pool_index = pool_index;
-      *p_oid = oid;
-      pact->pool_index = pool_index;
-      return true;
+    auto& p = pools_[pool_index];
+    // Skip pools the accounting already knows cannot hold the value, instead
+    // of paying for a failed reserve.
+    if (p.used.load(std::memory_order_relaxed) + size <= p.capacity) {
+      oid = pmemobj_reserve(p.pool, pact, size, 0);
+      if (!OID_IS_NULL(oid)) {
+        p.used += pmemobj_alloc_usable_size(oid);
+        *p_pool_index = pool_index;
+        *p_oid = oid;
+        pact->pool_index = pool_index;
+        return true;
+      }
     }
     pool_index++;
     if (pool_index >= pool_count_) {
@@ -134,100 +155,244 @@ static bool ReservePmem(size_t size, size_t* p_pool_index, PMEMoid* p_oid,
     }
   }
 
-  dcpmm_is_avail_ = false;
   return false;
 }
 
-bool KVSEncodeValue(const Slice& value, bool compress,
-                    struct KVSRef* ref) {
-  assert(pools_);
+// Per-thread scratch space used to compress values before they are copied to
+// DCPMM, so that the write path does not allocate for every value.
+struct KVSScratch {
+  std::unique_ptr<char[]> buf;
+  size_t capacity = 0;
+#ifdef ZSTD
+  ZSTD_CCtx* zstd_cctx = nullptr;
+  ZSTD_DCtx* zstd_dctx = nullptr;
+#endif
 
-  // If dcpmm has not enough space, the caller need to fallback to non-kvs.
-  if (!dcpmm_is_avail_) {
-    return false;
+  ~KVSScratch() {
+#ifdef ZSTD
+    if (zstd_cctx) {
+      ZSTD_freeCCtx(zstd_cctx);
+    }
+    if (zstd_dctx) {
+      ZSTD_freeDCtx(zstd_dctx);
+    }
+#endif
   }
 
-  PobjAction pact;
+  char* Get(size_t size) {
+    if (size > capacity) {
+      buf.reset(new char[size]);
+      capacity = size;
+    }
+    return buf.get();
+  }
+};
 
-  if (!compress) {
-    PMEMoid oid;
-    if (!ReservePmem(sizeof(struct KVSHdr) + value.size(), &(ref->pool_index),
-                      &oid, &pact)) {
+static thread_local KVSScratch scratch_;
+
+// Room for the varint32 uncompressed length ahead of LZ4 and ZSTD output.
+static const size_t kMaxVarint32Len = 5;
+
+// Same rule as the block based table builder: compression has to save at
+// least 12.5% or the value is stored uncompressed.
+static bool GoodCompressionRatio(size_t compressed_size, size_t raw_size) {
+  return compressed_size < raw_size - (raw_size / 8u);
+}
+
+// Compress value into the thread-local scratch buffer with the configured
+// codec. Return false if the codec is not available or compression does not
+// pay off, in which case the caller stores the value uncompressed.
+// LZ4 and ZSTD output is prefixed with the varint32 uncompressed length;
+// snappy already records it in its own format.
+static bool CompressValue(const Slice& value, enum ValueCodec* codec,
+                          Slice* output) {
+  size_t outsize = 0;
+  char* out;
+  switch (compression_type_) {
+    case kLZ4Compression: {
+#ifdef LZ4
+      if (value.size() > static_cast<size_t>(LZ4_MAX_INPUT_SIZE)) {
+        return false;
+      }
+      int bound = LZ4_compressBound(static_cast<int>(value.size()));
+      out = scratch_.Get(kMaxVarint32Len + bound);
+      char* p = EncodeVarint32(out, static_cast<uint32_t>(value.size()));
+      int len = LZ4_compress_default(value.data(), p,
+                                     static_cast<int>(value.size()), bound);
+      if (len <= 0) {
+        return false;
+      }
+      outsize = (p - out) + len;
+      *codec = kCodecLZ4;
+      break;
+#else
       return false;
+#endif
     }
-    void *buf = pmemobj_direct(oid);
-    ref->hdr.encoding = kEncodingPtrUncompressed;
-    ref->size = value.size();
-    assert((size_t)buf >= pools_[ref->pool_index].base_addr);
-    ref->off_in_pool = (size_t)buf - pools_[ref->pool_index].base_addr;
-
-    // Prefix the encoding type of the value content.
-    memcpy(buf, &(ref->hdr), sizeof(ref->hdr));
-    memcpy((char*)buf + sizeof(ref->hdr), value.data(), value.size());
-    pmemobj_persist(pools_[ref->pool_index].pool, buf, value.size() + sizeof(ref->hdr));
-    pmemobj_publish(pools_[ref->pool_index].pool, (pobj_action*)&pact, 1);
-  } else {
-    // So far, just support to use snappy for value compression.
+    case kZSTD: {
+#ifdef ZSTD
+      if (scratch_.zstd_cctx == nullptr) {
+        scratch_.zstd_cctx = ZSTD_createCCtx();
+      }
+      size_t bound = ZSTD_compressBound(value.size());
+      out = scratch_.Get(kMaxVarint32Len + bound);
+      char* p = EncodeVarint32(out, static_cast<uint32_t>(value.size()));
+      size_t len = ZSTD_compressCCtx(scratch_.zstd_cctx, p, bound,
+                                     value.data(), value.size(), 1);
+      if (ZSTD_isError(len)) {
+        return false;
+      }
+      outsize = (p - out) + len;
+      *codec = kCodecZSTD;
+      break;
+#else
+      return false;
+#endif
+    }
+    default: {
 #ifdef SNAPPY
-    char *compressed = new char[snappy::MaxCompressedLength(value.size())];
-    size_t outsize;
-    snappy::RawCompress(value.data(), value.size(), compressed, &outsize);
+      out = scratch_.Get(snappy::MaxCompressedLength(value.size()));
+      snappy::RawCompress(value.data(), value.size(), out, &outsize);
+      *codec = kCodecSnappy;
+      break;
 #else
-    fprintf(stderr, "Doesn't support snappy.\n");
-    assert(0);
+      (void)codec;
+      return false;
 #endif
+    }
+  }
 
-    PMEMoid oid;
-    if (!ReservePmem(sizeof(struct KVSHdr) + outsize, &(ref->pool_index),
-                      &oid, &pact)) {
-      delete[] compressed;
+  if (!GoodCompressionRatio(outsize, value.size())) {
+    return false;
+  }
+  *output = Slice(out, outsize);
+  return true;
+}
+
+static bool DecompressValue(enum ValueCodec codec, const char* src,
+                            size_t src_len, std::string* dst) {
+  switch (codec) {
+    case kCodecSnappy: {
+      size_t dst_len;
+      if (!Snappy_GetUncompressedLength(src, src_len, &dst_len)) {
+        return false;
+      }
+      dst->resize(dst_len);
+      return Snappy_Uncompress(src, src_len, &(*dst)[0]);
+    }
+    case kCodecLZ4: {
+#ifdef LZ4
+      uint32_t dst_len;
+      const char* p = GetVarint32Ptr(src, src + src_len, &dst_len);
+      if (p == nullptr) {
+        return false;
+      }
+      dst->resize(dst_len);
+      int len = LZ4_decompress_safe(p, &(*dst)[0],
+                                    static_cast<int>(src + src_len - p),
+                                    static_cast<int>(dst_len));
+      return len == static_cast<int>(dst_len);
+#else
       return false;
+#endif
+    }
+    case kCodecZSTD: {
+#ifdef ZSTD
+      uint32_t dst_len;
+      const char* p = GetVarint32Ptr(src, src + src_len, &dst_len);
+      if (p == nullptr) {
+        return false;
+      }
+      if (scratch_.zstd_dctx == nullptr) {
+        scratch_.zstd_dctx = ZSTD_createDCtx();
+      }
+      dst->resize(dst_len);
+      size_t len = ZSTD_decompressDCtx(scratch_.zstd_dctx, &(*dst)[0], dst_len,
+                                       p, src + src_len - p);
+      return !ZSTD_isError(len) && len == dst_len;
+#else
+      return false;
+#endif
     }
-    void *buf = pmemobj_direct(oid);
-    // Fill a header structure, and the caller will insert it instead of the
-    // original value.
-    ref->hdr.encoding = kEncodingPtrCompressed;
-    ref->size = outsize;
-    assert((size_t)buf >= pools_[ref->pool_index].base_addr);
-    ref->off_in_pool = (size_t)buf - pools_[ref->pool_index].base_addr;
-
-    // Prefix the encoding type of value content.
-    memcpy(buf, &(ref->hdr), sizeof(ref->hdr));
-    memcpy((char*)buf + sizeof(ref->hdr), compressed, outsize);
-    pmemobj_persist(pools_[ref->pool_index].pool, buf, outsize + sizeof(ref->hdr));
-    pmemobj_publish(pools_[ref->pool_index].pool, (pobj_action*)&pact, 1);
-    delete[] compressed;
   }
+  return false;
+}
 
+// Copy the value content to a new DCPMM object, prefixed with its encoding,
+// and fill the reference the caller inserts instead of the value.
+static bool StoreValue(const Slice& content, unsigned char encoding,
+                       struct KVSRef* ref) {
+  PobjAction pact;
+  PMEMoid oid;
+  if (!ReservePmem(sizeof(struct KVSHdr) + content.size(), &(ref->pool_index),
+                    &oid, &pact)) {
+    return false;
+  }
+  void *buf = pmemobj_direct(oid);
+  ref->hdr.encoding = encoding;
+  ref->size = content.size();
+  assert((size_t)buf >= pools_[ref->pool_index].base_addr);
+  ref->off_in_pool = (size_t)buf - pools_[ref->pool_index].base_addr;
+
+  // Prefix the encoding type of the value content.
+  memcpy(buf, &(ref->hdr), sizeof(ref->hdr));
+  memcpy((char*)buf + sizeof(ref->hdr), content.data(), content.size());
+  pmemobj_persist(pools_[ref->pool_index].pool, buf,
+                  content.size() + sizeof(ref->hdr));
+  pmemobj_publish(pools_[ref->pool_index].pool, (pobj_action*)&pact, 1);
+  RecordTick(statistics_, DCPMM_KVS_BYTES_WRITTEN,
+             content.size() + sizeof(ref->hdr));
   return true;
 }
 
+bool KVSEncodeValue(const Slice& value, bool compress,
+                    struct KVSRef* ref) {
+  assert(pools_);
+
+  enum ValueCodec codec;
+  Slice compressed;
+  bool stored;
+  if (compress && CompressValue(value, &codec, &compressed)) {
+    stored = StoreValue(compressed,
+                        kEncodingPtrCompressed | (codec << kEncodingCodecShift),
+                        ref);
+  } else {
+    // Incompressible values are not worth decompressing on every read.
+    stored = StoreValue(value, kEncodingPtrUncompressed, ref);
+  }
+  // If dcpmm has not enough space, the caller need to fallback to non-kvs.
+  if (!stored) {
+    RecordTick(statistics_, DCPMM_KVS_INLINE_FALLBACKS);
+  }
+  return stored;
+}
+
 static void FreePmem(struct KVSRef* ref) {
   PMEMoid oid;
   oid.pool_uuid_lo = pools_[ref->pool_index].uuid_lo;
   oid.off = ref->off_in_pool;
+  size_t usable = pmemobj_alloc_usable_size(oid);
   pmemobj_free(&oid);
-  if (!dcpmm_is_avail_) {
-    if ((dcpmm_avail_size_ += ref->size) > dcpmm_avail_size_min_) {
-      dcpmm_avail_size_ = 0;
-      dcpmm_is_avail_ = true;
-    }
-  }
+  pools_[ref->pool_index].used -= usable;
+  RecordTick(statistics_, DCPMM_KVS_BYTES_FREED, usable);
 }
 Slice KVSDumpFromValueRef(const Slice& value,
                            std::function<void(const Slice& value)> add) {
   assert(pools_);
   const char* input = value.data();
   auto* ref = (struct KVSRef*)input;
-  if (ref->hdr.encoding == kEncodingPtrCompressed ||
-      ref->hdr.encoding == kEncodingPtrUncompressed) {
+  auto encoding = KVSGetEncoding(input);
+  if (encoding == kEncodingPtrCompressed ||
+      encoding == kEncodingPtrUncompressed) {
     auto* hdr = (struct KVSHdr*)(pools_[ref->pool_index].base_addr
                                       + ref->off_in_pool);
-    if (ref->hdr.encoding == kEncodingPtrCompressed) {
-      hdr->encoding = kEncodingRawCompressed;
+    // Keep the codec bits, only the raw/pointer bits change.
+    unsigned char codec_bits = ref->hdr.encoding & ~kEncodingTypeMask;
+    if (encoding == kEncodingPtrCompressed) {
+      hdr->encoding = codec_bits | kEncodingRawCompressed;
     }
     else {
-      hdr->encoding = kEncodingRawUncompressed;
+      hdr->encoding = codec_bits | kEncodingRawUncompressed;
     }
 
     // Prefix encoding type of the value content.
@@ -276,13 +441,8 @@ void KVSDecodeValueRef(const char* input, size_t size, std::string* dst) {
   {
     assert(encoding == kEncodingRawCompressed ||
       encoding == kEncodingPtrCompressed);
-    size_t dst_len;
-    if (Snappy_GetUncompressedLength(src_data, src_len, &dst_len)) {
-      char* tmp_buf = new char[dst_len];
-      Snappy_Uncompress(src_data, src_len, tmp_buf);
-      dst->assign(tmp_buf, dst_len);
-      delete[] tmp_buf;
-    } else {
+    // Decompress straight into dst, no intermediate buffer.
+    if (!DecompressValue(KVSGetCodec(input), src_data, src_len, dst)) {
       abort();
     }
   }
@@ -290,8 +450,9 @@ void KVSDecodeValueRef(const char* input, size_t size, std::string* dst) {
 
 size_t KVSGetExtraValueSize(const Slice& value) {
   auto* ref = (struct KVSRef*)value.data();
-  if (ref->hdr.encoding == kEncodingRawCompressed ||
-      ref->hdr.encoding == kEncodingRawUncompressed) {
+  auto encoding = KVSGetEncoding(value.data());
+  if (encoding == kEncodingRawCompressed ||
+      encoding == kEncodingRawUncompressed) {
     return 0;
   }
   else {
@@ -301,8 +462,8 @@ size_t KVSGetExtraValueSize(const Slice& value) {
 
 void KVSFreeValue(const Slice& value) {
   auto* ref = (struct KVSRef*)value.data();
-  if (ref && ref->hdr.encoding != kEncodingRawCompressed &&
-      ref->hdr.encoding != kEncodingRawUncompressed) {
+  if (ref && KVSGetEncoding(ref) != kEncodingRawCompressed &&
+      KVSGetEncoding(ref) != kEncodingRawUncompressed) {
     FreePmem(ref);
   }
 }
@@ -323,5 +484,68 @@ bool KVSGetCompressKnob() {
   return compress_value_;
 }
 
+void KVSSetCompressionType(CompressionType type) {
+  switch (type) {
+    case kLZ4Compression:
+    case kZSTD:
+      compression_type_ = type;
+      break;
+    default:
+      compression_type_ = kSnappyCompression;
+      break;
+  }
+}
+
+CompressionType KVSGetCompressionType() {
+  return compression_type_;
+}
+
+void KVSSetUsageLimits(double migrate_ratio, double slowdown_ratio) {
+  migrate_ratio_ = migrate_ratio;
+  slowdown_ratio_ = slowdown_ratio;
+}
+
+void KVSSetStatistics(Statistics* statistics) {
+  statistics_ = statistics;
+}
+
+size_t KVSGetPoolCount() {
+  return pools_ ? pool_count_ : 0;
+}
+
+struct KVSUsage KVSGetPoolUsage(size_t pool_index) {
+  assert(pools_ && pool_index < pool_count_);
+  struct KVSUsage usage;
+  usage.capacity = pools_[pool_index].capacity;
+  usage.used = pools_[pool_index].used.load(std::memory_order_relaxed);
+  return usage;
+}
+
+struct KVSUsage KVSGetUsage() {
+  struct KVSUsage usage = {0, 0};
+  for (size_t i = 0; i < KVSGetPoolCount(); i++) {
+    auto pool_usage = KVSGetPoolUsage(i);
+    usage.capacity += pool_usage.capacity;
+    usage.used += pool_usage.used;
+  }
+  return usage;
+}
+
+static bool UsageAbove(double ratio) {
+  if (!pools_ || ratio >= 1.0) {
+    return false;
+  }
+  auto usage = KVSGetUsage();
+  return usage.used >= static_cast<size_t>(usage.capacity * ratio);
+}
+
+bool KVSNeedsMigration() {
+  return UsageAbove(migrate_ratio_);
+}
+
+bool KVSNeedsWriteDelay() {
+  return UsageAbove(slowdown_ratio_);
+}
+
 }  // namespace rocksdb
 #endif
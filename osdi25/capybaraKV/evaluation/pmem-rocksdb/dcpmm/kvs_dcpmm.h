@@ -13,7 +13,9 @@
 #include <functional>
 #include <libpmemobj.h>
 
+#include "rocksdb/options.h"
 #include "rocksdb/slice.h"
+#include "rocksdb/statistics.h"
 
 namespace rocksdb {
 
@@ -39,6 +41,26 @@ enum ValueEncoding {
   kEncodingUnknown
 };
 
+// The low bits of KVSHdr::encoding hold the ValueEncoding, the high bits hold
+// the codec used for compressed value content. Snappy is codec 0, so values
+// written before the codec was recorded still decode as snappy.
+enum ValueCodec {
+  kCodecSnappy = 0x0,
+  kCodecLZ4 = 0x1,
+  kCodecZSTD = 0x2,
+};
+
+const unsigned char kEncodingTypeMask = 0x0f;
+const int kEncodingCodecShift = 4;
+
+// Space accounting of one pool, or of all pools together.
+struct KVSUsage {
+  // Bytes the pool was created with.
+  size_t capacity;
+  // Usable bytes of the live value objects.
+  size_t used;
+};
+
 // Create or open the space on DCPMM for storing value.
 extern int KVSOpen(const char* path, size_t size, size_t pool_count = 16);
 
@@ -78,10 +100,44 @@ extern void KVSSetCompressKnob(bool compress);
 // Return if need to compress the value for KVS.
 extern bool KVSGetCompressKnob();
 
+// Select the codec for compressed values. Snappy, LZ4 and ZSTD are supported,
+// anything else falls back to snappy.
+extern void KVSSetCompressionType(CompressionType type);
+
+// Return the codec used for compressed values.
+extern CompressionType KVSGetCompressionType();
+
+// Set the usage ratios at which compactions start migrating values out of
+// KVS regardless of the output level, and at which writes are delayed.
+extern void KVSSetUsageLimits(double migrate_ratio, double slowdown_ratio);
+
+// Record KVS tickers to statistics, may be nullptr.
+extern void KVSSetStatistics(Statistics* statistics);
+
+// Return the number of pools.
+extern size_t KVSGetPoolCount();
+
+// Return the space accounting of one pool.
+extern struct KVSUsage KVSGetPoolUsage(size_t pool_index);
+
+// Return the space accounting summed over all pools.
+extern struct KVSUsage KVSGetUsage();
+
+// Return true if usage is above the migrate ratio, compactions should then
+// move values out of KVS at any output level.
+extern bool KVSNeedsMigration();
+
+// Return true if usage is above the slowdown ratio, writes should then be
+// delayed until compactions have migrated values out of KVS.
+extern bool KVSNeedsWriteDelay();
+
 // To make the objects recoverable after restarting.
 extern int KVSPublish(struct pobj_action** pact_array, size_t actvcnt);
 
 // Return the value encoding type.
 enum ValueEncoding KVSGetEncoding(const void *ptr);
+
+// Return the codec of compressed value content.
+enum ValueCodec KVSGetCodec(const void *ptr);
 }  // namespace rocksdb
 #endif
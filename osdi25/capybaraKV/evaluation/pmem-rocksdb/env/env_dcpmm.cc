@@ -20,9 +20,16 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <dirent.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
 
 #include "env_dcpmm.h"
+#include "port/port.h"
 #include "libpmem.h"
 
 namespace rocksdb {
@@ -163,8 +170,276 @@ IOStatus DCPMMMmapFile::InvalidateCache(size_t, size_t) {
   return IOStatus::OK();
 }
 
+DCPMMMmapFile::DCPMMMmapFile(const std::string& fname,
+                             const DCPMMSstPool::File& file, size_t page_size,
+                             const EnvOptions& options)
+    : DCPMMMmapFile(fname, file.fd, page_size, options) {
+  base_ = file.base;
+  limit_ = file.base + file.map_len;
+  dst_ = base_;
+}
+
+namespace {
+const size_t kSstPoolMinReady = 2;
+const size_t kSstPoolMaxReady = 16;
+// at most this many files are kept, ready or not
+const size_t kSstPoolMaxFiles = 100;
+// keep ready what flushes and compactions take in this time
+const double kSstPoolLookaheadMicros = 1000000;
+const size_t kSstPoolAlign = size_t{2} << 20;
+const char* const kSstPoolSuffix = ".reuse";
+
+uint64_t SstPoolNowMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+std::string DirName(const std::string& fname) {
+  auto pos = fname.rfind('/');
+  return pos == std::string::npos ? "." : fname.substr(0, pos);
+}
+}  // namespace
+
+DCPMMSstPool::DCPMMSstPool()
+    : disabled_(false),
+      shutdown_(false),
+      next_file_(0),
+      file_size_(size_t{64} << 20),
+      last_take_micros_(0),
+      take_interval_micros_(0) {}
+
+DCPMMSstPool::~DCPMMSstPool() {
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    shutdown_ = true;
+  }
+  cv_.notify_all();
+  if (thread_) {
+    thread_->join();
+  }
+  for (auto& entry : ready_) {
+    munmap(entry.second.base, entry.second.map_len);
+    close(entry.second.fd);
+  }
+}
+
+bool DCPMMSstPool::Take(const std::string& fname, File* file) {
+  std::string dir = DirName(fname);
+  std::pair<std::string, File> entry;
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    if (disabled_) {
+      return false;
+    }
+    if (dir_.empty()) {
+      // serve the first SST directory, usually the only one
+      dir_ = dir;
+      thread_.reset(new std::thread(&DCPMMSstPool::BGThread, this));
+    }
+    if (dir != dir_) {
+      return false;
+    }
+    uint64_t now = SstPoolNowMicros();
+    if (last_take_micros_ != 0) {
+      double interval = static_cast<double>(now - last_take_micros_);
+      take_interval_micros_ = take_interval_micros_ == 0
+                                  ? interval
+                                  : 0.8 * take_interval_micros_ + 0.2 * interval;
+    }
+    last_take_micros_ = now;
+    cv_.notify_all();
+    if (ready_.empty()) {
+      return false;
+    }
+    entry = std::move(ready_.front());
+    ready_.pop_front();
+  }
+  if (rename(entry.first.c_str(), fname.c_str()) != 0) {
+    munmap(entry.second.base, entry.second.map_len);
+    close(entry.second.fd);
+    return false;
+  }
+  *file = entry.second;
+  return true;
+}
+
+bool DCPMMSstPool::Recycle(const std::string& fname) {
+  std::string reuse = fname + kSstPoolSuffix;
+  struct stat st;
+  std::lock_guard<std::mutex> guard(mutex_);
+  if (disabled_ || dir_ != DirName(fname) ||
+      recycled_.size() + ready_.size() >= kSstPoolMaxFiles ||
+      stat(fname.c_str(), &st) != 0 ||
+      rename(fname.c_str(), reuse.c_str()) != 0) {
+    return false;
+  }
+  // follow the largest recent file, decaying slowly
+  size_t size =
+      ((size_t)st.st_size + kSstPoolAlign - 1) & ~(kSstPoolAlign - 1);
+  file_size_ =
+      std::max(size, std::max(kSstPoolAlign, file_size_ - file_size_ / 8));
+  recycled_.push_back(reuse);
+  cv_.notify_all();
+  return true;
+}
+
+size_t DCPMMSstPool::TargetReady() {
+  if (take_interval_micros_ <= 0) {
+    return kSstPoolMinReady;
+  }
+  auto n =
+      static_cast<size_t>(kSstPoolLookaheadMicros / take_interval_micros_) + 1;
+  return std::min(kSstPoolMaxReady, std::max(kSstPoolMinReady, n));
+}
+
+Status DCPMMSstPool::PrepareFile(const std::string& fname, bool fresh,
+                                 size_t size, File* file) {
+  int fd = open(fname.c_str(), O_CREAT | O_RDWR, 0644);
+  if (fd < 0) {
+    return Status::IOError(fname, strerror(errno));
+  }
+  if (fallocate(fd, 0, 0, size) != 0) {
+    close(fd);
+    return Status::IOError(fname, strerror(errno));
+  }
+  // place the mapping on a huge page boundary so DAX can use PMD mappings
+  void* hint = mmap(nullptr, size + kSstPoolAlign, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (hint == MAP_FAILED) {
+    close(fd);
+    return Status::IOError(fname, strerror(errno));
+  }
+  munmap(hint, size + kSstPoolAlign);
+  auto aligned = ((uintptr_t)hint + kSstPoolAlign - 1) & ~(kSstPoolAlign - 1);
+  void* base = mmap((void*)aligned, size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED_VALIDATE | MAP_SYNC | MAP_POPULATE, fd, 0);
+  if (base == MAP_FAILED) {
+    int err = errno;
+    close(fd);
+    if (err == EOPNOTSUPP) {
+      return Status::NotSupported(fname, "not on a DAX filesystem");
+    }
+    return Status::IOError(fname, strerror(err));
+  }
+  if (fresh) {
+    pmem_memset(base, 0, size, PMEM_F_MEM_NONTEMPORAL);
+  }
+  file->fd = fd;
+  file->base = (char*)base;
+  file->map_len = size;
+  return Status::OK();
+}
+
+void DCPMMSstPool::BGThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  // files a previous process recycled
+  DIR* d = opendir(dir_.c_str());
+  if (d != nullptr) {
+    struct dirent* entry;
+    while ((entry = readdir(d)) != nullptr) {
+      std::string name = entry->d_name;
+      if (name.size() > strlen(kSstPoolSuffix) &&
+          name.compare(name.size() - strlen(kSstPoolSuffix),
+                       strlen(kSstPoolSuffix), kSstPoolSuffix) == 0 &&
+          recycled_.size() < kSstPoolMaxFiles) {
+        recycled_.push_back(dir_ + "/" + name);
+      }
+    }
+    closedir(d);
+  }
+  while (true) {
+    cv_.wait(lock, [&] { return shutdown_ || ready_.size() < TargetReady(); });
+    if (shutdown_) {
+      break;
+    }
+    std::string fname;
+    bool fresh = recycled_.empty();
+    if (fresh) {
+      if (ready_.size() + recycled_.size() >= kSstPoolMaxFiles) {
+        cv_.wait(lock);
+        continue;
+      }
+      fname = dir_ + "/pool-" + std::to_string(getpid()) + "-" +
+              std::to_string(next_file_++) + ".sst" + kSstPoolSuffix;
+    } else {
+      fname = recycled_.back();
+      recycled_.pop_back();
+    }
+    size_t size = file_size_;
+    lock.unlock();
+    File file;
+    Status s = PrepareFile(fname, fresh, size, &file);
+    lock.lock();
+    if (s.ok()) {
+      ready_.emplace_back(fname, file);
+    } else {
+      unlink(fname.c_str());
+      if (s.IsNotSupported()) {
+        disabled_ = true;
+        break;
+      }
+      // try again when the next file is taken
+      cv_.wait(lock);
+    }
+  }
+}
+
 // namespace {
 
+class DCPMMWritableFile;
+
+// Grows DCPMM WAL files ahead of their writers. Every file reserves address
+// space for wal_max_size when it is opened; the extender allocates the next
+// extent, maps it in place inside the reservation and pre-faults it, so that
+// Append() only ever copies into memory that is already mapped.
+class DCPMMWalExtender {
+ public:
+  DCPMMWalExtender()
+      : running(nullptr),
+        shutdown(false),
+        thread(&DCPMMWalExtender::BGThread, this) {}
+
+  ~DCPMMWalExtender() {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      shutdown = true;
+    }
+    cv.notify_all();
+    thread.join();
+  }
+
+  // ask for one more extent of headroom for the file
+  void Schedule(DCPMMWritableFile* file) {
+    std::lock_guard<std::mutex> guard(mutex);
+    if (running != file &&
+        std::find(queue.begin(), queue.end(), file) == queue.end()) {
+      queue.push_back(file);
+    }
+    cv.notify_all();
+  }
+
+  // wait until `size` bytes of the file are mapped, or extending failed
+  Status WaitFor(DCPMMWritableFile* file, size_t size);
+
+  // the file is closing, forget it
+  void Remove(DCPMMWritableFile* file) {
+    std::unique_lock<std::mutex> lock(mutex);
+    queue.erase(std::remove(queue.begin(), queue.end(), file), queue.end());
+    cv.wait(lock, [&] { return running != file; });
+  }
+
+ private:
+  void BGThread();
+
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<DCPMMWritableFile*> queue;  // files waiting for an extent
+  DCPMMWritableFile* running;            // file being extended
+  bool shutdown;
+  port::Thread thread;
+};
+
 class DCPMMWritableFile : public WritableFile {
  public:
   // this flag strictly requires the file system to be on DCPMM
@@ -172,8 +447,9 @@ class DCPMMWritableFile : public WritableFile {
 
   // create a new WAL file on DCPMM
   static Status Create(const std::string& fname, WritableFile** p_file,
-                       size_t init_size, size_t size_addition) {
-    auto s = CheckArguments(init_size, size_addition);
+                       const DCPMMEnvOptions& options,
+                       DCPMMWalExtender* extender) {
+    auto s = CheckArguments(options);
     if (!s.ok()) {
       return s;
     }
@@ -186,21 +462,22 @@ class DCPMMWritableFile : public WritableFile {
                                  .append(strerror(errno)));
     }
     // pre-allocate space
-    if (fallocate(fd, 0, 0, init_size) != 0) {
+    if (fallocate(fd, 0, 0, options.wal_init_size) != 0) {
       close(fd);
       return Status::IOError(std::string("fallocate '")
                                  .append(fname)
                                  .append("' failed: ")
                                  .append(strerror(errno)));
     }
-    return MapFile(fd, init_size, size_addition, p_file);
+    return MapFile(fd, options.wal_init_size, options, extender, p_file);
   }
 
   // reuse a WAL file on DCPMM
   static Status Reuse(const std::string& old_fname,
                       const std::string& new_fname, WritableFile** p_file,
-                      size_t init_size, size_t size_addition) {
-    auto s = CheckArguments(init_size, size_addition);
+                      const DCPMMEnvOptions& options,
+                      DCPMMWalExtender* extender) {
+    auto s = CheckArguments(options);
     if (!s.ok()) {
       return s;
     }
@@ -221,12 +498,13 @@ class DCPMMWritableFile : public WritableFile {
                                  .append("' failed: ")
                                  .append(strerror(errno)));
     }
-    if ((size_t)stat.st_size < init_size) {
+    if ((size_t)stat.st_size < options.wal_init_size ||
+        (size_t)stat.st_size > options.wal_max_size) {
       close(fd);
       return Status::InvalidArgument(
           std::string("the file '")
               .append(old_fname)
-              .append("' to reuse is less than init_size"));
+              .append("' to reuse is not between init_size and max_size"));
     }
     // rename it
     if (rename(old_fname.c_str(), new_fname.c_str()) < 0) {
@@ -238,76 +516,72 @@ class DCPMMWritableFile : public WritableFile {
                                  .append("' failed: ")
                                  .append(strerror(errno)));
     }
-    return MapFile(fd, init_size, size_addition, p_file);
+    // keep all extents the file grew in its previous life
+    return MapFile(fd, (size_t)stat.st_size, options, extender, p_file);
   }
 
+  ~DCPMMWritableFile() {
+    if (fd >= 0) {
+      Close();
+    }
+  }
+
+  // Copy non-temporally without a fence. The data is published by Flush(),
+  // which WritableFileWriter calls once per write group, so a group costs a
+  // single copy and a single fence however many records it holds.
   Status Append(const Slice& slice) override {
     size_t len = slice.size();
-    // the least file size to write the new slice
-    size_t least_file_size = sizeof(size_t) + data_length + len;
-    // left space is not enough, need expand
-    if (least_file_size > file_size) {
-      // the multiple of size_addition to add
-      size_t count = (least_file_size - file_size - 1) / size_addition + 1;
-      size_t add_size = count * size_addition;
-      // allocate new space
-      if (fallocate(fd, 0, file_size, add_size) != 0) {
-        return Status::IOError(
-            std::string("expand file failed: ").append(strerror(errno)));
-      }
-      size_t new_file_size = file_size + add_size;
-      assert(new_file_size >= least_file_size);
-      // the offset in file to mmap(), align to 4K
-      size_t offset = sizeof(size_t) + data_length;
-      size_t offset_aligned = offset & ~(4096 - 1);
-      assert(offset_aligned <= offset);
-      // mmaped() the new area, but because aligned,
-      // usually overlip with current mmap()-ed range
-      size_t new_map_length = new_file_size - offset_aligned;
-      void* new_map_base =
-          mmap(0, new_map_length, PROT_WRITE, MMAP_FLAGS, fd, offset_aligned);
-      if (new_map_base == MAP_FAILED) {
-        return Status::IOError(
-            std::string("mmap new range failed: ").append(strerror(errno)));
+    // the least mapped size to write the new slice
+    size_t least_size = sizeof(size_t) + data_length + len;
+    if (least_size > mapped_size.load(std::memory_order_acquire)) {
+      // the extender fell behind, wait for it
+      auto s = extender->WaitFor(this, least_size);
+      if (!s.ok()) {
+        return s;
       }
-      // unmap the previous range
-      munmap(map_base, map_length);
-      file_size = new_file_size;
-      map_base = new_map_base;
-      map_length = new_map_length;
-      buffer = (uint8_t*)new_map_base + offset - offset_aligned - data_length;
-    }
-    MemcpyNT(buffer + data_length, slice.data(), len);
-    // need sfence, make sure all data is persisted to DCPMM
-    __builtin_ia32_sfence();
+    }
+    pmem_memcpy(buffer + data_length, slice.data(), len,
+                PMEM_F_MEM_NONTEMPORAL | PMEM_F_MEM_NODRAIN);
     data_length += len;
-    SetSizeNT(p_length, data_length);
-    // need sfence, make sure all data is persisted to DCPMM
-    __builtin_ia32_sfence();
+    // keep an extent of headroom mapped ahead of the writer
+    if (mapped_size.load(std::memory_order_relaxed) - least_size <
+        size_addition) {
+      extender->Schedule(this);
+    }
     return Status::OK();
   }
 
   Status Truncate(uint64_t size) override {
     data_length = size;
+    published_length = data_length;
     SetSizeNT(p_length, data_length);
     __builtin_ia32_sfence();
     return Status::OK();
   }
 
   Status Close() override {
-    close(fd);
-    munmap(p_length, sizeof(size_t));
+    extender->Remove(this);
+    Sync();
     munmap(map_base, map_length);
+    close(fd);
+    fd = -1;
     return Status::OK();
   }
 
   Status Flush() override {
-    // DCPMM need no flush
+    if (published_length != data_length) {
+      // one sfence orders the data before the length; the length itself is
+      // ordered by the next fence, which Sync() provides for sync writes
+      __builtin_ia32_sfence();
+      SetSizeNT(p_length, data_length);
+      published_length = data_length;
+    }
     return Status::OK();
   }
 
   Status Sync() override {
-    // NT write need on sync
+    Flush();
+    __builtin_ia32_sfence();
     return Status::OK();
   }
 
@@ -317,41 +591,73 @@ class DCPMMWritableFile : public WritableFile {
   }
 
  private:
-  static Status CheckArguments(size_t init_size, size_t size_addition) {
-    if (init_size < sizeof(size_t)) {
+  friend class DCPMMWalExtender;
+
+  static Status CheckArguments(const DCPMMEnvOptions& options) {
+    if (options.wal_init_size < sizeof(size_t)) {
       return Status::InvalidArgument("too small init_size");
     }
-    if (size_addition == 0) {
+    if (options.wal_size_addition == 0) {
       return Status::InvalidArgument("size_addition is zero");
     }
+    if (options.wal_max_size < options.wal_init_size) {
+      return Status::InvalidArgument("max_size is less than init_size");
+    }
+    // extents are mapped in place, at page aligned offsets
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (options.wal_init_size % page_size != 0 ||
+        options.wal_size_addition % page_size != 0) {
+      return Status::InvalidArgument(
+          "init_size and size_addition must be multiples of the page size");
+    }
     return Status::OK();
   }
 
-  static Status MapFile(int fd, size_t init_size, size_t size_addition,
-                        WritableFile** p_file) {
-    // first size_t is to record length of data
-    void* p_length = mmap(0, sizeof(size_t), PROT_WRITE, MMAP_FLAGS, fd, 0);
-    if (p_length == MAP_FAILED) {
+  static Status MapFile(int fd, size_t file_size,
+                        const DCPMMEnvOptions& options,
+                        DCPMMWalExtender* extender, WritableFile** p_file) {
+    // reserve address space for the largest file, extents are mapped in
+    // place so the buffer never moves
+    size_t reserve = options.wal_max_size;
+    void* base = mmap(0, reserve, PROT_NONE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) {
       close(fd);
       return Status::IOError(
-          std::string("mmap first size_t failed: ").append(strerror(errno)));
+          std::string("reserve address space failed: ").append(strerror(errno)));
     }
-    // whole file
-    void* base = mmap(0, init_size, PROT_WRITE, MMAP_FLAGS, fd, 0);
-    if (base == MAP_FAILED) {
+    // whole file, the first size_t records length of data
+    if (mmap(base, file_size, PROT_READ | PROT_WRITE,
+             MMAP_FLAGS | MAP_FIXED | MAP_POPULATE, fd,
+             0) == MAP_FAILED) {
       close(fd);
-      munmap(p_length, sizeof(size_t));
+      munmap(base, reserve);
       return Status::IOError(
           std::string("mmap whole file failed: ").append(strerror(errno)));
     }
-    *p_file = new DCPMMWritableFile(fd, (size_t*)p_length, base, init_size,
-                                    size_addition);
+    *p_file = new DCPMMWritableFile(fd, base, reserve, file_size,
+                                    options.wal_size_addition, extender);
     return Status::OK();
   }
 
-  // memcpy non-temporally
-  static void MemcpyNT(void* dst, const void* src, size_t len) {
-    pmem_memcpy(dst, src, len, PMEM_F_MEM_NONTEMPORAL);
+  // map one more extent, called by the extender
+  Status Extend() {
+    size_t offset = mapped_size.load(std::memory_order_relaxed);
+    if (offset + size_addition > map_length) {
+      return Status::NoSpace("WAL file reached wal_max_size");
+    }
+    if (fallocate(fd, 0, offset, size_addition) != 0) {
+      return Status::IOError(
+          std::string("expand file failed: ").append(strerror(errno)));
+    }
+    if (mmap((uint8_t*)map_base + offset, size_addition,
+             PROT_READ | PROT_WRITE, MMAP_FLAGS | MAP_FIXED | MAP_POPULATE, fd,
+             offset) == MAP_FAILED) {
+      return Status::IOError(
+          std::string("mmap new range failed: ").append(strerror(errno)));
+    }
+    mapped_size.store(offset + size_addition, std::memory_order_release);
+    return Status::OK();
   }
 
   // set a 64-bit non-temporally
@@ -361,33 +667,72 @@ class DCPMMWritableFile : public WritableFile {
     __builtin_ia32_movnti64((long long*)dst, value);
   }
 
-  DCPMMWritableFile(int _fd, size_t* _p_length, void* base, size_t init_size,
-                    size_t _size_addition)
+  DCPMMWritableFile(int _fd, void* base, size_t reserve, size_t file_size,
+                    size_t _size_addition, DCPMMWalExtender* _extender)
       : data_length(0),
-        file_size(init_size),
+        published_length(0),
+        mapped_size(file_size),
         size_addition(_size_addition),
         fd(_fd),
-        p_length(_p_length),
+        p_length((size_t*)base),
         map_base(base),
-        map_length(init_size),
-        buffer((uint8_t*)base + sizeof(size_t)) {
+        map_length(reserve),
+        buffer((uint8_t*)base + sizeof(size_t)),
+        extender(_extender) {
     // reset the data length
     SetSizeNT(p_length, 0);
     __builtin_ia32_sfence();
   }
 
  private:
-  size_t data_length;    // the writen data length
-  size_t file_size;      // the length of the whole file
-  size_t size_addition;  // expand size_addition bytes
-                         // every time left space is not enough
-  int fd;                // the file descriptor
-  size_t* p_length;      // the first size_t to record data length
-  void* map_base;        // mmap()-ed area
-  size_t map_length;     // mmap()-ed length
-  uint8_t* buffer;       // the base address of buffer to write
+  size_t data_length;                // the writen data length
+  size_t published_length;           // the data length stored in p_length
+  std::atomic<size_t> mapped_size;   // the allocated and mapped file length
+  size_t size_addition;              // expand size_addition bytes
+                                     // every time headroom runs low
+  int fd;                            // the file descriptor
+  size_t* p_length;                  // the first size_t to record data length
+  void* map_base;                    // reserved address space
+  size_t map_length;                 // reserved length
+  uint8_t* buffer;                   // the base address of buffer to write
+  DCPMMWalExtender* extender;        // maps extents ahead of Append()
+  Status extend_status;              // set by the extender, under its mutex
 };
 
+Status DCPMMWalExtender::WaitFor(DCPMMWritableFile* file, size_t size) {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (file->mapped_size.load(std::memory_order_acquire) < size) {
+    if (!file->extend_status.ok()) {
+      return file->extend_status;
+    }
+    if (running != file &&
+        std::find(queue.begin(), queue.end(), file) == queue.end()) {
+      queue.push_back(file);
+      cv.notify_all();
+    }
+    cv.wait(lock);
+  }
+  return Status::OK();
+}
+
+void DCPMMWalExtender::BGThread() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true) {
+    cv.wait(lock, [&] { return shutdown || !queue.empty(); });
+    if (shutdown) {
+      break;
+    }
+    running = queue.front();
+    queue.pop_front();
+    lock.unlock();
+    auto s = running->Extend();
+    lock.lock();
+    running->extend_status = s;
+    running = nullptr;
+    cv.notify_all();
+  }
+}
+
 class DCPMMSequentialFile : public SequentialFile {
  public:
   static Status Open(const std::string& fname, SequentialFile** p_file) {
@@ -511,9 +856,8 @@ Status DCPMMEnv::NewWritableFile(const std::string& fname,
   Status status;
   if (found) {
     // reuse the file
-    status = DCPMMWritableFile::Reuse(recycle_fname, fname, &file,
-                                      options.wal_init_size,
-                                      options.wal_size_addition);
+    status = DCPMMWritableFile::Reuse(recycle_fname, fname, &file, options,
+                                      wal_extender.get());
     if (!status.ok()) {
       EnvWrapper::DeleteFile(recycle_fname);
     }
@@ -521,8 +865,8 @@ Status DCPMMEnv::NewWritableFile(const std::string& fname,
 
   if (!found || !status.ok()) {
     // create it
-    status = DCPMMWritableFile::Create(fname, &file, options.wal_init_size,
-                                       options.wal_size_addition);
+    status = DCPMMWritableFile::Create(fname, &file, options,
+                                       wal_extender.get());
   }
 
   if (status.ok()) {
@@ -531,6 +875,14 @@ Status DCPMMEnv::NewWritableFile(const std::string& fname,
   return status;
 }
 
+DCPMMEnv::DCPMMEnv(const DCPMMEnvOptions& _options, Env* base_env)
+    : EnvWrapper(base_env),
+      options(_options),
+      recycle_logs_inited(false),
+      wal_extender(new DCPMMWalExtender()) {}
+
+DCPMMEnv::~DCPMMEnv() {}
+
 Status DCPMMEnv::DeleteFile(const std::string& fname) {
   // if it is not a log file, then fall back to original logic
   if (!IsWALFile(fname)) {
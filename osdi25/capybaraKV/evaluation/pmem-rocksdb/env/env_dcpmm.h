@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 #include "rocksdb/env.h"
 #include "rocksdb/status.h"
@@ -21,6 +26,53 @@
 
 namespace rocksdb {
 
+// A pool of SST files on DCPMM that are allocated, mapped and pre-faulted
+// by a background thread ahead of flushes and compactions, which then only
+// rename a ready file into place. Deleted SST files are recycled into the
+// pool. The number of ready files follows the recent rate at which SST
+// files are created, and their size the largest file recently recycled.
+class DCPMMSstPool {
+ public:
+  // a ready file, mapped at base for map_len bytes
+  struct File {
+    int fd;
+    char* base;
+    size_t map_len;
+  };
+
+  DCPMMSstPool();
+  ~DCPMMSstPool();
+
+  // Rename a ready file in fname's directory to fname. Returns false if
+  // there is none, or the directory is not on DCPMM.
+  bool Take(const std::string& fname, File* file);
+
+  // Keep fname for reuse instead of deleting it. Returns false if the pool
+  // is full, or the directory is not on DCPMM.
+  bool Recycle(const std::string& fname);
+
+ private:
+  void BGThread();
+  // Allocate, map and pre-fault one file; fresh files are also zeroed so
+  // that no write to them faults on an unwritten extent.
+  Status PrepareFile(const std::string& fname, bool fresh, size_t size,
+                     File* file);
+  size_t TargetReady();
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::string dir_;                        // set by the first SST request
+  bool disabled_;                          // dir_ is not on DCPMM
+  bool shutdown_;
+  std::vector<std::string> recycled_;      // deleted files, not mapped yet
+  std::deque<std::pair<std::string, File>> ready_;
+  uint64_t next_file_;
+  size_t file_size_;                       // size ready files are grown to
+  uint64_t last_take_micros_;
+  double take_interval_micros_;            // moving average between Take()s
+  std::unique_ptr<std::thread> thread_;
+};
+
 class DCPMMMmapFile : public FSWritableFile {
  private:
   std::string filename_;
@@ -55,6 +107,9 @@ class DCPMMMmapFile : public FSWritableFile {
  public:
   DCPMMMmapFile(const std::string& fname, int fd, size_t page_size,
                 const EnvOptions& options);
+  // take over a file the DCPMMSstPool already mapped and pre-faulted
+  DCPMMMmapFile(const std::string& fname, const DCPMMSstPool::File& file,
+                size_t page_size, const EnvOptions& options);
   ~DCPMMMmapFile();
 
   // Means Close() will properly take care of truncate
@@ -79,11 +134,12 @@ class DCPMMMmapFile : public FSWritableFile {
 #endif
 };
 
+class DCPMMWalExtender;
+
 class DCPMMEnv : public EnvWrapper {
 public:
-  explicit DCPMMEnv(const DCPMMEnvOptions& _options, Env* base_env) :
-    EnvWrapper(base_env), options(_options), recycle_logs_inited(false) {
-}
+  explicit DCPMMEnv(const DCPMMEnvOptions& _options, Env* base_env);
+  ~DCPMMEnv() override;
 
   // we should use DCPMM-awared filesystem for WAL file
   Status NewWritableFile(const std::string& fname,
@@ -104,6 +160,8 @@ private:
                                           // in wal_dir to init recycle_logs
   std::vector<std::string> recycle_logs;  // file names of recycled log files
   std::mutex lock_recycle_logs;           // lock protecting recycle_logs
+  std::unique_ptr<DCPMMWalExtender> wal_extender;  // grows WAL files ahead
+                                                   // of their writers
 };
 
 }  // namespace rocksdb
@@ -273,32 +273,29 @@ class PosixFileSystem : public FileSystem {
                                     const FileOptions& options,
                                     bool reopen,
                                     std::unique_ptr<FSWritableFile>* result,
-                                    IODebugContext* dbg) {
+                                    IODebugContext* /*dbg*/) {
     result->reset();
     IOStatus s;
     int fd = -1;
 #ifdef ON_DCPMM
-    std::string old;
     bool recycle = false;
     if(options.recycle_dcpmm_sst && !recycle_dcpmm_sst_) {
       std::cerr<<"recycle pmem sst!"<<std::endl;
       recycle_dcpmm_sst_ = true;
     }
-    if(recycle_dcpmm_sst_ && fname.rfind(".sst") == fname.length() - 4) {
-      int is_pmem;
-      size_t len;
-      pmem_map_file(fname.c_str(), 0, PMEM_FILE_CREATE, 0666, &len, &is_pmem);
-      if(is_pmem)
-      {
-        std::lock_guard<SpinMutex> lg(recycle_lock_);
-        if (!recycled_sst_.empty()) {
-          old = recycled_sst_.back();
-          recycled_sst_.pop_back();
-          recycle = true;
-        }
+    DCPMMSstPool::File pooled;
+    if (recycle_dcpmm_sst_ && !reopen && IsSstFile(fname) &&
+        sst_pool_.Take(fname, &pooled)) {
+      if (options.use_mmap_writes && options.use_dcpmm_writes) {
+        // already allocated, mapped and pre-faulted
+        result->reset(new DCPMMMmapFile(fname, pooled, page_size_, options));
+        return s;
       }
+      // other writers open the file by name, it is allocated at least
+      munmap(pooled.base, pooled.map_len);
+      close(pooled.fd);
+      recycle = true;
     }
-    if(recycle) RenameFile(old, fname, IOOptions(), dbg);
     int flags = (reopen) ? (O_CREAT | O_APPEND) : ( recycle? 0 : (O_CREAT | O_TRUNC));
 #else
     int flags = (reopen) ? (O_CREAT | O_APPEND) : (O_CREAT | O_TRUNC);
@@ -672,24 +669,12 @@ class PosixFileSystem : public FileSystem {
     return IOStatus::OK();
   }
 
-  IOStatus DeleteFile(const std::string& fname, const IOOptions& opts,
-                      IODebugContext* dbg) override {
+  IOStatus DeleteFile(const std::string& fname, const IOOptions& /*opts*/,
+                      IODebugContext* /*dbg*/) override {
     IOStatus result;
 #ifdef ON_DCPMM
-    if(recycle_dcpmm_sst_ && fname.rfind(".sst")==fname.length() - 4) {
-      int is_pmem;
-      size_t len;
-      pmem_map_file(fname.c_str(), 0, PMEM_FILE_CREATE, 0666, &len, &is_pmem);
-      if(is_pmem)
-      {
-        std::lock_guard<SpinMutex> lg(recycle_lock_);
-        if (recycled_sst_.size() > 100) {
-        } else {
-          result = RenameFile(fname, fname + ".reuse", opts, dbg);
-          recycled_sst_.push_back(fname + ".reuse");
-          return result;
-        }
-      }
+    if (recycle_dcpmm_sst_ && IsSstFile(fname) && sst_pool_.Recycle(fname)) {
+      return result;
     }
 #endif
     if (unlink(fname.c_str()) != 0) {
@@ -1058,8 +1043,12 @@ class PosixFileSystem : public FileSystem {
                                                     const std::string& fname,
                                                     int fd);
 #ifdef ON_DCPMM
-  std::vector<std::string> recycled_sst_;
-  SpinMutex recycle_lock_;
+  static bool IsSstFile(const std::string& fname) {
+    return fname.size() > 4 &&
+           fname.compare(fname.size() - 4, 4, ".sst") == 0;
+  }
+
+  DCPMMSstPool sst_pool_;
   bool recycle_dcpmm_sst_;
 #endif
 };
@@ -931,6 +931,18 @@ class DB {
     // "rocksdb.options-statistics" - returns multi-line string
     //      of options.statistics
     static const std::string kOptionsStatistics;
+
+    //  "rocksdb.dcpmm-kvs-capacity" - returns the DCPMM space of KVS, the
+    //      store for values kept outside the LSM tree.
+    static const std::string kDcpmmKvsCapacity;
+
+    //  "rocksdb.dcpmm-kvs-usage" - returns the DCPMM space used by values
+    //      in KVS.
+    static const std::string kDcpmmKvsUsage;
+
+    //  "rocksdb.dcpmm-kvs-stats" - returns a multi-line string with the
+    //      capacity and usage of each KVS pool.
+    static const std::string kDcpmmKvsStats;
   };
 #endif /* ROCKSDB_LITE */
 
@@ -987,6 +999,8 @@ class DB {
   //  "rocksdb.block-cache-capacity"
   //  "rocksdb.block-cache-usage"
   //  "rocksdb.block-cache-pinned-usage"
+  //  "rocksdb.dcpmm-kvs-capacity"
+  //  "rocksdb.dcpmm-kvs-usage"
   virtual bool GetIntProperty(ColumnFamilyHandle* column_family,
                               const Slice& property, uint64_t* value) = 0;
   virtual bool GetIntProperty(const Slice& property, uint64_t* value) {
@@ -1643,9 +1643,13 @@ struct DCPMMEnvOptions {
   // the initial allocation size of wal file
   // default 256 MB
   size_t wal_init_size = 256 << 20;
-  // expand wal file with this size every time it is not enough
+  // expand wal file with this size every time it is not enough; a
+  // background thread keeps this much space mapped ahead of the writer
   // default 64 MB
   size_t wal_size_addition = 64 << 20;
+  // address space reserved for each wal file, which cannot grow beyond it
+  // default 16 GB
+  size_t wal_max_size = size_t{16} << 30;
 };
 
 Env* NewDCPMMEnvDefault(Env* base_env = nullptr);
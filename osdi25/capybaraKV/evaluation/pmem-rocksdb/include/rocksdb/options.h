@@ -1169,6 +1169,31 @@ struct DBOptions {
   // Indicates if compress the value
   bool dcpmm_compress_value = true;
 
+  // Codec for compressed values: kSnappyCompression, kLZ4Compression or
+  // kZSTD. Values that do not shrink by at least 12.5% are stored
+  // uncompressed.
+  CompressionType dcpmm_compression_type = kSnappyCompression;
+
+  // Once this fraction of KVS space is used, every compaction moves the values
+  // it outputs back into SST files, not only those below dcpmm_kvs_level.
+  double dcpmm_kvs_migrate_ratio = 0.7;
+
+  // Once this fraction of KVS space is used, writes are delayed through the
+  // write controller until compactions have freed KVS space. Values that do
+  // not fit in KVS at all are still stored inline.
+  double dcpmm_kvs_slowdown_ratio = 0.9;
+
+  // If not empty, memtables are built in arena files in this directory,
+  // which must be on a DAX filesystem. Memtables that were switched to
+  // immutable but not flushed at the time of a crash are flushed from their
+  // arena on open, instead of being rebuilt from the WAL.
+  std::string dcpmm_memtable_dir = "";
+
+  // Size of one memtable arena file. Once it is full the memtable continues
+  // in DRAM and is rebuilt from the WAL after a crash.
+  // Default: 0, meaning 2 * write_buffer_size
+  size_t dcpmm_memtable_arena_size = 0;
+
   bool recycle_dcpmm_sst = false;
 #endif
 };
@@ -366,6 +366,13 @@ enum Tickers : uint32_t {
   // # of files deleted immediately by sst file manger through delete scheduler.
   FILES_DELETED_IMMEDIATELY,
 
+  // # of bytes of value content written to DCPMM KVS.
+  DCPMM_KVS_BYTES_WRITTEN,
+  // # of bytes of DCPMM KVS space freed by compaction and deletes.
+  DCPMM_KVS_BYTES_FREED,
+  // # of values above the KVS threshold stored inline because KVS was full.
+  DCPMM_KVS_INLINE_FALLBACKS,
+
   TICKER_ENUM_MAX
 };
 
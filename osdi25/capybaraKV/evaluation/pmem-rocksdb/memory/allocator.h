@@ -28,6 +28,20 @@ class Allocator {
                                 Logger* logger = nullptr) = 0;
 
   virtual size_t BlockSize() const = 0;
+
+  // Allocate the entry point of a data structure. A persistent allocator
+  // records it, so that a recovered allocator can hand it back.
+  virtual char* AllocateRoot(size_t bytes) { return AllocateAligned(bytes); }
+
+  // True if the memory survives a restart and Persist() must be called on
+  // what is written to it.
+  virtual bool IsPersistent() const { return false; }
+
+  // True if the memory was left by a previous incarnation; roots point to
+  // complete data structures and nothing new can be allocated.
+  virtual bool IsRecovered() const { return false; }
+
+  virtual void Persist(const void* /*addr*/, size_t /*len*/) {}
 };
 
 class AllocTracker {
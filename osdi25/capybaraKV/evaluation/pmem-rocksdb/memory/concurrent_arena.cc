@@ -27,9 +27,10 @@ const size_t kMaxShardBlockSize = size_t{128 * 1024};
 }  // namespace
 
 ConcurrentArena::ConcurrentArena(size_t block_size, AllocTracker* tracker,
-                                 size_t huge_page_size)
+                                 size_t huge_page_size, DcpmmArena* dcpmm_arena)
     : shard_block_size_(std::min(kMaxShardBlockSize, block_size / 8)),
       shards_(),
+      dcpmm_arena_(dcpmm_arena),
       arena_(block_size, tracker, huge_page_size) {
   (void)tracker;
   (void)huge_page_size;
@@ -45,11 +45,18 @@ class ConcurrentArena : public Allocator {
   // in fact just passed to the constructor of arena_.  The core-local
   // shards compute their shard_block_size as a fraction of block_size
   // that varies according to the hardware concurrency level.
+  // If dcpmm_arena is given, allocations are served from it first and
+  // only go to arena_ once it is full.
   explicit ConcurrentArena(size_t block_size = Arena::kMinBlockSize,
                            AllocTracker* tracker = nullptr,
-                           size_t huge_page_size = 0);
+                           size_t huge_page_size = 0,
+                           DcpmmArena* dcpmm_arena = nullptr);
 
   char* Allocate(size_t bytes) override {
+    char* rv = AllocateDcpmm(bytes);
+    if (rv != nullptr) {
+      return rv;
+    }
     return AllocateImpl(bytes, false /*force_arena*/,
                         [this, bytes]() { return arena_.Allocate(bytes); });
   }
@@ -60,6 +67,10 @@ class ConcurrentArena : public Allocator {
     assert(rounded_up >= bytes && rounded_up < bytes + sizeof(void*) &&
            (rounded_up % sizeof(void*)) == 0);
 
+    char* rv = AllocateDcpmm(rounded_up);
+    if (rv != nullptr) {
+      return rv;
+    }
     return AllocateImpl(rounded_up, huge_page_size != 0 /*force_arena*/,
                         [this, rounded_up, huge_page_size, logger]() {
                           return arena_.AllocateAligned(rounded_up,
@@ -67,14 +78,39 @@ class ConcurrentArena : public Allocator {
                         });
   }
 
+  char* AllocateRoot(size_t bytes) override {
+    if (dcpmm_arena_ != nullptr) {
+      char* rv = dcpmm_arena_->AllocateRoot(bytes);
+      if (rv != nullptr) {
+        return rv;
+      }
+      dcpmm_arena_->MarkSpilled();
+    }
+    return AllocateAligned(bytes);
+  }
+
+  bool IsPersistent() const override { return dcpmm_arena_ != nullptr; }
+
+  bool IsRecovered() const override {
+    return dcpmm_arena_ != nullptr && dcpmm_arena_->IsRecovered();
+  }
+
+  void Persist(const void* addr, size_t len) override {
+    if (dcpmm_arena_ != nullptr) {
+      dcpmm_arena_->Persist(addr, len);
+    }
+  }
+
   size_t ApproximateMemoryUsage() const {
     std::unique_lock<SpinMutex> lock(arena_mutex_, std::defer_lock);
     lock.lock();
-    return arena_.ApproximateMemoryUsage() - ShardAllocatedAndUnused();
+    return arena_.ApproximateMemoryUsage() - ShardAllocatedAndUnused() +
+           DcpmmMemoryUsage();
   }
 
   size_t MemoryAllocatedBytes() const {
-    return memory_allocated_bytes_.load(std::memory_order_relaxed);
+    return memory_allocated_bytes_.load(std::memory_order_relaxed) +
+           DcpmmMemoryUsage();
   }
 
   size_t AllocatedAndUnused() const {
@@ -110,7 +146,7 @@ class ConcurrentArena : public Allocator {
 
   CoreLocalArray<Shard> shards_;
 
-//  DcpmmArena arena_;
+  DcpmmArena* dcpmm_arena_;
   Arena arena_;
   mutable SpinMutex arena_mutex_;
   std::atomic<size_t> arena_allocated_and_unused_;
@@ -121,6 +157,26 @@ class ConcurrentArena : public Allocator {
 
   Shard* Repick();
 
+  // The DCPMM arena bump-allocates with a single atomic add, it needs
+  // neither the shards nor arena_mutex_.
+  char* AllocateDcpmm(size_t bytes) {
+    if (dcpmm_arena_ == nullptr) {
+      return nullptr;
+    }
+    char* rv = dcpmm_arena_->Allocate(bytes);
+    if (rv == nullptr) {
+      dcpmm_arena_->MarkSpilled();
+    }
+    return rv;
+  }
+
+  size_t DcpmmMemoryUsage() const {
+    return dcpmm_arena_ == nullptr
+               ? 0
+               : std::min(dcpmm_arena_->ApproximateMemoryUsage(),
+                          dcpmm_arena_->BlockSize());
+  }
+
   size_t ShardAllocatedAndUnused() const {
     size_t total = 0;
     for (size_t i = 0; i < shards_.Size(); ++i) {
@@ -1,73 +1,275 @@
 //
 // Created by root on 12/23/20.
 //
-#include "dcpmm_arena.h"
+#include "memory/dcpmm_arena.h"
 
-#include <zconf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-#include <iostream>
+#include <cinttypes>
+#include <cstring>
 
 #include "libpmem.h"
+#include "port/port.h"
+
+#ifndef MAP_SYNC
+#define MAP_SYNC 0x80000
+#endif
+
+#ifndef MAP_SHARED_VALIDATE
+#define MAP_SHARED_VALIDATE 0x03
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
 
 namespace ROCKSDB_NAMESPACE {
-const size_t DcpmmArena::kMapSize = 512 << 20;
-std::atomic<uint64_t> DcpmmArena::arena_num{0};
 
-DcpmmArena::DcpmmArena(std::string pmem_file_path, size_t map_size)
-    : filename_(pmem_file_path + std::to_string(arena_num.fetch_add(
-                                     1, std::memory_order_relaxed)%4)),
-      map_size_(map_size) {
-  static bool arena = false;
-  if(!arena){
-    arena = true;
-    std::cerr<<"dcpmm arena!"<<std::endl;
+namespace {
+const uint64_t kArenaMagic = 0x52444250414e4552ULL;  // "RENAPBDR"
+const size_t kHeaderSize = 256;
+const uint32_t kFlagSealed = 0x1;
+const uint32_t kFlagSpilled = 0x2;
+
+// Arenas are mapped in a range of their own, away from where the kernel
+// places other mappings, so the same addresses are likely to be free again
+// when the next incarnation reattaches them.
+const uint64_t kBaseHint = 0x600000000000ULL;
+const size_t kMapAlign = size_t{2} << 20;
+std::atomic<uint64_t> next_base{kBaseHint};
+std::atomic<uint64_t> next_file{0};
+
+// Tells arenas of this process apart from those left by a previous one.
+uint64_t Incarnation() {
+  static const uint64_t incarnation =
+      (static_cast<uint64_t>(getpid()) << 32) ^
+      static_cast<uint64_t>(time(nullptr));
+  return incarnation;
+}
+
+char* MapAt(uint64_t addr, size_t len, int fd, bool* is_pmem) {
+  void* want = reinterpret_cast<void*>(addr);
+  void* p = mmap(want, len, PROT_READ | PROT_WRITE,
+                 MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED_NOREPLACE, fd, 0);
+  *is_pmem = true;
+  if (p == MAP_FAILED && errno == EOPNOTSUPP) {
+    // Not on a DAX filesystem, persist with msync instead.
+    p = mmap(want, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE,
+             fd, 0);
+    *is_pmem = false;
+  }
+  if (p == MAP_FAILED) {
+    return nullptr;
   }
+  if (p != want) {
+    // Kernels before 4.17 take MAP_FIXED_NOREPLACE as a hint only.
+    munmap(p, len);
+    return nullptr;
+  }
+  return static_cast<char*>(p);
+}
+}  // namespace
+
+const char* const DcpmmArena::kFileSuffix = ".arena";
+
+struct DcpmmArena::Header {
+  uint64_t magic;
+  uint64_t incarnation;
+  uint64_t base;
+  uint64_t capacity;
+  uint32_t column_family_id;
+  uint32_t flags;
+  uint64_t log_number;
+  uint64_t last_sequence;
+  uint64_t next_log_number;
+  uint64_t roots[kMaxRoots];
+};
+
+DcpmmArena::DcpmmArena(std::string filename, char* base, size_t capacity,
+                       bool is_pmem, bool recovered)
+    : filename_(std::move(filename)),
+      base_(base),
+      capacity_(capacity),
+      is_pmem_(is_pmem),
+      recovered_(recovered),
+      offset_(kHeaderSize) {
+  static_assert(sizeof(Header) <= kHeaderSize, "arena header too large");
 }
 
 DcpmmArena::~DcpmmArena() {
-//  unlink(filename_.c_str());
-    pmem_unmap(base_, capacity_);
-  // nothing todo for now
-}
-
-Status DcpmmArena::MapNewRegion() {
-  size_t mmap_len;
-  int is_pmem;
-  // TODO record block unit size on file head
-  // TODO reuse existing files
-  base_ = (char*)pmem_map_file(filename_.c_str(), offset_ + map_size_,
-                               PMEM_FILE_EXCL, 0666, &mmap_len, &is_pmem);
-  if (base_ == nullptr) {
-    base_ = (char*)pmem_map_file(filename_.c_str(), offset_ + map_size_,
-                                 PMEM_FILE_CREATE, 0666, &mmap_len, &is_pmem);
-  }
-  if (base_ == nullptr || !is_pmem || mmap_len != offset_ + map_size_) {
-    return Status::IOError("dcpmm arena: map new region error");
-  }
-  capacity_ = mmap_len;
-//  std::cerr<<"map new region done\n";
+  munmap(base_, capacity_);
+  if (discard_) {
+    unlink(filename_.c_str());
+  }
+}
+
+Status DcpmmArena::Create(const std::string& dir, uint32_t column_family_id,
+                          size_t capacity, std::unique_ptr<DcpmmArena>* arena) {
+  capacity = (capacity + kMapAlign - 1) & ~(kMapAlign - 1);
+  char name[100];
+  snprintf(name, sizeof(name), "/%u-%016" PRIx64 "-%06" PRIu64 "%s",
+           column_family_id, Incarnation(), next_file.fetch_add(1),
+           kFileSuffix);
+  std::string filename = dir + name;
+
+  int fd = open(filename.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    return Status::IOError("dcpmm arena: create " + filename, strerror(errno));
+  }
+  int err = posix_fallocate(fd, 0, static_cast<off_t>(capacity));
+  if (err != 0) {
+    close(fd);
+    unlink(filename.c_str());
+    return Status::IOError("dcpmm arena: allocate " + filename, strerror(err));
+  }
+
+  char* base = nullptr;
+  bool is_pmem = false;
+  // Skip ranges taken by other mappings, recovered arenas included.
+  for (int i = 0; i < 1024 && base == nullptr; i++) {
+    base = MapAt(next_base.fetch_add(capacity), capacity, fd, &is_pmem);
+  }
+  close(fd);
+  if (base == nullptr) {
+    unlink(filename.c_str());
+    return Status::IOError("dcpmm arena: map " + filename, strerror(errno));
+  }
+
+  arena->reset(new DcpmmArena(filename, base, capacity, is_pmem, false));
+  auto* h = (*arena)->header();
+  memset(static_cast<void*>(h), 0, kHeaderSize);
+  h->incarnation = Incarnation();
+  h->base = reinterpret_cast<uint64_t>(base);
+  h->capacity = capacity;
+  h->column_family_id = column_family_id;
+  (*arena)->Persist(h, kHeaderSize);
+  // The magic goes last, a torn header is never taken for an arena.
+  h->magic = kArenaMagic;
+  (*arena)->Persist(&h->magic, sizeof(h->magic));
+  return Status::OK();
+}
+
+Status DcpmmArena::Open(const std::string& path,
+                        std::unique_ptr<DcpmmArena>* arena) {
+  int fd = open(path.c_str(), O_RDWR);
+  if (fd < 0) {
+    return Status::IOError("dcpmm arena: open " + path, strerror(errno));
+  }
+  Header h;
+  if (pread(fd, &h, sizeof(h), 0) != static_cast<ssize_t>(sizeof(h)) ||
+      h.magic != kArenaMagic) {
+    close(fd);
+    return Status::Corruption("dcpmm arena: bad header", path);
+  }
+  if (h.incarnation == Incarnation()) {
+    close(fd);
+    return Status::Busy("dcpmm arena: in use", path);
+  }
+  bool is_pmem;
+  char* base = MapAt(h.base, h.capacity, fd, &is_pmem);
+  close(fd);
+  if (base == nullptr) {
+    return Status::IOError("dcpmm arena: address taken", path);
+  }
+  arena->reset(new DcpmmArena(path, base, h.capacity, is_pmem, true));
   return Status::OK();
 }
 
+bool DcpmmArena::IsArenaFile(const std::string& fname) {
+  const size_t suffix_len = strlen(kFileSuffix);
+  return fname.size() > suffix_len &&
+         fname.compare(fname.size() - suffix_len, suffix_len, kFileSuffix) ==
+             0;
+}
+
 char* DcpmmArena::Allocate(size_t bytes) {
-  bytes = bytes + (64 - (bytes&63)); //align
-  if (base_ == nullptr || offset_ + bytes >= capacity_) {
-    auto s = MapNewRegion();
-    if (!s.ok()) {
-      std::cerr<<s.ToString()<<std::endl;
-      fprintf(stderr, "%s\n", pmem_errormsg());
-      return nullptr;
-    }
+  if (recovered_) {
+    return nullptr;
+  }
+  // Keep every allocation pointer aligned, links live inside them.
+  bytes = (bytes + sizeof(void*) - 1) & ~(sizeof(void*) - 1);
+  size_t off = offset_.fetch_add(bytes, std::memory_order_relaxed);
+  if (off + bytes > capacity_) {
+    return nullptr;
   }
-  // TODO record size
-  char* ret = base_ + offset_;
-  offset_ += bytes;
-  return ret;
+  return base_ + off;
 }
 
 char* DcpmmArena::AllocateAligned(size_t bytes, size_t, Logger*) {
-  // TODO: aligned allocate
   return Allocate(bytes);
 }
 
-}  // namespace ROCKSDB_NAMESPACE
\ No newline at end of file
+char* DcpmmArena::AllocateRoot(size_t bytes) {
+  size_t slot = next_root_.fetch_add(1, std::memory_order_relaxed);
+  if (slot >= kMaxRoots) {
+    return nullptr;
+  }
+  auto* h = header();
+  if (recovered_) {
+    return h->roots[slot] == 0 ? nullptr : base_ + h->roots[slot];
+  }
+  char* rv = Allocate(bytes);
+  if (rv != nullptr) {
+    h->roots[slot] = static_cast<uint64_t>(rv - base_);
+    Persist(&h->roots[slot], sizeof(h->roots[slot]));
+  }
+  return rv;
+}
+
+void DcpmmArena::Persist(const void* addr, size_t len) {
+  if (is_pmem_) {
+    pmem_persist(addr, len);
+  } else {
+    pmem_msync(addr, len);
+  }
+}
+
+void DcpmmArena::MarkSpilled() {
+  auto* h = header();
+  if (!recovered_ && !(h->flags & kFlagSpilled)) {
+    h->flags |= kFlagSpilled;
+    Persist(&h->flags, sizeof(h->flags));
+  }
+}
+
+void DcpmmArena::SetLogNumber(uint64_t log_number) {
+  auto* h = header();
+  h->log_number = log_number;
+  Persist(&h->log_number, sizeof(h->log_number));
+}
+
+void DcpmmArena::Seal(SequenceNumber last_sequence, uint64_t next_log_number) {
+  auto* h = header();
+  h->last_sequence = last_sequence;
+  h->next_log_number = next_log_number;
+  Persist(&h->last_sequence,
+          sizeof(h->last_sequence) + sizeof(h->next_log_number));
+  h->flags |= kFlagSealed;
+  Persist(&h->flags, sizeof(h->flags));
+}
+
+bool DcpmmArena::IsSealed() const {
+  return header()->flags == kFlagSealed;
+}
+
+uint32_t DcpmmArena::GetColumnFamilyID() const {
+  return header()->column_family_id;
+}
+
+uint64_t DcpmmArena::GetLogNumber() const {
+  return header()->log_number;
+}
+
+SequenceNumber DcpmmArena::GetLastSequence() const {
+  return header()->last_sequence;
+}
+
+uint64_t DcpmmArena::GetNextLogNumber() const {
+  return header()->next_log_number;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
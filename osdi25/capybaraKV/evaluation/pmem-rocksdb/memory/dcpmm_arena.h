@@ -2,56 +2,118 @@
 // Created by root on 12/23/20.
 //
 
-#ifndef ROCKSDB_DCPMM_ARENA_H
-#define ROCKSDB_DCPMM_ARENA_H
+#pragma once
 
-#endif  // ROCKSDB_DCPMM_ARENA_H
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <string>
 
 #include "memory/allocator.h"
+#include "rocksdb/status.h"
+#include "rocksdb/types.h"
 
 namespace ROCKSDB_NAMESPACE {
-class DcpmmArena : Allocator {
+
+// DcpmmArena is a bump allocator over one file on a DAX filesystem, used to
+// build a memtable directly on DCPMM.
+//
+// The file starts with a header that records the address the file was mapped
+// at, so a later incarnation can map it at the same address and follow the
+// pointers inside it (the skiplist links) without relocating them. The header
+// also keeps a few root slots, which the skiplists use to find their head
+// nodes again, and the state of the memtable the arena belongs to.
+//
+// Only sealed arenas, whose memtable was switched to immutable, are complete
+// and can be reattached. An arena of the mutable memtable at the time of a
+// crash is discarded and its content is recovered from the WAL instead.
+class DcpmmArena : public Allocator {
  public:
+  static const size_t kMaxRoots = 4;
+  static const char* const kFileSuffix;
+
   DcpmmArena(const DcpmmArena&) = delete;
   void operator=(const DcpmmArena&) = delete;
   ~DcpmmArena();
 
-  static const size_t kMapSize;
-  static std::atomic<uint64_t > arena_num;
+  // Create a new arena file of `capacity` bytes in `dir` for a memtable of
+  // column family `column_family_id`.
+  static Status Create(const std::string& dir, uint32_t column_family_id,
+                       size_t capacity, std::unique_ptr<DcpmmArena>* arena);
 
-  explicit DcpmmArena(std::string pmem_file_path = "/mnt/pmem0/pmem_arena/",
-                      size_t map_size = kMapSize);
+  // Map an arena file left by a previous incarnation at the address it was
+  // created at. The result is read-only: Allocate() returns nullptr, and
+  // AllocateRoot() hands back the recorded roots in order.
+  static Status Open(const std::string& path,
+                     std::unique_ptr<DcpmmArena>* arena);
 
+  // Return true if fname is an arena file name.
+  static bool IsArenaFile(const std::string& fname);
+
+  // Return nullptr when the arena is full or read-only; the caller then
+  // allocates elsewhere and must call MarkSpilled().
   char* Allocate(size_t bytes) override;
 
   char* AllocateAligned(size_t bytes, size_t huge_page_size = 0,
                         Logger* logger = nullptr) override;
 
-  size_t BlockSize() const override { return map_size_; }
+  char* AllocateRoot(size_t bytes) override;
+
+  bool IsPersistent() const override { return true; }
+
+  bool IsRecovered() const override { return recovered_; }
+
+  void Persist(const void* addr, size_t len) override;
 
-  size_t AllocatedAndUnused() const { return capacity_ - offset_; }
+  size_t BlockSize() const override { return capacity_; }
+
+  size_t AllocatedAndUnused() const {
+    return capacity_ - std::min(capacity_, ApproximateMemoryUsage());
+  }
 
   size_t ApproximateMemoryUsage() const {
-    return offset_;
+    return offset_.load(std::memory_order_relaxed);
   }
 
-  size_t MemoryAllocatedBytes() const { return offset_; }
+  size_t MemoryAllocatedBytes() const { return ApproximateMemoryUsage(); }
 
-  size_t IrregularBlockNum() const { return 0; }
+  // Part of the memtable lives outside this arena, it cannot be reattached.
+  void MarkSpilled();
 
-  bool IsInInlineBlock() const {
-    // TODO figure out
-    return true;
-  }
+  // Record the first WAL whose writes may be in the memtable. Recovery only
+  // reattaches an arena if it continues where the previous one, or the last
+  // flush, stopped.
+  void SetLogNumber(uint64_t log_number);
+
+  // The memtable became immutable; record what recovery needs to flush it
+  // and to skip its WAL.
+  void Seal(SequenceNumber last_sequence, uint64_t next_log_number);
+
+  // Unlink the file when the arena is destroyed.
+  void Discard() { discard_ = true; }
+
+  bool IsSealed() const;
+  uint32_t GetColumnFamilyID() const;
+  uint64_t GetLogNumber() const;
+  SequenceNumber GetLastSequence() const;
+  uint64_t GetNextLogNumber() const;
+  const std::string& GetFileName() const { return filename_; }
 
  private:
-  //TODO restore
-  Status MapNewRegion();
+  struct Header;
+
+  DcpmmArena(std::string filename, char* base, size_t capacity, bool is_pmem,
+             bool recovered);
+
+  Header* header() const { return reinterpret_cast<Header*>(base_); }
 
   std::string filename_;
   char* base_;
-  size_t offset_{0};  // offset of block unit
-  size_t map_size_;
-  size_t capacity_{0};
+  size_t capacity_;
+  bool is_pmem_;
+  bool recovered_;
+  bool discard_{false};
+  std::atomic<size_t> offset_;
+  std::atomic<size_t> next_root_{0};
 };
-}  // namespace ROCKSDB_NAMESPACE
\ No newline at end of file
+}  // namespace ROCKSDB_NAMESPACE
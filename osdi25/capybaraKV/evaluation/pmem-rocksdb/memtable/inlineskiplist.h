@@ -86,6 +86,19 @@ class InlineSkipList {
   // Allocate a splice using allocator.
   Splice* AllocateSplice();
 
+  // Allocate the head node as the allocator's root, so that a recovered
+  // allocator hands back the head of a list built by a previous incarnation.
+  Node* AllocateHead(int height);
+
+  // On a persistent allocator, a node's own link is persisted before the
+  // node is published and the predecessor's link right after, so that the
+  // list found after a restart is always well formed.
+  void PersistLink(Node* x, int level) {
+    if (persistent_) {
+      allocator_->Persist(x->LinkAddr(level), sizeof(std::atomic<Node*>));
+    }
+  }
+
   // Allocate a splice on heap.
   Splice* AllocateSpliceOnHeap();
 
@@ -197,6 +210,8 @@ class InlineSkipList {
   const uint32_t kScaledInverseBranching_;
 
   Allocator* const allocator_;  // Allocator used for allocations of nodes
+  // Links must be persisted as they are written, see PersistLink().
+  const bool persistent_;
   // Immutable after construction
   Comparator const compare_;
   Node* const head_;
@@ -340,6 +355,11 @@ struct InlineSkipList<Comparator>::Node {
     (&next_[0] - n)->store(x, std::memory_order_relaxed);
   }
 
+  const void* LinkAddr(int n) const {
+    assert(n >= 0);
+    return &next_[0] - n;
+  }
+
   // Insert node after prev on specific level.
   void InsertAfter(Node* prev, int level) {
     // NoBarrier_SetNext() suffices since we will add a barrier when
@@ -595,8 +615,9 @@ InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
       kBranching_(static_cast<uint16_t>(branching_factor)),
       kScaledInverseBranching_((Random::kMaxNext + 1) / kBranching_),
       allocator_(allocator),
+      persistent_(allocator->IsPersistent()),
       compare_(cmp),
-      head_(AllocateNode(0, max_height)),
+      head_(AllocateHead(max_height)),
       max_height_(1),
       seq_splice_(AllocateSplice()) {
   assert(max_height > 0 && kMaxHeight_ == static_cast<uint32_t>(max_height));
@@ -604,9 +625,32 @@ InlineSkipList<Comparator>::InlineSkipList(const Comparator cmp,
          kBranching_ == static_cast<uint32_t>(branching_factor));
   assert(kScaledInverseBranching_ > 0);
 
+  if (allocator_->IsRecovered()) {
+    // The links were left by a previous incarnation; find the height of the
+    // list from the head.
+    for (int i = kMaxHeight_ - 1; i > 0; --i) {
+      if (head_->Next(i) != nullptr) {
+        max_height_.store(i + 1, std::memory_order_relaxed);
+        break;
+      }
+    }
+    return;
+  }
   for (int i = 0; i < kMaxHeight_; ++i) {
     head_->SetNext(i, nullptr);
   }
+  if (persistent_) {
+    allocator_->Persist(head_->LinkAddr(kMaxHeight_ - 1),
+                        sizeof(std::atomic<Node*>) * kMaxHeight_);
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::AllocateHead(int height) {
+  auto prefix = sizeof(std::atomic<Node*>) * (height - 1);
+  char* raw = allocator_->AllocateRoot(prefix + sizeof(Node));
+  return reinterpret_cast<Node*>(raw + prefix);
 }
 
 template <class Comparator>
@@ -870,8 +914,10 @@ bool InlineSkipList<Comparator>::Insert(const char* key, Splice* splice,
         assert(splice->prev_[i] == head_ ||
                compare_(splice->prev_[i]->Key(), x->Key()) < 0);
         x->NoBarrier_SetNext(i, splice->next_[i]);
+        PersistLink(x, i);
         if (splice->prev_[i]->CASNext(i, splice->next_[i], x)) {
           // success
+          PersistLink(splice->prev_[i], i);
           break;
         }
         // CAS failed, we need to recompute prev and next. It is unlikely
@@ -914,7 +960,9 @@ bool InlineSkipList<Comparator>::Insert(const char* key, Splice* splice,
              compare_(splice->prev_[i]->Key(), x->Key()) < 0);
       assert(splice->prev_[i]->Next(i) == splice->next_[i]);
       x->NoBarrier_SetNext(i, splice->next_[i]);
+      PersistLink(x, i);
       splice->prev_[i]->SetNext(i, x);
+      PersistLink(splice->prev_[i], i);
     }
   }
   if (splice_is_valid) {
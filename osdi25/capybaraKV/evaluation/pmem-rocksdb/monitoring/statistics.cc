@@ -186,6 +186,9 @@ const std::vector<std::pair<Tickers, std::string>> TickersNameMap = {
      "rocksdb.block.cache.compression.dict.add.redundant"},
     {FILES_MARKED_TRASH, "rocksdb.files.marked.trash"},
     {FILES_DELETED_IMMEDIATELY, "rocksdb.files.deleted.immediately"},
+    {DCPMM_KVS_BYTES_WRITTEN, "rocksdb.dcpmm.kvs.bytes.written"},
+    {DCPMM_KVS_BYTES_FREED, "rocksdb.dcpmm.kvs.bytes.freed"},
+    {DCPMM_KVS_INLINE_FALLBACKS, "rocksdb.dcpmm.kvs.inline.fallbacks"},
 };
 
 const std::vector<std::pair<Histograms, std::string>> HistogramsNameMap = {
@@ -476,7 +476,12 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       dcpmm_kvs_mmapped_file_fullpath(options.dcpmm_kvs_mmapped_file_fullpath),
       dcpmm_kvs_mmapped_file_size(options.dcpmm_kvs_mmapped_file_size),
       dcpmm_kvs_value_thres(options.dcpmm_kvs_value_thres),
-      dcpmm_compress_value(options.dcpmm_compress_value) 
+      dcpmm_compress_value(options.dcpmm_compress_value),
+      dcpmm_compression_type(options.dcpmm_compression_type),
+      dcpmm_kvs_migrate_ratio(options.dcpmm_kvs_migrate_ratio),
+      dcpmm_kvs_slowdown_ratio(options.dcpmm_kvs_slowdown_ratio),
+      dcpmm_memtable_dir(options.dcpmm_memtable_dir),
+      dcpmm_memtable_arena_size(options.dcpmm_memtable_arena_size)
       #endif 
       {}
 
@@ -99,6 +99,11 @@ struct ImmutableDBOptions {
   size_t dcpmm_kvs_mmapped_file_size;
   size_t dcpmm_kvs_value_thres;
   bool dcpmm_compress_value;
+  CompressionType dcpmm_compression_type;
+  double dcpmm_kvs_migrate_ratio;
+  double dcpmm_kvs_slowdown_ratio;
+  std::string dcpmm_memtable_dir;
+  size_t dcpmm_memtable_arena_size;
  #endif
 };
 
@@ -891,7 +891,26 @@ DEFINE_int64(dcpmm_kvs_mmapped_file_size, 1024 * 1024 * 1024,
 DEFINE_int64(dcpmm_kvs_value_thres, 64, "Use kvs for values larger than it. ");
 
 DEFINE_bool(dcpmm_compress_value, true,
-            "Compress the value in DCPMM with snappy. ");
+            "Compress the value in DCPMM. ");
+
+DEFINE_string(dcpmm_compression_type, "snappy",
+              "Algorithm to compress the value in DCPMM: snappy, lz4 or zstd");
+static enum ROCKSDB_NAMESPACE::CompressionType
+    FLAGS_dcpmm_compression_type_e = ROCKSDB_NAMESPACE::kSnappyCompression;
+
+DEFINE_double(dcpmm_kvs_migrate_ratio, 0.7,
+              "Migrate values out of DCPMM at every compaction once this "
+              "fraction of it is used. ");
+
+DEFINE_double(dcpmm_kvs_slowdown_ratio, 0.9,
+              "Delay writes once this fraction of DCPMM KVS space is used. ");
+
+DEFINE_string(dcpmm_memtable_dir, "",
+              "Build memtables in arena files in this DAX directory. ");
+
+DEFINE_uint64(dcpmm_memtable_arena_size, 0,
+              "Size of one memtable arena file, 0 for twice the write "
+              "buffer size. ");
 
 DEFINE_int32(trace_replay_fast_forward, 1,
              "Fast forward trace replay, must >= 1. ");
@@ -4128,6 +4147,11 @@ class Benchmark {
     options.dcpmm_kvs_mmapped_file_size = FLAGS_dcpmm_kvs_mmapped_file_size;
     options.dcpmm_kvs_value_thres = FLAGS_dcpmm_kvs_value_thres;
     options.dcpmm_compress_value = FLAGS_dcpmm_compress_value;
+    options.dcpmm_compression_type = FLAGS_dcpmm_compression_type_e;
+    options.dcpmm_kvs_migrate_ratio = FLAGS_dcpmm_kvs_migrate_ratio;
+    options.dcpmm_kvs_slowdown_ratio = FLAGS_dcpmm_kvs_slowdown_ratio;
+    options.dcpmm_memtable_dir = FLAGS_dcpmm_memtable_dir;
+    options.dcpmm_memtable_arena_size = FLAGS_dcpmm_memtable_arena_size;
 #endif
 
     options.listeners.emplace_back(listener_);
@@ -7115,6 +7139,8 @@ int db_bench_tool(int argc, char** argv) {
 
   FLAGS_compression_type_e =
       StringToCompressionType(FLAGS_compression_type.c_str());
+  FLAGS_dcpmm_compression_type_e =
+      StringToCompressionType(FLAGS_dcpmm_compression_type.c_str());
 
 #ifndef ROCKSDB_LITE
   FLAGS_blob_db_compression_type_e =
@@ -1,3 +1,15 @@
+// Contention benchmark for the lock primitives used by the stores and some alternatives.
+//
+// Build: g++ -std=c++17 -O2 -pthread sema.cpp -o sema
+// Usage: ./sema [--locks cceh,viper,rwlock,mcs,ticket,seqlock,percore] [--threads 1,2,4,8,16,32,64]
+//               [--reads 100,95,50,0] [--duration-ms 1000] [--words 8] [--sample 16]
+//
+// Every thread runs reads or writes of one shared record of --words words under the lock, picking a
+// write with probability 100 - reads percent. Every --sample-th operation is timed into a histogram
+// owned by the thread, so threads never share anything but the lock and the record while running.
+// The output is one CSV line per lock, read percentage and thread count.
+
+#include <algorithm>
 #include <atomic>
 #include <stdlib.h>
 #include <stdint.h>
@@ -6,52 +18,548 @@
 #include <vector>
 #include <chrono>
 #include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <sstream>
+#include <memory>
+#include <pthread.h>
+#include <immintrin.h>
 
 using namespace std;
 
-atomic<uint64_t> sema = 0;
-const int iters = 1000000;
-mutex timing_lock;
-vector<uint64_t> timing;
+constexpr size_t CACHE_LINE_SIZE = 64;
+constexpr size_t MAX_WORDS = 64;
+constexpr size_t MAX_THREADS = 256;
+
+static inline void cpu_relax() {
+    _mm_pause();
+}
+
+// The record protected by the lock. Optimistic readers may read it while it is written, so all
+// accesses are relaxed atomics and a torn copy is detected by comparing its words.
+struct alignas(CACHE_LINE_SIZE) Record {
+    atomic<uint64_t> words[MAX_WORDS];
+};
+
+// The segment lock of CCEH (viper/cceh.hpp). Inserts and gets share it by counting up, a split takes
+// it exclusively and sets SPLIT_REQUEST_BIT to keep new sharers out while it waits.
+struct CcehSema {
+    static constexpr uint64_t SPLIT_REQUEST_BIT = 1ul << 63;
+    static constexpr uint64_t EXCLUSIVE_LOCK = -1;
 
+    alignas(CACHE_LINE_SIZE) atomic<uint64_t> sema{0};
 
-void sema_cas(void) {
-    for (int i = 0; i < iters; i++) {
-        chrono::steady_clock::time_point begin = chrono::steady_clock::now();
-        auto v = sema.load();
-        sema.compare_exchange_weak(v, v+1);
+    template <typename Fn>
+    void read(size_t, Fn&& fn) {
+        uint64_t lock = sema.load();
+        while (true) {
+            if ((lock & SPLIT_REQUEST_BIT) != 0) {
+                // CCEH returns to the caller here, which retries the operation.
+                cpu_relax();
+                lock = sema.load();
+                continue;
+            }
+            if (sema.compare_exchange_weak(lock, lock + 1)) {
+                break;
+            }
+        }
+        fn();
         sema.fetch_sub(1);
-        chrono::steady_clock::time_point end = chrono::steady_clock::now();
-        auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
-        timing_lock.lock();
-        timing.push_back(time);
-        timing_lock.unlock();
     }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        while (true) {
+            uint64_t lock = sema.load();
+            if ((lock == 0 || lock == SPLIT_REQUEST_BIT) && sema.compare_exchange_strong(lock, EXCLUSIVE_LOCK)) {
+                break;
+            }
+            if (lock != EXCLUSIVE_LOCK && (lock & SPLIT_REQUEST_BIT) == 0) {
+                sema.compare_exchange_strong(lock, lock | SPLIT_REQUEST_BIT);
+            }
+            cpu_relax();
+        }
+        fn();
+        sema.store(0);
+    }
+};
+
+// The one byte version lock of ViperPage (viper/viper.hpp). Writers take the lock bit, readers are
+// optimistic and retry if the version changed while they read.
+struct ViperVersionLock {
+    using version_lock_t = uint8_t;
+    static constexpr version_lock_t CLIENT_BIT   = 0b10000000;
+    static constexpr version_lock_t USED_BIT     = 0b01000000;
+    static constexpr version_lock_t UNLOCKED_BIT = 0b11111110;
+
+    alignas(CACHE_LINE_SIZE) atomic<version_lock_t> version_lock{USED_BIT};
+
+    template <typename Fn>
+    void read(size_t, Fn&& fn) {
+        while (true) {
+            const version_lock_t lock_val = version_lock.load(memory_order_acquire);
+            if (lock_val & 1) {
+                cpu_relax();
+                continue;
+            }
+            fn();
+            if (lock_val == version_lock.load(memory_order_acquire)) {
+                return;
+            }
+        }
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        version_lock_t lock_value = version_lock.load(memory_order_acquire);
+        lock_value &= UNLOCKED_BIT;
+        while (!version_lock.compare_exchange_weak(lock_value, lock_value + 1)) {
+            lock_value &= UNLOCKED_BIT;
+        }
+        fn();
+        const version_lock_t current_version = version_lock.load(memory_order_acquire);
+        version_lock_t new_version = (current_version + 1) % USED_BIT;
+        new_version |= USED_BIT;
+        new_version |= (current_version & CLIENT_BIT);
+        version_lock.store(new_version, memory_order_release);
+    }
+};
+
+// Stands in for the std::sync::RwLock behind CapybaraKV's RwLockWithPredicate. Both are futex based
+// reader-writer locks, but Rust's prefers writers while glibc's prefers readers by default.
+struct SharedMutex {
+    shared_mutex mutex;
+
+    template <typename Fn>
+    void read(size_t, Fn&& fn) {
+        shared_lock<shared_mutex> guard{mutex};
+        fn();
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        unique_lock<shared_mutex> guard{mutex};
+        fn();
+    }
+};
+
+// Exclusive queue lock. Each waiter spins on its own node.
+struct McsLock {
+    struct alignas(CACHE_LINE_SIZE) Node {
+        atomic<Node*> next{nullptr};
+        atomic<bool> locked{false};
+    };
+
+    alignas(CACHE_LINE_SIZE) atomic<Node*> tail{nullptr};
+
+    template <typename Fn>
+    void read(size_t thread_id, Fn&& fn) {
+        write(thread_id, fn);
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        static thread_local Node node;
+        node.next.store(nullptr, memory_order_relaxed);
+        node.locked.store(true, memory_order_relaxed);
+        Node* prev = tail.exchange(&node, memory_order_acq_rel);
+        if (prev != nullptr) {
+            prev->next.store(&node, memory_order_release);
+            while (node.locked.load(memory_order_acquire)) {
+                cpu_relax();
+            }
+        }
+
+        fn();
+
+        Node* next = node.next.load(memory_order_acquire);
+        if (next == nullptr) {
+            Node* expected = &node;
+            if (tail.compare_exchange_strong(expected, nullptr, memory_order_acq_rel)) {
+                return;
+            }
+            while ((next = node.next.load(memory_order_acquire)) == nullptr) {
+                cpu_relax();
+            }
+        }
+        next->locked.store(false, memory_order_release);
+    }
+};
+
+// Exclusive FIFO lock. All waiters spin on the same line.
+struct TicketLock {
+    alignas(CACHE_LINE_SIZE) atomic<uint32_t> next_ticket{0};
+    atomic<uint32_t> now_serving{0};
+
+    template <typename Fn>
+    void read(size_t thread_id, Fn&& fn) {
+        write(thread_id, fn);
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        const uint32_t ticket = next_ticket.fetch_add(1, memory_order_relaxed);
+        while (now_serving.load(memory_order_acquire) != ticket) {
+            cpu_relax();
+        }
+        fn();
+        now_serving.store(ticket + 1, memory_order_release);
+    }
+};
+
+// Like the Viper version lock, but with a 64 bit sequence that cannot wrap and a fence that orders
+// the reads of the record before the second sequence load.
+struct SeqLock {
+    alignas(CACHE_LINE_SIZE) atomic<uint64_t> seq{0};
+
+    template <typename Fn>
+    void read(size_t, Fn&& fn) {
+        while (true) {
+            const uint64_t start_seq = seq.load(memory_order_acquire);
+            if (start_seq & 1) {
+                cpu_relax();
+                continue;
+            }
+            fn();
+            atomic_thread_fence(memory_order_acquire);
+            if (start_seq == seq.load(memory_order_relaxed)) {
+                return;
+            }
+        }
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        uint64_t current_seq = seq.load(memory_order_relaxed);
+        while ((current_seq & 1) || !seq.compare_exchange_weak(current_seq, current_seq + 1, memory_order_acquire)) {
+            cpu_relax();
+            current_seq = seq.load(memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_release);
+        fn();
+        seq.store(current_seq + 2, memory_order_release);
+    }
+};
+
+// Readers only touch the counter of their own core. Writers announce themselves and wait until all
+// counters drained, so reads are cheap and writes scale with the number of counters.
+struct PerCoreReaderLock {
+    static constexpr size_t NUM_COUNTERS = 64;
+
+    struct alignas(CACHE_LINE_SIZE) Counter {
+        atomic<uint64_t> readers{0};
+    };
+
+    alignas(CACHE_LINE_SIZE) atomic<bool> writer{false};
+    Counter counters[NUM_COUNTERS];
+
+    template <typename Fn>
+    void read(size_t thread_id, Fn&& fn) {
+        atomic<uint64_t>& readers = counters[thread_id % NUM_COUNTERS].readers;
+        while (true) {
+            readers.fetch_add(1);
+            if (!writer.load()) {
+                break;
+            }
+            readers.fetch_sub(1);
+            while (writer.load(memory_order_relaxed)) {
+                cpu_relax();
+            }
+        }
+        fn();
+        readers.fetch_sub(1, memory_order_release);
+    }
+
+    template <typename Fn>
+    void write(size_t, Fn&& fn) {
+        while (writer.exchange(true)) {
+            while (writer.load(memory_order_relaxed)) {
+                cpu_relax();
+            }
+        }
+        for (Counter& counter : counters) {
+            while (counter.readers.load() != 0) {
+                cpu_relax();
+            }
+        }
+        fn();
+        writer.store(false, memory_order_release);
+    }
+};
+
+// Log-linear latency histogram in nanoseconds with 16 sub-buckets per power of two.
+struct Histogram {
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t NUM_SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr size_t NUM_BUCKETS = 64 * NUM_SUB_BUCKETS;
+
+    vector<uint64_t> counts = vector<uint64_t>(NUM_BUCKETS, 0);
+    uint64_t max_value = 0;
+
+    static size_t bucket(uint64_t value) {
+        if (value < NUM_SUB_BUCKETS) {
+            return value;
+        }
+        const size_t msb = 63 - __builtin_clzll(value);
+        const size_t sub_bucket = (value >> (msb - SUB_BUCKET_BITS)) & (NUM_SUB_BUCKETS - 1);
+        return (msb - SUB_BUCKET_BITS + 1) * NUM_SUB_BUCKETS + sub_bucket;
+    }
+
+    static uint64_t lower_bound(size_t bucket) {
+        if (bucket < NUM_SUB_BUCKETS) {
+            return bucket;
+        }
+        const size_t msb = bucket / NUM_SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+        const uint64_t sub_bucket = bucket % NUM_SUB_BUCKETS;
+        return (1ul << msb) | (sub_bucket << (msb - SUB_BUCKET_BITS));
+    }
+
+    void record(uint64_t value) {
+        counts[bucket(value)]++;
+        max_value = max(max_value, value);
+    }
+
+    void merge(const Histogram& other) {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            counts[i] += other.counts[i];
+        }
+        max_value = max(max_value, other.max_value);
+    }
+
+    uint64_t percentile(double percent) const {
+        uint64_t total = 0;
+        for (uint64_t count : counts) {
+            total += count;
+        }
+        const uint64_t rank = total * percent / 100;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                return lower_bound(i);
+            }
+        }
+        return max_value;
+    }
+};
+
+struct alignas(CACHE_LINE_SIZE) ThreadResult {
+    Histogram latencies;
+    uint64_t num_ops = 0;
+    uint64_t num_torn_reads = 0;
+};
+
+struct Config {
+    vector<string> locks{"cceh", "viper", "rwlock", "mcs", "ticket", "seqlock", "percore"};
+    vector<size_t> threads{1, 2, 4, 8, 16, 32, 64};
+    vector<size_t> read_percentages{100, 95, 50, 0};
+    uint64_t duration_ms = 1000;
+    size_t num_words = 8;
+    size_t sample = 16;
+};
+
+static void pin_thread(size_t thread_id) {
+    const size_t num_cpus = max(1u, thread::hardware_concurrency());
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(thread_id % num_cpus, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
 }
 
-void run_benchmark(int num_threads) {
+template <typename Lock>
+void run_benchmark(const string& lock_name, const Config& config, size_t num_threads, size_t read_percentage) {
+    auto lock = make_unique<Lock>();
+    auto record = make_unique<Record>();
+    for (atomic<uint64_t>& word : record->words) {
+        word.store(0);
+    }
+    vector<ThreadResult> results(num_threads);
+    atomic<size_t> num_ready{0};
+    atomic<bool> start{false};
+    atomic<bool> stop{false};
+
+    auto worker = [&](size_t thread_id) {
+        pin_thread(thread_id);
+        ThreadResult& result = results[thread_id];
+        uint64_t rng = 0x9E3779B97F4A7C15ul * (thread_id + 1);
+        uint64_t snapshot[MAX_WORDS];
+
+        auto read_fn = [&] {
+            for (size_t i = 0; i < config.num_words; ++i) {
+                snapshot[i] = record->words[i].load(memory_order_relaxed);
+            }
+        };
+        auto write_fn = [&] {
+            for (size_t i = 0; i < config.num_words; ++i) {
+                record->words[i].store(record->words[i].load(memory_order_relaxed) + 1, memory_order_relaxed);
+            }
+        };
+
+        num_ready++;
+        while (!start.load(memory_order_acquire)) {
+            cpu_relax();
+        }
+
+        while (!stop.load(memory_order_relaxed)) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            const bool is_read = rng % 100 < read_percentage;
+            const bool is_sampled = result.num_ops % config.sample == 0;
+
+            chrono::steady_clock::time_point begin;
+            if (is_sampled) {
+                begin = chrono::steady_clock::now();
+            }
+            if (is_read) {
+                lock->read(thread_id, read_fn);
+            } else {
+                lock->write(thread_id, write_fn);
+            }
+            if (is_sampled) {
+                const chrono::steady_clock::time_point end = chrono::steady_clock::now();
+                result.latencies.record(chrono::duration_cast<chrono::nanoseconds>(end - begin).count());
+            }
+
+            if (is_read) {
+                for (size_t i = 1; i < config.num_words; ++i) {
+                    result.num_torn_reads += snapshot[i] != snapshot[0];
+                }
+            }
+            result.num_ops++;
+        }
+    };
+
     vector<thread> threads;
+    for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back(worker, i);
+    }
+    while (num_ready.load() < num_threads) {
+        this_thread::yield();
+    }
 
-    for (int i = 0; i < num_threads; i++) {
-        thread t(sema_cas); 
-        threads.push_back(move(t));
+    const chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    this_thread::sleep_for(chrono::milliseconds(config.duration_ms));
+    stop.store(true);
+    for (thread& t : threads) {
+        t.join();
     }
+    const chrono::steady_clock::time_point end = chrono::steady_clock::now();
 
-    for (int i = 0; i < num_threads; i++) {
-        threads[i].join();
+    Histogram latencies;
+    uint64_t num_ops = 0;
+    uint64_t num_torn_reads = 0;
+    for (const ThreadResult& result : results) {
+        latencies.merge(result.latencies);
+        num_ops += result.num_ops;
+        num_torn_reads += result.num_torn_reads;
     }
+    const double seconds = chrono::duration<double>(end - begin).count();
+
+    cout << lock_name << "," << num_threads << "," << read_percentage << "," << (num_ops / seconds / 1e6) << ","
+         << latencies.percentile(50) << "," << latencies.percentile(99) << "," << latencies.percentile(99.9) << ","
+         << latencies.max_value << "," << num_torn_reads << endl;
+}
+
+static void run_lock(const string& lock_name, const Config& config, size_t num_threads, size_t read_percentage) {
+    if (lock_name == "cceh") {
+        run_benchmark<CcehSema>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "viper") {
+        run_benchmark<ViperVersionLock>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "rwlock") {
+        run_benchmark<SharedMutex>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "mcs") {
+        run_benchmark<McsLock>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "ticket") {
+        run_benchmark<TicketLock>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "seqlock") {
+        run_benchmark<SeqLock>(lock_name, config, num_threads, read_percentage);
+    } else if (lock_name == "percore") {
+        run_benchmark<PerCoreReaderLock>(lock_name, config, num_threads, read_percentage);
+    } else {
+        cerr << "Unknown lock: " << lock_name << endl;
+        exit(1);
+    }
+}
+
+static vector<string> split_list(const string& list) {
+    vector<string> items;
+    stringstream stream{list};
+    string item;
+    while (getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
 
-    uint64_t sum = 0;
-    for (int i = 0; i < timing.size(); i++) {
-        sum += timing[i];
+static vector<size_t> split_numbers(const string& list) {
+    vector<size_t> numbers;
+    for (const string& item : split_list(list)) {
+        numbers.push_back(stoul(item));
     }
-    cout << "average time " << num_threads << " threads: " << sum / timing.size() << endl;
+    return numbers;
 }
 
-int main(void) {
-    run_benchmark(1);
-    run_benchmark(2);
-    run_benchmark(4);
-    run_benchmark(8);
-    run_benchmark(16);
-}
\ No newline at end of file
+static Config parse_args(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        const string arg = argv[i];
+        if (i + 1 >= argc) {
+            cerr << "Missing value for " << arg << endl;
+            exit(1);
+        }
+        const string value = argv[++i];
+        if (arg == "--locks") {
+            config.locks = split_list(value);
+        } else if (arg == "--threads") {
+            config.threads = split_numbers(value);
+        } else if (arg == "--reads") {
+            config.read_percentages = split_numbers(value);
+        } else if (arg == "--duration-ms") {
+            config.duration_ms = stoul(value);
+        } else if (arg == "--words") {
+            config.num_words = stoul(value);
+        } else if (arg == "--sample") {
+            config.sample = stoul(value);
+        } else {
+            cerr << "Unknown argument: " << arg << endl;
+            exit(1);
+        }
+    }
+
+    if (config.num_words == 0 || config.num_words > MAX_WORDS) {
+        cerr << "--words must be between 1 and " << MAX_WORDS << endl;
+        exit(1);
+    }
+    if (config.sample == 0) {
+        config.sample = 1;
+    }
+    for (size_t num_threads : config.threads) {
+        if (num_threads == 0 || num_threads > MAX_THREADS) {
+            cerr << "Thread counts must be between 1 and " << MAX_THREADS << endl;
+            exit(1);
+        }
+    }
+    for (size_t read_percentage : config.read_percentages) {
+        if (read_percentage > 100) {
+            cerr << "Read percentages must be at most 100" << endl;
+            exit(1);
+        }
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
+    const Config config = parse_args(argc, argv);
+    cout << "lock,threads,read_pct,mops,p50_ns,p99_ns,p999_ns,max_ns,torn_reads" << endl;
+    for (const string& lock_name : config.locks) {
+        for (size_t read_percentage : config.read_percentages) {
+            for (size_t num_threads : config.threads) {
+                run_lock(lock_name, config, num_threads, read_percentage);
+            }
+        }
+    }
+}
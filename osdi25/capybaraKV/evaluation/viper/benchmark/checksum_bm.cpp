@@ -0,0 +1,144 @@
+#include <benchmark/benchmark.h>
+
+#include "benchmark.hpp"
+#include "fixtures/viper_fixture.hpp"
+
+namespace viper::kv_bm {
+
+// Same record as ValueT, but stored by Viper with a per-record checksum.
+template <typename ValueT>
+struct ChecksummedValue : ValueT {
+    using ValueT::ValueT;
+};
+
+}  // namespace viper::kv_bm
+
+namespace viper {
+
+template <typename K, typename V>
+struct use_checksums<K, kv_bm::ChecksummedValue<V>> : std::true_type {};
+
+}  // namespace viper
+
+using namespace viper::kv_bm;
+
+constexpr size_t CHECKSUM_NUM_REPETITIONS = 1;
+constexpr size_t CHECKSUM_PREFILL_SIZE = 10 * (1000l * 1000 * 1000);
+constexpr size_t CHECKSUM_INSERT_SIZE = CHECKSUM_PREFILL_SIZE / 2;
+constexpr size_t CHECKSUM_NUM_FINDS = 50'000'000;
+constexpr size_t CHECKSUM_NUM_UPDATES = 50'000'000;
+
+#define GENERAL_ARGS \
+              Repetitions(CHECKSUM_NUM_REPETITIONS) \
+            ->Iterations(1) \
+            ->Unit(BM_TIME_UNIT) \
+            ->UseRealTime() \
+            ->Threads(36)
+
+#define DEFINE_BM_INTERNAL(method, KS, VS, ValueT, suffix) \
+        BENCHMARK_TEMPLATE2_DEFINE_F(ViperFixture, method ##_ ##KS ##_ ##VS ##suffix,  \
+                                     KeyType##KS, ValueT)(benchmark::State& state) { \
+            bm_##method(state, *this); \
+        } \
+        BENCHMARK_REGISTER_F(ViperFixture, method ##_ ##KS ##_ ##VS ##suffix)->GENERAL_ARGS
+
+#define DEFINE_BM_VARIANT(KS, VS, ValueT, suffix) \
+        DEFINE_BM_INTERNAL(insert, KS, VS, ValueT, suffix) \
+            ->Args({CHECKSUM_PREFILL_SIZE / (KS + VS), CHECKSUM_INSERT_SIZE / (KS + VS)}); \
+        DEFINE_BM_INTERNAL(get, KS, VS, ValueT, suffix) \
+            ->Args({CHECKSUM_PREFILL_SIZE / (KS + VS), CHECKSUM_NUM_FINDS}); \
+        DEFINE_BM_INTERNAL(update, KS, VS, ValueT, suffix) \
+            ->Args({CHECKSUM_PREFILL_SIZE / (KS + VS), CHECKSUM_NUM_UPDATES})
+
+// Each size runs once with plain records and once with checksummed records.
+#define DEFINE_BM(KS, VS) \
+        DEFINE_BM_VARIANT(KS, VS, ValueType##VS, ); \
+        DEFINE_BM_VARIANT(KS, VS, ChecksummedValue<ValueType##VS>, _crc)
+
+
+inline void bm_insert(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_inserts = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_inserts_per_thread = num_total_inserts / state.threads;
+    const uint64_t start_idx = (state.thread_index * num_inserts_per_thread) + num_total_prefill;
+    const uint64_t end_idx = start_idx + num_inserts_per_thread;
+
+    for (auto _ : state) {
+        fixture.setup_and_insert(start_idx, end_idx);
+    }
+
+    state.SetItemsProcessed(num_inserts_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+inline void bm_get(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_finds = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_finds_per_thread = num_total_finds / state.threads;
+    const uint64_t start_idx = 0;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    for (auto _ : state) {
+        fixture.setup_and_find(start_idx, end_idx, num_finds_per_thread);
+    }
+
+    state.SetItemsProcessed(num_finds_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+inline void bm_update(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_updates = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_updates_per_thread = num_total_updates / state.threads;
+    const uint64_t start_idx = 0;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    for (auto _ : state) {
+        fixture.setup_and_update(start_idx, end_idx, num_updates_per_thread);
+    }
+
+    state.SetItemsProcessed(num_updates_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+DEFINE_BM(  8,   8);
+DEFINE_BM( 16, 200);
+DEFINE_BM( 32, 500);
+DEFINE_BM(100, 900);
+
+
+int main(int argc, char** argv) {
+    std::string exec_name = argv[0];
+    const std::string arg = get_output_file("checksum/checksum");
+    return bm_main({exec_name, arg});
+}
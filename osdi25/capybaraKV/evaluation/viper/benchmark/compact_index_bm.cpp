@@ -0,0 +1,205 @@
+#include <benchmark/benchmark.h>
+
+#include "benchmark.hpp"
+#include "fixtures/viper_fixture.hpp"
+
+namespace viper::kv_bm {
+
+// Same key as KeyT, but indexed by Viper with cceh::CompactCCEH.
+template <typename KeyT>
+struct CompactKey : KeyT {
+    using KeyT::KeyT;
+};
+
+}  // namespace viper::kv_bm
+
+namespace viper {
+
+template <typename K, typename V>
+struct use_compact_index<kv_bm::CompactKey<K>, V> : std::true_type {};
+
+}  // namespace viper
+
+using namespace viper::kv_bm;
+
+constexpr size_t COMPACT_NUM_REPETITIONS = 1;
+constexpr size_t COMPACT_PREFILL_SIZE = 10 * (1000l * 1000 * 1000);
+constexpr size_t COMPACT_INSERT_SIZE = COMPACT_PREFILL_SIZE / 2;
+constexpr size_t COMPACT_NUM_FINDS = 50'000'000;
+constexpr size_t COMPACT_NUM_UPDATES = 50'000'000;
+constexpr size_t COMPACT_NUM_DELETES = 50'000'000;
+
+#define GENERAL_ARGS \
+              Repetitions(COMPACT_NUM_REPETITIONS) \
+            ->Iterations(1) \
+            ->Unit(BM_TIME_UNIT) \
+            ->UseRealTime() \
+            ->Threads(36)
+
+#define DEFINE_BM_INTERNAL(method, KS, VS, KeyT, suffix) \
+        BENCHMARK_TEMPLATE2_DEFINE_F(ViperFixture, method ##_ ##KS ##_ ##VS ##suffix,  \
+                                     KeyT, ValueType##VS)(benchmark::State& state) { \
+            bm_##method(state, *this); \
+        } \
+        BENCHMARK_REGISTER_F(ViperFixture, method ##_ ##KS ##_ ##VS ##suffix)->GENERAL_ARGS
+
+#define DEFINE_BM_VARIANT(KS, VS, KeyT, suffix) \
+        DEFINE_BM_INTERNAL(insert, KS, VS, KeyT, suffix) \
+            ->Args({COMPACT_PREFILL_SIZE / (KS + VS), COMPACT_INSERT_SIZE / (KS + VS)}); \
+        DEFINE_BM_INTERNAL(get, KS, VS, KeyT, suffix) \
+            ->Args({COMPACT_PREFILL_SIZE / (KS + VS), COMPACT_NUM_FINDS}); \
+        DEFINE_BM_INTERNAL(update, KS, VS, KeyT, suffix) \
+            ->Args({COMPACT_PREFILL_SIZE / (KS + VS), COMPACT_NUM_UPDATES}); \
+        DEFINE_BM_INTERNAL(delete, KS, VS, KeyT, suffix) \
+            ->Args({COMPACT_PREFILL_SIZE / (KS + VS), COMPACT_NUM_DELETES}); \
+        DEFINE_BM_INTERNAL(reinsert, KS, VS, KeyT, suffix) \
+            ->Args({COMPACT_PREFILL_SIZE / (KS + VS)})
+
+// Each size runs once with the default index and once with the compact index. Keys of 8 bytes or less are
+// stored inline in the index, so only larger keys use compact segments.
+#define DEFINE_BM(KS, VS) \
+        DEFINE_BM_VARIANT(KS, VS, KeyType##KS, ); \
+        DEFINE_BM_VARIANT(KS, VS, CompactKey<KeyType##KS>, _compact)
+
+
+inline void bm_insert(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_inserts = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_inserts_per_thread = num_total_inserts / state.threads;
+    const uint64_t start_idx = (state.thread_index * num_inserts_per_thread) + num_total_prefill;
+    const uint64_t end_idx = start_idx + num_inserts_per_thread;
+
+    for (auto _ : state) {
+        fixture.setup_and_insert(start_idx, end_idx);
+    }
+
+    state.SetItemsProcessed(num_inserts_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+inline void bm_get(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_finds = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_finds_per_thread = num_total_finds / state.threads;
+    const uint64_t start_idx = 0;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    for (auto _ : state) {
+        fixture.setup_and_find(start_idx, end_idx, num_finds_per_thread);
+    }
+
+    state.SetItemsProcessed(num_finds_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+inline void bm_update(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_updates = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_updates_per_thread = num_total_updates / state.threads;
+    const uint64_t start_idx = 0;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    for (auto _ : state) {
+        fixture.setup_and_update(start_idx, end_idx, num_updates_per_thread);
+    }
+
+    state.SetItemsProcessed(num_updates_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+inline void bm_delete(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_deletes = state.range(1);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+    }
+
+    const uint64_t num_deletes_per_thread = num_total_deletes / state.threads;
+    const uint64_t start_idx = 0;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    uint64_t found_counter = 0;
+    for (auto _ : state) {
+        found_counter = fixture.setup_and_delete(start_idx, end_idx, num_deletes_per_thread);
+    }
+
+    state.SetItemsProcessed(num_deletes_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+
+    // Random keys repeat, so not every delete finds its key.
+    BaseFixture::log_find_count(state, found_counter, found_counter);
+}
+
+// Puts all prefilled keys again after a random part of them was deleted, so the index updates present keys and
+// re-adds deleted ones in the same probe windows.
+inline void bm_reinsert(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap(num_total_prefill);
+        fixture.setup_and_delete(0, num_total_prefill - 1, num_total_prefill / 2);
+    }
+
+    const uint64_t num_inserts_per_thread = num_total_prefill / state.threads;
+    const uint64_t start_idx = state.thread_index * num_inserts_per_thread;
+    const uint64_t end_idx = start_idx + num_inserts_per_thread;
+
+    for (auto _ : state) {
+        fixture.setup_and_insert(start_idx, end_idx);
+    }
+
+    state.SetItemsProcessed(num_inserts_per_thread);
+
+    if (is_init_thread(state)) {
+        fixture.DeInitMap();
+    }
+}
+
+DEFINE_BM( 16, 200);
+DEFINE_BM( 32, 500);
+DEFINE_BM(100, 900);
+
+
+int main(int argc, char** argv) {
+    std::string exec_name = argv[0];
+    const std::string arg = get_output_file("compact_index/compact_index");
+    return bm_main({exec_name, arg});
+}
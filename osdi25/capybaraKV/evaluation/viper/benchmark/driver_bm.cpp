@@ -0,0 +1,414 @@
+#include <cctype>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <type_traits>
+
+#include <benchmark/benchmark.h>
+#include <hdr_histogram.h>
+
+#include "benchmark.hpp"
+#include "fixtures/common_fixture.hpp"
+#include "fixtures/viper_fixture.hpp"
+#include "fixtures/cceh_fixture.hpp"
+#include "fixtures/dash_fixture.hpp"
+#include "fixtures/faster_fixture.hpp"
+#include "fixtures/crl_fixture.hpp"
+#include "fixtures/tbb_fixture.hpp"
+#include "fixtures/pmem_kv_fixture.hpp"
+#include "fixtures/utree_fixture.hpp"
+#include "fixtures/ycsb_common.hpp"
+
+// Runs the same phases against any of the engines and writes all results into one report, so the
+// engines can be compared without a separate benchmark binary per engine and phase.
+//
+// driver_bm --engines=viper,dash --phases=insert,get,ycsb --threads=1,8,24 --kv-size=16:200 \
+//           --prefills=100000000 --ops=50000000 --workload=A --out=results.json --format=json
+//
+// Every run reports items_per_second, its wall time and the PMem it used. YCSB runs also report
+// HDR latency percentiles. With VIPER_BM_PERF set, runs also report hardware counters per op. Only
+// Viper runs YCSB records of any --kv-size, the other engines run the ycsb phase with 8 byte keys and
+// 200 byte values. Only Viper runs scans and read-modify-writes, so the other engines skip the ycsb
+// phase of workloads E and F.
+
+using namespace viper::kv_bm;
+
+using PhaseFn = std::function<void(benchmark::State&, BaseFixture&)>;
+
+struct DriverConfig {
+    std::vector<std::string> engines{"viper"};
+    std::vector<std::string> phases{"insert", "get", "update", "delete", "ycsb"};
+    std::vector<int> threads{1, static_cast<int>(NUM_MAX_THREADS)};
+    size_t key_size = 16;
+    size_t value_size = 200;
+    uint64_t num_prefills = NUM_PREFILLS;
+    uint64_t num_ops = NUM_OPS;
+    char workload = 'A';
+};
+
+static DriverConfig config;
+static std::unique_ptr<ycsb::Workload> workload;
+static uint64_t pmem_used_before = 0;
+
+template <typename FixtureT>
+class DriverBenchmark : public FixtureT {
+  public:
+    DriverBenchmark(const std::string& name, PhaseFn phase) : phase_{std::move(phase)} {
+        this->SetName(name.c_str());
+    }
+
+  protected:
+    void BenchmarkCase(benchmark::State& state) override {
+        phase_(state, *this);
+    }
+
+  private:
+    const PhaseFn phase_;
+};
+
+uint64_t pmem_used() {
+    // Devdax pools have no file system to ask and are reported as 0.
+    std::error_code ec;
+    const std::filesystem::space_info space = std::filesystem::space(DB_PMEM_DIR, ec);
+    return ec ? 0 : space.capacity - space.free;
+}
+
+void init_phase(benchmark::State& state, BaseFixture& fixture, uint64_t num_prefills) {
+    set_cpu_affinity(state.thread_index);
+    if (is_init_thread(state)) {
+        pmem_used_before = pmem_used();
+        fixture.InitMap(num_prefills);
+    }
+}
+
+void deinit_phase(benchmark::State& state, BaseFixture& fixture, std::chrono::nanoseconds duration,
+                  uint64_t num_ops_per_thread) {
+    state.counters["phase-ns"] = duration.count();
+    if (is_init_thread(state)) {
+        // Usage can drop during a run, e.g., when Viper reclaims blocks, so the difference is signed.
+        state.counters["pmem_used_bytes"] =
+            static_cast<int64_t>(pmem_used()) - static_cast<int64_t>(pmem_used_before);
+        fixture.log_perf_counters(state, num_ops_per_thread * state.threads);
+        fixture.DeInitMap();
+    }
+}
+
+void bm_insert(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_inserts = state.range(1);
+    init_phase(state, fixture, num_total_prefill);
+
+    const uint64_t num_inserts_per_thread = num_total_inserts / state.threads;
+    const uint64_t start_idx = (state.thread_index * num_inserts_per_thread) + num_total_prefill;
+    const uint64_t end_idx = start_idx + num_inserts_per_thread;
+
+    uint64_t insert_counter = 0;
+    std::chrono::nanoseconds duration{};
+    PerfCounters perf;
+    for (auto _ : state) {
+        auto start_op = std::chrono::high_resolution_clock::now();
+        perf.start();
+        insert_counter = fixture.setup_and_insert(start_idx, end_idx);
+        perf.stop();
+        duration = std::chrono::high_resolution_clock::now() - start_op;
+        fixture.merge_perf(perf);
+    }
+
+    state.SetItemsProcessed(num_inserts_per_thread);
+    deinit_phase(state, fixture, duration, num_inserts_per_thread);
+    BaseFixture::log_find_count(state, insert_counter, num_inserts_per_thread);
+}
+
+void bm_get(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_finds = state.range(1);
+    init_phase(state, fixture, num_total_prefill);
+
+    const uint64_t num_finds_per_thread = num_total_finds / state.threads;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    uint64_t found_counter = 0;
+    std::chrono::nanoseconds duration{};
+    PerfCounters perf;
+    for (auto _ : state) {
+        auto start_op = std::chrono::high_resolution_clock::now();
+        perf.start();
+        found_counter = fixture.setup_and_find(0, end_idx, num_finds_per_thread);
+        perf.stop();
+        duration = std::chrono::high_resolution_clock::now() - start_op;
+        fixture.merge_perf(perf);
+    }
+
+    state.SetItemsProcessed(num_finds_per_thread);
+    deinit_phase(state, fixture, duration, num_finds_per_thread);
+    BaseFixture::log_find_count(state, found_counter, num_finds_per_thread);
+}
+
+void bm_update(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_updates = state.range(1);
+    init_phase(state, fixture, num_total_prefill);
+
+    const uint64_t num_updates_per_thread = num_total_updates / state.threads;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    uint64_t update_counter = 0;
+    std::chrono::nanoseconds duration{};
+    PerfCounters perf;
+    for (auto _ : state) {
+        auto start_op = std::chrono::high_resolution_clock::now();
+        perf.start();
+        update_counter = fixture.setup_and_update(0, end_idx, num_updates_per_thread);
+        perf.stop();
+        duration = std::chrono::high_resolution_clock::now() - start_op;
+        fixture.merge_perf(perf);
+    }
+
+    state.SetItemsProcessed(num_updates_per_thread);
+    deinit_phase(state, fixture, duration, num_updates_per_thread);
+    BaseFixture::log_find_count(state, update_counter, num_updates_per_thread);
+}
+
+void bm_delete(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_deletes = state.range(1);
+    init_phase(state, fixture, num_total_prefill);
+
+    const uint64_t num_deletes_per_thread = num_total_deletes / state.threads;
+    const uint64_t end_idx = num_total_prefill - state.threads;
+
+    uint64_t found_counter = 0;
+    std::chrono::nanoseconds duration{};
+    PerfCounters perf;
+    for (auto _ : state) {
+        auto start_op = std::chrono::high_resolution_clock::now();
+        perf.start();
+        found_counter = fixture.setup_and_delete(0, end_idx, num_deletes_per_thread);
+        perf.stop();
+        duration = std::chrono::high_resolution_clock::now() - start_op;
+        fixture.merge_perf(perf);
+    }
+
+    state.SetItemsProcessed(found_counter);
+    deinit_phase(state, fixture, duration, num_deletes_per_thread);
+    BaseFixture::log_find_count(state, found_counter, found_counter);
+}
+
+// Viper runs YCSB records of every key and value size, the other fixtures only ycsb::Record.
+template <typename KeyT, typename ValueT>
+uint64_t run_ycsb_batch(BaseFixture& fixture, const std::vector<ycsb::BasicRecord<KeyT, ValueT>>& batch,
+                        hdr_histogram* hdr) {
+    if constexpr (std::is_same_v<ycsb::BasicRecord<KeyT, ValueT>, ycsb::Record>) {
+        return fixture.run_ycsb(0, batch.size(), batch, hdr);
+    } else {
+        return dynamic_cast<ViperFixture<KeyT, ValueT>&>(fixture).run_ycsb_records(0, batch.size(), batch, hdr);
+    }
+}
+
+template <typename KeyT, typename ValueT>
+void bm_ycsb(benchmark::State& state, BaseFixture& fixture) {
+    const uint64_t num_total_prefill = state.range(0);
+    const uint64_t num_total_ops = state.range(1);
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        pmem_used_before = pmem_used();
+        fixture.InitMap();
+        workload = std::make_unique<ycsb::Workload>(ycsb::WorkloadSpec::core(config.workload, num_total_prefill));
+        fixture.prefill_ycsb_generated(num_total_prefill);
+        hdr_init(1, 1000000000, 4, &fixture.hdr_);
+    }
+
+    hdr_histogram* hdr;
+    hdr_init(1, 1000000000, 4, &hdr);
+
+    static constexpr size_t BATCH_SIZE = 1024;
+    std::vector<ycsb::BasicRecord<KeyT, ValueT>> batch(BATCH_SIZE);
+    const uint64_t num_ops_per_thread = num_total_ops / state.threads;
+    uint64_t op_counter = 0;
+    std::chrono::nanoseconds duration{};
+    PerfCounters perf;
+    for (auto _ : state) {
+        auto start_op = std::chrono::high_resolution_clock::now();
+        perf.start();
+        ycsb::Generator generator{*workload, state.thread_index + 1ul};
+        for (uint64_t op_num = 0; op_num < num_ops_per_thread; op_num += batch.size()) {
+            batch.resize(std::min<uint64_t>(BATCH_SIZE, num_ops_per_thread - op_num));
+            generator.fill(&batch);
+            op_counter += run_ycsb_batch(fixture, batch, hdr);
+            generator.acknowledge_inserts();
+        }
+        perf.stop();
+        duration = std::chrono::high_resolution_clock::now() - start_op;
+        fixture.merge_perf(perf);
+        fixture.merge_hdr(hdr);
+        hdr_close(hdr);
+    }
+
+    state.SetItemsProcessed(num_ops_per_thread);
+    if (is_init_thread(state)) {
+        hdr_histogram* global_hdr = fixture.get_hdr();
+        state.counters["hdr_max"] = hdr_max(global_hdr);
+        state.counters["hdr_avg"] = hdr_mean(global_hdr);
+        state.counters["hdr_min"] = hdr_min(global_hdr);
+        state.counters["hdr_std"] = hdr_stddev(global_hdr);
+        state.counters["hdr_median"] = hdr_value_at_percentile(global_hdr, 50.0);
+        state.counters["hdr_90"] = hdr_value_at_percentile(global_hdr, 90.0);
+        state.counters["hdr_95"] = hdr_value_at_percentile(global_hdr, 95.0);
+        state.counters["hdr_99"] = hdr_value_at_percentile(global_hdr, 99.0);
+        state.counters["hdr_999"] = hdr_value_at_percentile(global_hdr, 99.9);
+        state.counters["hdr_9999"] = hdr_value_at_percentile(global_hdr, 99.99);
+        hdr_close(global_hdr);
+        workload.reset();
+    }
+    deinit_phase(state, fixture, duration, num_ops_per_thread);
+    BaseFixture::log_find_count(state, op_counter, num_ops_per_thread);
+}
+
+template <template <typename, typename> typename FixtureT, typename KeyT, typename ValueT>
+void register_phase(const std::string& engine, const std::string& phase, PhaseFn phase_fn) {
+    const std::string name = engine + "/" + phase + "/" + std::to_string(sizeof(KeyT)) + "_"
+        + std::to_string(sizeof(ValueT));
+    auto* bm = benchmark::internal::RegisterBenchmarkInternal(
+        new DriverBenchmark<FixtureT<KeyT, ValueT>>(name, std::move(phase_fn)));
+    bm->Args({(int64_t) config.num_prefills, (int64_t) config.num_ops})
+      ->Iterations(1)
+      ->Unit(BM_TIME_UNIT)
+      ->UseRealTime();
+    for (const int num_threads : config.threads) {
+        bm->Threads(num_threads);
+    }
+}
+
+// Only ViperFixture::run_ycsb() handles SCAN and READ_MODIFY_WRITE. The other fixtures throw on them from within
+// the benchmark threads, so workloads E and F are not registered for them.
+bool uses_scan_or_rmw(const char workload) {
+    const ycsb::WorkloadSpec spec = ycsb::WorkloadSpec::core(workload);
+    return spec.scan_proportion > 0 || spec.read_modify_write_proportion > 0;
+}
+
+template <template <typename, typename> typename FixtureT, typename KeyT, typename ValueT>
+void register_engine(const std::string& engine) {
+    for (const std::string& phase : config.phases) {
+        if (phase == "insert") register_phase<FixtureT, KeyT, ValueT>(engine, phase, bm_insert);
+        else if (phase == "get") register_phase<FixtureT, KeyT, ValueT>(engine, phase, bm_get);
+        else if (phase == "update") register_phase<FixtureT, KeyT, ValueT>(engine, phase, bm_update);
+        else if (phase == "delete") register_phase<FixtureT, KeyT, ValueT>(engine, phase, bm_delete);
+        else if (phase == "ycsb") {
+            if constexpr (std::is_same_v<FixtureT<KeyT, ValueT>, ViperFixture<KeyT, ValueT>>) {
+                register_phase<FixtureT, KeyT, ValueT>(engine, phase, bm_ycsb<KeyT, ValueT>);
+            } else if (uses_scan_or_rmw(config.workload)) {
+                std::cerr << "Skipping " << engine << "/ycsb: only Viper runs the SCAN and READ_MODIFY_WRITE "
+                          << "operations of workload " << config.workload << "." << std::endl;
+            } else {
+                register_phase<FixtureT, KeyType8, ValueType200>(engine, phase, bm_ycsb<KeyType8, ValueType200>);
+            }
+        }
+        else throw std::runtime_error("Unknown phase: " + phase);
+    }
+}
+
+template <typename KeyT, typename ValueT>
+void register_engines() {
+    for (const std::string& engine : config.engines) {
+        if (engine == "viper") register_engine<ViperFixture, KeyT, ValueT>(engine);
+        else if (engine == "cceh") register_engine<CcehFixture, KeyT, ValueT>(engine);
+        else if (engine == "dash") register_engine<DashFixture, KeyT, ValueT>(engine);
+        else if (engine == "faster") register_engine<PmemHybridFasterFixture, KeyT, ValueT>(engine);
+        else if (engine == "crl") register_engine<CrlFixture, KeyT, ValueT>(engine);
+        else if (engine == "tbb") register_engine<TbbFixture, KeyT, ValueT>(engine);
+        else if (engine == "pmemkv") register_engine<PmemKVFixture, KeyT, ValueT>(engine);
+        else if (engine == "utree") register_engine<UTreeFixture, KeyT, ValueT>(engine);
+        else throw std::runtime_error("Unknown engine: " + engine);
+    }
+}
+
+void register_all() {
+    const std::string kv_size = std::to_string(config.key_size) + ":" + std::to_string(config.value_size);
+    if (kv_size == "8:8") register_engines<KeyType8, ValueType8>();
+    else if (kv_size == "8:200") register_engines<KeyType8, ValueType200>();
+    else if (kv_size == "16:200") register_engines<KeyType16, ValueType200>();
+    else if (kv_size == "32:500") register_engines<KeyType32, ValueType500>();
+    else if (kv_size == "100:900") register_engines<KeyType100, ValueType900>();
+    else throw std::runtime_error("Unsupported key/value size " + kv_size
+                                  + ", use one of 8:8, 8:200, 16:200, 32:500, 100:900");
+}
+
+std::vector<std::string> split(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream ss{list};
+    for (std::string item; std::getline(ss, item, ',');) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Parses --kv-size=<key size>:<value size>. A malformed size is an error instead of a silent default.
+void parse_kv_size(const std::string& value) {
+    const std::string usage = "Usage: --kv-size=<key size>:<value size>, e.g., --kv-size=16:200. Got: " + value;
+    const size_t colon = value.find(':');
+    if (colon == std::string::npos) {
+        throw std::runtime_error(usage);
+    }
+
+    const std::string key_size = value.substr(0, colon);
+    const std::string value_size = value.substr(colon + 1);
+    size_t key_end = 0;
+    size_t value_end = 0;
+    try {
+        config.key_size = std::stoul(key_size, &key_end);
+        config.value_size = std::stoul(value_size, &value_end);
+    } catch (const std::logic_error&) {
+        throw std::runtime_error(usage);
+    }
+    if (key_end != key_size.size() || value_end != value_size.size()) {
+        throw std::runtime_error(usage);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::vector<std::string> bm_args{argv[0]};
+    std::string out_file = get_output_file("driver/driver");
+    std::string out_format = "json";
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{argv[i]};
+        const size_t eq = arg.find('=');
+        const std::string flag = arg.substr(0, eq);
+        const std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+
+        if (flag == "--engines") {
+            config.engines = split(value);
+        } else if (flag == "--phases") {
+            config.phases = split(value);
+        } else if (flag == "--threads") {
+            config.threads.clear();
+            for (const std::string& num_threads : split(value)) {
+                config.threads.push_back(std::stoi(num_threads));
+            }
+        } else if (flag == "--kv-size") {
+            parse_kv_size(value);
+        } else if (flag == "--prefills") {
+            config.num_prefills = std::stoull(value);
+        } else if (flag == "--ops") {
+            config.num_ops = std::stoull(value);
+        } else if (flag == "--workload") {
+            config.workload = value.empty() ? 'A' : std::toupper(value[0]);
+            ycsb::WorkloadSpec::core(config.workload);
+        } else if (flag == "--out") {
+            out_file = "--benchmark_out=" + value;
+        } else if (flag == "--format") {
+            out_format = value;
+        } else {
+            // Everything else goes to google benchmark, e.g., --benchmark_filter.
+            bm_args.push_back(arg);
+        }
+    }
+
+    register_all();
+    bm_args.push_back(out_file);
+    bm_args.push_back("--benchmark_out_format=" + out_format);
+    return bm_main(bm_args);
+}
@@ -1,8 +1,10 @@
 #include "common_fixture.hpp"
 #include "ycsb_common.hpp"
 #include <fcntl.h>
+#include <fstream>
 #include <sys/mman.h>
 #include <thread>
+#include <tuple>
 #include <unordered_set>
 
 namespace viper::kv_bm {
@@ -32,6 +34,24 @@ void BaseFixture::log_find_count(benchmark::State& state, uint64_t num_found, ui
     }
 }
 
+void BaseFixture::log_perf_counters(benchmark::State& state, const uint64_t num_ops) {
+    for (size_t event = 0; event < PerfCounters::NUM_EVENTS; ++event) {
+        const int64_t count = perf_counts_[event];
+        if (count < 0) {
+            continue;
+        }
+        const std::string name = PerfCounters::EVENT_NAMES[event];
+        state.counters[name] = count;
+        state.counters[name + "_per_op"] = num_ops == 0 ? 0 : static_cast<double>(count) / num_ops;
+    }
+    const int64_t cycles = perf_counts_[PerfCounters::CYCLES];
+    const int64_t instructions = perf_counts_[PerfCounters::INSTRUCTIONS];
+    if (cycles > 0 && instructions >= 0) {
+        state.counters["ipc"] = static_cast<double>(instructions) / cycles;
+    }
+    perf_counts_ = PerfCounters::empty_counts();
+}
+
 template <typename PrefillFn>
 void BaseFixture::prefill_internal(const size_t num_prefills, PrefillFn prefill_fn) {
 #ifndef NDEBUG
@@ -86,6 +106,24 @@ void BaseFixture::prefill_ycsb(const std::vector<ycsb::Record>& data) {
     prefill_internal(num_prefills, prefill_fn);
 }
 
+void BaseFixture::prefill_ycsb_generated(const uint64_t num_records) {
+    auto prefill_fn = [this](const size_t start, const size_t end) {
+        this->load_ycsb_generated(start, end);
+    };
+
+    prefill_internal(num_records, prefill_fn);
+}
+
+void BaseFixture::load_ycsb_generated(const uint64_t start_id, const uint64_t end_id) {
+    static constexpr size_t BATCH_SIZE = 1024;
+    std::vector<ycsb::Record> batch(BATCH_SIZE);
+    for (uint64_t id = start_id; id < end_id; id += BATCH_SIZE) {
+        batch.resize(std::min<uint64_t>(BATCH_SIZE, end_id - id));
+        ycsb::Generator::fill_load(id, &batch);
+        this->run_ycsb(0, batch.size(), batch, nullptr);
+    }
+}
+
 void BaseFixture::generate_strings(size_t num_strings, size_t key_size, size_t value_size) {
     static const char alphabet[] =
         "abcdefghijklmnopqrstuvwxyz"
@@ -169,10 +207,77 @@ bool is_init_thread(const benchmark::State& state) {
     return state.threads == 1 || state.thread_index == 1;
 }
 
+// Parse a sysfs CPU list such as "0-17,36-53".
+static std::vector<int> read_cpu_list(const std::filesystem::path& file) {
+    std::vector<int> cpus;
+    std::ifstream ifs{file};
+    std::string range;
+    while (std::getline(ifs, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+static int read_int(const std::filesystem::path& file, const int default_value) {
+    std::ifstream ifs{file};
+    int value;
+    return (ifs >> value) ? value : default_value;
+}
+
+const CpuTopology& CpuTopology::get() {
+    static const CpuTopology topology = [] {
+        const std::filesystem::path cpu_dir{"/sys/devices/system/cpu"};
+        const std::filesystem::path node_dir{"/sys/devices/system/node"};
+
+        CpuTopology topology{};
+        std::vector<int> online_cpus = read_cpu_list(cpu_dir / "online");
+        if (online_cpus.empty()) {
+            for (int cpu = 0; cpu < static_cast<int>(std::thread::hardware_concurrency()); ++cpu) {
+                online_cpus.push_back(cpu);
+            }
+        }
+        topology.cpu_nodes.assign(online_cpus.back() + 1, 0);
+
+        for (int node = 0; std::filesystem::exists(node_dir / ("node" + std::to_string(node))); ++node) {
+            for (const int cpu : read_cpu_list(node_dir / ("node" + std::to_string(node)) / "cpulist")) {
+                if (cpu < topology.cpu_nodes.size()) {
+                    topology.cpu_nodes[cpu] = node;
+                }
+            }
+            topology.num_nodes = node + 1;
+        }
+
+        // (socket, hardware thread within core, node, cpu)
+        std::vector<std::tuple<int, int, int, int>> order;
+        for (const int cpu : online_cpus) {
+            const std::filesystem::path cpu_topology = cpu_dir / ("cpu" + std::to_string(cpu)) / "topology";
+            const int socket = read_int(cpu_topology / "physical_package_id", 0);
+            const std::vector<int> siblings = read_cpu_list(cpu_topology / "thread_siblings_list");
+            const int hw_thread = std::find(siblings.begin(), siblings.end(), cpu) - siblings.begin();
+            order.emplace_back(socket, siblings.empty() ? 0 : hw_thread, topology.cpu_nodes[cpu], cpu);
+        }
+        std::sort(order.begin(), order.end());
+        for (const auto& [socket, hw_thread, node, cpu] : order) {
+            topology.cpus.push_back(cpu);
+        }
+        return topology;
+    }();
+    return topology;
+}
+
 void set_cpu_affinity(const uint16_t from, const uint16_t to) {
+    const std::vector<int>& cpus = CpuTopology::get().cpus;
     const uint16_t from_cpu = from + CPU_AFFINITY_OFFSET;
     const uint16_t to_cpu = to + CPU_AFFINITY_OFFSET;
-    if (from_cpu >= CPUS.size() || to_cpu > CPUS.size() || from < 0 || to < 0 || to < from) {
+    if (from_cpu >= cpus.size() || to_cpu > cpus.size() || from < 0 || to < 0 || to < from) {
         throw std::runtime_error("Thread range invalid! " +
                                  std::to_string(from) + " -> " + std::to_string(to) + " with cpu offset "
                                  + std::to_string(CPU_AFFINITY_OFFSET));
@@ -182,7 +287,7 @@ void set_cpu_affinity(const uint16_t from, const uint16_t to) {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
     for (int cpu = from_cpu; cpu < to_cpu; ++cpu) {
-        CPU_SET(CPUS[cpu], &cpuset);
+        CPU_SET(cpus[cpu], &cpuset);
     }
     int rc = pthread_setaffinity_np(native_thread_handle, sizeof(cpu_set_t), &cpuset);
     if (rc != 0) {
@@ -193,8 +298,8 @@ void set_cpu_affinity(const uint16_t from, const uint16_t to) {
 void set_cpu_affinity() {
     cpu_set_t cpuset;
     CPU_ZERO(&cpuset);
-    for (int cpu = 0; cpu < CPUS.size(); ++cpu) {
-        CPU_SET(CPUS[cpu], &cpuset);
+    for (const int cpu : CpuTopology::get().cpus) {
+        CPU_SET(cpu, &cpuset);
     }
     int rc = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
     if (rc != 0) {
@@ -13,21 +13,21 @@
 #include <thread>
 
 #include "../benchmark.hpp"
+#include "perf_counters.hpp"
 #include "ycsb_common.hpp"
 
 namespace viper::kv_bm {
 
-static constexpr std::array CPUS {
-    // CPU 1
-     0,  1,  2,  5,  6,  9, 10, 14, 15, // NUMA NODE 0
-     3,  4,  7,  8, 11, 12, 13, 16, 17, // NUMA NODE 1
-    36, 37, 38, 41, 42, 45, 46, 50, 51, // NUMA NODE 0
-    39, 40, 43, 44, 47, 48, 49, 52, 53, // NUMA NODE 1
-    // CPU 2
-    18, 19, 20, 23, 24, 27, 28, 32, 33, // NUMA NODE 2
-    21, 22, 25, 26, 29, 30, 31, 34, 35, // NUMA NODE 3
-    54, 55, 56, 59, 60, 63, 64, 68, 69, // NUMA NODE 2
-    57, 58, 61, 62, 65, 66, 67, 70, 71  // NUMA NODE 3
+// CPU and NUMA layout of this host, read from sysfs.
+struct CpuTopology {
+    // Threads are pinned in this order: socket by socket, first one hardware thread per core grouped by
+    // NUMA node, then the remaining hardware threads in the same order.
+    std::vector<int> cpus;
+    // NUMA node of each CPU id.
+    std::vector<int> cpu_nodes;
+    int num_nodes = 1;
+
+    static const CpuTopology& get();
 };
 
 bool is_init_thread(const benchmark::State& state);
@@ -55,6 +55,10 @@ class BaseFixture : public benchmark::Fixture {
 
     void prefill(size_t num_prefills);
     virtual void prefill_ycsb(const std::vector<ycsb::Record>& data);
+    // Load records 0..num_records - 1 of a generated workload, without materializing them.
+    void prefill_ycsb_generated(uint64_t num_records);
+    // Load records start_id..end_id - 1 of a generated workload. The default runs ycsb::Records.
+    virtual void load_ycsb_generated(uint64_t start_id, uint64_t end_id);
 
     void generate_strings(size_t num_strings, size_t key_size, size_t value_size);
 
@@ -77,6 +81,16 @@ class BaseFixture : public benchmark::Fixture {
     hdr_histogram* get_hdr() { return hdr_; }
     hdr_histogram* hdr_ = nullptr;
 
+    // Call from within the benchmark loop, so all threads have merged before the init thread logs.
+    void merge_perf(const PerfCounters& other) {
+        std::lock_guard lock{hdr_lock_};
+        other.add_to(&perf_counts_);
+    }
+
+    // Log the merged counters, in total and per operation, and reset them for the next run.
+    void log_perf_counters(benchmark::State& state, uint64_t num_ops);
+    PerfCounters::Counts perf_counts_ = PerfCounters::empty_counts();
+
     static void log_find_count(benchmark::State& state, const uint64_t num_found, const uint64_t num_expected);
 
   protected:
@@ -0,0 +1,122 @@
+#include "perf_counters.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace viper::kv_bm {
+
+namespace {
+
+struct EventConfig {
+    uint32_t type;
+    uint64_t config;
+};
+
+constexpr std::array<EventConfig, PerfCounters::NUM_EVENTS> EVENT_CONFIGS{{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                         | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_STALLED_CYCLES_BACKEND},
+}};
+
+int open_event(const EventConfig& event) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    // Count the calling thread on any CPU. Retry without kernel time if we may only count user space.
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd < 0 && (errno == EACCES || errno == EPERM)) {
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return fd;
+}
+
+}  // namespace
+
+bool PerfCounters::enabled() {
+    static const bool enabled = std::getenv("VIPER_BM_PERF") != nullptr;
+    return enabled;
+}
+
+PerfCounters::Counts PerfCounters::empty_counts() {
+    Counts counts;
+    counts.fill(-1);
+    return counts;
+}
+
+PerfCounters::PerfCounters() {
+    fds_.fill(-1);
+    if (!enabled()) {
+        return;
+    }
+    for (size_t event = 0; event < NUM_EVENTS; ++event) {
+        fds_[event] = open_event(EVENT_CONFIGS[event]);
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void PerfCounters::start() {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+void PerfCounters::stop() {
+    for (const int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+}
+
+PerfCounters::Counts PerfCounters::read() const {
+    Counts counts = empty_counts();
+    for (size_t event = 0; event < NUM_EVENTS; ++event) {
+        // value, time enabled, time running
+        uint64_t data[3];
+        if (fds_[event] < 0 || ::read(fds_[event], data, sizeof(data)) != sizeof(data)) {
+            continue;
+        }
+        if (data[2] == 0) {
+            counts[event] = 0;
+        } else {
+            counts[event] = static_cast<int64_t>(static_cast<double>(data[0]) * data[1] / data[2]);
+        }
+    }
+    return counts;
+}
+
+void PerfCounters::add_to(Counts* total) const {
+    const Counts counts = read();
+    for (size_t event = 0; event < NUM_EVENTS; ++event) {
+        if (counts[event] >= 0) {
+            (*total)[event] = std::max<int64_t>((*total)[event], 0) + counts[event];
+        }
+    }
+}
+
+}  // namespace viper::kv_bm
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace viper::kv_bm {
+
+// Hardware performance counters of the calling thread, read through perf_event_open. They are
+// only opened if VIPER_BM_PERF is set in the environment. Events that cannot be opened, e.g.,
+// because the CPU lacks them or perf_event_paranoid forbids them, are left out.
+class PerfCounters {
+  public:
+    enum Event { CYCLES = 0, INSTRUCTIONS, LLC_MISSES, DTLB_MISSES, STALLED_CYCLES, NUM_EVENTS };
+    static constexpr std::array<const char*, NUM_EVENTS> EVENT_NAMES{
+        "cycles", "instructions", "llc_misses", "dtlb_misses", "stalled_cycles"};
+
+    // Sum of the counts of several threads. -1 means the event was not counted.
+    using Counts = std::array<int64_t, NUM_EVENTS>;
+
+    PerfCounters();
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    static bool enabled();
+    static Counts empty_counts();
+
+    void start();
+    void stop();
+
+    // Counts since start(), scaled up if the kernel multiplexed the counters.
+    Counts read() const;
+
+    // Add the counts of this thread to total.
+    void add_to(Counts* total) const;
+
+  private:
+    std::array<int, NUM_EVENTS> fds_;
+};
+
+}  // namespace viper::kv_bm
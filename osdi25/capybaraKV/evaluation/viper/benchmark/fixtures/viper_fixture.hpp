@@ -1,5 +1,7 @@
 #pragma once
 
+#include <sstream>
+
 #include "../benchmark.hpp"
 #include "common_fixture.hpp"
 #include "viper/viper.hpp"
@@ -30,6 +32,10 @@ class ViperFixture : public BaseFixture {
 
     uint64_t run_ycsb(uint64_t start_idx, uint64_t end_idx,
         const std::vector<ycsb::Record>& data, hdr_histogram* hdr) final;
+    // Same as run_ycsb(), for records of the fixture's key and value size.
+    uint64_t run_ycsb_records(uint64_t start_idx, uint64_t end_idx,
+        const std::vector<ycsb::BasicRecord<KeyT, ValueT>>& data, hdr_histogram* hdr);
+    void load_ycsb_generated(uint64_t start_id, uint64_t end_id) final;
 
     ViperT* getViper() {
         return viper_.get();
@@ -38,7 +44,7 @@ class ViperFixture : public BaseFixture {
   protected:
     std::unique_ptr<ViperT> viper_;
     bool viper_initialized_ = false;
-    std::string pool_file_;
+    std::vector<std::string> pool_files_;
 };
 
 template <typename KeyT, typename ValueT>
@@ -47,7 +53,10 @@ void ViperFixture<KeyT, ValueT>::InitMap(uint64_t num_prefill_inserts, const boo
         return;
     }
 
-    return InitMap(num_prefill_inserts, ViperConfig{});
+    ViperConfig v_config{};
+    // Fault in the pool up front, so that prefills and inserts after a resize do not pay for first touches.
+    v_config.prefault = std::getenv("VIPER_BM_PREFAULT") != nullptr;
+    return InitMap(num_prefill_inserts, v_config);
 }
 
 template <typename KeyT, typename ValueT>
@@ -56,12 +65,31 @@ void ViperFixture<KeyT, ValueT>::InitMap(uint64_t num_prefill_inserts, ViperConf
     PMemAllocator::get().initialize();
 #endif
 
-    pool_file_ = VIPER_POOL_FILE;
-//    pool_file_ = random_file(DB_PMEM_DIR);
-//    pool_file_ = DB_PMEM_DIR + std::string("/viper");
+    // VIPER_BM_POOL_FILES lists one pool per NUMA node in node order, e.g. "/dev/dax0.0,/dev/dax1.0".
+    pool_files_.clear();
+    const char* pool_files_env = std::getenv("VIPER_BM_POOL_FILES");
+    std::stringstream pool_files{pool_files_env != nullptr ? pool_files_env : ""};
+    for (std::string pool_file; std::getline(pool_files, pool_file, ',');) {
+        if (!pool_file.empty()) {
+            pool_files_.push_back(pool_file);
+        }
+    }
+    if (pool_files_.empty()) {
+        pool_files_.push_back(VIPER_POOL_FILE);
+//        pool_files_.push_back(random_file(DB_PMEM_DIR));
+//        pool_files_.push_back(DB_PMEM_DIR + std::string("/viper"));
+    }
+    if (pool_files_.size() > 1 && pool_files_.size() != static_cast<size_t>(CpuTopology::get().num_nodes)) {
+        std::cerr << "Got " << pool_files_.size() << " Viper pools for "
+                  << CpuTopology::get().num_nodes << " NUMA nodes." << std::endl;
+    }
 
-//    viper_ = ViperT::open(pool_file_, v_config);
-    viper_ = ViperT::create(pool_file_, BM_POOL_SIZE, v_config);
+//    viper_ = ViperT::open(pool_files_[0], v_config);
+    if (pool_files_.size() == 1) {
+        viper_ = ViperT::create(pool_files_[0], BM_POOL_SIZE, v_config);
+    } else {
+        viper_ = ViperT::create(pool_files_, BM_POOL_SIZE, v_config);
+    }
     this->prefill(num_prefill_inserts);
     viper_initialized_ = true;
 }
@@ -71,8 +99,10 @@ void ViperFixture<KeyT, ValueT>::DeInitMap() {
     BaseFixture::DeInitMap();
     viper_ = nullptr;
     viper_initialized_ = false;
-    if (pool_file_.find("/dev/dax") == std::string::npos) {
-        std::filesystem::remove_all(pool_file_);
+    for (const std::string& pool_file : pool_files_) {
+        if (pool_file.find("/dev/dax") == std::string::npos) {
+            std::filesystem::remove_all(pool_file);
+        }
     }
 }
 
@@ -234,20 +264,42 @@ uint64_t ViperFixture<std::string, std::string>::setup_and_get_update(uint64_t,
 
 template <typename KeyT, typename ValueT>
 uint64_t ViperFixture<KeyT, ValueT>::run_ycsb(uint64_t, uint64_t, const std::vector<ycsb::Record>&, hdr_histogram*) {
-    throw std::runtime_error{"YCSB not implemented for non-ycsb key/value types."};
+    throw std::runtime_error{"YCSB records of other key/value sizes need run_ycsb_records()."};
 }
 
 template <>
 uint64_t ViperFixture<KeyType8, ValueType200>::run_ycsb(
     uint64_t start_idx, uint64_t end_idx, const std::vector<ycsb::Record>& data, hdr_histogram* hdr) {
+    return run_ycsb_records(start_idx, end_idx, data, hdr);
+}
+
+template <typename KeyT, typename ValueT>
+void ViperFixture<KeyT, ValueT>::load_ycsb_generated(const uint64_t start_id, const uint64_t end_id) {
+    static constexpr size_t BATCH_SIZE = 1024;
+    std::vector<ycsb::BasicRecord<KeyT, ValueT>> batch(BATCH_SIZE);
+    for (uint64_t id = start_id; id < end_id; id += BATCH_SIZE) {
+        batch.resize(std::min<uint64_t>(BATCH_SIZE, end_id - id));
+        ycsb::Generator::fill_load(id, &batch);
+        run_ycsb_records(0, batch.size(), batch, nullptr);
+    }
+}
+
+template <>
+void ViperFixture<std::string, std::string>::load_ycsb_generated(const uint64_t start_id, const uint64_t end_id) {
+    BaseFixture::load_ycsb_generated(start_id, end_id);
+}
+
+template <typename KeyT, typename ValueT>
+uint64_t ViperFixture<KeyT, ValueT>::run_ycsb_records(
+    uint64_t start_idx, uint64_t end_idx, const std::vector<ycsb::BasicRecord<KeyT, ValueT>>& data, hdr_histogram* hdr) {
     uint64_t op_count = 0;
     auto v_client = viper_->get_client();
-    ValueType200 value;
-    const ValueType200 null_value{0ul};
+    ValueT value;
+    const ValueT null_value{0ul};
 
     std::chrono::high_resolution_clock::time_point start;
     for (int op_num = start_idx; op_num < end_idx; ++op_num) {
-        const ycsb::Record& record = data[op_num];
+        const ycsb::BasicRecord<KeyT, ValueT>& record = data[op_num];
 
         if (hdr != nullptr) {
             start = std::chrono::high_resolution_clock::now();
@@ -265,13 +317,31 @@ uint64_t ViperFixture<KeyType8, ValueType200>::run_ycsb(
                 break;
             }
             case ycsb::Record::Op::UPDATE: {
-                auto update_fn = [&](ValueType200* value) {
+                auto update_fn = [&](ValueT* value) {
                     value->data[0] = record.value.data[0];
                     internal::pmem_persist(value->data.data(), sizeof(uint64_t));
                 };
                 op_count += v_client.update(record.key, update_fn);
                 break;
             }
+            case ycsb::Record::Op::SCAN: {
+                // Viper has no ordered index, so a scan reads the consecutive keys one by one.
+                const uint64_t first_key = record.key.get_key();
+                const uint32_t scan_length = record.value.data[0];
+                uint64_t num_found = 0;
+                for (uint64_t key = first_key; key < first_key + scan_length; ++key) {
+                    num_found += v_client.get(ycsb::make_record<KeyT>(key), &value);
+                }
+                op_count += num_found > 0;
+                break;
+            }
+            case ycsb::Record::Op::READ_MODIFY_WRITE: {
+                const bool found = v_client.get(record.key, &value);
+                value.data[0] = record.value.data[0];
+                v_client.put(record.key, value);
+                op_count += found;
+                break;
+            }
             default: {
                 throw std::runtime_error("Unknown operation: " + std::to_string(record.op));
             }
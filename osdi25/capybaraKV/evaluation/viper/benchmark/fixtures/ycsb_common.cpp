@@ -1,7 +1,12 @@
 #include "ycsb_common.hpp"
 
 #include <fstream>
+#include <cmath>
 #include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace viper::kv_bm::ycsb {
 
@@ -29,4 +34,213 @@ void read_workload_file(const std::filesystem::path wl_file, std::vector<Record>
     }
 }
 
-}
\ No newline at end of file
+WorkloadSpec WorkloadSpec::core(char workload, uint64_t record_count) {
+    WorkloadSpec spec{};
+    spec.record_count = record_count;
+    switch (workload) {
+        case 'A':
+            spec.read_proportion = 0.5;
+            spec.update_proportion = 0.5;
+            break;
+        case 'B':
+            spec.read_proportion = 0.95;
+            spec.update_proportion = 0.05;
+            break;
+        case 'C':
+            spec.read_proportion = 1;
+            spec.update_proportion = 0;
+            break;
+        case 'D':
+            spec.read_proportion = 0.95;
+            spec.update_proportion = 0;
+            spec.insert_proportion = 0.05;
+            spec.request_distribution = Distribution::LATEST;
+            break;
+        case 'E':
+            spec.read_proportion = 0;
+            spec.update_proportion = 0;
+            spec.scan_proportion = 0.95;
+            spec.insert_proportion = 0.05;
+            break;
+        case 'F':
+            spec.read_proportion = 0.5;
+            spec.update_proportion = 0;
+            spec.read_modify_write_proportion = 0.5;
+            break;
+        default:
+            throw std::runtime_error("Unknown YCSB workload: " + std::string(1, workload));
+    }
+    return spec;
+}
+
+double zeta(uint64_t from, uint64_t to, double theta, double initial_sum) {
+    double sum = initial_sum;
+    for (uint64_t i = from; i < to; ++i) {
+        sum += 1 / std::pow(i + 1, theta);
+    }
+    return sum;
+}
+
+uint64_t fnv_hash(uint64_t value) {
+    // FNV-1a over the bytes of value, as YCSB scrambles its zipfian keys.
+    uint64_t hash = 0xcbf29ce484222325ul;
+    for (int i = 0; i < 8; ++i) {
+        hash ^= value & 0xff;
+        hash *= 0x100000001b3ul;
+        value >>= 8;
+    }
+    return hash;
+}
+
+Workload::Workload(const WorkloadSpec& spec)
+    : spec_{spec}, initial_zeta_{zeta(0, spec.record_count, spec.zipfian_constant)},
+      insert_counter_{spec.record_count}, acknowledged_{spec.record_count},
+      ack_window_{new std::atomic<bool>[ACK_WINDOW_SIZE]{}} {
+    if (spec.record_count == 0) {
+        throw std::runtime_error("YCSB workload needs at least one record.");
+    }
+}
+
+void Workload::acknowledge_insert(const uint64_t id) {
+    if (id - acknowledged_.load(std::memory_order_acquire) >= ACK_WINDOW_SIZE) {
+        throw std::runtime_error("Too many unacknowledged YCSB inserts.");
+    }
+    ack_window_[id % ACK_WINDOW_SIZE].store(true, std::memory_order_release);
+
+    // Whoever gets the lock moves the limit past all acknowledged ids. An id acknowledged while the
+    // lock is held is checked again after unlocking, so it is not left behind the limit.
+    do {
+        if (!ack_lock_.try_lock()) {
+            return;
+        }
+        uint64_t limit = acknowledged_.load(std::memory_order_relaxed);
+        while (ack_window_[limit % ACK_WINDOW_SIZE].exchange(false, std::memory_order_acq_rel)) {
+            ++limit;
+        }
+        acknowledged_.store(limit, std::memory_order_release);
+        ack_lock_.unlock();
+    } while (ack_window_[acknowledged_.load(std::memory_order_acquire) % ACK_WINDOW_SIZE].load(std::memory_order_acquire));
+}
+
+Generator::Generator(Workload& workload, uint64_t seed)
+    : workload_{workload}, spec_{workload.spec()}, rng_{seed}, unit_{0.0, 1.0},
+      zeta_n_{workload.initial_zeta()}, zeta_count_{workload.spec().record_count},
+      zeta_2_{zeta(0, 2, workload.spec().zipfian_constant)},
+      alpha_{1 / (1 - workload.spec().zipfian_constant)} {}
+
+Op Generator::next_op() {
+    double choice = unit_(rng_) * (spec_.read_proportion + spec_.update_proportion + spec_.insert_proportion
+                                   + spec_.scan_proportion + spec_.read_modify_write_proportion);
+    if ((choice -= spec_.read_proportion) < 0) {
+        return Op::GET;
+    }
+    if ((choice -= spec_.update_proportion) < 0) {
+        return Op::UPDATE;
+    }
+    if ((choice -= spec_.insert_proportion) < 0) {
+        return Op::INSERT;
+    }
+    if ((choice -= spec_.scan_proportion) < 0) {
+        return Op::SCAN;
+    }
+    return Op::READ_MODIFY_WRITE;
+}
+
+uint64_t Generator::next_zipfian(const uint64_t num_items) {
+    // Gray et al., "Quickly Generating Billion-Record Synthetic Databases", as used by YCSB. The
+    // item count only grows, so zeta is extended by the new items instead of being recomputed.
+    const double theta = spec_.zipfian_constant;
+    if (num_items > zeta_count_) {
+        zeta_n_ = zeta(zeta_count_, num_items, theta, zeta_n_);
+        zeta_count_ = num_items;
+    }
+    const double eta = (1 - std::pow(2.0 / num_items, 1 - theta)) / (1 - zeta_2_ / zeta_n_);
+    const double u = unit_(rng_);
+    const double uz = u * zeta_n_;
+    if (uz < 1.0) {
+        return 0;
+    }
+    if (uz < 1.0 + std::pow(0.5, theta)) {
+        return 1;
+    }
+    const auto item = static_cast<uint64_t>(num_items * std::pow(eta * u - eta + 1, alpha_));
+    return std::min(item, num_items - 1);
+}
+
+uint64_t Generator::next_key() {
+    const uint64_t num_records = workload_.num_records();
+    switch (spec_.request_distribution) {
+        case Distribution::UNIFORM:
+            return rng_() % num_records;
+        case Distribution::ZIPFIAN:
+            return fnv_hash(next_zipfian(num_records)) % num_records;
+        case Distribution::LATEST:
+            return num_records - 1 - next_zipfian(num_records);
+        case Distribution::HOTSPOT: {
+            const uint64_t hot_records = std::max<uint64_t>(1, num_records * spec_.hotspot_data_fraction);
+            if (hot_records == num_records || unit_(rng_) < spec_.hotspot_op_fraction) {
+                return rng_() % hot_records;
+            }
+            return hot_records + rng_() % (num_records - hot_records);
+        }
+    }
+    throw std::runtime_error("Unknown request distribution");
+}
+
+uint32_t Generator::next_scan_length() {
+    return 1 + rng_() % spec_.max_scan_length;
+}
+
+void Generator::acknowledge_inserts() {
+    for (const uint64_t id : pending_inserts_) {
+        workload_.acknowledge_insert(id);
+    }
+    pending_inserts_.clear();
+}
+
+TraceFile::TraceFile(const std::filesystem::path& trace_file) {
+    const int fd = open(trace_file.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + trace_file.string() + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        throw std::runtime_error(trace_file.string() + " is empty.");
+    }
+    map_size_ = st.st_size;
+    void* map = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + trace_file.string() + ": " + std::strerror(errno));
+    }
+    map_ = static_cast<char*>(map);
+    madvise(map_, map_size_, MADV_SEQUENTIAL);
+
+    TraceHeader header{};
+    if (map_size_ >= sizeof(header)) {
+        std::memcpy(&header, map_, sizeof(header));
+    }
+    if (header.magic == MAGIC) {
+        key_size_ = header.key_size;
+        value_size_ = header.value_size;
+        records_ = map_ + sizeof(header);
+    } else {
+        key_size_ = sizeof(KeyType8);
+        value_size_ = sizeof(ValueType200);
+        records_ = map_;
+    }
+    record_size_ = sizeof(uint32_t) + key_size_ + value_size_;
+    const size_t data_size = map_size_ - (records_ - map_);
+    if (data_size % record_size_ != 0) {
+        munmap(map_, map_size_);
+        throw std::runtime_error(trace_file.string() + " has a truncated record.");
+    }
+    num_records_ = data_size / record_size_;
+}
+
+TraceFile::~TraceFile() {
+    munmap(map_, map_size_);
+}
+
+}
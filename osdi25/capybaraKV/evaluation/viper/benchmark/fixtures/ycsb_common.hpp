@@ -1,21 +1,220 @@
 #pragma once
 
+#include <atomic>
+#include <cstring>
 #include <filesystem>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include <vector>
 #include "../benchmark.hpp"
 
 namespace viper::kv_bm::ycsb {
 
-struct Record {
-    enum Op : uint32_t { INSERT = 0, GET = 1, UPDATE = 2 };
-    // This will be overwritten by the file read.
-    const Op op = INSERT;
-    const KeyType8 key;
-    const ValueType200 value;
+// SCAN reads value.data[0] keys starting at key. READ_MODIFY_WRITE reads key and writes value.
+enum Op : uint32_t { INSERT = 0, GET = 1, UPDATE = 2, SCAN = 3, READ_MODIFY_WRITE = 4 };
+
+// The BMRecord types are 4 byte aligned, so this has the layout of a trace record.
+template <typename K, typename V>
+struct BasicRecord {
+    using Op = ycsb::Op;
+    Op op = INSERT;
+    K key;
+    V value;
 };
 
+// The record size of the workload files and of the fixtures' run_ycsb().
+using Record = BasicRecord<KeyType8, ValueType200>;
+
 void read_workload_file(const std::filesystem::path wl_file, std::vector<Record>* data);
 
+enum class Distribution { UNIFORM, ZIPFIAN, LATEST, HOTSPOT };
+
+// Mirrors the properties of YCSB's CoreWorkload.
+struct WorkloadSpec {
+    double read_proportion = 0.95;
+    double update_proportion = 0.05;
+    double insert_proportion = 0;
+    double scan_proportion = 0;
+    double read_modify_write_proportion = 0;
+    Distribution request_distribution = Distribution::ZIPFIAN;
+    uint64_t record_count = NUM_PREFILLS;
+    uint32_t max_scan_length = 100;
+    double zipfian_constant = 0.99;
+    double hotspot_data_fraction = 0.2;
+    double hotspot_op_fraction = 0.8;
+
+    // The YCSB core workloads A-F.
+    static WorkloadSpec core(char workload, uint64_t record_count = NUM_PREFILLS);
+};
+
+// State shared by all threads running one workload. Records are numbered 0..num_records() - 1 and
+// the key of record i is i, so scans cover consecutive keys.
+class Workload {
+  public:
+    explicit Workload(const WorkloadSpec& spec);
+
+    const WorkloadSpec& spec() const { return spec_; }
+    // Records whose inserts completed, like YCSB's AcknowledgedCounterGenerator. Ids handed out by
+    // next_insert_id() only count once they and all lower ids are acknowledged.
+    uint64_t num_records() const { return acknowledged_.load(std::memory_order_acquire); }
+    uint64_t next_insert_id() { return insert_counter_.fetch_add(1, std::memory_order_relaxed); }
+    void acknowledge_insert(uint64_t id);
+
+    // Zeta(record_count, zipfian_constant), computed once and extended by each generator.
+    double initial_zeta() const { return initial_zeta_; }
+
+  private:
+    // Inserts that may be in flight at once, over all threads.
+    static constexpr uint64_t ACK_WINDOW_SIZE = 1ul << 20;
+
+    const WorkloadSpec spec_;
+    const double initial_zeta_;
+    std::atomic<uint64_t> insert_counter_;
+    std::atomic<uint64_t> acknowledged_;
+    std::unique_ptr<std::atomic<bool>[]> ack_window_;
+    std::mutex ack_lock_;
+};
+
+// Produces a workload's operations on the fly. One per thread, not thread-safe.
+class Generator {
+  public:
+    Generator(Workload& workload, uint64_t seed);
+
+    Op next_op();
+    // Key of an existing record, following the request distribution.
+    uint64_t next_key();
+    uint32_t next_scan_length();
+
+    // Overwrite every record in batch with the next operations of the run phase. Its inserts must be
+    // acknowledged once the batch ran, so that later operations pick their keys.
+    template <typename K, typename V>
+    void fill(std::vector<BasicRecord<K, V>>* batch);
+    void acknowledge_inserts();
+    // Overwrite batch with inserts of the records first_id.. of the load phase.
+    template <typename K, typename V>
+    static void fill_load(uint64_t first_id, std::vector<BasicRecord<K, V>>* batch);
+
+  private:
+    uint64_t next_zipfian(uint64_t num_items);
+
+    Workload& workload_;
+    const WorkloadSpec& spec_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> unit_;
+    double zeta_n_;
+    uint64_t zeta_count_;
+    double zeta_2_;
+    double alpha_;
+    std::vector<uint64_t> pending_inserts_;
+};
+
+double zeta(uint64_t from, uint64_t to, double theta, double initial_sum = 0);
+uint64_t fnv_hash(uint64_t value);
+
+template <typename T>
+T make_record(uint64_t id) {
+    T record{};
+    char* raw = reinterpret_cast<char*>(&record);
+    for (size_t offset = 0; offset < sizeof(T); offset += sizeof(id)) {
+        std::memcpy(raw + offset, &id, std::min(sizeof(id), sizeof(T) - offset));
+    }
+    return record;
 }
 
+// A binary trace of operations, mapped instead of read so it does not need to fit in memory. It
+// starts with a TraceHeader and holds records of a 4 byte op, key_size key bytes and value_size
+// value bytes. Files without a header are taken to hold Records, as written by convert_ycsb.py.
+class TraceFile {
+  public:
+    static constexpr uint64_t MAGIC = 0x3143525442534359ul;  // "YCSBTRC1"
+
+    struct TraceHeader {
+        uint64_t magic;
+        uint32_t key_size;
+        uint32_t value_size;
+    };
+
+    explicit TraceFile(const std::filesystem::path& trace_file);
+    ~TraceFile();
+    TraceFile(const TraceFile&) = delete;
+    TraceFile& operator=(const TraceFile&) = delete;
+
+    uint64_t size() const { return num_records_; }
+    uint32_t key_size() const { return key_size_; }
+    uint32_t value_size() const { return value_size_; }
 
+    Op op(uint64_t idx) const {
+        uint32_t op;
+        std::memcpy(&op, record(idx), sizeof(op));
+        return static_cast<Op>(op);
+    }
+    const char* key(uint64_t idx) const { return record(idx) + sizeof(uint32_t); }
+    const char* value(uint64_t idx) const { return key(idx) + key_size_; }
+
+    // Copy records start_idx.. into batch, as many as fit. Requires the key and value sizes of the trace.
+    template <typename K, typename V>
+    uint64_t copy(uint64_t start_idx, std::vector<BasicRecord<K, V>>* batch) const;
+
+  private:
+    const char* record(uint64_t idx) const { return records_ + idx * record_size_; }
+
+    char* map_ = nullptr;
+    size_t map_size_ = 0;
+    const char* records_ = nullptr;
+    uint64_t num_records_ = 0;
+    uint32_t key_size_ = 0;
+    uint32_t value_size_ = 0;
+    size_t record_size_ = 0;
+};
+
+template <typename K, typename V>
+void Generator::fill(std::vector<BasicRecord<K, V>>* batch) {
+    for (BasicRecord<K, V>& record : *batch) {
+        record.op = next_op();
+        switch (record.op) {
+            case Op::INSERT: {
+                const uint64_t id = workload_.next_insert_id();
+                pending_inserts_.push_back(id);
+                record.key = make_record<K>(id);
+                record.value = make_record<V>(id);
+                break;
+            }
+            case Op::SCAN: {
+                record.key = make_record<K>(next_key());
+                record.value.data[0] = next_scan_length();
+                break;
+            }
+            default: {
+                record.key = make_record<K>(next_key());
+                record.value = make_record<V>(rng_());
+            }
+        }
+    }
+}
+
+template <typename K, typename V>
+void Generator::fill_load(const uint64_t first_id, std::vector<BasicRecord<K, V>>* batch) {
+    for (size_t i = 0; i < batch->size(); ++i) {
+        BasicRecord<K, V>& record = (*batch)[i];
+        record.op = Op::INSERT;
+        record.key = make_record<K>(first_id + i);
+        record.value = make_record<V>(first_id + i);
+    }
+}
+
+template <typename K, typename V>
+uint64_t TraceFile::copy(const uint64_t start_idx, std::vector<BasicRecord<K, V>>* batch) const {
+    static_assert(std::is_trivially_copyable_v<BasicRecord<K, V>>, "Records are copied as bytes");
+    if (key_size_ != sizeof(K) || value_size_ != sizeof(V) || record_size_ != sizeof(BasicRecord<K, V>)) {
+        throw std::runtime_error("Trace records do not have the requested key and value sizes.");
+    }
+    const uint64_t num_copied = std::min<uint64_t>(batch->size(), num_records_ - std::min(start_idx, num_records_));
+    std::memcpy(static_cast<void*>(batch->data()), record(start_idx), num_copied * record_size_);
+    return num_copied;
+}
+
+}
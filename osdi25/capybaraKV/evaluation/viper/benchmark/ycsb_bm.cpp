@@ -33,43 +33,81 @@ static constexpr char PREFILL_FILE[] = "/ycsb_prefill.dat";
             ->Threads(24)
 //            ->ThreadRange(1, 18) \
 
-#define DEFINE_BM(fixture, workload, data) \
+#define DEFINE_BM(fixture, workload) \
             BENCHMARK_TEMPLATE2_DEFINE_F(fixture, workload ## _tp, KeyType8, ValueType200)(benchmark::State& state) { \
-                ycsb_run(state, *this, &data, \
-                    std::string{BASE_DIR} + "/ycsb_wl_" #workload ".dat", false); \
+                ycsb_run(state, *this, std::string{BASE_DIR} + "/ycsb_wl_" #workload ".dat", false); \
             } \
             BENCHMARK_REGISTER_F(fixture, workload ## _tp) GENERAL_ARGS;  \
             BENCHMARK_TEMPLATE2_DEFINE_F(fixture, workload ## _lat, KeyType8, ValueType200)(benchmark::State& state) { \
-                ycsb_run(state, *this, &data, \
-                    std::string{BASE_DIR} + "/ycsb_wl_" #workload ".dat", true); \
+                ycsb_run(state, *this, std::string{BASE_DIR} + "/ycsb_wl_" #workload ".dat", true); \
             } \
             BENCHMARK_REGISTER_F(fixture, workload ## _lat) GENERAL_ARGS
 
-#define ALL_BMS(fixture) \
-            DEFINE_BM(fixture, 5050_uniform, data_uniform_50_50); \
-            DEFINE_BM(fixture, 1090_uniform, data_uniform_10_90); \
-            DEFINE_BM(fixture, 5050_zipf,    data_zipf_50_50); \
-            DEFINE_BM(fixture, 1090_zipf,    data_zipf_10_90)
+#define DEFINE_GENERATED_BM(fixture, workload) \
+            BENCHMARK_TEMPLATE2_DEFINE_F(fixture, ycsb_ ## workload ## _tp, KeyType8, ValueType200)(benchmark::State& state) { \
+                ycsb_run_generated(state, *this, (#workload)[0], false); \
+            } \
+            BENCHMARK_REGISTER_F(fixture, ycsb_ ## workload ## _tp) GENERAL_ARGS;  \
+            BENCHMARK_TEMPLATE2_DEFINE_F(fixture, ycsb_ ## workload ## _lat, KeyType8, ValueType200)(benchmark::State& state) { \
+                ycsb_run_generated(state, *this, (#workload)[0], true); \
+            } \
+            BENCHMARK_REGISTER_F(fixture, ycsb_ ## workload ## _lat) GENERAL_ARGS
 
+#define ALL_BMS(fixture) \
+            DEFINE_BM(fixture, 5050_uniform); \
+            DEFINE_BM(fixture, 1090_uniform); \
+            DEFINE_BM(fixture, 5050_zipf); \
+            DEFINE_BM(fixture, 1090_zipf)
+
+#define ALL_GENERATED_BMS(fixture) \
+            DEFINE_GENERATED_BM(fixture, A); \
+            DEFINE_GENERATED_BM(fixture, B); \
+            DEFINE_GENERATED_BM(fixture, C); \
+            DEFINE_GENERATED_BM(fixture, D); \
+            DEFINE_GENERATED_BM(fixture, E); \
+            DEFINE_GENERATED_BM(fixture, F)
+
+// Operations are handed to the fixtures in batches of this size, so neither traces nor generated
+// workloads need to be held in memory.
+static constexpr size_t BATCH_SIZE = 1024;
 
 static std::vector<ycsb::Record> prefill_data;
-static std::vector<ycsb::Record> data_uniform_50_50;
-static std::vector<ycsb::Record> data_uniform_10_90;
-static std::vector<ycsb::Record> data_zipf_50_50;
-static std::vector<ycsb::Record> data_zipf_10_90;
+static std::unique_ptr<ycsb::TraceFile> trace;
+static std::unique_ptr<ycsb::Workload> workload;
 
-void ycsb_run(benchmark::State& state, BaseFixture& fixture, std::vector<ycsb::Record>* data,
-              const std::filesystem::path& wl_file, bool log_latency) {
+void ycsb_report(benchmark::State& state, BaseFixture& fixture, bool log_latency, uint64_t num_ops) {
+    fixture.log_perf_counters(state, num_ops);
+    if (log_latency) {
+        hdr_histogram* global_hdr = fixture.get_hdr();
+        state.counters["hdr_max"] = hdr_max(global_hdr);
+        state.counters["hdr_avg"] = hdr_mean(global_hdr);
+        state.counters["hdr_min"] = hdr_min(global_hdr);
+        state.counters["hdr_std"] = hdr_stddev(global_hdr);
+        state.counters["hdr_median"] = hdr_value_at_percentile(global_hdr, 50.0);
+        state.counters["hdr_90"] = hdr_value_at_percentile(global_hdr, 90.0);
+        state.counters["hdr_95"] = hdr_value_at_percentile(global_hdr, 95.0);
+        state.counters["hdr_99"] = hdr_value_at_percentile(global_hdr, 99.0);
+        state.counters["hdr_999"] = hdr_value_at_percentile(global_hdr, 99.9);
+        state.counters["hdr_9999"] = hdr_value_at_percentile(global_hdr, 99.99);
+        // hdr_percentiles_print(global_hdr, stdout, 3, 1.0, CLASSIC);
+    }
+    hdr_close(fixture.get_hdr());
+    fixture.DeInitMap();
+}
+
+void ycsb_run(benchmark::State& state, BaseFixture& fixture, const std::filesystem::path& wl_file, bool log_latency) {
     set_cpu_affinity(state.thread_index);
 
     if (is_init_thread(state)) {
         fixture.InitMap();
-        fixture.prefill_ycsb(prefill_data);
-        if (data->empty()) {
-            std::cout << "Reading workload file: " << wl_file << std::endl;
-            ycsb::read_workload_file(wl_file, data);
-            std::cout << "Done reading workload file." << std::endl;
+        if (prefill_data.empty()) {
+            std::cout << "Prefilling data..." << std::endl;
+            std::filesystem::path prefill_file = BASE_DIR + std::string{PREFILL_FILE};
+            ycsb::read_workload_file(prefill_file, &prefill_data);
         }
+        fixture.prefill_ycsb(prefill_data);
+        std::cout << "Mapping workload file: " << wl_file << std::endl;
+        trace = std::make_unique<ycsb::TraceFile>(wl_file);
         hdr_init(1, 1000000000, 4, &fixture.hdr_);
     }
 
@@ -80,18 +118,25 @@ void ycsb_run(benchmark::State& state, BaseFixture& fixture, std::vector<ycsb::R
         hdr = nullptr;
     }
 
-    uint64_t start_idx = 0;
-    uint64_t end_idx = 0;
+    std::vector<ycsb::Record> batch(BATCH_SIZE);
+    uint64_t num_ops_per_thread = 0;
     uint64_t op_counter = 0;
+    PerfCounters perf;
     for (auto _ : state) {
-        // Need to do this in here as data might not be loaded yet.
-        const uint64_t num_total_ops = data->size();
-        const uint64_t num_ops_per_thread = num_total_ops / state.threads;
-        start_idx = state.thread_index * num_ops_per_thread;
-        end_idx = start_idx + num_ops_per_thread;
+        // Need to do this in here as the trace might not be mapped yet.
+        num_ops_per_thread = trace->size() / state.threads;
+        const uint64_t start_idx = state.thread_index * num_ops_per_thread;
+        const uint64_t end_idx = start_idx + num_ops_per_thread;
 
         // Actual benchmark
-        op_counter = fixture.run_ycsb(start_idx, end_idx, *data, hdr);
+        perf.start();
+        for (uint64_t op_idx = start_idx; op_idx < end_idx; op_idx += batch.size()) {
+            batch.resize(std::min<uint64_t>(BATCH_SIZE, end_idx - op_idx));
+            trace->copy(op_idx, &batch);
+            op_counter += fixture.run_ycsb(0, batch.size(), batch, hdr);
+        }
+        perf.stop();
+        fixture.merge_perf(perf);
 
         state.SetItemsProcessed(num_ops_per_thread);
         if (log_latency) {
@@ -101,31 +146,69 @@ void ycsb_run(benchmark::State& state, BaseFixture& fixture, std::vector<ycsb::R
     }
 
     if (is_init_thread(state)) {
+        ycsb_report(state, fixture, log_latency, num_ops_per_thread * state.threads);
+        trace.reset();
+    }
+
+    if (op_counter == 0) {
+        BaseFixture::log_find_count(state, op_counter, num_ops_per_thread);
+    }
+}
+
+void ycsb_run_generated(benchmark::State& state, BaseFixture& fixture, char workload_name, bool log_latency) {
+    set_cpu_affinity(state.thread_index);
+
+    if (is_init_thread(state)) {
+        fixture.InitMap();
+        workload = std::make_unique<ycsb::Workload>(ycsb::WorkloadSpec::core(workload_name));
+        fixture.prefill_ycsb_generated(workload->spec().record_count);
+        hdr_init(1, 1000000000, 4, &fixture.hdr_);
+    }
+
+    struct hdr_histogram* hdr;
+    if (log_latency) {
+        hdr_init(1, 1000000000, 4, &hdr);
+    } else {
+        hdr = nullptr;
+    }
+
+    std::vector<ycsb::Record> batch(BATCH_SIZE);
+    const uint64_t num_ops_per_thread = NUM_OPS / state.threads;
+    uint64_t op_counter = 0;
+    PerfCounters perf;
+    for (auto _ : state) {
+        ycsb::Generator generator{*workload, state.thread_index + 1ul};
+
+        // Actual benchmark
+        perf.start();
+        for (uint64_t op_num = 0; op_num < num_ops_per_thread; op_num += batch.size()) {
+            batch.resize(std::min<uint64_t>(BATCH_SIZE, num_ops_per_thread - op_num));
+            generator.fill(&batch);
+            op_counter += fixture.run_ycsb(0, batch.size(), batch, hdr);
+            generator.acknowledge_inserts();
+        }
+        perf.stop();
+        fixture.merge_perf(perf);
+
+        state.SetItemsProcessed(num_ops_per_thread);
         if (log_latency) {
-            hdr_histogram* global_hdr = fixture.get_hdr();
-            state.counters["hdr_max"] = hdr_max(global_hdr);
-            state.counters["hdr_avg"] = hdr_mean(global_hdr);
-            state.counters["hdr_min"] = hdr_min(global_hdr);
-            state.counters["hdr_std"] = hdr_stddev(global_hdr);
-            state.counters["hdr_median"] = hdr_value_at_percentile(global_hdr, 50.0);
-            state.counters["hdr_90"] = hdr_value_at_percentile(global_hdr, 90.0);
-            state.counters["hdr_95"] = hdr_value_at_percentile(global_hdr, 95.0);
-            state.counters["hdr_99"] = hdr_value_at_percentile(global_hdr, 99.0);
-            state.counters["hdr_999"] = hdr_value_at_percentile(global_hdr, 99.9);
-            state.counters["hdr_9999"] = hdr_value_at_percentile(global_hdr, 99.99);
-            // hdr_percentiles_print(global_hdr, stdout, 3, 1.0, CLASSIC);
-            hdr_close(global_hdr);
+            fixture.merge_hdr(hdr);
+            hdr_close(hdr);
         }
+    }
 
-        fixture.DeInitMap();
+    if (is_init_thread(state)) {
+        ycsb_report(state, fixture, log_latency, num_ops_per_thread * state.threads);
+        workload.reset();
     }
 
     if (op_counter == 0) {
-        BaseFixture::log_find_count(state, op_counter, end_idx - start_idx);
+        BaseFixture::log_find_count(state, op_counter, num_ops_per_thread);
     }
 }
 
 ALL_BMS(ViperFixture);
+ALL_GENERATED_BMS(ViperFixture);
 //ALL_BMS(PmemKVFixture);
 //ALL_BMS(UTreeFixture);
 //ALL_BMS(CrlFixture);
@@ -136,10 +219,6 @@ ALL_BMS(ViperFixture);
 
 
 int main(int argc, char** argv) {
-    std::cout << "Prefilling data..." << std::endl;
-    std::filesystem::path prefill_file = BASE_DIR + std::string{PREFILL_FILE};
-    ycsb::read_workload_file(prefill_file, &prefill_data);
-
     std::string exec_name = argv[0];
     const std::string arg = get_output_file("ycsb/ycsb");
     return bm_main({exec_name, arg});
@@ -31,6 +31,8 @@
 #include <cassert>
 #include <unordered_map>
 #include <atomic>
+#include <functional>
+#include <algorithm>
 #include <stdlib.h>
 
 #include "hash.hpp"
@@ -212,6 +214,8 @@ inline void persist(void* data, size_t len) {
 template <typename KeyType>
 struct Segment {
     static const size_t kNumSlot = kSegmentSize / sizeof(Pair);
+    static constexpr size_t kNumSlotPerCacheLine = kNumPairPerCacheLine;
+    static constexpr bool kCompact = false;
 
     Segment(void)
         : local_depth{0}
@@ -236,6 +240,9 @@ struct Segment {
     template <typename KeyCheckFn>
     int Insert(const KeyType&, IndexV, size_t, size_t, IndexV* old_entry, KeyCheckFn);
 
+    template <typename KeyCheckFn>
+    IndexV Get(const KeyType&, size_t, size_t, KeyCheckFn);
+
     void Insert4split(IndexK, IndexV, size_t);
     Segment** Split(void);
 
@@ -246,10 +253,92 @@ struct Segment {
     static constexpr bool using_fp_ = requires_fingerprint(KeyType);
 };
 
+/**
+ * A segment that packs each entry into a single 8-byte word of a 16-bit fingerprint and a 48-bit offset
+ * (29-bit block, 3-bit page, 16-bit slot), so twice as many entries fit into a cache line as in a Segment.
+ * As the key hash is not stored, splits rehash the moved entries through the map's KeyHashFn.
+ */
 template <typename KeyType>
+struct CompactSegment {
+    static_assert(requires_fingerprint(KeyType), "Compact segments need fingerprinted keys.");
+
+    using KeyHashFn = std::function<size_t(IndexV)>;
+
+    static const size_t kNumSlot = kSegmentSize / sizeof(uint64_t);
+    static constexpr size_t kNumSlotPerCacheLine = CACHE_LINE_SIZE / sizeof(uint64_t);
+    static constexpr bool kCompact = true;
+
+    static constexpr size_t kFingerprintShift = 48;
+    static constexpr size_t kBlockShift = 19;
+    static constexpr block_size_t kBlockMask = (1ul << 29) - 1;
+    // The largest block is excluded, so that no entry looks like INVALID or SENTINEL.
+    static constexpr block_size_t kMaxBlock = kBlockMask - 1;
+
+    CompactSegment(void)
+        : local_depth{0}
+    {
+        std::fill(_, _ + kNumSlot, INVALID);
+    }
+
+    CompactSegment(size_t depth)
+        : local_depth{depth}
+    {
+        std::fill(_, _ + kNumSlot, INVALID);
+    }
+
+    void* operator new(size_t size) {
+#ifdef CCEH_PERSISTENT
+        PMEMoid ret;
+        PMemAllocator::get().allocate(&ret, size);
+        return pmemobj_direct(ret);
+#else
+        void* ret;
+        if (posix_memalign(&ret, 64, size) != 0) throw std::runtime_error("bad memalign");
+        return ret;
+#endif
+    }
+
+    static inline uint16_t Fingerprint(const size_t key_hash) {
+        // The low bits pick the cache line and the high bits the segment, so use the bits in between.
+        return (key_hash >> kSegmentBits) & 0xFFFF;
+    }
+
+    static inline uint64_t Pack(const uint16_t fingerprint, const IndexV value) {
+        if (value.block_number > kMaxBlock) {
+            throw std::runtime_error("Block " + std::to_string(value.block_number) + " does not fit into a compact slot.");
+        }
+        return ((uint64_t) fingerprint << kFingerprintShift) | ((uint64_t) value.block_number << kBlockShift)
+               | ((uint64_t) value.page_number << 16) | value.data_offset;
+    }
+
+    static inline IndexV Unpack(const uint64_t entry) {
+        return IndexV{(entry >> kBlockShift) & kBlockMask, static_cast<page_size_t>((entry >> 16) & 0x7),
+                      static_cast<data_offset_size_t>(entry & 0xFFFF)};
+    }
+
+    static inline bool IsEmpty(const uint64_t entry) {
+        return entry == INVALID || entry == SENTINEL;
+    }
+
+    template <typename KeyCheckFn>
+    int Insert(const KeyType&, IndexV, size_t, size_t, IndexV* old_entry, KeyCheckFn);
+
+    template <typename KeyCheckFn>
+    IndexV Get(const KeyType&, size_t, size_t, KeyCheckFn);
+
+    void Insert4split(uint64_t, size_t);
+    CompactSegment** Split(const KeyHashFn&);
+
+    uint64_t _[kNumSlot];
+    size_t local_depth;
+    std::atomic<uint64_t> sema = 0;
+    size_t pattern = 0;
+};
+
+template <typename KeyType, typename SegmentT = Segment<KeyType>>
 struct Directory {
     static const size_t kDefaultDepth = 10;
-    Segment<KeyType>** _;
+    SegmentT** _;
     size_t capacity;
     size_t depth;
     bool lock;
@@ -260,7 +349,7 @@ struct Directory {
     Directory(void) {
         depth = kDefaultDepth;
         capacity = pow(2, depth);
-        _ = new Segment<KeyType>*[capacity];
+        _ = new SegmentT*[capacity];
         lock = false;
     }
 
@@ -268,10 +357,10 @@ struct Directory {
         depth = _depth;
         capacity = pow(2, depth);
 #ifdef CCEH_PERSISTENT
-        PMemAllocator::get().allocate(&pmem_seg_loc_, sizeof(Segment<KeyType>*) * capacity);
-        _ = (Segment<KeyType>**) pmemobj_direct(pmem_seg_loc_);
+        PMemAllocator::get().allocate(&pmem_seg_loc_, sizeof(SegmentT*) * capacity);
+        _ = (SegmentT**) pmemobj_direct(pmem_seg_loc_);
 #else
-        _ = new Segment<KeyType>*[capacity];
+        _ = new SegmentT*[capacity];
 #endif
         lock = false;
     }
@@ -311,9 +400,15 @@ struct Directory {
 #endif
 };
 
-template <typename KeyType>
+/**
+ * The index maps keys to offsets. SegmentT is either Segment, which stores the full key hash (or the key
+ * itself for small keys) next to each offset, or CompactSegment, which needs a KeyHashFn to split.
+ */
+template <typename KeyType, typename SegmentT = Segment<KeyType>>
 class CCEH {
   public:
+    using KeyHashFn = std::function<size_t(IndexV)>;
+
     static constexpr auto dummy_key_check = [](const KeyType&, IndexV) {
         throw std::runtime_error("Dummy key check should never be used!");
         return true;
@@ -337,11 +432,18 @@ class CCEH {
     void Remove(IndexV* offset);
     size_t Capacity(void);
 
+    // Compact segments do not store key hashes, so splitting them needs the hash of the key at an offset.
+    void SetKeyHashFn(KeyHashFn key_hash_fn);
+
   private:
-    Directory<KeyType>* dir;
+    Directory<KeyType, SegmentT>* dir;
+    KeyHashFn key_hash_fn_;
     static constexpr bool using_fp_ = requires_fingerprint(KeyType);
 };
 
+template <typename KeyType>
+using CompactCCEH = CCEH<KeyType, CompactSegment<KeyType>>;
+
 extern size_t perfCounter;
 
 template <typename KeyType>
@@ -369,6 +471,36 @@ int Segment<KeyType>::Insert(const KeyType& key, IndexV value, size_t loc, size_
       key_checker = *reinterpret_cast<const IndexK*>(&key);
   }
 
+  // Look for the key first. Claiming a free slot in front of it would leave the old entry visible to Get(), so a
+  // delete would not remove the key and an update would not report the offset it replaced.
+  for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
+    auto slot = (loc + i) % kNumSlot;
+    if (ATOMIC_LOAD(&_[slot].key) != key_checker) continue;
+    if constexpr (using_fp_) {
+        // FPs matched but not necessarily the actual key.
+        const bool keys_match = key_check_fn(key, _[slot].value);
+        if (!keys_match) continue;
+    }
+
+    IndexV old_value = _[slot].value;
+    while (!CAS(&_[slot].value.offset, &old_value.offset, value.offset)) {}
+    if (value.is_tombstone()) {
+        IndexK expected = key_checker;
+        CAS(&_[slot].key, &expected, INVALID);
+    }
+    old_entry->offset = old_value.offset;
+    persist(&_[slot].key, sizeof(Pair));
+    sema.fetch_sub(1);
+    return 0;
+  }
+
+  if (value.is_tombstone()) {
+    // Nothing to delete.
+    old_entry->offset = IndexV::Tombstone().offset;
+    sema.fetch_sub(1);
+    return 0;
+  }
+
   for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
     auto slot = (loc + i) % kNumSlot;
     auto _key = _[slot].key;
@@ -385,35 +517,12 @@ int Segment<KeyType>::Insert(const KeyType& key, IndexV value, size_t loc, size_
     }
 
     if (CAS(&_[slot].key, &LOCK, SENTINEL)) {
-        old_entry->offset = _[slot].value.offset;
+        old_entry->offset = IndexV::Tombstone().offset;
         _[slot].value = value;
-        if (value.is_tombstone()) {
-            // Inserted tombstone
-            _[slot].key = INVALID;
-        }
-        else {
-            _[slot].key = key_checker;
-        }
+        _[slot].key = key_checker;
         persist(&_[slot], sizeof(Pair));
         ret = 0;
         break;
-    } else if (ATOMIC_LOAD(&_[slot].key) == key_checker) {
-        if constexpr (using_fp_) {
-            // FPs matched but not necessarily the actual key.
-            const bool keys_match = key_check_fn(key, _[slot].value);
-            if (!keys_match) continue;
-        }
-
-        IndexV old_value = _[slot].value;
-        while (!CAS(&_[slot].value.offset, &old_value.offset, value.offset)) {}
-        if (value.is_tombstone()) {
-            IndexK expected = key_checker;
-            CAS(&_[slot].key, &expected, INVALID);
-        }
-        old_entry->offset = old_value.offset;
-        persist(&_[slot].key, sizeof(Pair));
-        ret = 0;
-        break;
     } else {
         LOCK = INVALID;
     }
@@ -423,6 +532,30 @@ int Segment<KeyType>::Insert(const KeyType& key, IndexV value, size_t loc, size_
   return ret;
 }
 
+template <typename KeyType>
+template <typename KeyCheckFn>
+IndexV Segment<KeyType>::Get(const KeyType& key, size_t loc, size_t key_hash, KeyCheckFn key_check_fn) {
+    IndexK key_checker;
+    if constexpr (using_fp_) {
+        key_checker = key_hash;
+    } else {
+        key_checker = *reinterpret_cast<const IndexK*>(&key);
+    }
+
+    for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
+        auto slot = (loc+i) % kNumSlot;
+        if (_[slot].key == key_checker) {
+          if constexpr (using_fp_) {
+              const bool keys_match = key_check_fn(key, _[slot].value);
+              if (!keys_match) continue;
+          }
+
+          return _[slot].value;
+        }
+    }
+    return IndexV::NONE();
+}
+
 template <typename KeyType>
 void Segment<KeyType>::Insert4split(IndexK key, IndexV value, size_t loc) {
     for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
@@ -478,29 +611,164 @@ Segment<KeyType>** Segment<KeyType>::Split(void) {
 }
 
 template <typename KeyType>
-CCEH<KeyType>::CCEH(size_t initCap)
-    : dir{new Directory<KeyType>(static_cast<size_t>(log2(initCap)))}
+template <typename KeyCheckFn>
+int CompactSegment<KeyType>::Insert(const KeyType& key, IndexV value, size_t loc, size_t key_hash,
+                                    IndexV* old_entry, KeyCheckFn key_check_fn) {
+  uint64_t lock = sema.load();
+  if (lock == EXCLUSIVE_LOCK) return 2;
+  if (IS_BIT_SET(lock, SPLIT_REQUEST_BIT)) return 1;
+
+  const size_t pattern_shift = 8 * sizeof(key_hash) - local_depth;
+  if ((key_hash >> pattern_shift) != pattern) return 2;
+
+  int ret = 1;
+  while (!sema.compare_exchange_weak(lock, lock+1)) {
+      if (lock == EXCLUSIVE_LOCK) return 2;
+      if (IS_BIT_SET(lock, SPLIT_REQUEST_BIT)) return 1;
+  }
+
+  const uint16_t fingerprint = Fingerprint(key_hash);
+  const uint64_t new_entry = value.is_tombstone() ? INVALID : Pack(fingerprint, value);
+
+  // As in Segment, the key's existing entry has to be found before a free slot in front of it is claimed.
+  for (unsigned i = 0; i < kNumSlotPerCacheLine * kNumCacheLine; ++i) {
+    auto slot = (loc + i) % kNumSlot;
+
+    uint64_t entry = ATOMIC_LOAD(&_[slot]);
+    if (IsEmpty(entry) || (entry >> kFingerprintShift) != fingerprint) continue;
+
+    // FPs matched but not necessarily the actual key.
+    if (!key_check_fn(key, Unpack(entry))) continue;
+
+    while (!CAS(&_[slot], &entry, new_entry)) {}
+    old_entry->offset = IsEmpty(entry) ? IndexV::Tombstone().offset : Unpack(entry).offset;
+    persist(&_[slot], sizeof(uint64_t));
+    sema.fetch_sub(1);
+    return 0;
+  }
+
+  if (value.is_tombstone()) {
+    // Nothing to delete.
+    old_entry->offset = IndexV::Tombstone().offset;
+    sema.fetch_sub(1);
+    return 0;
+  }
+
+  // Splits move entries out eagerly, so unlike in Segment, there are no stale entries to invalidate here.
+  for (unsigned i = 0; i < kNumSlotPerCacheLine * kNumCacheLine; ++i) {
+    auto slot = (loc + i) % kNumSlot;
+
+    uint64_t entry = INVALID;
+    if (CAS(&_[slot], &entry, SENTINEL)) {
+        old_entry->offset = IndexV::Tombstone().offset;
+        ATOMIC_STORE(&_[slot], new_entry);
+        persist(&_[slot], sizeof(uint64_t));
+        ret = 0;
+        break;
+    }
+  }
+
+  sema.fetch_sub(1);
+  return ret;
+}
+
+template <typename KeyType>
+template <typename KeyCheckFn>
+IndexV CompactSegment<KeyType>::Get(const KeyType& key, size_t loc, size_t key_hash, KeyCheckFn key_check_fn) {
+    const uint16_t fingerprint = Fingerprint(key_hash);
+    for (unsigned i = 0; i < kNumSlotPerCacheLine * kNumCacheLine; ++i) {
+        const uint64_t entry = ATOMIC_LOAD(&_[(loc + i) % kNumSlot]);
+        if (IsEmpty(entry) || (entry >> kFingerprintShift) != fingerprint) continue;
+
+        const IndexV offset = Unpack(entry);
+        if (key_check_fn(key, offset)) {
+            return offset;
+        }
+    }
+    return IndexV::NONE();
+}
+
+template <typename KeyType>
+void CompactSegment<KeyType>::Insert4split(uint64_t entry, size_t loc) {
+    for (unsigned i = 0; i < kNumSlotPerCacheLine * kNumCacheLine; ++i) {
+        auto slot = (loc+i) % kNumSlot;
+        if (_[slot] == INVALID) {
+            _[slot] = entry;
+            persist(&_[slot], sizeof(uint64_t));
+            return;
+        }
+    }
+}
+
+template <typename KeyType>
+CompactSegment<KeyType>** CompactSegment<KeyType>::Split(const KeyHashFn& key_hash_fn) {
+  uint64_t lock = 0;
+  if (!sema.compare_exchange_strong(lock, EXCLUSIVE_LOCK)) {
+      if (lock == EXCLUSIVE_LOCK) {
+          return nullptr;
+      }
+
+      lock = SPLIT_REQUEST_BIT;
+      if (!sema.compare_exchange_strong(lock, EXCLUSIVE_LOCK)) {
+          if ((lock & SPLIT_REQUEST_BIT) != 0) {
+              return nullptr;
+          }
+          sema.compare_exchange_strong(lock, lock | SPLIT_REQUEST_BIT);
+          return nullptr;
+      }
+  }
+
+  CompactSegment<KeyType>** split = new CompactSegment<KeyType>*[2];
+  split[0] = this;
+  split[1] = new CompactSegment<KeyType>(local_depth + 1);
+
+  const size_t split_bit = (size_t) 1 << (sizeof(IndexK) * 8 - local_depth - 1);
+  for (unsigned i = 0; i < kNumSlot; ++i) {
+    if (IsEmpty(_[i])) continue;
+    const size_t key_hash = key_hash_fn(Unpack(_[i]));
+    if (key_hash & split_bit) {
+      split[1]->Insert4split(_[i], (key_hash & kMask) * kNumSlotPerCacheLine);
+      _[i] = INVALID;
+    }
+  }
+
+    persist((char*) split[1], sizeof(CompactSegment));
+    persist((char*) _, sizeof(_));
+    local_depth = local_depth + 1;
+    persist((char*) &local_depth, sizeof(size_t));
+
+    return split;
+}
+
+template <typename KeyType, typename SegmentT>
+CCEH<KeyType, SegmentT>::CCEH(size_t initCap)
+    : dir{new Directory<KeyType, SegmentT>(static_cast<size_t>(log2(initCap)))}
 {
     auto depth = static_cast<size_t>(log2(initCap));
-    dir = new Directory<KeyType>(depth);
+    dir = new Directory<KeyType, SegmentT>(depth);
     for (unsigned i = 0; i < dir->capacity; ++i) {
-        dir->_[i] = new Segment<KeyType>(static_cast<size_t>(log2(initCap)));
+        dir->_[i] = new SegmentT(static_cast<size_t>(log2(initCap)));
         dir->_[i]->pattern = i;
     }
 }
 
-template <typename KeyType>
-IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value) {
+template <typename KeyType, typename SegmentT>
+void CCEH<KeyType, SegmentT>::SetKeyHashFn(KeyHashFn key_hash_fn) {
+    key_hash_fn_ = std::move(key_hash_fn);
+}
+
+template <typename KeyType, typename SegmentT>
+IndexV CCEH<KeyType, SegmentT>::Insert(const KeyType& key, IndexV value) {
     return Insert(key, value, dummy_key_check);
 }
 
-template <typename KeyType>
+template <typename KeyType, typename SegmentT>
 template <typename KeyCheckFn>
-IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_check_fn) {
+IndexV CCEH<KeyType, SegmentT>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_check_fn) {
     size_t key_hash;
     if constexpr (std::is_same_v<KeyType, std::string>) { key_hash = h(key.data(), key.length()); }
     else { key_hash = h(&key, sizeof(key)); }
-    auto loc = (key_hash & kMask) * kNumPairPerCacheLine;
+    auto loc = (key_hash & kMask) * SegmentT::kNumSlotPerCacheLine;
 
     while (true) {
         auto x = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
@@ -515,7 +783,12 @@ IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_ch
         }
 
         // Segment is full, need to split.
-        Segment<KeyType>** s = target->Split();
+        SegmentT** s;
+        if constexpr (SegmentT::kCompact) {
+            s = target->Split(key_hash_fn_);
+        } else {
+            s = target->Split();
+        }
         if (s == nullptr) {
             // another thread is doing split
             continue;
@@ -553,7 +826,7 @@ IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_ch
             } else {  // directory doubling
                 auto dir_old = dir;
                 auto d = dir->_;
-                auto _dir = new Directory<KeyType>(dir->depth + 1);
+                auto _dir = new Directory<KeyType, SegmentT>(dir->depth + 1);
                 for (unsigned i = 0; i < dir->capacity; ++i) {
                     if (i == x) {
                         _dir->_[2 * i] = s[0];
@@ -563,8 +836,8 @@ IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_ch
                         _dir->_[2 * i + 1] = d[i];
                     }
                 }
-                persist((char*) &_dir->_[0], sizeof(Segment<KeyType>*) * _dir->capacity);
-                persist((char*) &_dir, sizeof(Directory<KeyType>));
+                persist((char*) &_dir->_[0], sizeof(SegmentT*) * _dir->capacity);
+                persist((char*) &_dir, sizeof(Directory<KeyType, SegmentT>));
                 if (!CAS(&dir, &dir_old, _dir)) {
                     throw std::runtime_error("Could not swap dirs. This should never happen!");
                 }
@@ -578,28 +851,29 @@ IndexV CCEH<KeyType>::Insert(const KeyType& key, IndexV value, KeyCheckFn key_ch
     }
 }
 
-template <typename KeyType>
-void CCEH<KeyType>::Remove(IndexV* offset) {
+template <typename KeyType, typename SegmentT>
+void CCEH<KeyType, SegmentT>::Remove(IndexV* offset) {
+    static_assert(!SegmentT::kCompact, "Compact segments do not store offsets in a Pair.");
     offset_size_t expected_value = offset->offset;
     CAS(&offset->offset, &expected_value, IndexV::Tombstone().offset);
     IndexK* key_slot = reinterpret_cast<IndexK*>(offset) - 1;
     ATOMIC_STORE(key_slot, INVALID);
 }
 
-template <typename KeyType>
-IndexV CCEH<KeyType>::Get(const KeyType& key) {
+template <typename KeyType, typename SegmentT>
+IndexV CCEH<KeyType, SegmentT>::Get(const KeyType& key) {
     return Get(key, dummy_key_check);
 }
 
-template <typename KeyType>
+template <typename KeyType, typename SegmentT>
 template <typename KeyCheckFn>
-IndexV CCEH<KeyType>::Get(const KeyType& key, KeyCheckFn key_check_fn) {
+IndexV CCEH<KeyType, SegmentT>::Get(const KeyType& key, KeyCheckFn key_check_fn) {
     size_t key_hash;
     if constexpr (std::is_same_v<KeyType, std::string>) { key_hash = h(key.data(), key.length()); }
     else { key_hash = h(&key, sizeof(key)); }
-    const size_t loc = (key_hash & kMask) * kNumPairPerCacheLine;
+    const size_t loc = (key_hash & kMask) * SegmentT::kNumSlotPerCacheLine;
 
-    Segment<KeyType>* segment;
+    SegmentT* segment;
     while (true) {
         const size_t seg_num = (key_hash >> (8 * sizeof(key_hash) - dir->depth));
         segment = dir->_[seg_num];
@@ -614,45 +888,25 @@ IndexV CCEH<KeyType>::Get(const KeyType& key, KeyCheckFn key_check_fn) {
         break;
     }
 
-    IndexK key_checker;
-    if constexpr (using_fp_) {
-        key_checker = key_hash;
-    } else {
-        key_checker = *reinterpret_cast<const IndexK*>(&key);
-    }
-
-    for (unsigned i = 0; i < kNumPairPerCacheLine * kNumCacheLine; ++i) {
-        auto slot = (loc+i) % Segment<KeyType>::kNumSlot;
-        if (segment->_[slot].key == key_checker) {
-          if constexpr (using_fp_) {
-              const bool keys_match = key_check_fn(key, segment->_[slot].value);
-              if (!keys_match) continue;
-          }
-
-          IndexV offset = segment->_[slot].value;
-          segment->sema.fetch_sub(1);
-          return offset;
-        }
-    }
-
+    const IndexV offset = segment->Get(key, loc, key_hash, key_check_fn);
     segment->sema.fetch_sub(1);
-    return IndexV::NONE();
+    return offset;
 }
 
-template <typename KeyType>
-size_t CCEH<KeyType>::Capacity(void) {
-    std::unordered_map<Segment<KeyType>*, bool> set;
+template <typename KeyType, typename SegmentT>
+size_t CCEH<KeyType, SegmentT>::Capacity(void) {
+    std::unordered_map<SegmentT*, bool> set;
     for (size_t i = 0; i < dir->capacity; ++i) {
         set[dir->_[i]] = true;
     }
-    return set.size() * Segment<KeyType>::kNumSlot;
+    return set.size() * SegmentT::kNumSlot;
 }
 
-template <typename KeyType>
-CCEH<KeyType>::~CCEH() {
+template <typename KeyType, typename SegmentT>
+CCEH<KeyType, SegmentT>::~CCEH() {
 #ifndef CCEH_PERSISTENT
     // Only clean up in volatile mode
-    std::unordered_map<Segment<KeyType>*, bool> set;
+    std::unordered_map<SegmentT*, bool> set;
     for (size_t i = 0; i < dir->capacity; ++i) {
         set[dir->_[i]] = true;
     }
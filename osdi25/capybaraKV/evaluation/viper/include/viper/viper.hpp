@@ -9,6 +9,7 @@
 #include <cmath>
 #include <linux/mman.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
 #include <atomic>
 #include <assert.h>
 #include <filesystem>
@@ -39,6 +40,7 @@ static constexpr uint16_t PAGE_SIZE = 4 * 1024; // 4kb
 static constexpr uint8_t NUM_DIMMS = 1;
 static constexpr size_t BLOCK_SIZE = NUM_DIMMS * PAGE_SIZE;
 static constexpr size_t ONE_GB = 1024l * 1024 * 1024;
+static constexpr size_t TWO_MB = 2l * 1024 * 1024;
 
 static_assert(sizeof(version_lock_t) == 1, "Lock must be 1 byte.");
 static constexpr version_lock_t CLIENT_BIT    = 0b10000000;
@@ -68,6 +70,9 @@ struct ViperConfig {
     size_t dax_alignment = ONE_GB;
     size_t fs_alignment = ONE_GB;
     bool enable_reclamation = false;
+    // Fault in new mappings in the background instead of on the first write to each page.
+    bool prefault = false;
+    uint8_t num_prefault_threads = 16;
 };
 
 // std::ceil is not constexpr in clang, which is what rust/bindgen use, 
@@ -80,11 +85,85 @@ constexpr int32_t ceil(float num)
         : static_cast<int32_t>(num) + ((num > 0) ? 1 : 0);
 }
 
+/**
+ * Specialize this to store a CRC32C of key and value with each record of a Viper instantiation. It is
+ * computed on put and update and verified on get and during recovery. Updates of such records are written
+ * out of place, so a crash never tears a committed record.
+ */
+template <typename K, typename V>
+struct use_checksums : std::false_type {};
+
 namespace internal {
 
+/** CRC32C, with the SSE4.2 instruction if available. */
+inline uint32_t crc32c(const void* data, size_t len, uint32_t crc = ~0u) {
+    const char* bytes = static_cast<const char*>(data);
+#ifdef __SSE4_2__
+    uint64_t crc64 = crc;
+    for (; len >= sizeof(uint64_t); len -= sizeof(uint64_t), bytes += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = crc64;
+    for (; len > 0; --len, ++bytes) {
+        crc = _mm_crc32_u8(crc, *bytes);
+    }
+#else
+    for (; len > 0; --len, ++bytes) {
+        crc ^= static_cast<uint8_t>(*bytes);
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0x82F63B78 & -(crc & 1));
+        }
+    }
+#endif
+    return crc;
+}
+
+template <typename K, typename V>
+struct ChecksummedEntry {
+    K first;
+    V second;
+    uint32_t checksum = 0;
+
+    static inline uint32_t compute_checksum(const K& key, const V& value) {
+        return ~crc32c(&value, sizeof(V), crc32c(&key, sizeof(K)));
+    }
+
+    inline void update_checksum() {
+        checksum = compute_checksum(first, second);
+    }
+
+    // Check a value that was copied out of this entry.
+    inline bool is_valid(const V& value) const {
+        return checksum == compute_checksum(first, value);
+    }
+};
+
+template <typename K, typename V>
+using entry_t = std::conditional_t<use_checksums<K, V>::value, ChecksummedEntry<K, V>, std::pair<K, V>>;
+
+constexpr size_t align_up(const size_t size, const size_t alignment) {
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Bytes used by a ViperPage with num_slots slots: the version lock, the free slot bitset and the entries, each
+ * at its natural alignment.
+ */
+template <typename K, typename V>
+constexpr size_t get_page_layout_size(const size_t num_slots) {
+    // std::bitset stores its bits in words of its own alignment.
+    constexpr size_t bitset_word_size = alignof(std::bitset<1>);
+    const size_t bitset_size = align_up(num_slots, 8 * bitset_word_size) / 8;
+    size_t layout_size = align_up(sizeof(version_lock_t), alignof(std::bitset<1>)) + bitset_size;
+    layout_size = align_up(layout_size, alignof(entry_t<K, V>));
+    return layout_size + num_slots * sizeof(entry_t<K, V>);
+}
+
 template <typename K, typename V>
 constexpr data_offset_size_t get_num_slots_per_page() {
-    const uint32_t entry_size = sizeof(std::pair<K, V>);
+    const uint32_t entry_size = sizeof(entry_t<K, V>);
     uint16_t current_page_size = PAGE_SIZE;
 
     const uint16_t page_overhead = sizeof(version_lock_t) + 1;
@@ -103,8 +182,7 @@ constexpr data_offset_size_t get_num_slots_per_page() {
         num_slots_per_page_large--;
     }
     data_offset_size_t num_slots_per_page = num_slots_per_page_large;
-    while ((num_slots_per_page * entry_size) + page_overhead +
-                ceil((double) num_slots_per_page / 8) > current_page_size) {
+    while (get_page_layout_size<K, V>(num_slots_per_page) > current_page_size) {
         num_slots_per_page--;
     }
     assert(num_slots_per_page > 0 && "Cannot fit KV pair into single page!");
@@ -176,7 +254,7 @@ struct VarEntryAccessor {
 
 template <typename K, typename V>
 struct alignas(PAGE_SIZE) ViperPage {
-    using VEntry = std::pair<K, V>;
+    using VEntry = entry_t<K, V>;
     static constexpr data_offset_size_t num_slots_per_page = get_num_slots_per_page<K, V>();
 
     std::atomic<version_lock_t> version_lock;
@@ -303,6 +381,64 @@ struct ViperInitData {
     std::vector<ViperFileMapping> mappings;
 };
 
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+
+namespace internal {
+
+/**
+ * Warn if a mapping cannot be backed by 2 MiB pages. DAX only maps huge pages for aligned extents, so an
+ * unaligned mapping takes a fault per 4 KiB page.
+ */
+inline void check_mapping_alignment(const void* addr, const size_t size) {
+    const auto address = reinterpret_cast<uintptr_t>(addr);
+    if (address % TWO_MB != 0 || size % TWO_MB != 0) {
+        std::cerr << "Mapping of " << size << " bytes at " << addr << " is not 2 MiB aligned." << std::endl;
+    } else if (address % ONE_GB != 0 && size % ONE_GB == 0) {
+        DEBUG_LOG("Mapping of " << size << " bytes at " << addr << " is not 1 GiB aligned.");
+    }
+}
+
+/**
+ * Fault in all pages of the mappings with num_threads threads, 2 MiB at a time. The data is not modified,
+ * so this is safe for mappings of an existing pool.
+ */
+inline void prefault_mappings(const std::vector<ViperFileMapping>& mappings, const size_t num_threads) {
+    std::vector<std::pair<char*, size_t>> chunks;
+    for (const ViperFileMapping& mapping : mappings) {
+        char* start = static_cast<char*>(mapping.start_addr);
+        for (size_t offset = 0; offset < mapping.mapped_size; offset += TWO_MB) {
+            chunks.emplace_back(start + offset, std::min(TWO_MB, mapping.mapped_size - offset));
+        }
+    }
+
+    std::atomic<size_t> next_chunk{0};
+    auto prefault = [&] {
+        for (size_t chunk = next_chunk++; chunk < chunks.size(); chunk = next_chunk++) {
+            auto [chunk_start, chunk_size] = chunks[chunk];
+            if (madvise(chunk_start, chunk_size, MADV_POPULATE_WRITE) == 0) {
+                continue;
+            }
+            // Kernels before 5.14 do not support MADV_POPULATE_WRITE, so write-fault each page by hand.
+            for (size_t offset = 0; offset < chunk_size; offset += PAGE_SIZE) {
+                __atomic_fetch_add(chunk_start + offset, 0, __ATOMIC_RELAXED);
+            }
+        }
+    };
+
+    std::vector<std::thread> prefault_threads;
+    for (size_t thread_num = 1; thread_num < num_threads; ++thread_num) {
+        prefault_threads.emplace_back(prefault);
+    }
+    prefault();
+    for (std::thread& thread : prefault_threads) {
+        thread.join();
+    }
+}
+
+}  // namespace internal
+
 template <typename KeyT>
 struct KeyAccessor {
     typedef const KeyT* checker_type;
@@ -339,6 +475,14 @@ struct ValueAccessor<std::string> {
     static const_ptr_type to_ptr_type(const type& x) { return &x; }
 };
 
+/**
+ * Specialize this to index a Viper instantiation with cceh::CompactCCEH, which stores 8-byte
+ * fingerprint/offset words instead of 16-byte hash/offset pairs. This halves the index for large keys. Small
+ * keys are stored inline in the index and keep the default layout.
+ */
+template <typename K, typename V>
+struct use_compact_index : std::false_type {};
+
 // std::mutex v_blocks_lock;
 
 template <typename K, typename V>
@@ -355,13 +499,34 @@ class Viper {
     static std::unique_ptr<Viper<K, V>> create(const std::string& pool_file, uint64_t initial_pool_size,
                                                             ViperConfig v_config = ViperConfig{});
     static std::unique_ptr<Viper<K, V>> open(const std::string& pool_file, ViperConfig v_config = ViperConfig{});
+
+    /**
+     * Create/open one pool per NUMA node, given in node order. Clients allocate their blocks from the pool of
+     * the node they are running on, while the index stays global.
+     */
+    static std::unique_ptr<Viper<K, V>> create(const std::vector<std::string>& pool_files,
+                                               uint64_t initial_pool_size_per_node, ViperConfig v_config = ViperConfig{});
+    static std::unique_ptr<Viper<K, V>> open(const std::vector<std::string>& pool_files,
+                                             ViperConfig v_config = ViperConfig{});
+
     Viper(ViperBase v_base, std::filesystem::path pool_dir, bool owns_pool, ViperConfig v_config);
+    Viper(std::vector<ViperBase> v_bases, std::vector<std::filesystem::path> pool_dirs,
+          bool owns_pool, ViperConfig v_config);
     ~Viper();
 
-    cceh::CCEH<K> map_;
+    using IndexT = std::conditional_t<use_compact_index<K, V>::value, cceh::CompactCCEH<K>, cceh::CCEH<K>>;
+    IndexT map_;
 
     void reclaim();
 
+    /**
+     * Reclaim sparse blocks, move the live blocks of each pool in front of its free ones and release the
+     * storage of tail chunks that hold no live blocks. Returns the size released by this call. Must not be called
+     * while clients are active. Variable-size records cannot be moved yet, so this does not compile for
+     * Viper<std::string, std::string>.
+     */
+    size_t shrink();
+
     class ReadOnlyClient {
         friend class Viper<K, V>;
       public:
@@ -405,6 +570,9 @@ class Viper {
         void free_occupied_slot(const KVOffset offset_to_delete, const K& key, const bool delete_offset = false);
         void invalidate_record(VPage* v_page, const data_offset_size_t data_offset);
 
+        template <typename UpdateFn>
+        bool update_out_of_place(const K& key, UpdateFn update_fn);
+
         enum PageStrategy : uint8_t { BlockBased, DimmBased };
 
         PageStrategy strategy_;
@@ -431,43 +599,66 @@ class Viper {
     ReadOnlyClient get_read_only_client();
 
   protected:
+    struct NodePool {
+        NodePool(ViperBase v_base, std::filesystem::path pool_dir) : v_base{v_base}, pool_dir{std::move(pool_dir)} {}
+
+        ViperBase v_base;
+        const std::filesystem::path pool_dir;
+
+        // Global numbers of the blocks in this pool. The block number in current_block_page indexes into this.
+        std::vector<block_size_t> blocks;
+        std::atomic<size_t> num_blocks{0};
+        std::atomic<offset_size_t> current_block_page{0};
+        moodycamel::ConcurrentQueue<block_size_t> free_blocks;
+        // Mappings whose storage shrink() released. They are backed again once the pool hands out their blocks.
+        std::vector<bool> released_mappings;
+
+        std::atomic<bool> is_resizing{false};
+        std::unique_ptr<std::thread> resize_thread;
+    };
+
     static ViperBase init_pool(const std::string& pool_file, uint64_t pool_size,
                                bool is_new_pool, ViperConfig v_config);
 
-    void get_new_access_information(Client* client);
-    void get_block_based_access(Client* client);
+    NodePool& get_new_access_information(Client* client);
+    void get_block_based_access(Client* client, NodePool& pool);
     void get_new_var_size_access_information(Client* client);
-    KVOffset get_new_block();
+    KVOffset get_new_block(NodePool& pool);
+    NodePool& local_pool();
     void remove_client(Client* client);
 
-    ViperFileMapping allocate_v_page_blocks();
-    void add_v_page_blocks(ViperFileMapping mapping);
+    ViperFileMapping allocate_v_page_blocks(NodePool& pool);
+    void add_v_page_blocks(NodePool& pool, ViperFileMapping mapping);
     void recover_database();
-    void trigger_resize();
+    void trigger_resize(NodePool& pool);
     void trigger_reclaim(size_t num_reclaim_ops);
     void compact(Client& client, VPageBlock* v_block);
+    void mark_block_free(VPageBlock* v_block);
+    void move_block(block_size_t from_block, block_size_t to_block);
+    bool holds_records(const VPageBlock* v_block);
+    size_t release_unused_chunks(NodePool& pool, block_size_t prev_num_used_blocks, block_size_t num_used_blocks);
 
     bool check_key_equality(const K& key, const KVOffset offset_to_compare);
+    [[noreturn]] void checksum_mismatch(KVOffset offset) const;
 
-    ViperBase v_base_;
+    std::vector<std::unique_ptr<NodePool>> pools_;
     const bool owns_pool_;
     ViperConfig v_config_;
-    std::filesystem::path pool_dir_;
 
     // cceh::CCEH<K> map_;
     static constexpr bool using_fp = requires_fingerprint(K);
+    static constexpr bool using_checksums = use_checksums<K, V>::value;
+    static_assert(!using_checksums || !std::is_same_v<K, std::string>, "Checksums need fixed-size records.");
 
     std::vector<VPageBlock*> v_blocks_;
     std::atomic<size_t> num_v_blocks_;
     std::atomic<size_t> current_size_;
     std::atomic<size_t> reclaimable_ops_;
-    std::atomic<offset_size_t> current_block_page_;
-    moodycamel::ConcurrentQueue<block_size_t> free_blocks_;
 
     const double resize_threshold_;
-    std::atomic<bool> is_resizing_;
-    std::unique_ptr<std::thread> resize_thread_;
     std::atomic<bool> is_v_blocks_resizing_;
+    // Pools resize independently, so their appends to v_blocks_ must not interleave.
+    std::mutex v_blocks_mutex_;
 
     const size_t reclaim_threshold_;
     std::atomic<bool> is_reclaiming_;
@@ -491,44 +682,98 @@ std::unique_ptr<Viper<K, V>> Viper<K, V>::open(const std::string& pool_file, Vip
     return std::make_unique<Viper<K, V>>(init_pool(pool_file, 0, false, v_config), pool_file, true, v_config);
 }
 
+template <typename K, typename V>
+std::unique_ptr<Viper<K, V>> Viper<K, V>::create(const std::vector<std::string>& pool_files,
+                                                 uint64_t initial_pool_size_per_node, ViperConfig v_config) {
+    std::vector<ViperBase> v_bases;
+    std::vector<std::filesystem::path> pool_dirs;
+    for (const std::string& pool_file : pool_files) {
+        v_bases.push_back(init_pool(pool_file, initial_pool_size_per_node, true, v_config));
+        pool_dirs.emplace_back(pool_file);
+    }
+    return std::make_unique<Viper<K, V>>(std::move(v_bases), std::move(pool_dirs), true, v_config);
+}
+
+template <typename K, typename V>
+std::unique_ptr<Viper<K, V>> Viper<K, V>::open(const std::vector<std::string>& pool_files, ViperConfig v_config) {
+    std::vector<ViperBase> v_bases;
+    std::vector<std::filesystem::path> pool_dirs;
+    for (const std::string& pool_file : pool_files) {
+        v_bases.push_back(init_pool(pool_file, 0, false, v_config));
+        pool_dirs.emplace_back(pool_file);
+    }
+    return std::make_unique<Viper<K, V>>(std::move(v_bases), std::move(pool_dirs), true, v_config);
+}
+
 template <typename K, typename V>
 Viper<K, V>::Viper(ViperBase v_base, const std::filesystem::path pool_dir, const bool owns_pool, const ViperConfig v_config) :
-    v_base_{v_base}, map_{131072}, owns_pool_{owns_pool}, v_config_{v_config}, pool_dir_{pool_dir},
+    Viper{std::vector<ViperBase>{v_base}, std::vector<std::filesystem::path>{pool_dir}, owns_pool, v_config} {}
+
+template <typename K, typename V>
+Viper<K, V>::Viper(std::vector<ViperBase> v_bases, std::vector<std::filesystem::path> pool_dirs,
+                   const bool owns_pool, const ViperConfig v_config) :
+    map_{131072}, owns_pool_{owns_pool}, v_config_{v_config},
     resize_threshold_{v_config.resize_threshold}, reclaim_threshold_{v_config.reclaim_threshold},
     num_recovery_threads_{v_config.num_recovery_threads} {
 
-    current_block_page_ = 0;
     current_size_ = 0;
     reclaimable_ops_ = 0;
-    is_resizing_ = false;
     is_reclaiming_ = false;
     num_active_clients_ = 0;
 
     std::srand(std::time(nullptr));
 
-    if (v_base_.v_mappings.empty()) {
-        throw new std::runtime_error("Need to have at least one memory section mapped.");
+    if constexpr (use_compact_index<K, V>::value) {
+        map_.SetKeyHashFn([this](const KVOffset offset) {
+            const auto entry = get_read_only_client().get_const_entry_from_offset(offset);
+            if constexpr (std::is_pointer_v<typename KeyAccessor<K>::checker_type>) {
+                return cceh::h(entry.first, sizeof(K));
+            } else {
+                return cceh::h(entry.first.data(), entry.first.length());
+            }
+        });
+    }
+
+    if (v_bases.empty() || v_bases.size() != pool_dirs.size()) {
+        throw std::runtime_error("Need one pool directory per pool.");
     }
 
-    for (ViperFileMapping mapping : v_base_.v_mappings) {
-        add_v_page_blocks(mapping);
+    bool is_new_db = true;
+    for (size_t pool_num = 0; pool_num < v_bases.size(); ++pool_num) {
+        if (v_bases[pool_num].v_mappings.empty()) {
+            throw std::runtime_error("Need to have at least one memory section mapped.");
+        }
+        pools_.push_back(std::make_unique<NodePool>(v_bases[pool_num], pool_dirs[pool_num]));
+        NodePool& pool = *pools_.back();
+        if (v_config_.prefault) {
+            internal::prefault_mappings(pool.v_base.v_mappings, v_config_.num_prefault_threads);
+        }
+        for (ViperFileMapping mapping : pool.v_base.v_mappings) {
+            add_v_page_blocks(pool, mapping);
+        }
+        is_new_db &= pool.v_base.is_new_db;
     }
 
-    if (!v_base_.is_new_db) {
+    if (!is_new_db) {
         DEBUG_LOG("Recovering existing database.");
         recover_database();
     }
-    current_block_page_ = KVOffset{v_base.v_metadata->num_used_blocks.load(LOAD_ORDER), 0, 0}.offset;
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        pool->current_block_page = KVOffset{pool->v_base.v_metadata->num_used_blocks.load(LOAD_ORDER), 0, 0}.offset;
+    }
 }
 
 template <typename K, typename V>
 Viper<K, V>::~Viper() {
     if (owns_pool_) {
-        auto ret = munmap(v_base_.v_metadata, v_base_.v_metadata->alloc_size);
-        for (const ViperFileMapping& mapping : v_base_.v_mappings) {
-            munmap(mapping.start_addr, mapping.mapped_size);
+        for (const std::unique_ptr<NodePool>& pool : pools_) {
+            const ViperBase& v_base = pool->v_base;
+            munmap(v_base.v_metadata, v_base.v_metadata->alloc_size);
+            for (const ViperFileMapping& mapping : v_base.v_mappings) {
+                munmap(mapping.start_addr, mapping.mapped_size);
+            }
+            close(v_base.file_descriptor);
         }
-        close(v_base_.file_descriptor);
     }
 }
 
@@ -612,6 +857,7 @@ ViperInitData init_devdax_pool(const std::string& pool_file, uint64_t pool_size,
 
     void* pmem_addr = mmap(nullptr, pool_size, VIPER_MAP_PROT, VIPER_MAP_FLAGS, fd, 0);
     MMAP_CHECK(pmem_addr)
+    internal::check_mapping_alignment(pmem_addr, pool_size);
 
     if (is_new_pool) {
         ViperFileMetadata v_metadata{ .block_offset = PAGE_SIZE, .block_size = block_size,
@@ -706,6 +952,7 @@ ViperInitData init_file_pool(const std::string& pool_dir, uint64_t pool_size,
 
         void* pmem_addr = mmap(nullptr, alloc_size, VIPER_MAP_PROT, VIPER_MAP_FLAGS, data_fd, 0);
         MMAP_CHECK(pmem_addr)
+        internal::check_mapping_alignment(pmem_addr, alloc_size);
         ViperFileMapping mapping{.mapped_size = alloc_size, .start_addr = (char*) pmem_addr};
         mappings.push_back(mapping);
         ::close(data_fd);
@@ -755,16 +1002,17 @@ ViperBase Viper<K, V>::init_pool(const std::string& pool_file, uint64_t pool_siz
 }
 
 template <typename K, typename V>
-ViperFileMapping Viper<K, V>::allocate_v_page_blocks() {
-    const size_t alloc_size = v_base_.v_metadata->alloc_size;
+ViperFileMapping Viper<K, V>::allocate_v_page_blocks(NodePool& pool) {
+    ViperBase& v_base = pool.v_base;
+    const size_t alloc_size = v_base.v_metadata->alloc_size;
 
     void* pmem_addr;
 #ifdef VIPER_DRAM
     pmem_addr = mmap(nullptr, alloc_size, VIPER_MAP_PROT, VIPER_DRAM_MAP_FLAGS, -1, 0);
 #else
-    if (v_base_.is_file_based) {
-        size_t next_file_id = v_base_.v_metadata->total_mapped_size / alloc_size;
-        std::filesystem::path data_file = pool_dir_ / ("data" + std::to_string(next_file_id));
+    if (v_base.is_file_based) {
+        size_t next_file_id = v_base.v_metadata->total_mapped_size / alloc_size;
+        std::filesystem::path data_file = pool.pool_dir / ("data" + std::to_string(next_file_id));
         DEBUG_LOG("Added data file " << data_file);
         const int data_fd = ::open(data_file.c_str(), VIPER_FILE_OPEN_FLAGS, 0644);
         if (data_fd < 0) {
@@ -776,44 +1024,73 @@ ViperFileMapping Viper<K, V>::allocate_v_page_blocks() {
         pmem_addr = mmap(nullptr, alloc_size, VIPER_MAP_PROT, VIPER_MAP_FLAGS, data_fd, 0);
         ::close(data_fd);
     } else {
-        const size_t offset = v_base_.v_metadata->total_mapped_size;
-        const int fd = v_base_.file_descriptor;
+        const size_t offset = v_base.v_metadata->total_mapped_size;
+        const int fd = v_base.file_descriptor;
         pmem_addr = mmap(nullptr, alloc_size, VIPER_MAP_PROT, VIPER_MAP_FLAGS, fd, offset);
     }
 #endif
 
     MMAP_CHECK(pmem_addr)
+#ifndef VIPER_DRAM
+    internal::check_mapping_alignment(pmem_addr, alloc_size);
+#endif
     const block_size_t num_blocks_to_map = alloc_size / sizeof(VPageBlock);
-    v_base_.v_metadata->num_allocated_blocks += num_blocks_to_map;
-    v_base_.v_metadata->total_mapped_size += alloc_size;
-    internal::pmem_persist(v_base_.v_metadata, sizeof(ViperFileMetadata));
+    v_base.v_metadata->num_allocated_blocks += num_blocks_to_map;
+    v_base.v_metadata->total_mapped_size += alloc_size;
+    internal::pmem_persist(v_base.v_metadata, sizeof(ViperFileMetadata));
     DEBUG_LOG("Allocated " << num_blocks_to_map << " blocks in " << (alloc_size / ONE_GB) << " GiB.");
 
     ViperFileMapping mapping{alloc_size, pmem_addr};
-    v_base_.v_mappings.push_back(mapping);
+    v_base.v_mappings.push_back(mapping);
     return mapping;
 }
 
 template <typename K, typename V>
-void Viper<K, V>::add_v_page_blocks(ViperFileMapping mapping) {
+void Viper<K, V>::add_v_page_blocks(NodePool& pool, ViperFileMapping mapping) {
     VPageBlock* start_block = reinterpret_cast<VPageBlock*>(mapping.start_addr);
     const block_size_t num_blocks_to_map = mapping.mapped_size / sizeof(VPageBlock);
 
+    std::lock_guard<std::mutex> v_blocks_lock{v_blocks_mutex_};
+    const block_size_t first_block = v_blocks_.size();
     is_v_blocks_resizing_.store(true, STORE_ORDER);
     v_blocks_.reserve(v_blocks_.size() + num_blocks_to_map);
+    pool.blocks.reserve(pool.blocks.size() + num_blocks_to_map);
     is_v_blocks_resizing_.store(false, STORE_ORDER);
     for (block_size_t block_offset = 0; block_offset < num_blocks_to_map; ++block_offset) {
         v_blocks_.push_back(start_block + block_offset);
+        pool.blocks.push_back(first_block + block_offset);
     }
     num_v_blocks_.store(v_blocks_.size(), STORE_ORDER);
+    pool.num_blocks.store(pool.blocks.size(), STORE_ORDER);
 }
 
 template <typename K, typename V>
 void Viper<K, V>::recover_database() {
     auto start = std::chrono::steady_clock::now();
 
-    const block_size_t num_used_blocks = v_base_.v_metadata->num_used_blocks.load(LOAD_ORDER);
+    // Each pool hands out its blocks in order, so the first num_used_blocks of every pool may hold data.
+    std::vector<block_size_t> used_blocks;
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        const size_t num_pool_used_blocks = std::min<size_t>(
+            pool->v_base.v_metadata->num_used_blocks.load(LOAD_ORDER), pool->blocks.size());
+        for (size_t pool_block = 0; pool_block < num_pool_used_blocks; ++pool_block) {
+            const block_size_t block_num = pool->blocks[pool_block];
+            VPageBlock* v_block = v_blocks_[block_num];
+            if (v_block->is_unused()) {
+                // Freed by reclaim() or shrink() before the restart, so it can be handed out again.
+                pool->free_blocks.enqueue(block_num);
+                continue;
+            }
+            // No client survives a restart.
+            v_block->v_pages[0].version_lock &= NO_CLIENT_BIT;
+            used_blocks.push_back(block_num);
+        }
+    }
+    const block_size_t num_used_blocks = used_blocks.size();
     DEBUG_LOG("Re-inserting values from " << num_used_blocks << " block(s).");
+    if (num_used_blocks == 0) {
+        return;
+    }
     const size_t num_rec_threads = std::min(num_used_blocks, (size_t) num_recovery_threads_);
 
     std::vector<std::thread> recovery_threads;
@@ -821,9 +1098,11 @@ void Viper<K, V>::recover_database() {
 
     auto key_check_fn = [&](auto key, auto offset) { return check_key_equality(key, offset); };
 
+    std::atomic<size_t> num_corrupted_entries = 0;
     auto recover = [&](const size_t thread_num, const block_size_t start_block, const block_size_t end_block) {
         size_t num_entries = 0;
-        for (block_size_t block_num = start_block; block_num < end_block; ++block_num) {
+        for (block_size_t used_block = start_block; used_block < end_block; ++used_block) {
+            const block_size_t block_num = used_blocks[used_block];
             VPageBlock* block = v_blocks_[block_num];
             for (page_size_t page_num = 0; page_num < num_pages_per_block; ++page_num) {
                 const VPage& page = block->v_pages[page_num];
@@ -838,6 +1117,15 @@ void Viper<K, V>::recover_database() {
                     }
 
                     // Data is present
+                    if constexpr (using_checksums) {
+                        // Updates of checksummed records are out of place, so only a torn put that never
+                        // completed fails here.
+                        const typename VPage::VEntry& entry = page.data[slot_num];
+                        if (!entry.is_valid(entry.second)) {
+                            num_corrupted_entries++;
+                            continue;
+                        }
+                    }
                     const K& key = page.data[slot_num].first;
                     const KVOffset offset{block_num, page_num, slot_num};
                     map_.Insert(key, offset, key_check_fn);
@@ -864,6 +1152,9 @@ void Viper<K, V>::recover_database() {
     auto end = std::chrono::steady_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
     DEBUG_LOG("RECOVERY DURATION: " << duration << " ms.");
+    if (num_corrupted_entries > 0) {
+        std::cerr << "Dropped " << num_corrupted_entries << " record(s) with invalid checksums." << std::endl;
+    }
     DEBUG_LOG("Re-inserted " << current_size_.load(LOAD_ORDER) << " keys.");
 }
 
@@ -874,16 +1165,33 @@ void Viper<std::string, std::string>::recover_database() {
 }
 
 template <typename K, typename V>
-void Viper<K, V>::get_new_access_information(Client* client) {
+typename Viper<K, V>::NodePool& Viper<K, V>::get_new_access_information(Client* client) {
     // Get insert/delete count info
     client->info_sync(true);
 
-    const KVOffset block_page{current_block_page_.load(LOAD_ORDER)};
-    if (block_page.block_number > resize_threshold_ * v_blocks_.size()) {
-        trigger_resize();
+    NodePool& pool = local_pool();
+    const KVOffset block_page{pool.current_block_page.load(LOAD_ORDER)};
+    if (block_page.block_number > resize_threshold_ * pool.num_blocks.load(LOAD_ORDER)) {
+        trigger_resize(pool);
     }
 
-    get_block_based_access(client);
+    get_block_based_access(client, pool);
+    return pool;
+}
+
+template <typename K, typename V>
+typename Viper<K, V>::NodePool& Viper<K, V>::local_pool() {
+    if (pools_.size() == 1) {
+        return *pools_[0];
+    }
+
+    // Threads may migrate between nodes, so look up the node whenever a client needs a new block.
+    unsigned int cpu;
+    unsigned int node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) {
+        node = 0;
+    }
+    return *pools_[node % pools_.size()];
 }
 
 template <typename K, typename V>
@@ -892,22 +1200,24 @@ void Viper<K, V>::get_new_var_size_access_information(Client* client) {
         throw std::runtime_error("Cannot update var pages for fixed-size entries.");
     }
 
-    get_new_access_information(client);
+    NodePool& pool = get_new_access_information(client);
     client->v_page_->next_insert_offset = 0;
 
-    v_base_.v_metadata->num_used_blocks.fetch_add(1);
-    internal::pmem_persist(v_base_.v_metadata, sizeof(ViperFileMetadata));
+    pool.v_base.v_metadata->num_used_blocks.fetch_add(1);
+    internal::pmem_persist(pool.v_base.v_metadata, sizeof(ViperFileMetadata));
 }
 
 template <typename K, typename V>
-void Viper<K, V>::get_block_based_access(Client* client) {
+void Viper<K, V>::get_block_based_access(Client* client, NodePool& pool) {
     block_size_t client_block = -1;
     page_size_t client_page = 0;
-    if (!free_blocks_.try_dequeue(client_block)) {
+    bool is_new_block = false;
+    if (!pool.free_blocks.try_dequeue(client_block)) {
         // No free block available, get new one.
-        const KVOffset new_block = get_new_block();
+        const KVOffset new_block = get_new_block(pool);
         client_block = new_block.block_number;
         client_page = new_block.page_number;
+        is_new_block = true;
     }
     assert(client_block != -1);
 
@@ -930,13 +1240,16 @@ void Viper<K, V>::get_block_based_access(Client* client) {
     client->v_page_->init();
     client->v_block_->v_pages[0].version_lock |= CLIENT_BIT;
 
-    v_base_.v_metadata->num_used_blocks.fetch_add(1, std::memory_order_relaxed);
-    internal::pmem_persist(v_base_.v_metadata, sizeof(ViperFileMetadata));
+    if (is_new_block) {
+        // Free blocks lie below the pool's high-water mark and are already counted.
+        pool.v_base.v_metadata->num_used_blocks.fetch_add(1, std::memory_order_relaxed);
+        internal::pmem_persist(pool.v_base.v_metadata, sizeof(ViperFileMetadata));
+    }
 }
 
 template <typename K, typename V>
-KeyValueOffset Viper<K, V>::get_new_block() {
-    offset_size_t raw_block_page = current_block_page_.load(LOAD_ORDER);
+KeyValueOffset Viper<K, V>::get_new_block(NodePool& pool) {
+    offset_size_t raw_block_page = pool.current_block_page.load(LOAD_ORDER);
     KVOffset new_offset{};
     block_size_t client_block;
     do {
@@ -944,10 +1257,10 @@ KeyValueOffset Viper<K, V>::get_new_block() {
         client_block = v_block_page.block_number;
 
         const block_size_t new_block = client_block + 1;
-        while (client_block >= num_v_blocks_.load(LOAD_ORDER)) {
+        while (client_block >= pool.num_blocks.load(LOAD_ORDER)) {
             asm("nop");
         }
-        assert(new_block < v_blocks_.size());
+        assert(new_block < pool.blocks.size());
 
         // Choose random offset to evenly distribute load on all DIMMs
         page_size_t new_page = 0;
@@ -955,30 +1268,39 @@ KeyValueOffset Viper<K, V>::get_new_block() {
             new_page = rand() % num_pages_per_block;
         }
         new_offset = KVOffset{new_block, new_page, 0};
-    } while (!current_block_page_.compare_exchange_weak(raw_block_page, new_offset.offset));
+    } while (!pool.current_block_page.compare_exchange_weak(raw_block_page, new_offset.offset));
+
+    while (is_v_blocks_resizing_.load(std::memory_order_acquire)) {
+        // Wait for vector's memmove to complete. Otherwise we might encounter a segfault.
+        asm("nop");
+    }
 
-    return KVOffset{raw_block_page};
+    // The pool counts its blocks locally, but clients and the index use global block numbers.
+    const KVOffset pool_block_page{raw_block_page};
+    return KVOffset{pool.blocks[pool_block_page.block_number], pool_block_page.page_number, 0};
 }
 
 template <typename K, typename V>
-void Viper<K, V>::trigger_resize() {
+void Viper<K, V>::trigger_resize(NodePool& pool) {
     bool expected_resizing = false;
-    const bool should_resize = is_resizing_.compare_exchange_strong(expected_resizing, true);
+    const bool should_resize = pool.is_resizing.compare_exchange_strong(expected_resizing, true);
     if (!should_resize) {
         return;
     }
 
-    // Only one thread can ever get here because for all others the atomic exchange above fails.
-    resize_thread_ = std::make_unique<std::thread>([this] {
+    // Only one thread per pool can ever get here because for all others the atomic exchange above fails.
+    pool.resize_thread = std::make_unique<std::thread>([this, &pool] {
         DEBUG_LOG("Start resizing.");
-        ViperFileMapping mapping = allocate_v_page_blocks();
-        // v_blocks_lock.lock();
-        add_v_page_blocks(mapping);
-        // v_blocks_lock.unlock();
-        is_resizing_.store(false, STORE_ORDER);
+        ViperFileMapping mapping = allocate_v_page_blocks(pool);
+        if (v_config_.prefault) {
+            // Clients only see the new blocks once they are added, so they never fault on them.
+            internal::prefault_mappings({mapping}, v_config_.num_prefault_threads);
+        }
+        add_v_page_blocks(pool, mapping);
+        pool.is_resizing.store(false, STORE_ORDER);
         DEBUG_LOG("End resizing.");
     });
-    resize_thread_->detach();
+    pool.resize_thread->detach();
 }
 
 template <typename K, typename V>
@@ -1036,6 +1358,13 @@ void Viper<K, V>::remove_client(Viper::Client* client) {
     --num_active_clients_;
 }
 
+template <typename K, typename V>
+void Viper<K, V>::checksum_mismatch(const KVOffset offset) const {
+    // Readers only report a mismatch if the page version shows that they did not race with a writer.
+    throw std::runtime_error("Checksum mismatch in block " + std::to_string(offset.block_number) + ", page "
+                             + std::to_string(offset.page_number) + ", slot " + std::to_string(offset.data_offset));
+}
+
 template <typename K, typename V>
 inline bool Viper<K, V>::check_key_equality(const K& key, const KVOffset offset_to_compare) {
     if constexpr (!using_fp) {
@@ -1073,6 +1402,9 @@ bool Viper<K, V>::Client::put(const K& key, const V& value, const bool delete_ol
     // We have found a free slot on this page. Persist data.
     v_page_->data[free_slot_idx] = {key, value};
     typename VPage::VEntry* entry_ptr = v_page_->data.data() + free_slot_idx;
+    if constexpr (using_checksums) {
+        entry_ptr->update_checksum();
+    }
     internal::pmem_persist(entry_ptr, sizeof(typename VPage::VEntry));
 
     free_slots->reset(free_slot_idx);
@@ -1297,6 +1629,11 @@ bool Viper<K, V>::Client::update(const K& key, UpdateFn update_fn) {
         else { return cceh::CCEH<K>::dummy_key_check(key, offset); }
     };
 
+    if constexpr (using_checksums) {
+        // A crash during an in-place update would leave a record that fails its checksum.
+        return update_out_of_place(key, update_fn);
+    }
+
     while (true) {
         const KVOffset kv_offset = this->viper_.map_.Get(key, key_check_fn);
         if (kv_offset.is_tombstone()) {
@@ -1316,6 +1653,76 @@ bool Viper<K, V>::Client::update(const K& key, UpdateFn update_fn) {
     }
 }
 
+template <typename K, typename V>
+template <typename UpdateFn>
+bool Viper<K, V>::Client::update_out_of_place(const K& key, UpdateFn update_fn) {
+    auto key_check_fn = [&](auto key, auto offset) {
+        if constexpr (using_fp) { return this->viper_.check_key_equality(key, offset); }
+        else { return cceh::CCEH<K>::dummy_key_check(key, offset); }
+    };
+
+    while (true) {
+        // Lock our page first, like put does.
+        v_page_->lock();
+        std::bitset<VPage::num_slots_per_page>* free_slots = &v_page_->free_slots;
+        const data_offset_size_t free_slot_idx = free_slots->_Find_first();
+        if (free_slot_idx >= free_slots->size()) {
+            v_page_->unlock();
+            update_access_information();
+            continue;
+        }
+
+        const KVOffset kv_offset = this->viper_.map_.Get(key, key_check_fn);
+        if (kv_offset.is_tombstone()) {
+            v_page_->unlock();
+            return false;
+        }
+
+        const auto [block, page, slot] = kv_offset.get_offsets();
+        VPage& old_page = this->viper_.v_blocks_[block]->v_pages[page];
+        const bool is_own_page = &old_page == v_page_;
+        if (!is_own_page && !old_page.lock(false)) {
+            // Back off, the client holding the old page may be waiting for ours.
+            v_page_->unlock();
+            continue;
+        }
+
+        auto unlock_pages = [&] {
+            if (!is_own_page) {
+                old_page.unlock();
+            }
+            v_page_->unlock();
+        };
+
+        if (this->viper_.map_.Get(key, key_check_fn) != kv_offset) {
+            // The record moved before we locked its page.
+            unlock_pages();
+            continue;
+        }
+
+        const typename VPage::VEntry& old_entry = old_page.data[slot];
+        if (!old_entry.is_valid(old_entry.second)) {
+            unlock_pages();
+            this->viper_.checksum_mismatch(kv_offset);
+        }
+
+        // The old record stays valid until the new one is persisted. A crash in between leaves both, as in put.
+        typename VPage::VEntry* entry_ptr = v_page_->data.data() + free_slot_idx;
+        *entry_ptr = old_entry;
+        update_fn(&entry_ptr->second);
+        entry_ptr->update_checksum();
+        internal::pmem_persist(entry_ptr, sizeof(typename VPage::VEntry));
+
+        free_slots->reset(free_slot_idx);
+        internal::pmem_persist(free_slots, sizeof(*free_slots));
+
+        this->viper_.map_.Insert(key, KVOffset{v_block_number_, v_page_number_, free_slot_idx}, key_check_fn);
+        invalidate_record(&old_page, slot);
+        unlock_pages();
+        return true;
+    }
+}
+
 /**
  * Delete the value for a given `key`.
  * Returns true if the item was deleted or false if not.
@@ -1580,20 +1987,38 @@ inline bool Viper<K, V>::ReadOnlyClient::get_const_value_from_offset(KVOffset of
     } else {
         *value = *(entry.second);
     }
-    return lock_val == page_lock.load(LOAD_ORDER);
+    bool is_valid = true;
+    if constexpr (using_checksums) {
+        is_valid = v_page.data[slot].is_valid(*value);
+    }
+    if (lock_val != page_lock.load(LOAD_ORDER)) {
+        return false;
+    }
+    if (!is_valid) {
+        this->viper_.checksum_mismatch(offset);
+    }
+    return true;
 }
 
 /** Return the total number of used bytes in PMem */
 template<typename K, typename V>
 size_t Viper<K, V>::ReadOnlyClient::get_total_used_pmem() const {
-    // + PAGE_SIZE for metadata block
-    return (this->viper_.v_base_.v_metadata->num_used_blocks * sizeof(VPageBlock)) + PAGE_SIZE;
+    size_t used_pmem = 0;
+    for (const std::unique_ptr<NodePool>& pool : this->viper_.pools_) {
+        // + PAGE_SIZE for metadata block
+        used_pmem += (pool->v_base.v_metadata->num_used_blocks * sizeof(VPageBlock)) + PAGE_SIZE;
+    }
+    return used_pmem;
 }
 
 /** Return the total number of allocated bytes in PMem */
 template<typename K, typename V>
 size_t Viper<K, V>::ReadOnlyClient::get_total_allocated_pmem() const {
-    return this->viper_.v_base_.v_metadata->total_mapped_size;
+    size_t allocated_pmem = 0;
+    for (const std::unique_ptr<NodePool>& pool : this->viper_.pools_) {
+        allocated_pmem += pool->v_base.v_metadata->total_mapped_size;
+    }
+    return allocated_pmem;
 }
 
 template <typename K, typename V>
@@ -1609,8 +2034,15 @@ inline bool Viper<K, V>::Client::get_value_from_offset(const KVOffset offset, V*
         return false;
     }
     *value = v_page.data[slot].second;
+    bool is_valid = true;
+    if constexpr (using_checksums) {
+        is_valid = v_page.data[slot].is_valid(*value);
+    }
     auto result = lock_val == page_lock.load(LOAD_ORDER);
     // v_blocks_lock.unlock();
+    if (result && !is_valid) {
+        this->viper_.checksum_mismatch(offset);
+    }
     return result;
 }
 
@@ -1731,34 +2163,189 @@ void Viper<std::string, std::string>::compact(Client& client, VPageBlock* v_bloc
     v_page->unlock();
 }
 
+template <typename K, typename V>
+void Viper<K, V>::mark_block_free(VPageBlock* v_block) {
+    // A block without used pages is free, so recovery can put it back on the free list.
+    for (VPage& v_page : v_block->v_pages) {
+        v_page.version_lock.store(0, STORE_ORDER);
+        internal::pmem_persist(&v_page.version_lock, sizeof(version_lock_t));
+    }
+}
+
+template <typename K, typename V>
+void Viper<K, V>::move_block(const block_size_t from_block, const block_size_t to_block) {
+    VPageBlock* from = v_blocks_[from_block];
+    VPageBlock* to = v_blocks_[to_block];
+
+    // Copy first and free the source last, so a crash in between leaves duplicates instead of losing records.
+    internal::pmem_memcpy_persist(to, from, sizeof(VPageBlock));
+
+    auto key_check_fn = [&](auto key, auto offset) {
+        if constexpr (using_fp) { return check_key_equality(key, offset); }
+        else { return cceh::CCEH<K>::dummy_key_check(key, offset); }
+    };
+
+    for (page_size_t page_num = 0; page_num < num_pages_per_block; ++page_num) {
+        const VPage& from_page = from->v_pages[page_num];
+        VPage& to_page = to->v_pages[page_num];
+        for (data_offset_size_t slot_num = 0; slot_num < VPage::num_slots_per_page; ++slot_num) {
+            if (from_page.free_slots[slot_num]) {
+                continue;
+            }
+
+            const K& key = from_page.data[slot_num].first;
+            const KVOffset from_offset{from_block, page_num, slot_num};
+            if (map_.Get(key, key_check_fn) == from_offset) {
+                map_.Insert(key, KVOffset{to_block, page_num, slot_num}, key_check_fn);
+            } else {
+                // Stale record that the index no longer points to.
+                to_page.free_slots[slot_num] = 1;
+            }
+        }
+        internal::pmem_persist(&to_page.free_slots, sizeof(to_page.free_slots));
+    }
+
+    mark_block_free(from);
+}
+
+template <typename K, typename V>
+bool Viper<K, V>::holds_records(const VPageBlock* v_block) {
+    for (const VPage& v_page : v_block->v_pages) {
+        if (IS_BIT_SET(v_page.version_lock, USED_BIT) && !v_page.free_slots.all()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename K, typename V>
+size_t Viper<K, V>::release_unused_chunks(NodePool& pool, const block_size_t prev_num_used_blocks,
+                                          const block_size_t num_used_blocks) {
+    // The chunks stay mapped so that the pool can grow into them again, only their storage is released.
+    const ViperBase& v_base = pool.v_base;
+    pool.released_mappings.resize(v_base.v_mappings.size(), false);
+    size_t released_size = 0;
+    size_t first_block = 0;
+    for (size_t mapping_num = 0; mapping_num < v_base.v_mappings.size(); ++mapping_num) {
+        const ViperFileMapping& mapping = v_base.v_mappings[mapping_num];
+        if (first_block < prev_num_used_blocks) {
+            // Blocks of this chunk were handed out since the last shrink, so it is backed again.
+            pool.released_mappings[mapping_num] = false;
+        }
+        const bool is_unused = first_block >= num_used_blocks;
+        first_block += mapping.mapped_size / sizeof(VPageBlock);
+        if (!is_unused || pool.released_mappings[mapping_num]) {
+            continue;
+        }
+
+#ifdef VIPER_DRAM
+        if (madvise(mapping.start_addr, mapping.mapped_size, MADV_DONTNEED) != 0) {
+            IO_ERROR("Could not release DRAM chunk");
+        }
+#else
+        if (!v_base.is_file_based) {
+            // A devdax device has no filesystem to return space to.
+            continue;
+        }
+        const std::filesystem::path data_file = pool.pool_dir / ("data" + std::to_string(mapping_num));
+        const int data_fd = ::open(data_file.c_str(), O_RDWR);
+        if (data_fd < 0) {
+            IO_ERROR("Cannot open data file: " + data_file.string());
+        }
+        if (fallocate(data_fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, mapping.mapped_size) != 0) {
+            ::close(data_fd);
+            IO_ERROR("Could not punch hole in: " + data_file.string());
+        }
+        ::close(data_fd);
+#endif
+        pool.released_mappings[mapping_num] = true;
+        released_size += mapping.mapped_size;
+    }
+    return released_size;
+}
+
+template <typename K, typename V>
+size_t Viper<K, V>::shrink() {
+    static_assert(!std::is_same_v<K, std::string>, "shrink() does not support variable-size records yet.");
+    if (num_active_clients_.load(LOAD_ORDER) > 0 || is_reclaiming_.load(LOAD_ORDER)) {
+        throw std::runtime_error("Cannot shrink while clients are active.");
+    }
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        if (pool->is_resizing.load(LOAD_ORDER)) {
+            throw std::runtime_error("Cannot shrink while a pool is resizing.");
+        }
+    }
+
+    reclaim();
+
+    size_t released_size = 0;
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        // All free blocks in front are filled below, so the free list starts out empty again.
+        block_size_t free_block;
+        while (pool->free_blocks.try_dequeue(free_block)) {}
+
+        const block_size_t num_used_blocks = KVOffset{pool->current_block_page.load(LOAD_ORDER)}.block_number;
+        block_size_t num_live_blocks = 0;
+        for (block_size_t pool_block = 0; pool_block < num_used_blocks; ++pool_block) {
+            VPageBlock* v_block = v_blocks_[pool->blocks[pool_block]];
+            if (!v_block->is_unused() && !holds_records(v_block)) {
+                // Taken by a client that never wrote to it, like the block reclaim() compacts into.
+                mark_block_free(v_block);
+            }
+            num_live_blocks += !v_block->is_unused();
+        }
+
+        // There are as many free blocks in front of num_live_blocks as there are live blocks behind it.
+        block_size_t front_block = 0;
+        for (block_size_t back_block = num_live_blocks; back_block < num_used_blocks; ++back_block) {
+            if (v_blocks_[pool->blocks[back_block]]->is_unused()) {
+                continue;
+            }
+            while (!v_blocks_[pool->blocks[front_block]]->is_unused()) {
+                ++front_block;
+            }
+            move_block(pool->blocks[back_block], pool->blocks[front_block++]);
+        }
+
+        pool->v_base.v_metadata->num_used_blocks.store(num_live_blocks, STORE_ORDER);
+        internal::pmem_persist(pool->v_base.v_metadata, sizeof(ViperFileMetadata));
+        pool->current_block_page.store(KVOffset{num_live_blocks, 0, 0}.offset, STORE_ORDER);
+        released_size += release_unused_chunks(*pool, num_used_blocks, num_live_blocks);
+        DEBUG_LOG("Shrunk pool from " << num_used_blocks << " to " << num_live_blocks << " block(s).");
+    }
+    return released_size;
+}
+
 template <typename K, typename V>
 void Viper<K, V>::reclaim() {
     const size_t num_slots_per_block = num_pages_per_block * VPage::num_slots_per_page;
-    const block_size_t max_block = KVOffset{current_block_page_.load(LOAD_ORDER)}.block_number;
 
     // At least X percent of the block should be free before reclaiming it.
     const size_t free_threshold = v_config_.reclaim_free_percentage * num_slots_per_block;
     size_t total_freed_blocks = 0;
     Client client = get_client();
 
-    for (block_size_t block_num = 0; block_num < max_block; ++block_num) {
-        VPageBlock* v_block = v_blocks_[block_num];
-        size_t block_free_slots = 0;
-        if (v_block->is_owned() || v_block->is_unused()) {
-            // Block in use by client or already marked as free.
-            continue;
-        }
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        const block_size_t max_block = KVOffset{pool->current_block_page.load(LOAD_ORDER)}.block_number;
+        for (block_size_t pool_block = 0; pool_block < max_block; ++pool_block) {
+            const block_size_t block_num = pool->blocks[pool_block];
+            VPageBlock* v_block = v_blocks_[block_num];
+            size_t block_free_slots = 0;
+            if (v_block->is_owned() || v_block->is_unused()) {
+                // Block in use by client or already marked as free.
+                continue;
+            }
 
-        for (const VPage& v_page : v_block->v_pages) {
-            block_free_slots += v_page.free_slots.count();
-        }
+            for (const VPage& v_page : v_block->v_pages) {
+                block_free_slots += v_page.free_slots.count();
+            }
 
-        if (block_free_slots > free_threshold) {
-            compact(client, v_block);
-            VPage& head_page = v_block->v_pages[0];
-            head_page.version_lock = 0;
-            free_blocks_.enqueue(block_num);
-            total_freed_blocks++;
+            if (block_free_slots > free_threshold) {
+                compact(client, v_block);
+                mark_block_free(v_block);
+                pool->free_blocks.enqueue(block_num);
+                total_freed_blocks++;
+            }
         }
     }
 
@@ -1767,33 +2354,35 @@ void Viper<K, V>::reclaim() {
 
 template <>
 void Viper<std::string, std::string>::reclaim() {
-    const block_size_t max_block = KVOffset{current_block_page_.load(LOAD_ORDER)}.block_number;
     const double modified_threshold = v_config_.reclaim_free_percentage;
     size_t total_freed_blocks = 0;
     Client client = get_client();
 
-    for (block_size_t block_num = 0; block_num < max_block; ++block_num) {
-        VPageBlock* v_block = v_blocks_[block_num];
-        if (v_block->is_owned() || v_block->is_unused()) {
-            // Block in use by client or already marked as free.
-            continue;
-        }
-
-        double modified_percentage = 0;
-        for (const VPage& v_page : v_block->v_pages) {
-            modified_percentage += ((double)v_page.modified_percentage / num_pages_per_block) / 100;
-            if (modified_percentage > modified_threshold) {
-                compact(client, v_block);
-                VPage& head_page = v_block->v_pages[0];
-                head_page.version_lock = 0;
-                free_blocks_.enqueue(block_num);
-                total_freed_blocks++;
-                break;
+    for (const std::unique_ptr<NodePool>& pool : pools_) {
+        const block_size_t max_block = KVOffset{pool->current_block_page.load(LOAD_ORDER)}.block_number;
+        for (block_size_t pool_block = 0; pool_block < max_block; ++pool_block) {
+            const block_size_t block_num = pool->blocks[pool_block];
+            VPageBlock* v_block = v_blocks_[block_num];
+            if (v_block->is_owned() || v_block->is_unused()) {
+                // Block in use by client or already marked as free.
+                continue;
             }
 
-            if (v_page.next_insert_offset != VPage::DATA_SIZE) {
-                // This page has not been completed, so no need to check next one.
-                break;
+            double modified_percentage = 0;
+            for (const VPage& v_page : v_block->v_pages) {
+                modified_percentage += ((double)v_page.modified_percentage / num_pages_per_block) / 100;
+                if (modified_percentage > modified_threshold) {
+                    compact(client, v_block);
+                    mark_block_free(v_block);
+                    pool->free_blocks.enqueue(block_num);
+                    total_freed_blocks++;
+                    break;
+                }
+
+                if (v_page.next_insert_offset != VPage::DATA_SIZE) {
+                    // This page has not been completed, so no need to check next one.
+                    break;
+                }
             }
         }
     }